@@ -3,6 +3,16 @@ ext_dir = "ext"
 
 imgui_dir = "imgui-1.51"
 
+newoption {
+    trigger = "voxel-layout",
+    value = "order",
+    description = "Order of the voxels within a chunk",
+    allowed = {
+        { "row", "x, then y, then z (default)" },
+        { "morton", "Morton order, BMI2 is used when the compiler targets it" },
+    },
+}
+
 workspace (project_name)
     configurations { "debug", "release" }
     language ("C++")
@@ -11,6 +21,7 @@ workspace (project_name)
     floatingpoint ("Fast")
     fpu ("Hardware")
     location ("build/" .. os.get())
+    startproject (project_name)
     symbols ("On")
     targetdir ("bin/%{cfg.system}/%{cfg.buildcfg}")
 
@@ -24,6 +35,9 @@ workspace (project_name)
     filter "action:vs*"
         defines { "_CRT_SECURE_NO_WARNINGS" }
 
+    filter "options:voxel-layout=morton"
+        defines { "VX_VOXEL_MORTON" }
+
 group ("ext")
 
     project ("imgui")
@@ -36,6 +50,36 @@ group ("ext")
 
 group ("")
 
+-- headless batch tool, no SDL or gpu
+project (project_name .. "-cli")
+    kind ("ConsoleApp")
+    warnings ("Extra")
+
+    files {
+        "src/cli/**",
+        "src/common/**",
+        "src/platform/filesystem.*",
+        "src/voxel/**",
+    }
+
+    removefiles {
+        "src/common/mouse.*",
+    }
+
+    includedirs {
+        path.join(ext_dir, "glm-0.9.8.4/glm"),
+        path.join("src"),
+    }
+
+    filter "action:vs*"
+        disablewarnings {
+            "4201", -- nonstandard extension used: nameless struct/union
+        }
+
+    filter "action:gmake"
+        buildoptions { "-std=c++14" }
+        links { "pthread" }
+
 project (project_name)
     kind ("ConsoleApp")
     warnings ("Extra")
@@ -45,6 +89,7 @@ project (project_name)
         "src/platform/**",
         "src/common/**",
         "src/editor/**",
+        "src/voxel/**",
         "src/main.cpp",
         "src/voxed.*"
     }
@@ -64,6 +109,7 @@ project (project_name)
 
     filter "action:gmake"
         buildoptions { "-std=c++14" }
+        links { "pthread" }
 
     filter "system:macosx"
         files {
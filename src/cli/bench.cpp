@@ -0,0 +1,1147 @@
+#include "cli/cli.h"
+#include "cli/voxel_octree.h"
+
+#include "common/intersection.h"
+#include "common/math_utils.h"
+#include "voxel/voxel_brush.h"
+#include "voxel/voxel_clip.h"
+#include "voxel/voxel_components.h"
+#include "voxel/voxel_file.h"
+#include "voxel/voxel_history.h"
+#include "voxel/voxel_mesh_export.h"
+#include "voxel/voxel_mesh_scheduler.h"
+#include "voxel/voxel_mesher.h"
+#include "voxel/voxel_point_cloud.h"
+#include "voxel/voxel_pyramid.h"
+#include "voxel/voxel_raycast.h"
+#include "voxel/voxel_vox.h"
+#include "voxel/voxel_voxelizer.h"
+
+#include <cstring>
+
+namespace vx
+{
+namespace
+{
+const char* bench_usage =
+    "usage: voxed-cli bench [options] [benchmarks...]\n"
+    "\n"
+    "Runs the named benchmarks, or all of them, on generated scenes and prints\n"
+    "the best time of a few runs.\n"
+    "\n"
+    "options:\n"
+    "  --resolution <n>    scene resolution, 256 by default\n"
+    "  --runs <n>          runs per measurement, 3 by default\n"
+    "  -o <dir>            directory for the files written, . by default\n";
+
+const bounds3f scene_bounds{float3{-1.0f}, float3{1.0f}};
+
+struct bench_scene
+{
+    const char* name;
+    voxel_world* world;
+};
+
+struct bench_context
+{
+    i32 runs;
+    const char* temp_dir;
+    bench_scene scenes[2];
+};
+
+u32 next_random(u32* state)
+{
+    // xorshift32
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+float random_unit(u32* state)
+{
+    return (next_random(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+float3 noisy_color(const float3& base, u32* state)
+{
+    return glm::clamp(base + 0.1f * float3{random_unit(state) - 0.5f}, 0.0f, 1.0f);
+}
+
+// a sphere shell a few voxels thick with holes, mostly empty space
+void build_shell(voxel_world* world)
+{
+    const i32 n = world->resolution;
+    const float center = 0.5f * n;
+    const float outer = 0.45f * n;
+    const float inner = outer - std::max(2.0f, 0.02f * n);
+
+    u32 state = 12345;
+    for (int z = 0; z < n; z++)
+        for (int y = 0; y < n; y++)
+            for (int x = 0; x < n; x++)
+            {
+                float3 d = float3{x, y, z} + 0.5f - center;
+                float r2 = glm::dot(d, d);
+                if (r2 > outer * outer || r2 < inner * inner)
+                    continue;
+                if (glm::sin(0.2f * x) * glm::sin(0.2f * z) > 0.8f)
+                    continue;
+
+                float3 base = 0.5f + 0.5f * d / outer;
+                voxel_world_set(world, {x, y, z}, voxel_leaf{noisy_color(base, &state), 1});
+            }
+}
+
+// a solid height field covering the whole floor, mostly full space
+void build_terrain(voxel_world* world)
+{
+    const i32 n = world->resolution;
+    for (int z = 0; z < n; z++)
+        for (int x = 0; x < n; x++)
+        {
+            float u = (float)x / n;
+            float v = (float)z / n;
+            float h = 0.3f + 0.1f * glm::sin(11.0f * u) * glm::cos(7.0f * v) +
+                      0.05f * glm::sin(37.0f * u + 23.0f * v);
+            i32 top = clamp((i32)(h * n), 1, n - 1);
+
+            // grass over dirt
+            voxel_world_fill(
+                world, bounds3i{{x, 0, z}, {x, top - 3, z}}, voxel_leaf{{0.45f, 0.3f, 0.2f}, 1});
+            voxel_world_fill(
+                world, bounds3i{{x, top - 2, z}, {x, top, z}}, voxel_leaf{{0.3f, 0.6f, 0.2f}, 1});
+        }
+}
+
+void report(const bench_scene& scene, const char* name, double ms, const char* detail, ...)
+{
+    char text[256];
+    va_list args;
+    va_start(args, detail);
+    std::vsnprintf(text, sizeof text, detail, args);
+    va_end(args);
+    fprintf(stdout, "%-8s %-28s %10.2f ms  %s\n", scene.name, name, ms, text);
+}
+
+// best time of runs calls to f
+template<typename F>
+double best_ms(i32 runs, F f)
+{
+    double best = 0.0;
+    for (i32 i = 0; i < runs; i++)
+    {
+        double start = cli_time_ms();
+        f();
+        double elapsed = cli_time_ms() - start;
+        if (i == 0 || elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+double megabytes(u64 bytes)
+{
+    return (double)bytes / (1024.0 * 1024.0);
+}
+
+u64 file_size(const char* path)
+{
+    mapped_file file;
+    if (!map_file(path, &file))
+        return 0;
+    u64 size = file.size;
+    unmap_file(&file);
+    return size;
+}
+
+void temp_path(const bench_context* ctx, char* out, usize size, const char* name)
+{
+    std::snprintf(out, size, "%s/voxed-bench-%s", ctx->temp_dir, name);
+}
+
+//
+// benchmarks
+//
+
+// sparse octree against the chunked world: memory and random lookups
+void bench_storage(bench_context* ctx, const bench_scene& scene)
+{
+    const voxel_world* world = scene.world;
+    voxel_octree* octree = voxel_octree_create(world->resolution);
+    double build = best_ms(ctx->runs, [&] { voxel_octree_build(octree, world); });
+    report(scene, "octree build", build, "%u nodes", voxel_octree_node_count(octree));
+
+    const int lookup_count = 1 << 20;
+    array<int3> points(lookup_count);
+    u32 state = 777;
+    for (int i = 0; i < lookup_count; i++)
+        points[i] = int3{float3{random_unit(&state), random_unit(&state), random_unit(&state)} *
+                         (float)world->resolution};
+
+    u32 solid = 0;
+    double flat = best_ms(ctx->runs, [&] {
+        for (int i = 0; i < lookup_count; i++)
+            solid += voxel_world_is_solid(world, points[i]);
+    });
+    report(
+        scene,
+        "world lookups",
+        flat,
+        "%.1f ns each, %.1f MB",
+        1e6 * flat / lookup_count,
+        megabytes(voxel_world_byte_size(world)));
+
+    double tree = best_ms(ctx->runs, [&] {
+        for (int i = 0; i < lookup_count; i++)
+            solid += voxel_octree_is_solid(octree, points[i]);
+    });
+    report(
+        scene,
+        "octree lookups",
+        tree,
+        "%.1f ns each, %.1f MB",
+        1e6 * tree / lookup_count,
+        megabytes(voxel_octree_byte_size(octree)));
+
+    // keeps the lookups from being optimized away
+    if (solid == 0xffffffffu)
+        fprintf(stdout, "\n");
+    voxel_octree_destroy(octree);
+}
+
+// bitmask culling against per-voxel lookups, with and without merging
+void bench_mesh(bench_context* ctx, const bench_scene& scene)
+{
+    struct
+    {
+        const char* name;
+        u32 flags;
+    } variants[] = {
+        {"mesh reference", voxel_mesh_flag_reference},
+        {"mesh", 0},
+        {"mesh greedy", voxel_mesh_flag_greedy},
+    };
+
+    voxel_mesh mesh;
+    for (auto& variant : variants)
+    {
+        double ms =
+            best_ms(ctx->runs, [&] { voxel_mesh_build(&mesh, scene.world, variant.flags); });
+        report(
+            scene,
+            variant.name,
+            ms,
+            "%d vertices, %d triangles",
+            mesh.vertices.size(),
+            mesh.triangles.size());
+    }
+}
+
+// flat DDA against the occupancy pyramid and the octree
+void bench_raycast(bench_context* ctx, const bench_scene& scene)
+{
+    const voxel_world* world = scene.world;
+    voxel_pyramid pyramid;
+    double build = best_ms(ctx->runs, [&] { voxel_pyramid_build(&pyramid, world); });
+    report(
+        scene,
+        "pyramid build",
+        build,
+        "%.1f KB",
+        (double)voxel_pyramid_byte_size(&pyramid) / 1024.0);
+
+    voxel_octree* octree = voxel_octree_create(world->resolution);
+    voxel_octree_build(octree, world);
+
+    // rays from outside the scene through random points inside it
+    const int ray_count = 1 << 16;
+    array<ray> rays(ray_count);
+    u32 state = 4242;
+    for (int i = 0; i < ray_count; i++)
+    {
+        float3 target =
+            float3{random_unit(&state), random_unit(&state), random_unit(&state)} * 1.6f - 0.8f;
+        float3 origin =
+            glm::normalize(
+                float3{random_unit(&state), random_unit(&state), random_unit(&state)} - 0.5f) *
+            3.0f;
+        rays[i] = ray{origin, glm::normalize(target - origin)};
+    }
+
+    array<voxel_raycast_hit> flat_hits(ray_count);
+    array<u8> flat_hit(ray_count);
+    double flat = best_ms(ctx->runs, [&] {
+        for (int i = 0; i < ray_count; i++)
+            flat_hit[i] = voxel_world_raycast(world, rays[i], scene_bounds, &flat_hits[i]);
+    });
+
+    int hit_count = 0;
+    for (int i = 0; i < ray_count; i++)
+        hit_count += flat_hit[i];
+    report(
+        scene,
+        "raycast flat",
+        flat,
+        "%.2f Mrays/s, %d hits",
+        ray_count / (flat * 1e3),
+        hit_count);
+
+    int mismatches = 0;
+    double pyramid_ms = best_ms(ctx->runs, [&] {
+        mismatches = 0;
+        for (int i = 0; i < ray_count; i++)
+        {
+            voxel_raycast_hit hit;
+            bool h = voxel_pyramid_raycast(&pyramid, world, rays[i], scene_bounds, &hit);
+            mismatches += h != (bool)flat_hit[i] ||
+                          (h && hit.voxel_coords != flat_hits[i].voxel_coords);
+        }
+    });
+    report(
+        scene,
+        "raycast pyramid",
+        pyramid_ms,
+        "%.2f Mrays/s, %.1fx, %d differ from flat",
+        ray_count / (pyramid_ms * 1e3),
+        flat / pyramid_ms,
+        mismatches);
+
+    double octree_ms = best_ms(ctx->runs, [&] {
+        for (int i = 0; i < ray_count; i++)
+        {
+            voxel_octree_hit hit;
+            voxel_octree_raycast(octree, rays[i], scene_bounds, &hit);
+        }
+    });
+    report(
+        scene,
+        "raycast octree",
+        octree_ms,
+        "%.2f Mrays/s, %.1fx",
+        ray_count / (octree_ms * 1e3),
+        flat / octree_ms);
+
+    voxel_octree_destroy(octree);
+}
+
+// scalar ray-box tests against the batched ones, without a scene
+void bench_aabb(bench_context* ctx, const bench_scene& scene)
+{
+    const int box_count = 1 << 16;
+    array<float> coords(6 * box_count);
+    u32 state = 99;
+    for (int i = 0; i < box_count; i++)
+    {
+        float3 center = float3{random_unit(&state), random_unit(&state), random_unit(&state)};
+        float extent = 0.01f + 0.02f * random_unit(&state);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            coords[axis * box_count + i] = center[axis] - extent;
+            coords[(3 + axis) * box_count + i] = center[axis] + extent;
+        }
+    }
+    const aabb_soa boxes{
+        &coords[0],
+        &coords[box_count],
+        &coords[2 * box_count],
+        &coords[3 * box_count],
+        &coords[4 * box_count],
+        &coords[5 * box_count]};
+    const ray r{float3{-1.0f, 0.45f, 0.5f}, glm::normalize(float3{1.0f, 0.1f, 0.05f})};
+
+    int scalar_hits = 0;
+    double scalar = best_ms(ctx->runs, [&] {
+        scalar_hits = 0;
+        for (int i = 0; i < box_count; i++)
+        {
+            bounds3f b{
+                float3{boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]},
+                float3{boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]}};
+            float t;
+            scalar_hits += ray_intersects_aabb(r, b, &t);
+        }
+    });
+    report(scene, "ray-aabb scalar", scalar, "%.2f Mtests/s", box_count / (scalar * 1e3));
+
+    array<u64> masks(box_count / 64);
+    array<float> t(box_count);
+    int batched_hits = 0;
+    double batched = best_ms(ctx->runs, [&] {
+        batched_hits = ray_intersects_aabbs(r, boxes, box_count, masks.ptr(), t.ptr());
+    });
+    report(
+        scene,
+        "ray-aabb batched",
+        batched,
+        "%.2f Mtests/s, %.1fx, %d lanes, %s",
+        box_count / (batched * 1e3),
+        scalar / batched,
+        ray_aabb_batch_width(),
+        scalar_hits == batched_hits ? "same hits" : "hits differ");
+}
+
+// scene file save, open and decode, and saving again after a small edit
+void bench_file(bench_context* ctx, const bench_scene& scene)
+{
+    char path[1024];
+    temp_path(ctx, path, sizeof path, "scene.vx");
+
+    array<int3> coords;
+    voxel_world_chunk_coords(scene.world, &coords);
+    const u64 raw_size = (u64)coords.size() * voxel_chunk_volume * sizeof(voxel_leaf);
+
+    bool ok = true;
+    double save = best_ms(ctx->runs, [&] { ok = voxel_file_save(scene.world, path) && ok; });
+    const u64 size = file_size(path);
+    report(
+        scene,
+        "file save",
+        save,
+        "%.0f MB/s raw, %.1f MB, %.0fx smaller",
+        megabytes(raw_size) / (save / 1e3),
+        megabytes(size),
+        size ? (double)raw_size / size : 0.0);
+
+    voxel_world* loaded = voxel_world_create(1);
+    double open = best_ms(ctx->runs, [&] { ok = voxel_file_load(loaded, path) && ok; });
+    report(scene, "file open", open, "%d chunks left encoded", (int)loaded->encoded_chunks.size());
+
+    double decode = best_ms(ctx->runs, [&] {
+        ok = voxel_file_load(loaded, path) && ok;
+        for (int i = 0; i < coords.size(); i++)
+            voxel_world_find_chunk(loaded, coords[i]);
+    });
+    report(
+        scene,
+        "file open and decode",
+        decode,
+        "%.0f MB/s raw",
+        megabytes(raw_size) / (decode / 1e3));
+
+    // Saving over the file the world was loaded from only encodes the
+    // chunks changed since.
+    const int3 p = int3{loaded->resolution / 2};
+    double incremental = best_ms(ctx->runs, [&] {
+        voxel_world_set(loaded, p, voxel_leaf{float3{1.0f, 0.0f, 0.0f}, 1});
+        ok = voxel_file_save(loaded, path) && ok;
+    });
+    report(scene, "file save one edit", incremental, "%.1fx faster", save / incremental);
+
+    voxel_world_destroy(loaded);
+    std::remove(path);
+    if (!ok)
+        fprintf(stdout, "%-8s file benchmarks failed\n", scene.name);
+}
+
+// MagicaVoxel export and import
+void bench_vox(bench_context* ctx, const bench_scene& scene)
+{
+    if (scene.world->resolution > voxel_vox_max_resolution)
+        return;
+
+    char path[1024];
+    temp_path(ctx, path, sizeof path, "scene.vox");
+
+    bool ok = true;
+    double save = best_ms(ctx->runs, [&] { ok = voxel_vox_export(scene.world, path) && ok; });
+    report(scene, "vox export", save, "%.1f MB", megabytes(file_size(path)));
+
+    voxel_world* loaded = voxel_world_create(1);
+    double load = best_ms(ctx->runs, [&] { ok = voxel_vox_import(loaded, path) && ok; });
+    report(
+        scene,
+        "vox import",
+        load,
+        "%.1f Mvoxels/s",
+        (double)voxel_world_solid_count(scene.world) / (load * 1e3));
+
+    voxel_world_destroy(loaded);
+    std::remove(path);
+    if (!ok)
+        fprintf(stdout, "%-8s vox benchmarks failed\n", scene.name);
+}
+
+// mesh files in every format
+void bench_export(bench_context* ctx, const bench_scene& scene)
+{
+    for (int i = 0; i < voxel_mesh_format_count; i++)
+    {
+        char name[64];
+        std::snprintf(name, sizeof name, "mesh.%s", voxel_mesh_format_extensions[i]);
+        char path[1024];
+        temp_path(ctx, path, sizeof path, name);
+
+        bool ok = true;
+        double ms = best_ms(ctx->runs, [&] {
+            ok = voxel_mesh_export(
+                     scene.world,
+                     scene_bounds,
+                     voxel_mesh_flag_greedy,
+                     (voxel_mesh_format)i,
+                     path) &&
+                 ok;
+        });
+
+        char label[64];
+        std::snprintf(label, sizeof label, "export %s", voxel_mesh_format_extensions[i]);
+        const u64 size = file_size(path);
+        report(
+            scene,
+            label,
+            ms,
+            "%.1f MB, %.0f MB/s%s",
+            megabytes(size),
+            megabytes(size) / (ms / 1e3),
+            ok ? "" : ", failed");
+        std::remove(path);
+    }
+}
+
+// the scene as a mesh file read back and voxelized, surface only and solid
+void bench_voxelize(bench_context* ctx, const bench_scene& scene)
+{
+    char path[1024];
+    temp_path(ctx, path, sizeof path, "voxelize.ply");
+    voxel_triangle_mesh mesh;
+    bool ok = voxel_mesh_export(scene.world, scene_bounds, 0, voxel_mesh_format_ply, path);
+    double load = best_ms(ctx->runs, [&] { ok = voxel_triangle_mesh_load(&mesh, path) && ok; });
+    const i32 triangle_count = mesh.indices.size() / 3;
+    report(
+        scene,
+        "mesh import ply",
+        load,
+        "%.2f Mtriangles/s, %.1f MB",
+        triangle_count / (load * 1e3),
+        megabytes(file_size(path)));
+    std::remove(path);
+
+    voxel_world* voxelized = voxel_world_create(1);
+    for (int solid = 0; solid < 2; solid++)
+    {
+        voxel_voxelize_options options;
+        options.resolution = scene.world->resolution;
+        options.solid = solid != 0;
+        options.color = float3{0.5f};
+        options.worker_count = -1;
+        double ms = best_ms(ctx->runs, [&] {
+            ok = voxel_voxelize(voxelized, mesh, options) && ok;
+        });
+        report(
+            scene,
+            solid ? "voxelize solid" : "voxelize surface",
+            ms,
+            "%.2f Mtriangles/s, %llu voxels",
+            triangle_count / (ms * 1e3),
+            (unsigned long long)voxel_world_solid_count(voxelized));
+    }
+
+    voxel_world_destroy(voxelized);
+    if (!ok)
+        fprintf(stdout, "%-8s voxelize benchmarks failed\n", scene.name);
+}
+
+// a binary PLY point cloud of a few points in every solid voxel, streamed back
+void bench_points(bench_context* ctx, const bench_scene& scene)
+{
+    const int points_per_voxel = 4;
+    char path[1024];
+    temp_path(ctx, path, sizeof path, "points.ply");
+    FILE* f = std::fopen(path, "wb");
+    if (!f)
+        return;
+
+    fprintf(
+        f,
+        "ply\nformat binary_little_endian 1.0\nelement vertex %llu\n"
+        "property float x\nproperty float y\nproperty float z\n"
+        "property uchar red\nproperty uchar green\nproperty uchar blue\nend_header\n",
+        (unsigned long long)voxel_world_solid_count(scene.world) * points_per_voxel);
+
+    array<int3> coords;
+    voxel_world_chunk_coords(scene.world, &coords);
+    u32 state = 31337;
+    for (int i = 0; i < coords.size(); i++)
+    {
+        const voxel_chunk* chunk = voxel_world_find_chunk(scene.world, coords[i]);
+        for (int v = 0; v < voxel_chunk_volume; v++)
+        {
+            if (!voxel_chunk_is_solid(chunk, v))
+                continue;
+
+            const voxel_leaf& leaf = voxel_chunk_get(chunk, v);
+
+            const float3 p{coords[i] * voxel_chunk_size + voxel_chunk_index_local(v)};
+            const int3 c = int3{leaf.color * 255.0f + 0.5f};
+            const u8 color[3] = {(u8)c.x, (u8)c.y, (u8)c.z};
+            for (int k = 0; k < points_per_voxel; k++)
+            {
+                const float3 point =
+                    p + float3{random_unit(&state), random_unit(&state), random_unit(&state)};
+                std::fwrite(&point[0], sizeof(float), 3, f);
+                std::fwrite(color, 1, 3, f);
+            }
+        }
+    }
+    std::fclose(f);
+
+    voxel_world* voxelized = voxel_world_create(1);
+    voxel_point_cloud_options options;
+    options.resolution = scene.world->resolution;
+    options.color = float3{0.5f};
+    options.worker_count = -1;
+    voxel_point_cloud_stats stats;
+    bool ok = true;
+    double ms = best_ms(ctx->runs, [&] {
+        ok = voxel_point_cloud_voxelize(voxelized, path, options, &stats) && ok;
+    });
+    report(
+        scene,
+        "voxelize points",
+        ms,
+        "%.2f Mpoints/s, %.1f MB, %llu voxels",
+        stats.point_count / (ms * 1e3),
+        megabytes(file_size(path)),
+        (unsigned long long)stats.voxel_count);
+
+    voxel_world_destroy(voxelized);
+    std::remove(path);
+    if (!ok)
+        fprintf(stdout, "%-8s point benchmarks failed\n", scene.name);
+}
+
+// Work that depends on the order of the voxels within a chunk. Run a build
+// with and without VX_VOXEL_MORTON to compare the two.
+void bench_layout(bench_context* ctx, const bench_scene& scene)
+{
+    const voxel_world* world = scene.world;
+
+    // six neighbors of every voxel within its chunk, as the reference mesher
+    // and ambient occlusion sample them
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+    const int3 steps[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    u64 solid = 0;
+    double neighbors = best_ms(ctx->runs, [&] {
+        for (int i = 0; i < coords.size(); i++)
+        {
+            const voxel_chunk* chunk = voxel_world_find_chunk(world, coords[i]);
+            for (int z = 1; z < voxel_chunk_mask; z++)
+                for (int y = 1; y < voxel_chunk_mask; y++)
+                    for (int x = 1; x < voxel_chunk_mask; x++)
+                        for (const int3& step : steps)
+                            solid += voxel_chunk_is_solid(
+                                chunk, voxel_chunk_index(int3{x, y, z} + step));
+        }
+    });
+    const double samples = (double)coords.size() * 6 * 30 * 30 * 30;
+    report(scene, "neighbor reads", neighbors, "%.2f ns each", 1e6 * neighbors / samples);
+
+    voxel_mesh mesh;
+    double reference = best_ms(
+        ctx->runs, [&] { voxel_mesh_build(&mesh, world, voxel_mesh_flag_reference); });
+    report(scene, "mesh reference", reference, "%d triangles", mesh.triangles.size());
+    double bitmask = best_ms(ctx->runs, [&] { voxel_mesh_build(&mesh, world, 0); });
+    report(scene, "mesh", bitmask, "%d triangles", mesh.triangles.size());
+
+    // boxes of every size, alternately solid and empty, into a copy
+    const int box_count = 4096;
+    const i32 n = world->resolution;
+    array<bounds3i> boxes(box_count);
+    u64 box_volume = 0;
+    u32 state = 4242;
+    for (int i = 0; i < box_count; i++)
+    {
+        const i32 size = 1 + (i32)(random_unit(&state) * std::min(n, 48));
+        const int3 mn = int3{float3{random_unit(&state), random_unit(&state), random_unit(&state)} *
+                             (float)std::max(n - size, 1)};
+        boxes[i] = bounds3i{mn, mn + (size - 1)};
+        box_volume += (u64)size * size * size;
+    }
+
+    voxel_world* copy = voxel_world_create(1);
+    double fill = 0.0;
+    for (i32 run = 0; run < ctx->runs; run++)
+    {
+        voxel_world_copy(copy, world);
+        double start = cli_time_ms();
+        for (int i = 0; i < box_count; i++)
+            voxel_world_fill(copy, boxes[i], voxel_leaf{float3{0.2f, 0.4f, 0.6f}, u32(i & 1)});
+        double elapsed = cli_time_ms() - start;
+        if (run == 0 || elapsed < fill)
+            fill = elapsed;
+    }
+    report(scene, "box fill", fill, "%.0f Mvoxels/s", (double)box_volume / (fill * 1e3));
+
+    voxel_world_destroy(copy);
+
+    // keeps the reads from being optimized away
+    if (solid == ~0ull)
+        fprintf(stdout, "\n");
+}
+
+// Shape brushes with a radius of a fifth of the scene at its center, into a
+// copy of it and recorded into a history as the editor does.
+void bench_brush(bench_context* ctx, const bench_scene& scene)
+{
+    struct
+    {
+        const char* name;
+        voxel_brush_shape shape;
+        voxel_brush_mode mode;
+    } cases[] = {
+        {"brush sphere union", voxel_brush_shape_sphere, voxel_brush_mode_union},
+        {"brush ellipsoid union", voxel_brush_shape_ellipsoid, voxel_brush_mode_union},
+        {"brush cylinder union", voxel_brush_shape_cylinder, voxel_brush_mode_union},
+        {"brush cone union", voxel_brush_shape_cone, voxel_brush_mode_union},
+        {"brush capsule union", voxel_brush_shape_capsule, voxel_brush_mode_union},
+        {"brush sphere subtract", voxel_brush_shape_sphere, voxel_brush_mode_subtract},
+        {"brush sphere intersect", voxel_brush_shape_sphere, voxel_brush_mode_intersect},
+        {"brush sphere paint", voxel_brush_shape_sphere, voxel_brush_mode_paint},
+    };
+
+    const float n = (float)scene.world->resolution;
+    job_system* jobs = job_system_create(-1);
+    voxel_history* history = voxel_history_create(1024 MB);
+    voxel_world* copy = voxel_world_create(1);
+    for (const auto& c : cases)
+    {
+        voxel_brush brush;
+        brush.shape = c.shape;
+        brush.mode = c.mode;
+        brush.a = float3{0.5f * n, 0.3f * n, 0.5f * n};
+        brush.b = brush.a + float3{0.0f, 0.4f * n, 0.0f};
+        brush.radius = float3{0.2f * n, 0.1f * n, 0.15f * n};
+        brush.leaf = voxel_leaf{float3{0.8f, 0.2f, 0.2f}, voxel_flag_solid};
+
+        const bounds3i b = voxel_brush_bounds(brush);
+        const int3 size = b.max - b.min + 1;
+        const double volume = (double)size.x * size.y * size.z;
+        double best = 0.0;
+        bounds3i region;
+        for (i32 run = 0; run < ctx->runs; run++)
+        {
+            voxel_world_copy(copy, scene.world);
+            voxel_history_clear(history);
+            double start = cli_time_ms();
+            voxel_history_begin(history);
+            voxel_brush_apply(copy, brush, jobs, history, &region);
+            voxel_history_end(history);
+            double elapsed = cli_time_ms() - start;
+            if (run == 0 || elapsed < best)
+                best = elapsed;
+        }
+        report(
+            scene,
+            c.name,
+            best,
+            "%.0f Mvoxels/s of bounds, %.1f MB undo",
+            volume / (best * 1e3),
+            megabytes(history->byte_size));
+    }
+
+    voxel_world_destroy(copy);
+    voxel_history_destroy(history);
+    job_system_destroy(jobs);
+}
+
+// Connected components of the whole scene, and flood fills from the lowest
+// solid voxel of the center column, as the editor selects them.
+void bench_components(bench_context* ctx, const bench_scene& scene)
+{
+    const voxel_world* world = scene.world;
+    const char* connectivity_names[] = {"6", "26"};
+    const char* match_names[] = {"solid", "color"};
+
+    job_system* jobs = job_system_create(-1);
+    voxel_components components;
+    for (int c = 0; c < voxel_connectivity_count; c++)
+        for (int m = 0; m < voxel_match_count; m++)
+        {
+            double ms = best_ms(ctx->runs, [&] {
+                voxel_components_label(
+                    &components, world, (voxel_connectivity)c, (voxel_match)m, jobs);
+            });
+
+            int floating = 0;
+            for (int i = 0; i < components.components.size(); i++)
+                floating += !components.components[i].grounded;
+            char name[64];
+            std::snprintf(
+                name, sizeof name, "components %s %s", connectivity_names[c], match_names[m]);
+            report(
+                scene,
+                name,
+                ms,
+                "%d components, %d floating, %d runs",
+                components.components.size(),
+                floating,
+                components.runs.size());
+        }
+
+    const i32 n = world->resolution;
+    int3 seed{n / 2, 0, n / 2};
+    while (seed.y < n && !(voxel_world_get(world, seed).flags & voxel_flag_solid))
+        seed.y++;
+
+    voxel_region region;
+    for (int c = 0; c < voxel_connectivity_count; c++)
+        for (int m = 0; m < voxel_match_count; m++)
+        {
+            double ms = best_ms(ctx->runs, [&] {
+                voxel_flood_select(&region, world, seed, (voxel_connectivity)c, (voxel_match)m);
+            });
+            char name[64];
+            std::snprintf(name, sizeof name, "flood %s %s", connectivity_names[c], match_names[m]);
+            report(
+                scene,
+                name,
+                ms,
+                "%llu voxels, %.0f Mvoxels/s",
+                (unsigned long long)region.voxel_count,
+                (double)region.voxel_count / (ms * 1e3));
+        }
+
+    job_system_destroy(jobs);
+}
+
+// The whole scene copied into a clip, turned and pasted back shifted by an
+// eighth of it into a copy of the scene, recorded into a history as the editor
+// does.
+void bench_clip(bench_context* ctx, const bench_scene& scene)
+{
+    const i32 n = scene.world->resolution;
+    const bounds3i box{int3{0}, int3{n - 1}};
+    job_system* jobs = job_system_create(-1);
+    voxel_clip clip;
+
+    double ms = best_ms(ctx->runs, [&] { voxel_clip_copy(&clip, scene.world, box, jobs); });
+    const usize clip_bytes = clip.blocks.size() * sizeof(voxel_clip_block) +
+                             clip.palette.size() * sizeof(voxel_leaf) +
+                             clip.indices.size() * sizeof(u16);
+    report(
+        scene,
+        "clip copy",
+        ms,
+        "%llu voxels, %.0f Mvoxels/s, %.1f MB",
+        (unsigned long long)clip.voxel_count,
+        (double)clip.voxel_count / (ms * 1e3),
+        megabytes(clip_bytes));
+
+    struct
+    {
+        const char* name;
+        bool mirror;
+        axis a;
+    } cases[] = {
+        {"clip rotate x", false, axis_x},
+        {"clip rotate y", false, axis_y},
+        {"clip mirror x", true, axis_x},
+    };
+    for (const auto& c : cases)
+    {
+        ms = best_ms(ctx->runs, [&] {
+            if (c.mirror)
+                voxel_clip_mirror(&clip, c.a, jobs);
+            else
+                voxel_clip_rotate(&clip, c.a, jobs);
+        });
+        report(scene, c.name, ms, "%.0f Mvoxels/s", (double)clip.voxel_count / (ms * 1e3));
+    }
+
+    voxel_history* history = voxel_history_create(1024 MB);
+    voxel_world* copy = voxel_world_create(1);
+    double best = 0.0;
+    bounds3i region;
+    for (i32 run = 0; run < ctx->runs; run++)
+    {
+        voxel_world_copy(copy, scene.world);
+        voxel_history_clear(history);
+        double start = cli_time_ms();
+        voxel_history_begin(history);
+        voxel_clip_paste(copy, clip, int3{n / 8}, jobs, history, &region);
+        voxel_history_end(history);
+        double elapsed = cli_time_ms() - start;
+        if (run == 0 || elapsed < best)
+            best = elapsed;
+    }
+    report(
+        scene,
+        "clip paste",
+        best,
+        "%.0f Mvoxels/s, %.1f MB undo",
+        (double)clip.voxel_count / (best * 1e3),
+        megabytes(history->byte_size));
+
+    voxel_world_destroy(copy);
+    voxel_history_destroy(history);
+    job_system_destroy(jobs);
+}
+
+// Number of chunks whose mesh in the cache differs from meshing the chunk of
+// the world directly, including chunks missing from either.
+int mesh_cache_mismatches(const voxel_mesh_cache* cache, const voxel_world* world, u32 flags)
+{
+    int mismatches = 0;
+    voxel_mesh mesh;
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+    for (int i = 0; i < coords.size(); i++)
+    {
+        voxel_mesh_clear(&mesh);
+        if (const voxel_chunk* chunk = voxel_world_find_chunk(world, coords[i]))
+            voxel_mesh_build_chunk(&mesh, world, chunk, flags);
+
+        auto it = cache->ranges.find(voxel_chunk_key(coords[i]));
+        const voxel_mesh_range empty{};
+        const voxel_mesh_range& r = it != cache->ranges.end() ? it->second : empty;
+        bool same = r.vertex_count == (u32)mesh.vertices.size() &&
+                    r.triangle_count == (u32)mesh.triangles.size() &&
+                    r.face_count == mesh.face_count;
+        for (u32 v = 0; same && v < r.vertex_count; v++)
+            same = !std::memcmp(
+                &cache->vertices[r.vertex_offset + v], &mesh.vertices[v], sizeof(voxel_vertex));
+        const int3 base((i32)r.vertex_offset);
+        for (u32 t = 0; same && t < r.triangle_count; t++)
+            same = cache->triangles[r.triangle_offset + t] == mesh.triangles[t] + base;
+        mismatches += !same;
+    }
+
+    // chunks the world no longer has must have been emptied
+    std::unordered_set<u64> keys;
+    for (int i = 0; i < coords.size(); i++)
+        keys.insert(voxel_chunk_key(coords[i]));
+    for (const auto& kv : cache->ranges)
+        mismatches += kv.second.vertex_count && !keys.count(kv.first);
+    return mismatches;
+}
+
+// Not a measurement but a check of the mesh scheduler. Random edits, undo and
+// redo, box previews, rebuilds and worker count changes are made while chunks
+// are being meshed, as in the editor. Once the scheduler is drained, the mesh
+// of every chunk in the front cache has to match meshing the world directly.
+void bench_scheduler(bench_context* ctx, const bench_scene& scene)
+{
+    const i32 n = scene.world->resolution;
+    const i32 worker_counts[] = {2, 0, 1, 3};
+    const u32 variants[] = {0, voxel_mesh_flag_greedy};
+
+    voxel_world* world = voxel_world_create(1);
+    voxel_history* history = voxel_history_create(64 MB);
+    voxel_mesh_scheduler* scheduler = voxel_mesh_scheduler_create(worker_counts[0]);
+    u32 state = 9001;
+    int frames = 0, checked = 0;
+
+    double start = cli_time_ms();
+    for (u32 flags : variants)
+    {
+        voxel_world_copy(world, scene.world);
+        voxel_history_clear(history);
+        voxel_mesh_scheduler_rebuild(scheduler, world);
+
+        voxel_mesh_overlay overlay;
+        overlay.clip = nullptr;
+        bool has_overlay = false;
+
+        for (i32 frame = 0; frame < 50 * ctx->runs; frame++, frames++)
+        {
+            int3 mn{(i32)(next_random(&state) % n),
+                    (i32)(next_random(&state) % n),
+                    (i32)(next_random(&state) % n)};
+            int3 size{(i32)(next_random(&state) % 24),
+                      (i32)(next_random(&state) % 24),
+                      (i32)(next_random(&state) % 24)};
+            const bounds3i box{mn, glm::min(mn + size, int3{n - 1})};
+            voxel_leaf leaf{float3{random_unit(&state), random_unit(&state), 0.5f}, 0};
+            bounds3i region;
+
+            switch (next_random(&state) % 8)
+            {
+                case 0:
+                case 1:
+                case 2:
+                    leaf.flags = next_random(&state) % 3 ? voxel_flag_solid : 0;
+                    voxel_history_begin(history);
+                    voxel_history_fill(history, world, box, leaf);
+                    voxel_history_end(history);
+                    voxel_mesh_scheduler_update(scheduler, world, box);
+                    break;
+                case 3:
+                    if (voxel_history_undo(history, world, &region))
+                        voxel_mesh_scheduler_update(scheduler, world, region);
+                    break;
+                case 4:
+                    if (voxel_history_redo(history, world, &region))
+                        voxel_mesh_scheduler_update(scheduler, world, region);
+                    break;
+                case 5:
+                case 6:
+                    // move the preview, the chunks of both boxes change
+                    if (has_overlay)
+                        voxel_mesh_scheduler_update(scheduler, world, overlay.box);
+                    has_overlay = next_random(&state) % 4 != 0;
+                    overlay.box = box;
+                    overlay.leaf = voxel_leaf{leaf.color, voxel_flag_solid};
+                    if (has_overlay)
+                        voxel_mesh_scheduler_update(scheduler, world, overlay.box);
+                    break;
+                case 7:
+                    if (next_random(&state) % 4 == 0)
+                        voxel_mesh_scheduler_rebuild(scheduler, world);
+                    else
+                        voxel_mesh_scheduler_set_worker_count(
+                            scheduler, worker_counts[next_random(&state) % 4]);
+                    break;
+            }
+
+            voxel_mesh_scheduler_run(scheduler, world, has_overlay ? &overlay : nullptr, flags);
+            voxel_mesh_cache_clear_patches(scheduler->front);
+        }
+
+        if (has_overlay)
+            voxel_mesh_scheduler_update(scheduler, world, overlay.box);
+        // a lost result would keep a rebuild from ever finishing
+        const double deadline = cli_time_ms() + 10000.0;
+        for (;;)
+        {
+            voxel_mesh_scheduler_run(scheduler, world, nullptr, flags);
+            if (!voxel_mesh_scheduler_busy(scheduler) && !scheduler->back)
+                break;
+            if (cli_time_ms() > deadline)
+                fatal("%s: the mesh scheduler did not finish its chunks", scene.name);
+        }
+
+        int mismatches = mesh_cache_mismatches(scheduler->front, world, flags);
+        if (mismatches)
+            fatal(
+                "%s: %d chunks of the scheduled mesh differ from meshing the world (flags %u)",
+                scene.name,
+                mismatches,
+                flags);
+        checked += (int)world->chunks.size();
+    }
+    report(
+        scene,
+        "scheduler stress",
+        cli_time_ms() - start,
+        "%d frames, %d chunk meshes match",
+        frames,
+        checked);
+
+    voxel_mesh_scheduler_destroy(scheduler);
+    voxel_history_destroy(history);
+    voxel_world_destroy(world);
+}
+
+using bench_fn = void (*)(bench_context* ctx, const bench_scene& scene);
+
+struct bench
+{
+    const char* name;
+    bench_fn run;
+
+    // run once for every scene, once without a scene otherwise
+    bool per_scene;
+};
+
+const bench benches[] = {
+    {"storage", bench_storage, true},
+    {"mesh", bench_mesh, true},
+    {"raycast", bench_raycast, true},
+    {"aabb", bench_aabb, false},
+    {"file", bench_file, true},
+    {"vox", bench_vox, true},
+    {"export", bench_export, true},
+    {"voxelize", bench_voxelize, true},
+    {"points", bench_points, true},
+    {"layout", bench_layout, true},
+    {"brush", bench_brush, true},
+    {"components", bench_components, true},
+    {"clip", bench_clip, true},
+    {"scheduler", bench_scheduler, true},
+};
+
+const char* option_value(int argc, char** argv, int* i)
+{
+    if (*i + 1 >= argc)
+        fatal("%s needs a value", argv[*i]);
+    return argv[++*i];
+}
+}
+
+int cli_bench(int argc, char** argv)
+{
+    i32 resolution = 256;
+    bench_context ctx{3, ".", {}};
+    array<const char*> names;
+    for (int i = 0; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (!std::strcmp(arg, "--help") || !std::strcmp(arg, "-h"))
+        {
+            fprintf(stdout, "%s\nbenchmarks:", bench_usage);
+            for (const bench& b : benches)
+                fprintf(stdout, " %s", b.name);
+            fprintf(stdout, "\n");
+            return 0;
+        }
+        else if (!std::strcmp(arg, "--resolution"))
+            resolution = std::atoi(option_value(argc, argv, &i));
+        else if (!std::strcmp(arg, "--runs"))
+            ctx.runs = std::max(std::atoi(option_value(argc, argv, &i)), 1);
+        else if (!std::strcmp(arg, "-o"))
+            ctx.temp_dir = option_value(argc, argv, &i);
+        else if (arg[0] == '-')
+            fatal("Unknown option %s, see voxed-cli bench --help", arg);
+        else
+            names.add(arg);
+    }
+
+    if (resolution < 1 || resolution > voxel_vertex_max_coordinate)
+        fatal("--resolution must be within 1 and %d", voxel_vertex_max_coordinate);
+
+    for (int i = 0; i < names.size(); i++)
+    {
+        bool known = false;
+        for (const bench& b : benches)
+            known = known || !std::strcmp(names[i], b.name);
+        if (!known)
+            fatal("Unknown benchmark %s, see voxed-cli bench --help", names[i]);
+    }
+
+    double start = cli_time_ms();
+    ctx.scenes[0] = bench_scene{"shell", voxel_world_create(resolution)};
+    ctx.scenes[1] = bench_scene{"terrain", voxel_world_create(resolution)};
+    build_shell(ctx.scenes[0].world);
+    build_terrain(ctx.scenes[1].world);
+    fprintf(
+        stdout,
+        "%d^3 scenes built in %.0f ms, best of %d runs, %s order chunks\n",
+        resolution,
+        cli_time_ms() - start,
+        ctx.runs,
+        voxel_chunk_layout_name);
+
+    for (const bench& b : benches)
+    {
+        bool selected = names.size() == 0;
+        for (int i = 0; i < names.size(); i++)
+            selected = selected || !std::strcmp(names[i], b.name);
+        if (!selected)
+            continue;
+
+        if (b.per_scene)
+        {
+            for (const bench_scene& scene : ctx.scenes)
+                b.run(&ctx, scene);
+        }
+        else
+            b.run(&ctx, bench_scene{"-", nullptr});
+    }
+
+    for (const bench_scene& scene : ctx.scenes)
+        voxel_world_destroy(scene.world);
+    return 0;
+}
+}
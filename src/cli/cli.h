@@ -0,0 +1,25 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+
+#include <chrono>
+
+namespace vx
+{
+// milliseconds since some fixed point in time
+inline double cli_time_ms()
+{
+    using clock = std::chrono::steady_clock;
+    return std::chrono::duration<double, std::milli>(clock::now().time_since_epoch()).count();
+}
+
+// true if the extension of path is ext, ext without the dot
+bool cli_has_extension(const char* path, const char* ext);
+
+// Load a .vx or .vox scene into world by the extension of path, false for
+// anything else.
+bool cli_load_scene(voxel_world* world, const char* path);
+
+// the bench command, args are the arguments after it
+int cli_bench(int argc, char** argv);
+}
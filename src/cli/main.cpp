@@ -0,0 +1,447 @@
+#include "cli/cli.h"
+
+#include "common/array.h"
+#include "common/job_system.h"
+#include "common/math_utils.h"
+#include "platform/filesystem.h"
+#include "voxel/voxel_file.h"
+#include "voxel/voxel_mesh_export.h"
+#include "voxel/voxel_mesher.h"
+#include "voxel/voxel_point_cloud.h"
+#include "voxel/voxel_vox.h"
+#include "voxel/voxel_voxelizer.h"
+
+#include <cctype>
+#include <cstring>
+#include <thread>
+
+namespace vx
+{
+namespace
+{
+const char* usage =
+    "usage: voxed-cli <command> [options] <scenes or directories...>\n"
+    "\n"
+    "Runs a command over .vx and .vox scenes, one scene per worker thread.\n"
+    "Directories are searched for scenes, including the directories below.\n"
+    "voxelize runs over .obj and .ply meshes and .xyz and .ply point clouds instead.\n"
+    "\n"
+    "commands:\n"
+    "  convert    save scenes as .vx or .vox, --format vx (default) or vox\n"
+    "  export     write meshes, --format ply (default), obj or glb\n"
+    "  mesh       mesh scenes and print the mesh size\n"
+    "  stats      print resolution, chunk and voxel counts\n"
+    "  voxelize   turn meshes and point clouds into scenes, --format vx (default) or vox\n"
+    "  bench      run the benchmarks, see voxed-cli bench --help\n"
+    "\n"
+    "options:\n"
+    "  -o <dir>            write outputs into dir instead of next to the scenes\n"
+    "  -j <count>          worker threads, one per hardware thread by default\n"
+    "  --format <ext>      output format of convert, export and voxelize\n"
+    "  --greedy            merge faces for export and mesh\n"
+    "  --voxel-size <s>    edge length of a voxel in exported meshes, 1 by default\n"
+    "  --resolution <n>    voxels along the longest side of voxelized inputs, 256 by default\n"
+    "  --solid             also fill the insides of voxelized meshes\n";
+
+enum command
+{
+    command_convert,
+    command_export,
+    command_mesh,
+    command_stats,
+    command_voxelize,
+    command_count,
+};
+
+const char* command_names[command_count] = {"convert", "export", "mesh", "stats", "voxelize"};
+
+struct options
+{
+    command cmd;
+
+    // null writes outputs next to their scenes
+    const char* output_dir;
+    const char* format;
+    u32 mesh_flags;
+    float voxel_size;
+    i32 job_count;
+    i32 resolution;
+    bool solid;
+
+    // of the voxelizer of each scene, as in job_system_create
+    i32 voxelize_worker_count;
+};
+
+// a scene and what to do with it, run on a worker thread
+struct scene_job
+{
+    const options* opts;
+    char input[1024];
+    char output[1024];
+    char report[1280];
+    bool ok;
+};
+
+bool run_convert(scene_job* job, voxel_world* world)
+{
+    bool ok = cli_has_extension(job->output, "vox") ? voxel_vox_export(world, job->output)
+                                                    : voxel_file_save(world, job->output);
+    std::snprintf(job->report, sizeof job->report, "wrote %s", job->output);
+    return ok;
+}
+
+bool run_export(scene_job* job, voxel_world* world)
+{
+    voxel_mesh_format format;
+    if (!voxel_mesh_format_from_path(job->output, &format))
+        return false;
+
+    // The min corner of the scene lands on the origin.
+    const float3 size{world->resolution * job->opts->voxel_size};
+    bool ok = voxel_mesh_export(
+        world, bounds3f{float3{0.0f}, size}, job->opts->mesh_flags, format, job->output);
+    std::snprintf(job->report, sizeof job->report, "wrote %s", job->output);
+    return ok;
+}
+
+bool run_mesh(scene_job* job, voxel_world* world)
+{
+    // decode first, so only meshing is timed
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+    for (int i = 0; i < coords.size(); i++)
+        voxel_world_find_chunk(world, coords[i]);
+
+    voxel_mesh mesh;
+    double start = cli_time_ms();
+    voxel_mesh_build(&mesh, world, job->opts->mesh_flags);
+    double elapsed = cli_time_ms() - start;
+
+    std::snprintf(
+        job->report,
+        sizeof job->report,
+        "%d vertices, %d triangles, %u faces, meshed in %.1f ms",
+        mesh.vertices.size(),
+        mesh.triangles.size(),
+        mesh.face_count,
+        elapsed);
+    return true;
+}
+
+bool run_stats(scene_job* job, voxel_world* world)
+{
+    // decode first, so the solid counts of the chunk table are checked
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+    for (int i = 0; i < coords.size(); i++)
+        voxel_world_find_chunk(world, coords[i]);
+
+    const u64 chunk_count = world->chunks.size() + world->encoded_chunks.size();
+    const u64 solid_count = voxel_world_solid_count(world);
+    std::snprintf(
+        job->report,
+        sizeof job->report,
+        "resolution %d, %llu chunks, %llu solid voxels, %.1f%% full",
+        world->resolution,
+        (unsigned long long)chunk_count,
+        (unsigned long long)solid_count,
+        100.0 * (double)solid_count / (double)pow3((u64)world->resolution));
+    return true;
+}
+
+// the scene of a voxelize job, saved by run_convert
+bool voxelize_input(scene_job* job, voxel_world* world)
+{
+    if (voxel_point_cloud_detect(job->input))
+    {
+        voxel_point_cloud_options options;
+        options.resolution = job->opts->resolution;
+        options.color = float3{0.8f};
+        options.worker_count = job->opts->voxelize_worker_count;
+        voxel_point_cloud_stats stats;
+        if (!voxel_point_cloud_voxelize(world, job->input, options, &stats))
+            return false;
+
+        fprintf(
+            stdout,
+            "%s: %llu points, %.2f Mpoints/s\n",
+            job->input,
+            (unsigned long long)stats.point_count,
+            (double)stats.point_count / std::max(stats.seconds, 1e-9) / 1e6);
+        return true;
+    }
+
+    voxel_triangle_mesh mesh;
+    if (!voxel_triangle_mesh_load(&mesh, job->input))
+        return false;
+
+    voxel_voxelize_options options;
+    options.resolution = job->opts->resolution;
+    options.solid = job->opts->solid;
+    options.color = float3{0.8f};
+    options.worker_count = job->opts->voxelize_worker_count;
+    return voxel_voxelize(world, mesh, options);
+}
+
+void scene_job_run(void* data)
+{
+    scene_job* job = (scene_job*)data;
+    double start = cli_time_ms();
+
+    voxel_world* world = voxel_world_create(voxel_chunk_size);
+    if (job->opts->cmd == command_voxelize)
+        job->ok = voxelize_input(job, world);
+    else
+        job->ok = cli_load_scene(world, job->input);
+    if (job->ok)
+    {
+        switch (job->opts->cmd)
+        {
+            case command_convert:
+            case command_voxelize:
+                job->ok = run_convert(job, world);
+                break;
+            case command_export:
+                job->ok = run_export(job, world);
+                break;
+            case command_mesh:
+                job->ok = run_mesh(job, world);
+                break;
+            case command_stats:
+                job->ok = run_stats(job, world);
+                break;
+            default:
+                job->ok = false;
+                break;
+        }
+    }
+    if (job->ok && world->corrupt_chunk_count)
+    {
+        const usize length = std::strlen(job->report);
+        std::snprintf(
+            job->report + length,
+            sizeof job->report - length,
+            ", %u corrupt chunks read as empty",
+            world->corrupt_chunk_count);
+    }
+    voxel_world_destroy(world);
+
+    // one call per line, so lines of different workers do not mix
+    fprintf(
+        stdout,
+        "%s: %s (%.0f ms)\n",
+        job->input,
+        job->ok ? job->report : "failed",
+        cli_time_ms() - start);
+}
+
+void add_input(array<scene_job>* jobs, const char* path)
+{
+    scene_job& job = jobs->add();
+    if (std::strlen(path) >= sizeof job.input)
+        fatal("Path too long: %s", path);
+    std::strcpy(job.input, path);
+}
+
+void add_scene_file(const char* path, void* user)
+{
+    if (cli_has_extension(path, "vx") || cli_has_extension(path, "vox"))
+        add_input((array<scene_job>*)user, path);
+}
+
+void add_mesh_file(const char* path, void* user)
+{
+    if (cli_has_extension(path, "obj") || cli_has_extension(path, "ply") ||
+        cli_has_extension(path, "xyz"))
+        add_input((array<scene_job>*)user, path);
+}
+
+// the path of input with its extension replaced by ext, moved into dir if given
+void output_path(char* out, usize size, const char* input, const char* dir, const char* ext)
+{
+    const char* name = input;
+    for (const char* p = input; *p; p++)
+        if (*p == '/' || *p == '\\')
+            name = p + 1;
+
+    const char* dot = std::strrchr(name, '.');
+    int stem = dot ? (int)(dot - name) : (int)std::strlen(name);
+
+    int n;
+    if (dir)
+        n = std::snprintf(out, size, "%s/%.*s.%s", dir, stem, name, ext);
+    else
+        n = std::snprintf(out, size, "%.*s.%s", (int)(name - input) + stem, input, ext);
+    if (n < 0 || (usize)n >= size)
+        fatal("Path too long: %s", input);
+}
+
+const char* option_value(int argc, char** argv, int* i)
+{
+    if (*i + 1 >= argc)
+        fatal("%s needs a value", argv[*i]);
+    return argv[++*i];
+}
+
+int run(int argc, char** argv)
+{
+    if (argc < 2 || !std::strcmp(argv[1], "--help") || !std::strcmp(argv[1], "-h"))
+    {
+        fprintf(stdout, "%s", usage);
+        return argc < 2 ? 1 : 0;
+    }
+
+    if (!std::strcmp(argv[1], "bench"))
+        return cli_bench(argc - 2, argv + 2);
+
+    options opts{command_count, nullptr, nullptr, 0, 1.0f, 0, 256, false, 0};
+    for (int i = 0; i < command_count; i++)
+        if (!std::strcmp(argv[1], command_names[i]))
+            opts.cmd = (command)i;
+    if (opts.cmd == command_count)
+        fatal("Unknown command %s, see voxed-cli --help", argv[1]);
+
+    array<const char*> inputs;
+    for (int i = 2; i < argc; i++)
+    {
+        const char* arg = argv[i];
+        if (!std::strcmp(arg, "-o"))
+            opts.output_dir = option_value(argc, argv, &i);
+        else if (!std::strcmp(arg, "-j"))
+            opts.job_count = std::atoi(option_value(argc, argv, &i));
+        else if (!std::strcmp(arg, "--format"))
+            opts.format = option_value(argc, argv, &i);
+        else if (!std::strcmp(arg, "--greedy"))
+            opts.mesh_flags |= voxel_mesh_flag_greedy;
+        else if (!std::strcmp(arg, "--voxel-size"))
+            opts.voxel_size = (float)std::atof(option_value(argc, argv, &i));
+        else if (!std::strcmp(arg, "--resolution"))
+            opts.resolution = std::atoi(option_value(argc, argv, &i));
+        else if (!std::strcmp(arg, "--solid"))
+            opts.solid = true;
+        else if (arg[0] == '-')
+            fatal("Unknown option %s, see voxed-cli --help", arg);
+        else
+            inputs.add(arg);
+    }
+
+    if (opts.cmd == command_convert || opts.cmd == command_voxelize)
+    {
+        if (!opts.format)
+            opts.format = "vx";
+        if (std::strcmp(opts.format, "vx") && std::strcmp(opts.format, "vox"))
+            fatal("%s writes vx or vox, not %s", command_names[opts.cmd], opts.format);
+        if (opts.resolution < 1 || opts.resolution > voxel_voxelize_max_resolution)
+            fatal("--resolution must be in 1..%d", voxel_voxelize_max_resolution);
+    }
+    else if (opts.cmd == command_export)
+    {
+        if (!opts.format)
+            opts.format = voxel_mesh_format_extensions[voxel_mesh_format_ply];
+
+        bool known = false;
+        for (int i = 0; i < voxel_mesh_format_count; i++)
+            known = known || !std::strcmp(opts.format, voxel_mesh_format_extensions[i]);
+        if (!known)
+            fatal("export writes ply, obj or glb, not %s", opts.format);
+        if (!(opts.voxel_size > 0.0f))
+            fatal("--voxel-size must be positive");
+    }
+
+    array<scene_job> jobs;
+    for (int i = 0; i < inputs.size(); i++)
+    {
+        file_visitor visit = opts.cmd == command_voxelize ? add_mesh_file : add_scene_file;
+        if (!visit_files(inputs[i], visit, &jobs))
+            add_input(&jobs, inputs[i]);
+    }
+    if (jobs.size() == 0)
+        fatal("No inputs given, see voxed-cli --help");
+
+    std::sort(jobs.ptr(), jobs.ptr() + jobs.size(), [](const scene_job& a, const scene_job& b) {
+        return std::strcmp(a.input, b.input) < 0;
+    });
+
+    if (opts.format)
+    {
+        if (opts.output_dir && !create_directory(opts.output_dir))
+            fatal("Could not create %s", opts.output_dir);
+
+        for (int i = 0; i < jobs.size(); i++)
+            output_path(
+                jobs[i].output, sizeof jobs[i].output, jobs[i].input, opts.output_dir, opts.format);
+
+        // Scenes of the same name from different directories would overwrite
+        // each other's outputs in a single output directory.
+        array<const char*> outputs;
+        for (int i = 0; i < jobs.size(); i++)
+            outputs.add(jobs[i].output);
+        std::sort(outputs.ptr(), outputs.ptr() + outputs.size(), [](const char* a, const char* b) {
+            return std::strcmp(a, b) < 0;
+        });
+        for (int i = 1; i < outputs.size(); i++)
+            if (!std::strcmp(outputs[i - 1], outputs[i]))
+                fatal("More than one scene would be written to %s", outputs[i]);
+    }
+
+    const i32 thread_count = std::max((i32)std::thread::hardware_concurrency(), 1);
+    i32 job_count = opts.job_count;
+    if (job_count <= 0)
+        job_count = thread_count;
+    job_count = std::min(job_count, jobs.size());
+
+    // The hardware threads left over by the scenes go to the voxelizer, a
+    // single large mesh is voxelized by all of them.
+    const i32 threads_per_scene = thread_count / job_count;
+    opts.voxelize_worker_count = threads_per_scene > 1 ? threads_per_scene : 0;
+
+    double start = cli_time_ms();
+    job_system* workers = job_system_create(job_count);
+    for (int i = 0; i < jobs.size(); i++)
+    {
+        jobs[i].opts = &opts;
+        job_system_submit(workers, scene_job_run, &jobs[i]);
+    }
+    job_system_destroy(workers);
+
+    int failed = 0;
+    for (int i = 0; i < jobs.size(); i++)
+        failed += !jobs[i].ok;
+    fprintf(
+        stdout,
+        "%d scenes, %d failed, %.2f s\n",
+        jobs.size(),
+        failed,
+        (cli_time_ms() - start) / 1000.0);
+    return failed ? 1 : 0;
+}
+}
+
+bool cli_has_extension(const char* path, const char* ext)
+{
+    const char* dot = std::strrchr(path, '.');
+    if (!dot || std::strlen(dot + 1) != std::strlen(ext))
+        return false;
+
+    for (int i = 0; ext[i]; i++)
+        if (std::tolower((unsigned char)dot[1 + i]) != ext[i])
+            return false;
+    return true;
+}
+
+bool cli_load_scene(voxel_world* world, const char* path)
+{
+    if (cli_has_extension(path, "vx"))
+        return voxel_file_load(world, path);
+    if (cli_has_extension(path, "vox"))
+        return voxel_vox_import(world, path);
+
+    fprintf(stdout, "%s is not a .vx or .vox scene\n", path);
+    return false;
+}
+}
+
+int main(int argc, char** argv)
+{
+    return vx::run(argc, argv);
+}
@@ -0,0 +1,441 @@
+#include "cli/voxel_octree.h"
+
+namespace vx
+{
+namespace
+{
+voxel_leaf normalized(const voxel_leaf& leaf)
+{
+    // Empty voxels compare equal regardless of their color.
+    return (leaf.flags & voxel_flag_solid) ? leaf : voxel_leaf{float3{0.f}, 0};
+}
+
+bool leaf_equal(const voxel_leaf& a, const voxel_leaf& b)
+{
+    return a.flags == b.flags && a.color == b.color;
+}
+
+bool is_uniform(const voxel_octree_node& node) { return node.first_child == 0; }
+
+u32 alloc_block(voxel_octree* octree, const voxel_leaf& leaf)
+{
+    u32 first;
+    if (octree->free_blocks.size())
+    {
+        first = octree->free_blocks[octree->free_blocks.size() - 1];
+        octree->free_blocks.resize(octree->free_blocks.size() - 1);
+    }
+    else
+    {
+        first = (u32)octree->nodes.size();
+        octree->nodes.resize(octree->nodes.size() + 8);
+    }
+
+    for (u32 i = 0; i < 8; i++)
+    {
+        octree->nodes[first + i].first_child = 0;
+        octree->nodes[first + i].leaf = leaf;
+    }
+    return first;
+}
+
+void free_subtree(voxel_octree* octree, u32 node)
+{
+    u32 first = octree->nodes[node].first_child;
+    if (!first)
+        return;
+
+    for (u32 i = 0; i < 8; i++)
+        free_subtree(octree, first + i);
+
+    octree->free_blocks.add(first);
+    octree->nodes[node].first_child = 0;
+}
+
+void split(voxel_octree* octree, u32 node)
+{
+    assert(is_uniform(octree->nodes[node]));
+    voxel_leaf leaf = octree->nodes[node].leaf;
+    u32 first = alloc_block(octree, leaf);
+    octree->nodes[node].first_child = first;
+}
+
+// collapse the children of the node if they are uniform and equal
+bool try_collapse(voxel_octree* octree, u32 node)
+{
+    u32 first = octree->nodes[node].first_child;
+    if (!first)
+        return true;
+
+    const voxel_octree_node& c0 = octree->nodes[first];
+    if (!is_uniform(c0))
+        return false;
+
+    for (u32 i = 1; i < 8; i++)
+    {
+        const voxel_octree_node& ci = octree->nodes[first + i];
+        if (!is_uniform(ci) || !leaf_equal(ci.leaf, c0.leaf))
+            return false;
+    }
+
+    octree->nodes[node].leaf = c0.leaf;
+    octree->nodes[node].first_child = 0;
+    octree->free_blocks.add(first);
+    return true;
+}
+
+// child index bit i is set when the child is on the upper half of axis i
+int3 child_origin(const int3& origin, i32 half_size, u32 child)
+{
+    return origin + int3{(child >> 0) & 1, (child >> 1) & 1, (child >> 2) & 1} * half_size;
+}
+
+void fill_node(
+    voxel_octree* octree,
+    u32 node,
+    const int3& origin,
+    i32 size,
+    const bounds3i& b,
+    const voxel_leaf& leaf)
+{
+    int3 node_max = origin + (size - 1);
+
+    if (glm::any(glm::lessThan(node_max, b.min)) || glm::any(glm::greaterThan(origin, b.max)))
+        return;
+
+    if (glm::all(glm::lessThanEqual(b.min, origin)) &&
+        glm::all(glm::greaterThanEqual(b.max, node_max)))
+    {
+        free_subtree(octree, node);
+        octree->nodes[node].leaf = leaf;
+        return;
+    }
+
+    if (is_uniform(octree->nodes[node]))
+    {
+        if (leaf_equal(octree->nodes[node].leaf, leaf))
+            return;
+        split(octree, node);
+    }
+
+    i32 half = size / 2;
+    for (u32 i = 0; i < 8; i++)
+    {
+        u32 child = octree->nodes[node].first_child + i;
+        fill_node(octree, child, child_origin(origin, half, i), half, b, leaf);
+    }
+
+    try_collapse(octree, node);
+}
+
+struct slab_hit
+{
+    float tmin, tmax;
+    int axis;
+};
+
+bool ray_slab(const ray& r, const float3& inv_dir, const bounds3f& b, slab_hit* out)
+{
+    float tmin = -INFINITY, tmax = INFINITY;
+    int axis = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        float t0 = (b.min[i] - r.origin[i]) * inv_dir[i];
+        float t1 = (b.max[i] - r.origin[i]) * inv_dir[i];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > tmin)
+            tmin = t0, axis = i;
+        if (t1 < tmax)
+            tmax = t1;
+    }
+
+    out->tmin = tmin;
+    out->tmax = tmax;
+    out->axis = axis;
+    return tmin <= tmax && tmax >= 0.f;
+}
+
+struct raycast_context
+{
+    const voxel_octree* octree;
+    const ray* r;
+    float3 inv_dir;
+    float3 scene_min;
+    float3 voxel_extents;
+};
+
+bool raycast_node(
+    const raycast_context& ctx,
+    u32 node,
+    const int3& origin,
+    i32 size,
+    const slab_hit& entry,
+    voxel_octree_hit* out_hit)
+{
+    const voxel_octree_node& n = ctx.octree->nodes[node];
+
+    if (is_uniform(n))
+    {
+        if (~n.leaf.flags & voxel_flag_solid)
+            return false;
+
+        // Hit the entry face of a solid block; locate the voxel by stepping
+        // half a voxel into the block from the entry point.
+        float3 p = ctx.r->origin + ctx.r->direction * entry.tmin;
+        float3 local = (p - ctx.scene_min) / ctx.voxel_extents;
+        int3 v = (int3)glm::floor(local);
+        v = glm::clamp(v, origin, origin + (size - 1));
+
+        out_hit->t = entry.tmin;
+        out_hit->voxel_coords = v;
+        out_hit->normal = float3{0.f};
+        out_hit->normal[entry.axis] = ctx.r->direction[entry.axis] > 0.f ? -1.f : 1.f;
+        return true;
+    }
+
+    // visit children front to back by their entry distance
+    i32 half = size / 2;
+    u32 order[8];
+    slab_hit hits[8];
+    int count = 0;
+
+    for (u32 i = 0; i < 8; i++)
+    {
+        u32 child = n.first_child + i;
+        const voxel_octree_node& c = ctx.octree->nodes[child];
+        if (is_uniform(c) && (~c.leaf.flags & voxel_flag_solid))
+            continue;
+
+        int3 co = child_origin(origin, half, i);
+        if (glm::any(glm::greaterThanEqual(co, int3{ctx.octree->resolution})))
+            continue;
+
+        bounds3f cb;
+        cb.min = ctx.scene_min + float3{co} * ctx.voxel_extents;
+        cb.max = cb.min + float(half) * ctx.voxel_extents;
+
+        slab_hit h;
+        if (!ray_slab(*ctx.r, ctx.inv_dir, cb, &h))
+            continue;
+
+        int j = count++;
+        while (j > 0 && hits[j - 1].tmin > h.tmin)
+        {
+            hits[j] = hits[j - 1];
+            order[j] = order[j - 1];
+            j--;
+        }
+        hits[j] = h;
+        order[j] = i;
+    }
+
+    for (int k = 0; k < count; k++)
+    {
+        u32 i = order[k];
+        if (raycast_node(
+                ctx,
+                n.first_child + i,
+                child_origin(origin, half, i),
+                half,
+                hits[k],
+                out_hit))
+            return true;
+    }
+
+    return false;
+}
+
+void visit_node(
+    const voxel_octree* octree,
+    u32 node,
+    const int3& origin,
+    i32 size,
+    voxel_octree_visitor visitor,
+    void* user)
+{
+    if (glm::any(glm::greaterThanEqual(origin, int3{octree->resolution})))
+        return;
+
+    const voxel_octree_node& n = octree->nodes[node];
+
+    if (is_uniform(n))
+    {
+        if (n.leaf.flags & voxel_flag_solid)
+        {
+            bounds3i region;
+            region.min = origin;
+            region.max = glm::min(origin + (size - 1), int3{octree->resolution - 1});
+            visitor(region, n.leaf, user);
+        }
+        return;
+    }
+
+    i32 half = size / 2;
+    for (u32 i = 0; i < 8; i++)
+        visit_node(octree, n.first_child + i, child_origin(origin, half, i), half, visitor, user);
+}
+} // namespace
+
+voxel_octree* voxel_octree_create(i32 resolution)
+{
+    assert(resolution > 0);
+
+    voxel_octree* octree = new voxel_octree;
+    octree->resolution = resolution;
+    octree->size = 1;
+    octree->depth = 0;
+    while (octree->size < resolution)
+        octree->size <<= 1, octree->depth++;
+
+    voxel_octree_clear(octree);
+    return octree;
+}
+
+void voxel_octree_destroy(voxel_octree* octree) { delete octree; }
+
+void voxel_octree_clear(voxel_octree* octree)
+{
+    octree->nodes.clear();
+    octree->free_blocks.clear();
+
+    voxel_octree_node& root = octree->nodes.add();
+    root.first_child = 0;
+    root.leaf = normalized(voxel_leaf{});
+}
+
+void voxel_octree_build(voxel_octree* octree, const voxel_world* world)
+{
+    voxel_octree_clear(octree);
+
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+
+    for (int i = 0; i < coords.size(); i++)
+    {
+        const voxel_chunk* chunk = voxel_world_find_chunk(world, coords[i]);
+        if (!chunk)
+            continue;
+
+        const int3 base = chunk->coords * voxel_chunk_size;
+
+        for (int z = 0; z < voxel_chunk_size; z++)
+            for (int y = 0; y < voxel_chunk_size; y++)
+                for (int x = 0; x < voxel_chunk_size; x++)
+                {
+                    const i32 v = voxel_chunk_index(int3{x, y, z});
+                    if (voxel_chunk_is_solid(chunk, v))
+                        voxel_octree_set(octree, base + int3{x, y, z}, voxel_chunk_get(chunk, v));
+                }
+    }
+}
+
+voxel_leaf voxel_octree_get(const voxel_octree* octree, const int3& p)
+{
+    if (glm::any(glm::lessThan(p, int3{0})) ||
+        glm::any(glm::greaterThanEqual(p, int3{octree->resolution})))
+        return normalized(voxel_leaf{});
+
+    u32 node = 0;
+    i32 half = octree->size / 2;
+
+    while (!is_uniform(octree->nodes[node]))
+    {
+        u32 child = ((p.x & half) ? 1 : 0) | ((p.y & half) ? 2 : 0) | ((p.z & half) ? 4 : 0);
+        node = octree->nodes[node].first_child + child;
+        half >>= 1;
+    }
+
+    return octree->nodes[node].leaf;
+}
+
+bool voxel_octree_is_solid(const voxel_octree* octree, const int3& p)
+{
+    return (voxel_octree_get(octree, p).flags & voxel_flag_solid) != 0;
+}
+
+void voxel_octree_set(voxel_octree* octree, const int3& p, const voxel_leaf& leaf)
+{
+    if (glm::any(glm::lessThan(p, int3{0})) ||
+        glm::any(glm::greaterThanEqual(p, int3{octree->resolution})))
+        return;
+
+    voxel_leaf value = normalized(leaf);
+    u32 path[32];
+    int depth = 0;
+    u32 node = 0;
+    i32 half = octree->size / 2;
+
+    while (half > 0)
+    {
+        if (is_uniform(octree->nodes[node]))
+        {
+            if (leaf_equal(octree->nodes[node].leaf, value))
+                return;
+            split(octree, node);
+        }
+
+        path[depth++] = node;
+        u32 child = ((p.x & half) ? 1 : 0) | ((p.y & half) ? 2 : 0) | ((p.z & half) ? 4 : 0);
+        node = octree->nodes[node].first_child + child;
+        half >>= 1;
+    }
+
+    octree->nodes[node].leaf = value;
+
+    while (depth > 0 && try_collapse(octree, path[--depth]))
+        ;
+}
+
+void voxel_octree_fill(voxel_octree* octree, const bounds3i& b, const voxel_leaf& leaf)
+{
+    bounds3i clipped;
+    clipped.min = glm::max(b.min, int3{0});
+    clipped.max = glm::min(b.max, int3{octree->resolution - 1});
+
+    if (glm::any(glm::greaterThan(clipped.min, clipped.max)))
+        return;
+
+    fill_node(octree, 0, int3{0}, octree->size, clipped, normalized(leaf));
+}
+
+bool voxel_octree_raycast(
+    const voxel_octree* octree,
+    const ray& r,
+    const bounds3f& scene_bounds,
+    voxel_octree_hit* out_hit)
+{
+    raycast_context ctx;
+    ctx.octree = octree;
+    ctx.r = &r;
+    ctx.inv_dir = 1.f / r.direction;
+    ctx.scene_min = scene_bounds.min;
+    ctx.voxel_extents = extents(scene_bounds) / (float)octree->resolution;
+
+    bounds3f root_bounds;
+    root_bounds.min = scene_bounds.min;
+    root_bounds.max = scene_bounds.min + float(octree->size) * ctx.voxel_extents;
+
+    slab_hit entry;
+    if (!ray_slab(r, ctx.inv_dir, root_bounds, &entry))
+        return false;
+
+    return raycast_node(ctx, 0, int3{0}, octree->size, entry, out_hit);
+}
+
+void voxel_octree_visit(const voxel_octree* octree, voxel_octree_visitor visitor, void* user)
+{
+    visit_node(octree, 0, int3{0}, octree->size, visitor, user);
+}
+
+u32 voxel_octree_node_count(const voxel_octree* octree)
+{
+    return (u32)(octree->nodes.size() - 8 * octree->free_blocks.size());
+}
+
+usize voxel_octree_byte_size(const voxel_octree* octree)
+{
+    return sizeof(voxel_octree) + octree->nodes.byte_size() + octree->free_blocks.byte_size();
+}
+}
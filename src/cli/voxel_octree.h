@@ -0,0 +1,74 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+#include "common/array.h"
+
+namespace vx
+{
+// The chunked voxel_world stores the scenes of the editor. The octree is
+// kept next to the benchmarks as a point of comparison for its memory use,
+// lookups and raycasts.
+//
+// Sparse voxel octree over a power-of-two cube. Nodes whose whole region holds
+// the same leaf are stored as a single uniform node, so empty space and solid
+// single-colored blocks cost one node regardless of their size.
+//
+// Nodes live in a flat pool; children are allocated in blocks of 8 and
+// addressed by the index of the first one. The root is always node 0, so a
+// first_child of 0 marks a uniform node.
+struct voxel_octree_node
+{
+    u32 first_child;
+    voxel_leaf leaf;
+};
+
+struct voxel_octree
+{
+    i32 resolution;
+    i32 size;
+    i32 depth;
+    array<voxel_octree_node> nodes;
+    array<u32> free_blocks;
+};
+
+struct voxel_octree_hit
+{
+    float t;
+    int3 voxel_coords;
+    float3 normal;
+};
+
+voxel_octree* voxel_octree_create(i32 resolution);
+void voxel_octree_destroy(voxel_octree* octree);
+
+void voxel_octree_clear(voxel_octree* octree);
+
+// replace the contents of the octree with the solid voxels of the world
+void voxel_octree_build(voxel_octree* octree, const voxel_world* world);
+
+voxel_leaf voxel_octree_get(const voxel_octree* octree, const int3& p);
+
+bool voxel_octree_is_solid(const voxel_octree* octree, const int3& p);
+
+void voxel_octree_set(voxel_octree* octree, const int3& p, const voxel_leaf& leaf);
+
+// set every voxel in the inclusive box [b.min, b.max], clipped to the octree
+void voxel_octree_fill(voxel_octree* octree, const bounds3i& b, const voxel_leaf& leaf);
+
+// Find the closest solid voxel along the ray. The octree is mapped onto
+// scene_bounds with resolution voxels per axis. Empty nodes are skipped as a
+// whole, so the cost depends on the number of non-uniform nodes along the ray.
+bool voxel_octree_raycast(
+    const voxel_octree* octree,
+    const ray& r,
+    const bounds3f& scene_bounds,
+    voxel_octree_hit* out_hit);
+
+// Visit each solid uniform region of the octree as an inclusive voxel box.
+using voxel_octree_visitor = void (*)(const bounds3i& region, const voxel_leaf& leaf, void* user);
+void voxel_octree_visit(const voxel_octree* octree, voxel_octree_visitor visitor, void* user);
+
+u32 voxel_octree_node_count(const voxel_octree* octree);
+
+usize voxel_octree_byte_size(const voxel_octree* octree);
+}
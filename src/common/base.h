@@ -84,9 +84,14 @@ static_assert(VX_OS != VX_OS_UNKNOWN, "Platform detection failed");
 //
 
 #if VX_PLATFORM == VX_PLATFORM_WIN32
+#include <intrin.h>
 #define vx_popcnt(x) __popcnt(x)
+#define vx_popcnt64(x) __popcnt64(x)
+#define vx_ctz64(x) _tzcnt_u64(x)
 #elif VX_PLATFORM == VX_PLATFORM_POSIX
 #define vx_popcnt(x) __builtin_popcount(x)
+#define vx_popcnt64(x) __builtin_popcountll(x)
+#define vx_ctz64(x) __builtin_ctzll(x)
 #endif
 
 //
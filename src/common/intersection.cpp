@@ -1,6 +1,15 @@
 #include "common/intersection.h"
 #include "common/geometry.h"
 
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#define VX_RAY_AABB_SIMD
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VX_RAY_AABB_SIMD
+#define VX_RAY_AABB_SSE
+#endif
+
 namespace vx
 {
 bool ray_intersects_aabb(const ray& r, const bounds3f& b, float* out_t)
@@ -47,6 +56,224 @@ bool ray_intersects_aabb(const ray& r, const bounds3f& b, float* out_t)
     return true;
 }
 
+namespace
+{
+// Each instruction set wraps the few operations the slab test needs.
+// min(b, a) and max(a, b) select exactly like the compare and swaps of
+// ray_intersects_aabb, NaNs from zero direction components included.
+#if defined(__AVX512F__)
+struct simd
+{
+    using f = __m512;
+    static constexpr int width = 16;
+    static f load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, f a) { _mm512_storeu_ps(p, a); }
+    static f set1(float a) { return _mm512_set1_ps(a); }
+    static f sub(f a, f b) { return _mm512_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm512_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm512_div_ps(a, b); }
+    static f min(f a, f b) { return _mm512_min_ps(a, b); }
+    static f max(f a, f b) { return _mm512_max_ps(a, b); }
+    static u32 gt(f a, f b) { return _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ); }
+};
+#elif defined(__AVX2__)
+struct simd
+{
+    using f = __m256;
+    static constexpr int width = 8;
+    static f load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, f a) { _mm256_storeu_ps(p, a); }
+    static f set1(float a) { return _mm256_set1_ps(a); }
+    static f sub(f a, f b) { return _mm256_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm256_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm256_div_ps(a, b); }
+    static f min(f a, f b) { return _mm256_min_ps(a, b); }
+    static f max(f a, f b) { return _mm256_max_ps(a, b); }
+    static u32 gt(f a, f b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_GT_OQ)); }
+};
+#elif defined(VX_RAY_AABB_SSE)
+struct simd
+{
+    using f = __m128;
+    static constexpr int width = 4;
+    static f load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, f a) { _mm_storeu_ps(p, a); }
+    static f set1(float a) { return _mm_set1_ps(a); }
+    static f sub(f a, f b) { return _mm_sub_ps(a, b); }
+    static f mul(f a, f b) { return _mm_mul_ps(a, b); }
+    static f div(f a, f b) { return _mm_div_ps(a, b); }
+    static f min(f a, f b) { return _mm_min_ps(a, b); }
+    static f max(f a, f b) { return _mm_max_ps(a, b); }
+    static u32 gt(f a, f b) { return _mm_movemask_ps(_mm_cmpgt_ps(a, b)); }
+};
+#else
+struct simd
+{
+    static constexpr int width = 1;
+};
+#endif
+
+#if defined(VX_RAY_AABB_SIMD)
+static_assert(64 % simd::width == 0, "Batches must not straddle hit mask words");
+
+// ray_intersects_aabb on simd::width lanes, returns the mask of hits
+inline u32 slab_test(
+    const simd::f o[3],
+    const simd::f inv_d[3],
+    const simd::f mn[3],
+    const simd::f mx[3],
+    simd::f* out_t)
+{
+    simd::f t0 = simd::mul(simd::sub(mn[0], o[0]), inv_d[0]);
+    simd::f t1 = simd::mul(simd::sub(mx[0], o[0]), inv_d[0]);
+    simd::f tmin = simd::min(t1, t0);
+    simd::f tmax = simd::max(t0, t1);
+
+    t0 = simd::mul(simd::sub(mn[1], o[1]), inv_d[1]);
+    t1 = simd::mul(simd::sub(mx[1], o[1]), inv_d[1]);
+    simd::f tymin = simd::min(t1, t0);
+    simd::f tymax = simd::max(t0, t1);
+
+    u32 miss = simd::gt(tmin, tymax) | simd::gt(tymin, tmax);
+    tmin = simd::max(tymin, tmin);
+    tmax = simd::min(tymax, tmax);
+
+    t0 = simd::mul(simd::sub(mn[2], o[2]), inv_d[2]);
+    t1 = simd::mul(simd::sub(mx[2], o[2]), inv_d[2]);
+    simd::f tzmin = simd::min(t1, t0);
+    simd::f tzmax = simd::max(t0, t1);
+
+    miss |= simd::gt(tmin, tzmax) | simd::gt(tzmin, tmax);
+    *out_t = simd::max(tzmin, tmin);
+
+    return ~miss & (u32)((1ull << simd::width) - 1);
+}
+#endif
+
+void clear_hit_masks(u64* out_hit_masks, int count)
+{
+    for (int i = 0; i < (count + 63) / 64; i++)
+        out_hit_masks[i] = 0;
+}
+
+void set_hit(u64* out_hit_masks, int i)
+{
+    out_hit_masks[i / 64] |= 1ull << (i % 64);
+}
+}
+
+int ray_intersects_aabbs(
+    const ray& r,
+    const aabb_soa& boxes,
+    int count,
+    u64* out_hit_masks,
+    float* out_t)
+{
+    clear_hit_masks(out_hit_masks, count);
+
+    int i = 0;
+    int hits = 0;
+
+#if defined(VX_RAY_AABB_SIMD)
+    const simd::f o[3] = {simd::set1(r.origin.x), simd::set1(r.origin.y), simd::set1(r.origin.z)};
+    const simd::f inv_d[3] = {
+        simd::set1(1.f / r.direction.x),
+        simd::set1(1.f / r.direction.y),
+        simd::set1(1.f / r.direction.z),
+    };
+
+    for (; i + simd::width <= count; i += simd::width)
+    {
+        const simd::f mn[3] = {
+            simd::load(boxes.min_x + i), simd::load(boxes.min_y + i), simd::load(boxes.min_z + i)};
+        const simd::f mx[3] = {
+            simd::load(boxes.max_x + i), simd::load(boxes.max_y + i), simd::load(boxes.max_z + i)};
+
+        simd::f t;
+        u32 mask = slab_test(o, inv_d, mn, mx, &t);
+        simd::store(out_t + i, t);
+
+        out_hit_masks[i / 64] |= (u64)mask << (i % 64);
+        hits += vx_popcnt(mask);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        bounds3f b{
+            float3{boxes.min_x[i], boxes.min_y[i], boxes.min_z[i]},
+            float3{boxes.max_x[i], boxes.max_y[i], boxes.max_z[i]},
+        };
+        if (ray_intersects_aabb(r, b, &out_t[i]))
+        {
+            set_hit(out_hit_masks, i);
+            hits++;
+        }
+    }
+
+    return hits;
+}
+
+int rays_intersect_aabb(
+    const ray_soa& rays,
+    int count,
+    const bounds3f& b,
+    u64* out_hit_masks,
+    float* out_t)
+{
+    clear_hit_masks(out_hit_masks, count);
+
+    int i = 0;
+    int hits = 0;
+
+#if defined(VX_RAY_AABB_SIMD)
+    const simd::f one = simd::set1(1.f);
+    const simd::f mn[3] = {simd::set1(b.min.x), simd::set1(b.min.y), simd::set1(b.min.z)};
+    const simd::f mx[3] = {simd::set1(b.max.x), simd::set1(b.max.y), simd::set1(b.max.z)};
+
+    for (; i + simd::width <= count; i += simd::width)
+    {
+        const simd::f o[3] = {
+            simd::load(rays.origin_x + i),
+            simd::load(rays.origin_y + i),
+            simd::load(rays.origin_z + i),
+        };
+        const simd::f inv_d[3] = {
+            simd::div(one, simd::load(rays.direction_x + i)),
+            simd::div(one, simd::load(rays.direction_y + i)),
+            simd::div(one, simd::load(rays.direction_z + i)),
+        };
+
+        simd::f t;
+        u32 mask = slab_test(o, inv_d, mn, mx, &t);
+        simd::store(out_t + i, t);
+
+        out_hit_masks[i / 64] |= (u64)mask << (i % 64);
+        hits += vx_popcnt(mask);
+    }
+#endif
+
+    for (; i < count; i++)
+    {
+        ray r{
+            float3{rays.origin_x[i], rays.origin_y[i], rays.origin_z[i]},
+            float3{rays.direction_x[i], rays.direction_y[i], rays.direction_z[i]},
+        };
+        if (ray_intersects_aabb(r, b, &out_t[i]))
+        {
+            set_hit(out_hit_masks, i);
+            hits++;
+        }
+    }
+
+    return hits;
+}
+
+int ray_aabb_batch_width()
+{
+    return simd::width;
+}
+
 void ray_intersects_plane(const ray& r, const plane& p, float& out_t)
 {
     assert(std::abs(glm::l2Norm(r.direction) - 1.f) < 0.000001f);
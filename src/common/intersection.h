@@ -6,5 +6,52 @@ namespace vx
 {
 bool ray_intersects_aabb(const ray& r, const bounds3f& b, float* out_t);
 
+// Boxes in structure of arrays layout, each pointer to count floats.
+struct aabb_soa
+{
+    const float* min_x;
+    const float* min_y;
+    const float* min_z;
+    const float* max_x;
+    const float* max_y;
+    const float* max_z;
+};
+
+struct ray_soa
+{
+    const float* origin_x;
+    const float* origin_y;
+    const float* origin_z;
+    const float* direction_x;
+    const float* direction_y;
+    const float* direction_z;
+};
+
+// Batched versions of ray_intersects_aabb, giving the same results bit for
+// bit. Hits are written as bit i % 64 of out_hit_masks[i / 64] and t as
+// out_t[i], which is only meaningful for hits. Return the number of hits.
+//
+// The instruction set is picked at compile time, AVX-512 or AVX2 when the
+// compiler targets them, SSE otherwise and plain scalar code off x86.
+
+// one ray against count boxes
+int ray_intersects_aabbs(
+    const ray& r,
+    const aabb_soa& boxes,
+    int count,
+    u64* out_hit_masks,
+    float* out_t);
+
+// count rays against one box
+int rays_intersect_aabb(
+    const ray_soa& rays,
+    int count,
+    const bounds3f& b,
+    u64* out_hit_masks,
+    float* out_t);
+
+// lanes per instruction of the batched tests, for stats and benchmarks
+int ray_aabb_batch_width();
+
 void ray_intersects_plane(const ray& r, const plane& plane, float& out_t);
 }
@@ -0,0 +1,103 @@
+#include "common/job_system.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vx
+{
+struct job
+{
+    job_fn fn;
+    void* data;
+};
+
+struct job_system
+{
+    std::vector<std::thread> workers;
+    std::deque<job> queue;
+    std::mutex mutex;
+    std::condition_variable queue_changed;
+
+    // jobs submitted and not finished yet
+    u32 pending;
+    std::condition_variable idle;
+    bool quit;
+};
+
+static void worker_main(job_system* jobs)
+{
+    for (;;)
+    {
+        job j;
+        {
+            std::unique_lock<std::mutex> lock(jobs->mutex);
+            jobs->queue_changed.wait(lock, [jobs] { return jobs->quit || !jobs->queue.empty(); });
+            if (jobs->queue.empty())
+                return;
+            j = jobs->queue.front();
+            jobs->queue.pop_front();
+        }
+        j.fn(j.data);
+
+        std::lock_guard<std::mutex> lock(jobs->mutex);
+        if (--jobs->pending == 0)
+            jobs->idle.notify_all();
+    }
+}
+
+job_system* job_system_create(i32 worker_count)
+{
+    if (worker_count < 0)
+        worker_count = std::max((i32)std::thread::hardware_concurrency() - 1, 1);
+
+    job_system* jobs = new job_system;
+    jobs->pending = 0;
+    jobs->quit = false;
+    for (i32 i = 0; i < worker_count; i++)
+        jobs->workers.emplace_back(worker_main, jobs);
+
+    return jobs;
+}
+
+void job_system_destroy(job_system* jobs)
+{
+    {
+        std::lock_guard<std::mutex> lock(jobs->mutex);
+        jobs->quit = true;
+    }
+    jobs->queue_changed.notify_all();
+
+    // Workers drain the queue before they exit.
+    for (std::thread& worker : jobs->workers)
+        worker.join();
+
+    delete jobs;
+}
+
+void job_system_submit(job_system* jobs, job_fn fn, void* data)
+{
+    if (jobs->workers.empty())
+    {
+        fn(data);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobs->mutex);
+        jobs->queue.push_back(job{fn, data});
+        jobs->pending++;
+    }
+    jobs->queue_changed.notify_one();
+}
+
+void job_system_wait(job_system* jobs)
+{
+    std::unique_lock<std::mutex> lock(jobs->mutex);
+    jobs->idle.wait(lock, [jobs] { return jobs->pending == 0; });
+}
+
+u32 job_system_worker_count(const job_system* jobs) { return (u32)jobs->workers.size(); }
+}
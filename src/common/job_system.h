@@ -0,0 +1,69 @@
+#pragma once
+
+#include "common/base.h"
+
+#include <atomic>
+
+namespace vx
+{
+//
+// jobs
+//
+
+// A fixed pool of worker threads running jobs in submission order. With zero
+// workers jobs run immediately on the submitting thread.
+struct job_system;
+
+using job_fn = void (*)(void* data);
+
+// worker_count < 0 picks one worker per hardware thread, minus one for the caller
+job_system* job_system_create(i32 worker_count);
+
+// waits for all submitted jobs to finish
+void job_system_destroy(job_system* jobs);
+
+void job_system_submit(job_system* jobs, job_fn fn, void* data);
+
+// waits for all submitted jobs to finish, the workers keep running
+void job_system_wait(job_system* jobs);
+
+u32 job_system_worker_count(const job_system* jobs);
+
+//
+// lock-free list
+//
+
+// Intrusive list which any number of threads can push to without locking,
+// while a single consumer takes all of the nodes at once. T needs a T* next.
+template<typename T>
+struct mpsc_list
+{
+    std::atomic<T*> head{nullptr};
+};
+
+template<typename T>
+void mpsc_list_push(mpsc_list<T>* list, T* node)
+{
+    T* head = list->head.load(std::memory_order_relaxed);
+    do
+        node->next = head;
+    while (!list->head.compare_exchange_weak(
+        head, node, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// take all nodes in the order they were pushed
+template<typename T>
+T* mpsc_list_take_all(mpsc_list<T>* list)
+{
+    T* node = list->head.exchange(nullptr, std::memory_order_acquire);
+    T* reversed = nullptr;
+    while (node)
+    {
+        T* next = node->next;
+        node->next = reversed;
+        reversed = node;
+        node = next;
+    }
+    return reversed;
+}
+}
@@ -1,5 +1,19 @@
 #include "platform/filesystem.h"
 
+#if VX_PLATFORM == VX_PLATFORM_WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#elif VX_PLATFORM == VX_PLATFORM_POSIX
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
 namespace vx
 {
 char* read_whole_file(const char* path, usize* out_file_size)
@@ -26,4 +40,218 @@ char* read_whole_file(const char* path, usize* out_file_size)
 
     return buf;
 }
+
+#if VX_PLATFORM == VX_PLATFORM_WIN32
+bool map_file(const char* path, mapped_file* out_file)
+{
+    *out_file = mapped_file{};
+
+    HANDLE file = CreateFileA(
+        path,
+        GENERIC_READ,
+        FILE_SHARE_READ | FILE_SHARE_DELETE,
+        nullptr,
+        OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL,
+        nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+    {
+        // Empty files can not be mapped, but they are valid.
+        bool ok = size.QuadPart == 0;
+        CloseHandle(file);
+        return ok;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!data)
+    {
+        if (mapping)
+            CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    out_file->data = (const u8*)data;
+    out_file->size = (usize)size.QuadPart;
+    out_file->file = file;
+    out_file->mapping = mapping;
+    return true;
+}
+
+void unmap_file(mapped_file* file)
+{
+    if (file->data)
+    {
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->mapping);
+        CloseHandle(file->file);
+    }
+    *file = mapped_file{};
+}
+
+bool replace_file(const char* src_path, const char* dst_path)
+{
+    if (MoveFileExA(src_path, dst_path, MOVEFILE_REPLACE_EXISTING))
+        return true;
+
+    // A mapped file can not be replaced, but it can be renamed since
+    // map_file shares delete access. Move it aside and mark it for
+    // deletion, it goes away once the last mapping is closed.
+    char aside[MAX_PATH];
+    std::snprintf(aside, sizeof aside, "%s.%lu.old", dst_path, GetCurrentProcessId());
+    if (!MoveFileExA(dst_path, aside, MOVEFILE_REPLACE_EXISTING))
+        return false;
+
+    if (!MoveFileExA(src_path, dst_path, 0))
+    {
+        MoveFileExA(aside, dst_path, 0);
+        return false;
+    }
+
+    DeleteFileA(aside);
+    return true;
+}
+
+bool file_seek(FILE* f, u64 offset)
+{
+    return _fseeki64(f, (__int64)offset, SEEK_SET) == 0;
+}
+
+bool visit_files(const char* path, file_visitor visitor, void* user)
+{
+    char pattern[MAX_PATH];
+    if (std::snprintf(pattern, sizeof pattern, "%s\\*", path) >= (int)sizeof pattern)
+        return false;
+
+    WIN32_FIND_DATAA entry;
+    HANDLE find = FindFirstFileA(pattern, &entry);
+    if (find == INVALID_HANDLE_VALUE)
+        return false;
+
+    do
+    {
+        if (!std::strcmp(entry.cFileName, ".") || !std::strcmp(entry.cFileName, ".."))
+            continue;
+
+        char child[MAX_PATH];
+        if (std::snprintf(child, sizeof child, "%s\\%s", path, entry.cFileName) >=
+            (int)sizeof child)
+            continue;
+
+        // Reparse points are not followed, they can form cycles.
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
+            continue;
+        if (entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            visit_files(child, visitor, user);
+        else
+            visitor(child, user);
+    } while (FindNextFileA(find, &entry));
+
+    FindClose(find);
+    return true;
+}
+
+bool create_directory(const char* path)
+{
+    if (CreateDirectoryA(path, nullptr))
+        return true;
+
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+}
+#elif VX_PLATFORM == VX_PLATFORM_POSIX
+bool map_file(const char* path, mapped_file* out_file)
+{
+    *out_file = mapped_file{};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    // Empty files can not be mapped, but they are valid.
+    if (st.st_size == 0)
+    {
+        close(fd);
+        return true;
+    }
+
+    // the mapping keeps the file alive, the descriptor is not needed anymore
+    void* data = mmap(nullptr, (usize)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+        return false;
+
+    out_file->data = (const u8*)data;
+    out_file->size = (usize)st.st_size;
+    return true;
+}
+
+void unmap_file(mapped_file* file)
+{
+    if (file->data)
+        munmap((void*)file->data, file->size);
+    *file = mapped_file{};
+}
+
+bool replace_file(const char* src_path, const char* dst_path)
+{
+    return std::rename(src_path, dst_path) == 0;
+}
+
+bool file_seek(FILE* f, u64 offset)
+{
+    return fseeko(f, (off_t)offset, SEEK_SET) == 0;
+}
+
+bool visit_files(const char* path, file_visitor visitor, void* user)
+{
+    DIR* dir = opendir(path);
+    if (!dir)
+        return false;
+
+    while (dirent* entry = readdir(dir))
+    {
+        if (!std::strcmp(entry->d_name, ".") || !std::strcmp(entry->d_name, ".."))
+            continue;
+
+        char child[4096];
+        if (std::snprintf(child, sizeof child, "%s/%s", path, entry->d_name) >= (int)sizeof child)
+            continue;
+
+        // Links to directories are not followed, they can form cycles.
+        // Links to files are.
+        struct stat st;
+        if (lstat(child, &st) != 0)
+            continue;
+        if (S_ISDIR(st.st_mode))
+            visit_files(child, visitor, user);
+        else if (S_ISREG(st.st_mode) || (stat(child, &st) == 0 && S_ISREG(st.st_mode)))
+            visitor(child, user);
+    }
+
+    closedir(dir);
+    return true;
+}
+
+bool create_directory(const char* path)
+{
+    if (mkdir(path, 0777) == 0)
+        return true;
+
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+}
+#endif
 }
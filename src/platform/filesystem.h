@@ -5,4 +5,37 @@
 namespace vx
 {
 char* read_whole_file(const char* path, usize* out_file_size);
+
+// A whole file mapped read-only into memory. Pages are only read from disk
+// when first touched.
+struct mapped_file
+{
+    const u8* data;
+    usize size;
+
+#if VX_PLATFORM == VX_PLATFORM_WIN32
+    void* file;
+    void* mapping;
+#endif
+};
+
+// false if the file could not be opened or mapped
+bool map_file(const char* path, mapped_file* out_file);
+void unmap_file(mapped_file* file);
+
+// Move src_path over dst_path, replacing it in one step. Mappings of the
+// replaced file stay valid.
+bool replace_file(const char* src_path, const char* dst_path);
+
+// fseek from the start of the file, with offsets past 2 GiB on every platform
+bool file_seek(FILE* f, u64 offset);
+
+// Calls visitor with the path of every file in the directory at path and the
+// directories below it, in no particular order. False if path is not a
+// directory.
+using file_visitor = void (*)(const char* path, void* user);
+bool visit_files(const char* path, file_visitor visitor, void* user);
+
+// true if the directory exists afterwards, parents are not created
+bool create_directory(const char* path);
 }
@@ -1,40 +1,55 @@
 #define RENDER_FLAG_AMBIENT_OCCLUSION (1 << 0)
 #define RENDER_FLAG_DIRECTIONAL_LIGHT (1 << 1)
 
+// see voxel_vertex in voxel_mesher.h
 layout(std430, binding = 0) restrict readonly buffer vertex_t
 {
-    float vertex_data[];
+    uint vertex_data[];
 };
 
 layout(std430, binding = 1, column_major) buffer global_constants
 {
     mat4 world_to_clip;
+    vec4 voxel_to_world;
     uint flags;
 } global;
 
 #if VX_SHADER == VX_VERTEX_SHADER
 
+const vec3 normals[6] = vec3[6](
+    vec3(+1.0, 0.0, 0.0),
+    vec3(0.0, +1.0, 0.0),
+    vec3(0.0, 0.0, +1.0),
+    vec3(-1.0, 0.0, 0.0),
+    vec3(0.0, -1.0, 0.0),
+    vec3(0.0, 0.0, -1.0));
+
 out vec3 v_normal;
 out vec4 v_color;
 out float v_ao;
 
 void main()
 {
+    uint w0 = vertex_data[gl_VertexID * 2 + 0];
+    uint w1 = vertex_data[gl_VertexID * 2 + 1];
+
     vec3 pos;
-    pos.x = vertex_data[gl_VertexID * 8 + 0];
-    pos.y = vertex_data[gl_VertexID * 8 + 1];
-    pos.z = vertex_data[gl_VertexID * 8 + 2];
+    pos.x = float(w0 & 0xfffu);
+    pos.y = float((w0 >> 12) & 0xfffu);
+    pos.z = float(w1 & 0xfffu);
+    pos = global.voxel_to_world.xyz + pos * global.voxel_to_world.w;
 
     vec4 color;
-    color = unpackUnorm4x8(floatBitsToUint(vertex_data[gl_VertexID * 8 + 3]));
+    color.r = float((w1 >> 12) & 0x1fu) / 31.0;
+    color.g = float((w1 >> 17) & 0x3fu) / 63.0;
+    color.b = float((w1 >> 23) & 0x1fu) / 31.0;
+    color.a = 1.0;
 
     vec3 normal;
-    normal.x = vertex_data[gl_VertexID * 8 + 4];
-    normal.y = vertex_data[gl_VertexID * 8 + 5];
-    normal.z = vertex_data[gl_VertexID * 8 + 6];
+    normal = normals[(w0 >> 24) & 0x7u];
 
     float ao;
-    ao = vertex_data[gl_VertexID * 8 + 7];
+    ao = 0.5 * float((w0 >> 27) & 0x3u);
 
     v_normal = normal;
     v_color = color;
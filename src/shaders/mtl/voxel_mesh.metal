@@ -3,20 +3,29 @@
 
 using namespace metal;
 
+// see voxel_vertex in voxel_mesher.h
 struct vertex_t
 {
-    packed_float3 pos;
-    packed_uchar4 color;
-    packed_float3 normal;
-    float ao;
+    uint xy_normal_ao;
+    uint z_color;
 };
 
 struct global_t
 {
     float4x4 world_to_clip;
+    float4 voxel_to_world;
     uint flags;
 };
 
+constant float3 normals[6] = {
+    float3(+1.0f, 0.0f, 0.0f),
+    float3(0.0f, +1.0f, 0.0f),
+    float3(0.0f, 0.0f, +1.0f),
+    float3(-1.0f, 0.0f, 0.0f),
+    float3(0.0f, -1.0f, 0.0f),
+    float3(0.0f, 0.0f, -1.0f),
+};
+
 struct v2f
 {
     float4 pos[[position]];
@@ -37,14 +46,20 @@ vertex v2f vertex_main(
     unsigned int vid[[vertex_id]],
     unsigned int iid[[instance_id]])
 {
-    float4 pos = float4(vertices[vid].pos, 1.0f);
-    float4 color = float4(uchar4(vertices[vid].color)) / 255.0f;
+    uint w0 = vertices[vid].xy_normal_ao;
+    uint w1 = vertices[vid].z_color;
+
+    float3 grid_pos = float3(w0 & 0xfff, (w0 >> 12) & 0xfff, w1 & 0xfff);
+    float4 pos = float4(global.voxel_to_world.xyz + grid_pos * global.voxel_to_world.w, 1.0f);
+    float4 color = float4(
+        ((w1 >> 12) & 0x1f) / 31.0f, ((w1 >> 17) & 0x3f) / 63.0f, ((w1 >> 23) & 0x1f) / 31.0f, 1.0f);
+    float ao = 0.5f * ((w0 >> 27) & 0x3);
 
     v2f out;
     out.pos = global.world_to_clip * pos;
-    out.normal = vertices[vid].normal;
+    out.normal = normals[(w0 >> 24) & 0x7];
     out.color = color;
-    out.ao = global.flags & RENDER_FLAG_AMBIENT_OCCLUSION ? 1.0f - vertices[vid].ao : 1.0f;
+    out.ao = global.flags & RENDER_FLAG_AMBIENT_OCCLUSION ? 1.0f - ao : 1.0f;
     return out;
 }
 
@@ -5,10 +5,22 @@
 #include "common/array.h"
 #include "editor/orbit_camera.h"
 #include "platform/filesystem.h"
+#include "voxel/voxel_brush.h"
+#include "voxel/voxel_clip.h"
+#include "voxel/voxel_components.h"
+#include "voxel/voxel_file.h"
+#include "voxel/voxel_file_saver.h"
+#include "voxel/voxel_history.h"
+#include "voxel/voxel_mesh_export.h"
+#include "voxel/voxel_mesh_scheduler.h"
+#include "voxel/voxel_point_cloud.h"
+#include "voxel/voxel_pyramid.h"
+#include "voxel/voxel_raycast.h"
+#include "voxel/voxel_vox.h"
+#include "voxel/voxel_voxelizer.h"
+#include "voxel/voxel_world.h"
 #include "integrations/imgui/imgui_sdl.h"
 
-#define VX_GRID_SIZE 16
-
 namespace vx
 {
 namespace
@@ -20,17 +32,6 @@ struct voxel_intersect_event
     int3 voxel_coords;
 };
 
-enum voxel_flag
-{
-    voxel_flag_solid = 1 << 0,
-};
-
-struct voxel_leaf
-{
-    float3 color;
-    u32 flags;
-};
-
 // hsv2rgb from https://stackoverflow.com/a/19873710
 float3 hue(float h)
 {
@@ -42,29 +43,6 @@ float3 hue(float h)
 
 float3 hsv_to_rgb(float3 hsv) { return float3(((hue(hsv.x) - 1.f) * hsv.y + 1.f) * hsv.z); }
 
-float3 reconstruct_voxel_normal(const float3& voxel_center, const float3& point_on_voxel)
-{
-    // Reconstruct hit normal from voxel center & hit point by finding
-    // highest magnitude coefficient from their difference, zeroing other
-    // coefficients and extracting the sign of the highest coefficient.
-
-    float3 normal = glm::normalize(point_on_voxel - voxel_center);
-    int max_coeff_index = 0;
-    float max_coeff = 0.0f;
-
-    for (int i = 0; i < 3; i++)
-        if (std::abs(normal[i]) > max_coeff)
-        {
-            max_coeff = std::abs(normal[i]);
-            max_coeff_index = i;
-        }
-
-    for (int i = 0; i < 3; i++)
-        normal[i] = (i == max_coeff_index) ? glm::sign(normal[i]) : 0.0f;
-
-    return normal;
-}
-
 bounds3f reconstruct_voxel_bounds(
     const int3& voxel_coords,
     const bounds3f& voxel_grid_bounds,
@@ -97,10 +75,18 @@ struct color_pallette
 enum edit_brush
 {
     edit_brush_box,
-    edit_brush_voxel
+    edit_brush_voxel,
+    edit_brush_shape,
+    edit_brush_fill,
+    edit_brush_clip
 };
 
-static const char* edit_brush_names[] = {"box", "voxel"};
+static const char* edit_brush_names[] = {"box", "voxel", "shape", "fill", "clip"};
+
+static const char* brush_shape_names[] = {"sphere", "ellipsoid", "cylinder", "cone", "capsule"};
+static const char* brush_mode_names[] = {"union", "subtract", "intersect", "paint"};
+static const char* connectivity_names[] = {"6 faces", "26 faces, edges and corners"};
+static const char* match_names[] = {"solid", "color"};
 
 enum edit_mode
 {
@@ -110,6 +96,10 @@ enum edit_mode
 
 static const char* edit_mode_names[] = {"add", "delete"};
 
+static const i32 resolutions[] = {16, 32, 64, 128, 256, 512, 1024, 2048};
+static const char* resolution_names[] = {"16", "32", "64", "128", "256", "512", "1024", "2048"};
+static const i32 default_resolution = 16;
+
 static const float3 default_bg_color_a{0.445f, 0.566f, 0.819f};
 static const float3 default_bg_color_b{0.193f, 0.426f, 0.985f};
 static const float3 outrun_bg_color_a{0.3564f, 0.03689f, 0.7913f};
@@ -118,18 +108,50 @@ static const float3 outrun_bg_color_b{0.00518f, 0.00091f, 0.33716f};
 struct user_config
 {
     bool invert_zoom{false};
+
+    // -1 picks one per hardware thread
+    i32 mesh_worker_count{-1};
+
+    // 0 disables autosaving
+    i32 autosave_minutes{0};
+
+    // memory kept for undo and redo
+    i32 undo_megabytes{64};
 };
 
 struct voxed_cpu_state
 {
     orbit_camera* camera;
     u32 render_flags;
+    u32 mesh_flags;
 
     bounds3f scene_bounds{float3{-1.f}, float3{1.f}};
     float3 scene_extents;
     float3 voxel_extents;
-    voxel_leaf voxel_grid[VX_GRID_SIZE * VX_GRID_SIZE * VX_GRID_SIZE];
+    voxel_world* world;
     bool voxel_grid_is_dirty;
+
+    // block occupancy of world for picking, updated along with edits to it
+    voxel_pyramid world_pyramid;
+
+    voxel_file_saver* saver;
+    char save_status[64];
+
+    // edits made with the brushes, other changes to the world clear it
+    voxel_history* history;
+
+    // world changed since the last save was started
+    bool unsaved_changes;
+    float autosave_timer;
+
+    // voxel_mesh_format of Export Mesh
+    i32 mesh_export_format;
+
+    // Voxels changed since the mesh was last updated, as an inclusive box.
+    // Changes that affect the whole mesh rebuild it instead.
+    bounds3i voxel_dirty_region;
+    bool voxel_mesh_needs_rebuild;
+
     voxel_intersect_event intersect;
 
     struct ruler
@@ -145,17 +167,73 @@ struct voxed_cpu_state
 
     struct
     {
-        u32 voxel_solid, voxel_empty;
+        u64 voxel_solid, voxel_empty;
+        // corrupt chunks of the scene file found so far, see voxel_world
+        u32 corrupt_chunks;
     } stats;
 
     edit_brush edit_brush;
     edit_mode edit_mode;
+
+    // key pressed with ctrl, its release must not run the plain binding of the
+    // key, whichever of the two is let go first
+    SDL_Scancode ctrl_shortcut_key;
+
     struct
     {
         int3 initial_voxel_coords;
-        voxel_leaf working_voxels[VX_GRID_SIZE * VX_GRID_SIZE * VX_GRID_SIZE];
+
+        // box drawn over the world by the mesher until it is released
+        bounds3i applied_box;
+        voxel_leaf applied_leaf;
+        bool has_applied_box;
     } box_edit_state;
 
+    struct
+    {
+        i32 shape{voxel_brush_shape_sphere};
+        i32 mode{voxel_brush_mode_union};
+        float radius{8.0f};
+        float3 radii{12.0f, 6.0f, 8.0f};
+        float height{16.0f};
+
+        // a stroke is one transaction of the history, from press to release
+        bool stroking{false};
+        float3 last_center{0.0f};
+    } shape_edit_state;
+
+    struct
+    {
+        i32 connectivity{voxel_connectivity_6};
+        i32 match{voxel_match_color};
+
+        // from the last search for floating islands, -1 before the first
+        i32 floating_count{-1};
+        u64 floating_voxels{0};
+    } fill_edit_state;
+
+    struct
+    {
+        // inclusive box dragged over the surface, copied with ctrl+c
+        int3 initial_voxel_coords;
+        bounds3i selection;
+        bool has_selection{false};
+
+        voxel_clip clipboard;
+
+        // clipboard drawn over the world by the mesher at paste_position,
+        // pasted with each click until it is dropped
+        bool pasting{false};
+        int3 paste_position{0};
+        bounds3i applied_bounds;
+    } clip_edit_state;
+
+    // rasterizes the shape brush and labels components
+    job_system* edit_jobs;
+
+    // edit random boxes every frame
+    bool stress_edits;
+
     struct skybox
     {
         // NOTE(vinht): Angles in 0..1.
@@ -192,6 +270,16 @@ static void config_load(user_config* config)
     }
 }
 
+static bool scene_load(voxel_world* world)
+{
+    if (voxel_file_load(world, "scene.vx"))
+    {
+        fprintf(stdout, "Loaded scene\n");
+        return true;
+    }
+    return false;
+}
+
 struct voxed_gpu_state
 {
     struct mesh
@@ -206,6 +294,10 @@ struct voxed_gpu_state
     mesh quad;
     mesh voxel_mesh;
 
+    voxel_mesh_scheduler* mesh_scheduler;
+    i32 voxel_mesh_worker_count;
+    usize voxel_mesh_vertex_capacity, voxel_mesh_index_capacity;
+
     struct shader
     {
         gpu_shader *vertex, *fragment;
@@ -217,12 +309,14 @@ struct voxed_gpu_state
     shader skybox_shader;
 
     bool voxel_mesh_changed_recently;
+    u32 voxel_mesh_face_count;
 
     struct ruler
     {
         mesh mesh;
         bool enabled;
     } rulers[axis_plane_count];
+    i32 ruler_resolution;
 
     struct color_wheel
     {
@@ -235,6 +329,8 @@ struct voxed_gpu_state
         struct
         {
             float4x4 camera;
+            // voxel mesh grid to world, origin in xyz and voxel extent in w
+            float4 voxel_to_world;
             u32 flags;
         } data;
         gpu_buffer* buffer;
@@ -291,6 +387,79 @@ static voxed_cpu_state _voxed_cpu_state;
 static voxed_gpu_state _voxed_gpu_state;
 static voxed _voxed{&_voxed_cpu_state, &_voxed_gpu_state};
 
+static const bounds3i empty_region{int3{INT32_MAX}, int3{INT32_MIN}};
+
+static void mark_dirty(voxed_cpu_state* cpu, const bounds3i& region)
+{
+    cpu->voxel_dirty_region.min = glm::min(cpu->voxel_dirty_region.min, region.min);
+    cpu->voxel_dirty_region.max = glm::max(cpu->voxel_dirty_region.max, region.max);
+    cpu->voxel_grid_is_dirty = true;
+}
+
+static void mark_dirty_all(voxed_cpu_state* cpu)
+{
+    cpu->voxel_mesh_needs_rebuild = true;
+    cpu->voxel_grid_is_dirty = true;
+}
+
+// after changing the voxels of the world in the inclusive box region
+static void world_changed(voxed_cpu_state* cpu, const bounds3i& region)
+{
+    voxel_pyramid_update(&cpu->world_pyramid, cpu->world, region);
+    cpu->unsaved_changes = true;
+}
+
+// Saving runs in the background, edits made in the meantime are left for the
+// next save.
+static void scene_save(voxed_cpu_state* cpu, const char* path)
+{
+    if (!voxel_file_saver_start(cpu->saver, cpu->world, path))
+        return;
+
+    std::snprintf(cpu->save_status, sizeof cpu->save_status, "Saving %s", path);
+    cpu->unsaved_changes = false;
+    cpu->autosave_timer = 0.0f;
+}
+
+static void scene_save_update(voxed_cpu_state* cpu, float dt)
+{
+    bool ok;
+    if (voxel_file_saver_poll(cpu->saver, &ok))
+    {
+        const char* path = cpu->saver->path;
+        std::snprintf(
+            cpu->save_status,
+            sizeof cpu->save_status,
+            ok ? "Saved %s" : "Could not save %s",
+            path);
+        fprintf(stdout, "%s\n", cpu->save_status);
+
+        if (!ok)
+            cpu->unsaved_changes = true;
+    }
+
+    // Chunks that did not change since the last save are copied from the
+    // file it wrote, only the edited ones get encoded again.
+    cpu->autosave_timer += dt;
+    if (cpu->config.autosave_minutes > 0 && cpu->unsaved_changes &&
+        cpu->autosave_timer >= 60.0f * cpu->config.autosave_minutes &&
+        !voxel_file_saver_busy(cpu->saver))
+        scene_save(cpu, "autosave.vx");
+}
+
+static void world_resize(voxed_cpu_state* cpu, i32 resolution)
+{
+    voxel_world_resize(cpu->world, resolution);
+    voxel_pyramid_build(&cpu->world_pyramid, cpu->world);
+    voxel_history_clear(cpu->history);
+    cpu->unsaved_changes = true;
+
+    cpu->voxel_extents = cpu->scene_extents / (float)resolution;
+    for (int i = 0; i < axis_plane_count; i++)
+        cpu->rulers[i].offset = clamp(cpu->rulers[i].offset, -resolution / 2, resolution / 2);
+    mark_dirty_all(cpu);
+}
+
 static void voxel_mode_update(voxed_cpu_state* cpu)
 {
     if (cpu->intersect.t < INFINITY)
@@ -300,27 +469,31 @@ static void voxel_mode_update(voxed_cpu_state* cpu)
             if (cpu->edit_mode == edit_mode_delete)
             {
                 int3 p = cpu->intersect.voxel_coords;
-                if (glm::all(glm::greaterThanEqual(p, int3{0})) &&
-                    glm::all(glm::lessThan(p, int3{VX_GRID_SIZE})))
+                if (voxel_world_contains(cpu->world, p))
                 {
                     fprintf(stdout, "Erased voxel from %d %d %d\n", p.x, p.y, p.z);
-                    i32 i = p.x + p.y * VX_GRID_SIZE + p.z * VX_GRID_SIZE * VX_GRID_SIZE;
-                    cpu->voxel_grid[i].flags = 0;
-                    cpu->voxel_grid_is_dirty = true;
+                    voxel_history_begin(cpu->history);
+                    voxel_history_set(cpu->history, cpu->world, p, voxel_leaf{});
+                    voxel_history_end(cpu->history);
+                    world_changed(cpu, bounds3i{p, p});
+                    mark_dirty(cpu, bounds3i{p, p});
                 }
             }
             else
             {
                 int3 p = cpu->intersect.voxel_coords + (int3)cpu->intersect.normal;
 
-                if (glm::all(glm::greaterThanEqual(p, int3{0})) &&
-                    glm::all(glm::lessThan(p, int3{VX_GRID_SIZE})))
+                if (voxel_world_contains(cpu->world, p))
                 {
                     fprintf(stdout, "Placed voxel at %d %d %d\n", p.x, p.y, p.z);
-                    i32 i = p.x + p.y * VX_GRID_SIZE + p.z * VX_GRID_SIZE * VX_GRID_SIZE;
-                    cpu->voxel_grid[i].flags |= voxel_flag_solid;
-                    cpu->voxel_grid[i].color = cpu->brush.color_rgb;
-                    cpu->voxel_grid_is_dirty = true;
+                    voxel_leaf leaf;
+                    leaf.color = cpu->brush.color_rgb;
+                    leaf.flags = voxel_flag_solid;
+                    voxel_history_begin(cpu->history);
+                    voxel_history_set(cpu->history, cpu->world, p, leaf);
+                    voxel_history_end(cpu->history);
+                    world_changed(cpu, bounds3i{p, p});
+                    mark_dirty(cpu, bounds3i{p, p});
                 }
                 else
                     fprintf(
@@ -334,6 +507,29 @@ static void voxel_mode_update(voxed_cpu_state* cpu)
     }
 }
 
+// Debug aid to watch the mesher keep up with edits while previous ones are
+// still being meshed. voxed-cli bench scheduler checks the meshes it ends up
+// with.
+static void stress_edits_update(voxed_cpu_state* cpu)
+{
+    const i32 r = cpu->world->resolution;
+
+    voxel_history_begin(cpu->history);
+    for (int i = 0; i < 8; i++)
+    {
+        int3 mn{rand() % r, rand() % r, rand() % r};
+        int3 mx = glm::min(mn + int3{rand() % 8, rand() % 8, rand() % 8}, int3{r - 1});
+
+        voxel_leaf leaf;
+        leaf.color = float3{rand(), rand(), rand()} / (float)RAND_MAX;
+        leaf.flags = rand() % 2 ? voxel_flag_solid : 0;
+        voxel_history_fill(cpu->history, cpu->world, bounds3i{mn, mx}, leaf);
+        world_changed(cpu, bounds3i{mn, mx});
+        mark_dirty(cpu, bounds3i{mn, mx});
+    }
+    voxel_history_end(cpu->history);
+}
+
 static int3 box_mode_get_voxel_coords(voxed_cpu_state* cpu)
 {
     if (cpu->edit_mode == edit_mode_add)
@@ -346,11 +542,35 @@ static int3 box_mode_get_voxel_coords(voxed_cpu_state* cpu)
     }
 }
 
+// Change the box drawn over the world, marking the chunks of the boxes dirty
+// if it moved.
+static void box_mode_preview(
+    voxed_cpu_state* cpu,
+    bool has_box,
+    const bounds3i& box,
+    const voxel_leaf& leaf)
+{
+    auto& state = cpu->box_edit_state;
+    if (has_box == state.has_applied_box &&
+        (!has_box || (box == state.applied_box && voxel_leaf_equal(leaf, state.applied_leaf))))
+        return;
+
+    if (state.has_applied_box)
+        mark_dirty(cpu, state.applied_box);
+    if (has_box)
+        mark_dirty(cpu, box);
+
+    state.applied_box = box;
+    state.applied_leaf = leaf;
+    state.has_applied_box = has_box;
+}
+
 static void box_mode_update(voxed_cpu_state* cpu)
 {
     if (mouse_button_down(button::left))
     {
         cpu->box_edit_state.initial_voxel_coords = box_mode_get_voxel_coords(cpu);
+        cpu->box_edit_state.has_applied_box = false;
     }
 
     if (mouse_button_pressed(button::left))
@@ -359,13 +579,7 @@ static void box_mode_update(voxed_cpu_state* cpu)
         {
             int3 p = box_mode_get_voxel_coords(cpu);
 
-            voxel_leaf* working_voxels = cpu->box_edit_state.working_voxels;
-            const voxel_leaf* voxel_grid = cpu->voxel_grid;
-
-            std::memcpy(working_voxels, voxel_grid, sizeof(cpu->box_edit_state.working_voxels));
-
-            if (glm::all(glm::greaterThanEqual(p, int3{0})) &&
-                glm::all(glm::lessThan(p, int3{VX_GRID_SIZE})))
+            if (voxel_world_contains(cpu->world, p))
             {
                 int3 begin, end;
                 begin = cpu->box_edit_state.initial_voxel_coords;
@@ -377,32 +591,306 @@ static void box_mode_update(voxed_cpu_state* cpu)
                         std::swap(begin[i], end[i]);
                 }
 
-                for (int z = begin.z; z <= end.z; z++)
-                    for (int y = begin.y; y <= end.y; y++)
-                        for (int x = begin.x; x <= end.x; x++)
-                        {
-                            int i = x + y * VX_GRID_SIZE + z * VX_GRID_SIZE * VX_GRID_SIZE;
-                            // auto& voxel = state->mode_state.box.temporary_voxels[i];
-                            voxel_leaf& voxel = working_voxels[i];
-
-                            voxel.flags = cpu->edit_mode == edit_mode_add ? voxel_flag_solid : 0;
-                            voxel.color = cpu->brush.color_rgb;
-                        }
+                voxel_leaf voxel;
+                voxel.flags = cpu->edit_mode == edit_mode_add ? voxel_flag_solid : 0;
+                voxel.color = cpu->brush.color_rgb;
 
-                cpu->voxel_grid_is_dirty = true;
+                // only the chunks of the old and the new box are remeshed
+                box_mode_preview(cpu, true, bounds3i{begin, end}, voxel);
+            }
+            else
+            {
+                box_mode_preview(cpu, false, bounds3i{}, voxel_leaf{});
             }
         }
     }
 
-    if (mouse_button_up(button::left))
+    // The mesh already shows the box, filling the world with it needs no
+    // remeshing.
+    if (mouse_button_up(button::left) && cpu->box_edit_state.has_applied_box)
     {
-        std::memcpy(
-            cpu->voxel_grid,
-            cpu->box_edit_state.working_voxels,
-            sizeof(cpu->box_edit_state.working_voxels));
+        const bounds3i& box = cpu->box_edit_state.applied_box;
+        voxel_history_begin(cpu->history);
+        voxel_history_fill(cpu->history, cpu->world, box, cpu->box_edit_state.applied_leaf);
+        voxel_history_end(cpu->history);
+        world_changed(cpu, box);
+        cpu->box_edit_state.has_applied_box = false;
     }
 }
 
+static void shape_mode_end_stroke(voxed_cpu_state* cpu)
+{
+    if (!cpu->shape_edit_state.stroking)
+        return;
+    voxel_history_end(cpu->history);
+    cpu->shape_edit_state.stroking = false;
+}
+
+static void shape_mode_update(voxed_cpu_state* cpu)
+{
+    auto& state = cpu->shape_edit_state;
+    if (!mouse_button_pressed(button::left))
+    {
+        shape_mode_end_stroke(cpu);
+        return;
+    }
+    if (cpu->intersect.t == INFINITY)
+        return;
+
+    // Unions stand on the surface that was hit, the other modes reach into
+    // it. Dragging stamps the shape again once it moved by half its size,
+    // except for intersections which would leave nothing.
+    voxel_brush brush;
+    brush.shape = (voxel_brush_shape)state.shape;
+    brush.mode = (voxel_brush_mode)state.mode;
+    const bool outward = brush.mode == voxel_brush_mode_union;
+    const int3 p = cpu->intersect.voxel_coords + (outward ? int3(cpu->intersect.normal) : int3{0});
+    float3 normal = cpu->intersect.normal;
+    if (normal == float3{0.0f})
+        normal = float3{0.0f, 1.0f, 0.0f};
+
+    brush.a = float3{p} + 0.5f;
+    brush.b = brush.a + (outward ? normal : -normal) * std::max(state.height, 1.0f);
+    brush.radius = brush.shape == voxel_brush_shape_ellipsoid ? state.radii : float3{state.radius};
+    brush.leaf = voxel_leaf{cpu->brush.color_rgb, voxel_flag_solid};
+
+    const float spacing = 0.5f * std::min(brush.radius.x, std::min(brush.radius.y, brush.radius.z));
+    if (state.stroking)
+    {
+        const int2 delta = mouse_delta();
+        if (brush.mode == voxel_brush_mode_intersect || (delta.x == 0 && delta.y == 0) ||
+            glm::distance(brush.a, state.last_center) < std::max(spacing, 1.0f))
+            return;
+    }
+    else
+    {
+        voxel_history_begin(cpu->history);
+        state.stroking = true;
+    }
+    state.last_center = brush.a;
+
+    bounds3i region;
+    if (voxel_brush_apply(cpu->world, brush, cpu->edit_jobs, cpu->history, &region))
+    {
+        world_changed(cpu, region);
+        mark_dirty(cpu, region);
+    }
+}
+
+// Recolor the voxels connected to the one clicked, or delete them.
+static void fill_mode_update(voxed_cpu_state* cpu)
+{
+    if (!mouse_button_down(button::left) || cpu->intersect.t == INFINITY)
+        return;
+
+    const auto& state = cpu->fill_edit_state;
+    voxel_region region;
+    if (!voxel_flood_select(
+            &region,
+            cpu->world,
+            cpu->intersect.voxel_coords,
+            (voxel_connectivity)state.connectivity,
+            (voxel_match)state.match))
+        return;
+
+    voxel_leaf leaf{};
+    if (cpu->edit_mode == edit_mode_add)
+        leaf = voxel_leaf{cpu->brush.color_rgb, voxel_flag_solid};
+
+    voxel_history_begin(cpu->history);
+    const bool changed = voxel_region_fill(cpu->world, region, leaf, cpu->history);
+    voxel_history_end(cpu->history);
+    fprintf(stdout, "Filled %llu connected voxels\n", (unsigned long long)region.voxel_count);
+    if (changed)
+    {
+        world_changed(cpu, region.bounds);
+        mark_dirty(cpu, region.bounds);
+    }
+}
+
+// Components of the world that do not reach the ground plane, deleted if
+// remove is set.
+static void floating_islands_update(voxed_cpu_state* cpu, bool remove)
+{
+    auto& state = cpu->fill_edit_state;
+    voxel_components components;
+    voxel_components_label(
+        &components,
+        cpu->world,
+        (voxel_connectivity)state.connectivity,
+        voxel_match_solid,
+        cpu->edit_jobs);
+
+    voxel_region region;
+    voxel_components_floating(&region, components);
+    state.floating_count = 0;
+    for (int i = 0; i < components.components.size(); i++)
+        state.floating_count += !components.components[i].grounded;
+    state.floating_voxels = region.voxel_count;
+
+    if (!remove || !region.voxel_count)
+        return;
+    voxel_history_begin(cpu->history);
+    voxel_region_fill(cpu->world, region, voxel_leaf{}, cpu->history);
+    voxel_history_end(cpu->history);
+    world_changed(cpu, region.bounds);
+    mark_dirty(cpu, region.bounds);
+    fprintf(
+        stdout,
+        "Deleted %d floating islands of %llu voxels\n",
+        state.floating_count,
+        (unsigned long long)region.voxel_count);
+    state.floating_count = 0;
+    state.floating_voxels = 0;
+}
+
+// Change where the clipboard is drawn over the world, marking the chunks of
+// the old and the new place dirty if it moved or the clipboard changed.
+static void clip_mode_preview(
+    voxed_cpu_state* cpu,
+    bool pasting,
+    const int3& position,
+    bool clipboard_changed)
+{
+    auto& state = cpu->clip_edit_state;
+    if (!clipboard_changed && pasting == state.pasting &&
+        (!pasting || position == state.paste_position))
+        return;
+
+    const bounds3i bounds = voxel_clip_bounds(state.clipboard, position);
+    if (state.pasting)
+        mark_dirty(cpu, state.applied_bounds);
+    if (pasting)
+        mark_dirty(cpu, bounds);
+
+    state.pasting = pasting;
+    state.paste_position = position;
+    state.applied_bounds = bounds;
+}
+
+// Copy the selection into the clipboard, deleting it from the world if cut is
+// set.
+static void clip_mode_copy(voxed_cpu_state* cpu, bool cut)
+{
+    auto& state = cpu->clip_edit_state;
+    if (!state.has_selection)
+        return;
+
+    clip_mode_preview(cpu, false, state.paste_position, false);
+    voxel_clip_copy(&state.clipboard, cpu->world, state.selection, cpu->edit_jobs);
+    fprintf(
+        stdout,
+        "%s %llu voxels\n",
+        cut ? "Cut" : "Copied",
+        (unsigned long long)state.clipboard.voxel_count);
+    if (!cut || !state.clipboard.voxel_count)
+        return;
+
+    voxel_history_begin(cpu->history);
+    voxel_history_fill(cpu->history, cpu->world, state.selection, voxel_leaf{});
+    voxel_history_end(cpu->history);
+    world_changed(cpu, state.selection);
+    mark_dirty(cpu, state.selection);
+}
+
+// Draw the clipboard under the cursor until it is dropped, clicks paste it.
+static void clip_mode_paste_start(voxed_cpu_state* cpu)
+{
+    if (!cpu->clip_edit_state.clipboard.voxel_count)
+        return;
+    cpu->edit_brush = edit_brush_clip;
+    clip_mode_preview(cpu, true, cpu->clip_edit_state.paste_position, false);
+}
+
+static void clip_mode_transform(voxed_cpu_state* cpu, bool mirror, axis a)
+{
+    auto& state = cpu->clip_edit_state;
+    if (!state.clipboard.voxel_count)
+        return;
+
+    if (mirror)
+        voxel_clip_mirror(&state.clipboard, a, cpu->edit_jobs);
+    else
+        voxel_clip_rotate(&state.clipboard, a, cpu->edit_jobs);
+    if (state.pasting)
+        clip_mode_preview(cpu, true, state.paste_position, true);
+}
+
+// Drag a selection over the surface, or paste the clipboard standing on the
+// surface under the cursor.
+static void clip_mode_update(voxed_cpu_state* cpu)
+{
+    auto& state = cpu->clip_edit_state;
+    if (state.pasting)
+    {
+        if (cpu->intersect.t < INFINITY)
+        {
+            const int3 size = state.clipboard.size;
+            const int3 p = cpu->intersect.voxel_coords + int3(cpu->intersect.normal);
+            clip_mode_preview(cpu, true, p - int3{size.x / 2, 0, size.z / 2}, false);
+        }
+
+        // The mesh already shows the clipboard, pasting it needs no
+        // remeshing. Clicks on the buttons that turn it do not paste.
+        if (!mouse_button_down(button::left) || ImGui::IsAnyWindowHovered())
+            return;
+        bounds3i region;
+        voxel_history_begin(cpu->history);
+        const bool pasted = voxel_clip_paste(
+            cpu->world,
+            state.clipboard,
+            state.paste_position,
+            cpu->edit_jobs,
+            cpu->history,
+            &region);
+        voxel_history_end(cpu->history);
+        if (pasted)
+            world_changed(cpu, region);
+        return;
+    }
+
+    if (mouse_button_down(button::left))
+        state.initial_voxel_coords = cpu->intersect.voxel_coords;
+
+    if (mouse_button_pressed(button::left) && cpu->intersect.t < INFINITY)
+    {
+        const int3 p = cpu->intersect.voxel_coords;
+        const int3 begin = state.initial_voxel_coords;
+        state.selection.min = glm::max(glm::min(begin, p), int3{0});
+        state.selection.max = glm::min(glm::max(begin, p), int3{cpu->world->resolution - 1});
+        state.has_selection =
+            glm::all(glm::lessThanEqual(state.selection.min, state.selection.max));
+    }
+}
+
+// box outlined by the clip brush, where the clipboard goes or the selection
+static bool clip_mode_box(const voxed_cpu_state* cpu, bounds3i* out)
+{
+    const auto& state = cpu->clip_edit_state;
+    if (cpu->edit_brush != edit_brush_clip || !(state.pasting || state.has_selection))
+        return false;
+    *out = state.pasting ? state.applied_bounds : state.selection;
+    return true;
+}
+
+static void history_step(voxed_cpu_state* cpu, bool undo)
+{
+    // the box being dragged or the stroke being drawn go into the history
+    // once they are released
+    if (cpu->edit_brush == edit_brush_box && mouse_button_pressed(button::left))
+        return;
+    if (cpu->shape_edit_state.stroking)
+        return;
+
+    bounds3i region;
+    if (undo ? !voxel_history_undo(cpu->history, cpu->world, &region)
+             : !voxel_history_redo(cpu->history, cpu->world, &region))
+        return;
+
+    world_changed(cpu, region);
+    mark_dirty(cpu, region);
+}
+
 static void mesh_solid_cube_create(
     voxed_gpu_state::mesh& mesh,
     gpu_device* device,
@@ -471,6 +959,54 @@ static void mesh_solid_cube_create(
     m.index_count = 3 * vx_countof(indices);
 }
 
+static void mesh_rulers_create(
+    voxed_gpu_state::ruler* rulers,
+    gpu_device* device,
+    i32 resolution,
+    float voxel_extent)
+{
+    struct line
+    {
+        float3 a{0.f}, b{0.f};
+    };
+
+    // assume the extents are the same in all directions
+    const int line_count = resolution + 1;
+    const float half_line_length = 0.5f * resolution * voxel_extent;
+
+    array<line> grid_lines(axis_plane_count * 2 * line_count);
+
+    for (int i = 0; i < axis_plane_count; i++)
+    {
+        for (int j = 0; j < line_count; j++)
+        {
+            float line_offset = -half_line_length + j * voxel_extent;
+
+            line& l0 = grid_lines.add();
+            l0.a[i] = -half_line_length;
+            l0.b[i] = +half_line_length;
+            l0.a[(i + 1) % 3] = line_offset;
+            l0.b[(i + 1) % 3] = line_offset;
+
+            line& l1 = grid_lines.add();
+            l1.a[i] = line_offset;
+            l1.b[i] = line_offset;
+            l1.a[(i + 1) % 3] = -half_line_length;
+            l1.b[(i + 1) % 3] = +half_line_length;
+        }
+
+        voxed_gpu_state::mesh& m = rulers[i].mesh;
+        if (m.vertices)
+            gpu_buffer_destroy(device, m.vertices);
+        m.vertex_count = m.index_count = 2 * (u32)grid_lines.size();
+
+        m.vertices = gpu_buffer_create(device, grid_lines.byte_size(), gpu_buffer_type::vertex);
+        gpu_buffer_update(device, m.vertices, grid_lines.ptr(), grid_lines.byte_size(), 0);
+
+        grid_lines.clear();
+    }
+}
+
 static void mesh_skybox_create(
     voxed_gpu_state::mesh& mesh,
     gpu_device* device,
@@ -545,10 +1081,25 @@ voxed* voxed_create(platform* platform)
     //
 
     {
-        memset(cpu->voxel_grid, 0, sizeof(cpu->voxel_grid));
+        cpu->world = voxel_world_create(default_resolution);
+        voxel_pyramid_build(&cpu->world_pyramid, cpu->world);
         cpu->scene_extents = extents(cpu->scene_bounds);
-        cpu->voxel_extents = cpu->scene_extents / (float)VX_GRID_SIZE;
+        cpu->voxel_extents = cpu->scene_extents / (float)cpu->world->resolution;
         cpu->voxel_grid_is_dirty = false;
+        cpu->voxel_dirty_region = empty_region;
+        cpu->voxel_mesh_needs_rebuild = true;
+        cpu->saver = voxel_file_saver_create();
+        cpu->history = voxel_history_create((usize)cpu->config.undo_megabytes MB);
+        cpu->edit_jobs = job_system_create(-1);
+        cpu->unsaved_changes = false;
+
+        gpu->voxel_mesh_worker_count = cpu->config.mesh_worker_count;
+        gpu->mesh_scheduler = voxel_mesh_scheduler_create(gpu->voxel_mesh_worker_count);
+        fprintf(
+            stdout,
+            "Started %u edit and %u mesh workers\n",
+            job_system_worker_count(cpu->edit_jobs),
+            job_system_worker_count(gpu->mesh_scheduler->jobs));
     }
 
     //
@@ -605,47 +1156,10 @@ voxed* voxed_create(platform* platform)
 
         cpu->rulers[axis_plane_xy].offset = 0;
         cpu->rulers[axis_plane_yz].offset = 0;
-        cpu->rulers[axis_plane_zx].offset = -VX_GRID_SIZE / 2;
+        cpu->rulers[axis_plane_zx].offset = -cpu->world->resolution / 2;
 
-        struct line
-        {
-            float3 a{0.f}, b{0.f};
-        };
-
-        // assume the extents are the same in all directions
-        const float voxel_extent = cpu->voxel_extents.x;
-        const int line_count = VX_GRID_SIZE + 1;
-        const float half_line_length = 0.5f * VX_GRID_SIZE * voxel_extent;
-
-        array<line> grid_lines(axis_plane_count * 2 * line_count);
-
-        for (int i = 0; i < axis_plane_count; i++)
-        {
-            for (int j = 0; j < line_count; j++)
-            {
-                float line_offset = -half_line_length + j * voxel_extent;
-
-                line& l0 = grid_lines.add();
-                l0.a[i] = -half_line_length;
-                l0.b[i] = +half_line_length;
-                l0.a[(i + 1) % 3] = line_offset;
-                l0.b[(i + 1) % 3] = line_offset;
-
-                line& l1 = grid_lines.add();
-                l1.a[i] = line_offset;
-                l1.b[i] = line_offset;
-                l1.a[(i + 1) % 3] = -half_line_length;
-                l1.b[(i + 1) % 3] = +half_line_length;
-            }
-
-            voxed_gpu_state::mesh& m = gpu->rulers[i].mesh;
-            m.vertex_count = m.index_count = 2 * (u32)grid_lines.size();
-
-            m.vertices = gpu_buffer_create(device, grid_lines.byte_size(), gpu_buffer_type::vertex);
-            gpu_buffer_update(device, m.vertices, grid_lines.ptr(), grid_lines.byte_size(), 0);
-
-            grid_lines.clear();
-        }
+        mesh_rulers_create(gpu->rulers, device, cpu->world->resolution, cpu->voxel_extents.x);
+        gpu->ruler_resolution = cpu->world->resolution;
     }
 
     //
@@ -800,7 +1314,49 @@ voxed* voxed_create(platform* platform)
 
 void voxed_process_event(voxed_cpu_state* cpu, const SDL_Event& event)
 {
-    if (event.type == SDL_KEYUP)
+    if (event.type == SDL_KEYDOWN && (event.key.keysym.mod & KMOD_CTRL))
+    {
+        cpu->ctrl_shortcut_key = event.key.keysym.scancode;
+        const bool shift = (event.key.keysym.mod & KMOD_SHIFT) != 0;
+        switch (event.key.keysym.scancode)
+        {
+            case SDL_SCANCODE_Z:
+                history_step(cpu, !shift);
+                break;
+            case SDL_SCANCODE_Y:
+                history_step(cpu, false);
+                break;
+            case SDL_SCANCODE_C:
+                clip_mode_copy(cpu, false);
+                break;
+            case SDL_SCANCODE_X:
+                clip_mode_copy(cpu, true);
+                break;
+            case SDL_SCANCODE_V:
+                clip_mode_paste_start(cpu);
+                break;
+            case SDL_SCANCODE_D:
+                clip_mode_copy(cpu, false);
+                clip_mode_paste_start(cpu);
+                break;
+            default:
+                break;
+        }
+    }
+
+    // A fresh press without ctrl means the release was missed, e.g. while the
+    // window was not focused.
+    if (event.type == SDL_KEYDOWN && !(event.key.keysym.mod & KMOD_CTRL) && !event.key.repeat &&
+        event.key.keysym.scancode == cpu->ctrl_shortcut_key)
+        cpu->ctrl_shortcut_key = SDL_SCANCODE_UNKNOWN;
+
+    if (event.type == SDL_KEYUP && event.key.keysym.scancode == cpu->ctrl_shortcut_key)
+    {
+        cpu->ctrl_shortcut_key = SDL_SCANCODE_UNKNOWN;
+        return;
+    }
+
+    if (event.type == SDL_KEYUP && !(event.key.keysym.mod & KMOD_CTRL))
     {
         switch (event.key.keysym.scancode)
         {
@@ -810,6 +1366,24 @@ void voxed_process_event(voxed_cpu_state* cpu, const SDL_Event& event)
             case SDL_SCANCODE_V:
                 cpu->edit_brush = edit_brush_voxel;
                 break;
+            case SDL_SCANCODE_S:
+                cpu->edit_brush = edit_brush_shape;
+                break;
+            case SDL_SCANCODE_F:
+                cpu->edit_brush = edit_brush_fill;
+                break;
+            case SDL_SCANCODE_C:
+                cpu->edit_brush = edit_brush_clip;
+                break;
+            case SDL_SCANCODE_R:
+                clip_mode_transform(cpu, false, axis_y);
+                break;
+            case SDL_SCANCODE_ESCAPE:
+                if (cpu->clip_edit_state.pasting)
+                    clip_mode_preview(cpu, false, int3{0}, false);
+                else
+                    cpu->clip_edit_state.has_selection = false;
+                break;
             case SDL_SCANCODE_A:
                 cpu->edit_mode = edit_mode_add;
                 break;
@@ -860,30 +1434,14 @@ void voxed_update(voxed_cpu_state* cpu, const platform& platform, float dt)
 
         // voxel grid
 
-        for (int z = 0; z < VX_GRID_SIZE; z++)
-            for (int y = 0; y < VX_GRID_SIZE; y++)
-                for (int x = 0; x < VX_GRID_SIZE; x++)
-                {
-                    int i = x + y * VX_GRID_SIZE + z * VX_GRID_SIZE * VX_GRID_SIZE;
-                    if (cpu->voxel_grid[i].flags)
-                    {
-                        float3 voxel_coords{x, y, z};
-                        bounds3f voxel_bounds;
-                        voxel_bounds.min =
-                            cpu->scene_bounds.min + voxel_coords * cpu->voxel_extents;
-                        voxel_bounds.max = voxel_bounds.min + cpu->voxel_extents;
-
-                        float t;
-                        if (ray_intersects_aabb(ray, voxel_bounds, &t) && t < cpu->intersect.t)
-                        {
-                            cpu->intersect.t = t;
-                            cpu->intersect.voxel_coords = voxel_coords;
-                            cpu->intersect.position = ray.origin + ray.direction * t;
-                            cpu->intersect.normal = reconstruct_voxel_normal(
-                                center(voxel_bounds), cpu->intersect.position);
-                        }
-                    }
-                }
+        voxel_raycast_hit hit;
+        if (voxel_pyramid_raycast(&cpu->world_pyramid, cpu->world, ray, cpu->scene_bounds, &hit))
+        {
+            cpu->intersect.t = hit.t;
+            cpu->intersect.position = hit.position;
+            cpu->intersect.normal = hit.normal;
+            cpu->intersect.voxel_coords = hit.voxel_coords;
+        }
 
         // voxel rulers
 
@@ -916,7 +1474,7 @@ void voxed_update(voxed_cpu_state* cpu, const platform& platform, float dt)
                     cpu->scene_bounds.min,
                     cpu->scene_bounds.max,
                     float3{0.f},
-                    float3{VX_GRID_SIZE}));
+                    float3{(float)cpu->world->resolution}));
                 cpu->intersect.normal = float3{0.f};
             }
         }
@@ -926,33 +1484,59 @@ void voxed_update(voxed_cpu_state* cpu, const platform& platform, float dt)
     // voxel editing
     //
 
+    // a box dragged or a stroke drawn while switching brushes is dropped or
+    // ended
+    if (cpu->edit_brush != edit_brush_box)
+        box_mode_preview(cpu, false, bounds3i{}, voxel_leaf{});
+    if (cpu->edit_brush != edit_brush_shape)
+        shape_mode_end_stroke(cpu);
+    if (cpu->edit_brush != edit_brush_clip)
+        clip_mode_preview(cpu, false, int3{0}, false);
+
     if (cpu->edit_brush == edit_brush_voxel)
     {
         voxel_mode_update(cpu);
+
+        if (cpu->stress_edits)
+            stress_edits_update(cpu);
     }
-    else
+    else if (cpu->edit_brush == edit_brush_box)
     {
         box_mode_update(cpu);
     }
+    else if (cpu->edit_brush == edit_brush_shape)
+    {
+        shape_mode_update(cpu);
+    }
+    else if (cpu->edit_brush == edit_brush_fill)
+    {
+        fill_mode_update(cpu);
+    }
+    else
+    {
+        clip_mode_update(cpu);
+    }
+
+    scene_save_update(cpu, dt);
 
     //
     // voxel statistics
     //
 
-    if (cpu->voxel_grid_is_dirty)
-    {
-        cpu->stats.voxel_solid = cpu->stats.voxel_empty = 0;
+    // corrupt chunks were counted with the solid count of the scene file until
+    // they were decoded
+    const u32 corrupt_chunks = cpu->world->corrupt_chunk_count;
+    if (corrupt_chunks > cpu->stats.corrupt_chunks)
+        fprintf(
+            stdout,
+            "%u corrupt chunks in the scene file read as empty\n",
+            corrupt_chunks - cpu->stats.corrupt_chunks);
 
-        for (int z = 0; z < VX_GRID_SIZE; z++)
-            for (int y = 0; y < VX_GRID_SIZE; y++)
-                for (int x = 0; x < VX_GRID_SIZE; x++)
-                {
-                    int i = x + y * VX_GRID_SIZE + z * VX_GRID_SIZE * VX_GRID_SIZE;
-                    if (cpu->voxel_grid[i].flags & voxel_flag_solid)
-                        cpu->stats.voxel_solid++;
-                    else
-                        cpu->stats.voxel_empty++;
-                }
+    if (cpu->voxel_grid_is_dirty || corrupt_chunks != cpu->stats.corrupt_chunks)
+    {
+        cpu->stats.corrupt_chunks = corrupt_chunks;
+        cpu->stats.voxel_solid = voxel_world_solid_count(cpu->world);
+        cpu->stats.voxel_empty = pow3((u64)cpu->world->resolution) - cpu->stats.voxel_solid;
     }
 
     //
@@ -987,6 +1571,69 @@ void voxed_update(voxed_cpu_state* cpu, const platform& platform, float dt)
     }
 }
 
+static void voxel_mesh_upload(voxed_gpu_state* gpu, gpu_device* device)
+{
+    voxel_mesh_cache& cache = *gpu->mesh_scheduler->front;
+    voxed_gpu_state::mesh& m = gpu->voxel_mesh;
+
+    usize vertex_bytes = cache.vertices.byte_size(), index_bytes = cache.triangles.byte_size();
+    bool upload_all = cache.patch_all;
+
+    // Grow the buffers geometrically, so that chunks moving to the end of
+    // the cache arrays do not recreate them on every edit.
+    if (vertex_bytes > gpu->voxel_mesh_vertex_capacity ||
+        index_bytes > gpu->voxel_mesh_index_capacity)
+    {
+        if (m.vertices)
+            gpu_buffer_destroy(device, m.vertices);
+        if (m.indices)
+            gpu_buffer_destroy(device, m.indices);
+
+        gpu->voxel_mesh_vertex_capacity = 2 * vertex_bytes;
+        gpu->voxel_mesh_index_capacity = 2 * index_bytes;
+        m.vertices =
+            gpu_buffer_create(device, gpu->voxel_mesh_vertex_capacity, gpu_buffer_type::vertex);
+        m.indices =
+            gpu_buffer_create(device, gpu->voxel_mesh_index_capacity, gpu_buffer_type::index);
+        upload_all = true;
+    }
+
+    if (upload_all)
+    {
+        if (vertex_bytes && index_bytes)
+        {
+            gpu_buffer_update(device, m.vertices, cache.vertices.ptr(), vertex_bytes, 0);
+            gpu_buffer_update(device, m.indices, cache.triangles.ptr(), index_bytes, 0);
+        }
+    }
+    else
+    {
+        for (int i = 0; i < cache.patches.size(); i++)
+        {
+            const voxel_mesh_patch& p = cache.patches[i];
+            if (p.vertex_count)
+                gpu_buffer_update(
+                    device,
+                    m.vertices,
+                    &cache.vertices[p.vertex_offset],
+                    p.vertex_count * sizeof(voxel_vertex),
+                    p.vertex_offset * sizeof(voxel_vertex));
+            if (p.triangle_count)
+                gpu_buffer_update(
+                    device,
+                    m.indices,
+                    &cache.triangles[p.triangle_offset],
+                    p.triangle_count * sizeof(int3),
+                    p.triangle_offset * sizeof(int3));
+        }
+    }
+
+    voxel_mesh_cache_clear_patches(&cache);
+
+    m.vertex_count = cache.vertices.size();
+    m.index_count = 3 * cache.triangles.size();
+}
+
 void voxed_gpu_update(const voxed_cpu_state* cpu, voxed_gpu_state* gpu, const platform& platform)
 {
     //
@@ -999,6 +1646,8 @@ void voxed_gpu_update(const voxed_cpu_state* cpu, voxed_gpu_state* gpu, const pl
         int w, h;
         SDL_GetWindowSize(platform.window, &w, &h);
         gpu->global_constants.data.camera = orbit_camera_matrix(cpu->camera, w, h);
+        gpu->global_constants.data.voxel_to_world =
+            float4{cpu->scene_bounds.min, cpu->voxel_extents.x};
         gpu->global_constants.data.flags = cpu->render_flags;
 
         gpu->skybox_constants.data.transform = orbit_skybox_matrix(cpu->camera, w, h);
@@ -1016,6 +1665,13 @@ void voxed_gpu_update(const voxed_cpu_state* cpu, voxed_gpu_state* gpu, const pl
     // voxel rulers
 
     {
+        if (gpu->ruler_resolution != cpu->world->resolution)
+        {
+            mesh_rulers_create(
+                gpu->rulers, platform.gpu, cpu->world->resolution, cpu->voxel_extents.x);
+            gpu->ruler_resolution = cpu->world->resolution;
+        }
+
         for (int i = 0; i < axis_plane_count; ++i)
         {
             const auto& cpu_ruler = cpu->rulers[i];
@@ -1041,11 +1697,24 @@ void voxed_gpu_update(const voxed_cpu_state* cpu, voxed_gpu_state* gpu, const pl
             voxel_xform = glm::translate(
                               float4x4{1.f},
                               center(reconstruct_voxel_bounds(
-                                  cpu->intersect.voxel_coords, cpu->scene_bounds, VX_GRID_SIZE)) +
+                                  cpu->intersect.voxel_coords,
+                                  cpu->scene_bounds,
+                                  cpu->world->resolution)) +
                                   cpu->voxel_extents * cpu->intersect.normal) *
                           glm::scale(float4x4{1.f}, 0.5f * cpu->voxel_extents);
         }
 
+        bounds3i clip_box;
+        if (clip_mode_box(cpu, &clip_box))
+        {
+            const i32 n = cpu->world->resolution;
+            const bounds3f b{
+                reconstruct_voxel_bounds(clip_box.min, cpu->scene_bounds, n).min,
+                reconstruct_voxel_bounds(clip_box.max, cpu->scene_bounds, n).max};
+            voxel_xform = glm::translate(float4x4{1.f}, center(b)) *
+                          glm::scale(float4x4{1.f}, 0.5f * extents(b));
+        }
+
         auto& sel = gpu->wire_cube_constants.data[voxed_gpu_state::wire_cube_constants::selection];
         sel.model = voxel_xform;
         sel.color = colors.selection;
@@ -1062,240 +1731,54 @@ void voxed_gpu_update(const voxed_cpu_state* cpu, voxed_gpu_state* gpu, const pl
 
     // voxel (mesh)
 
-    if (cpu->voxel_grid_is_dirty)
     {
-        fprintf(stdout, "(Re)generating voxel mesh\n");
+        const voxel_world* voxel_grid = cpu->world;
 
-        struct vertex
+        voxel_mesh_overlay overlay;
+        overlay.clip = nullptr;
+        const voxel_mesh_overlay* edit_overlay = nullptr;
+        if (cpu->box_edit_state.has_applied_box)
         {
-            float3 pos;
-            u32 rgba;
-            float3 nm;
-            float ao;
-        };
-
-        array<vertex> new_vbo;
-        array<int3> new_ibo;
-
-        const voxel_leaf* voxel_grid;
-        if (cpu->edit_brush == edit_brush_voxel)
-        {
-            voxel_grid = cpu->voxel_grid;
+            overlay.box = cpu->box_edit_state.applied_box;
+            overlay.leaf = cpu->box_edit_state.applied_leaf;
+            edit_overlay = &overlay;
         }
-        else
+        else if (cpu->clip_edit_state.pasting)
         {
-            voxel_grid = cpu->box_edit_state.working_voxels;
+            overlay.box = cpu->clip_edit_state.applied_bounds;
+            overlay.clip = &cpu->clip_edit_state.clipboard;
+            edit_overlay = &overlay;
         }
 
-        // for each solid voxel:
-        //   for each face:
-        //     if neighbor is empty or out of bounds:
-        //       add face quad vertices and indices
-
-        for (int z = 0; z < VX_GRID_SIZE; z++)
-            for (int y = 0; y < VX_GRID_SIZE; y++)
-                for (int x = 0; x < VX_GRID_SIZE; x++)
-                {
-                    int ci = pows3(x, y, z, VX_GRID_SIZE);
-                    int3 c = int3(x, y, z);
-                    const voxel_leaf& ivx = voxel_grid[ci];
-
-                    // only process solid voxels
-                    if (~ivx.flags & voxel_flag_solid)
-                        continue;
-
-                    for (int di = 0; di < 6; di++)
-                    {
-                        bool make_face = false;
-                        int3 d(0), n(0);
-
-                        d[di % 3] = di / 3 ? -1 : 1;
-                        n = c + d;
-
-                        if (n.x >= 0 && n.y >= 0 && n.z >= 0 && n.x < VX_GRID_SIZE &&
-                            n.y < VX_GRID_SIZE && n.z < VX_GRID_SIZE)
-                        {
-                            int ni = pows3(n.x, n.y, n.z, VX_GRID_SIZE);
-                            const voxel_leaf& nvx = voxel_grid[ni];
-                            if (~nvx.flags & voxel_flag_solid)
-                                make_face = true;
-                        }
-                        else
-                            make_face = true;
-
-                        if (make_face)
-                        {
-                            const bounds3f& sb = cpu->scene_bounds;
-                            float3 color = ivx.color;
-                            vertex va, vb, vc, vd;
-
-                            // normal
-                            float3 nm(0.0f);
-                            nm[di % 3] = float(d[di % 3]);
-                            va.nm = vb.nm = vc.nm = vd.nm = nm;
-
-                            // position
-                            //   place 4 vertices to the voxel midpoint
-                            //   move vertices along the face normal
-                            //   move vertices to one of the face corners
-                            float half_ext = 0.5f * cpu->voxel_extents.x;
-                            float3 center(
-                                (x + 0.5f) / VX_GRID_SIZE,
-                                (y + 0.5f) / VX_GRID_SIZE,
-                                (z + 0.5f) / VX_GRID_SIZE);
-                            float3 pos;
-                            pos = glm::mix(sb.min, sb.max, center);
-                            pos += half_ext * nm;
-                            float3 fca(0.0f), fcb(0.0f), fcc(0.0f), fcd(0.0f);
-                            fca[(di + 1) % 3] = -half_ext, fca[(di + 2) % 3] = -half_ext;
-                            fcb[(di + 1) % 3] = +half_ext, fcb[(di + 2) % 3] = -half_ext;
-                            fcc[(di + 1) % 3] = +half_ext, fcc[(di + 2) % 3] = +half_ext;
-                            fcd[(di + 1) % 3] = -half_ext, fcd[(di + 2) % 3] = +half_ext;
-                            va.pos = pos + fca;
-                            vb.pos = pos + fcb;
-                            vc.pos = pos + fcc;
-                            vd.pos = pos + fcd;
-
-                            // color
-                            u32 rgba = 0;
-                            rgba |= u8(color.r * 0xFF) << 0;
-                            rgba |= u8(color.g * 0xFF) << 8;
-                            rgba |= u8(color.b * 0xFF) << 16;
-                            rgba |= 0xFF << 24;
-                            va.rgba = vb.rgba = vc.rgba = vd.rgba = rgba;
-
-                            // ambient occlusion
-                            //
-                            // Credits to:
-                            // https://0fps.net/2013/07/03/ambient-occlusion-for-minecraft-like-worlds/
-                            //
-                            // Search all the s's around x in the normal
-                            // direction.
-                            //
-                            //   top view   side views
-                            //   [s][s][s]  [s][s][s]  [s][s][s]  [s][s][s]  [s][s][s]
-                            //   [s][x][s]     [x]        [x]        [x]        [x]
-                            //   [s][s][s]
-                            //
-                            //   [7][6][5]  [1][2][3]  [3][4][5]  [5][6][7]  [7][0][1]
-                            //   [0][x][4]     [x]        [x]        [x]        [x]
-                            //   [1][2][3]
-                            //
-                            // With this layout we can mask 3 bits at the time
-                            // in offsets of two like so:
-                            //
-                            //   012345670
-                            //   aaa||||||
-                            //     bbb||||
-                            //       ccc||
-                            //         ddd
-
-                            // clang-format off
-                            static const int2 search_dirs[] =
-                            {
-                                int2(-1, +0), // 0
-                                int2(-1, -1), // 1
-                                int2(+0, -1), // 2
-                                int2(+1, -1), // 3
-                                int2(+1, +0), // 4
-                                int2(+1, +1), // 5
-                                int2(+0, +1), // 6
-                                int2(-1, +1), // 7
-                            };
-                            static const float symmetries[] =
-                            {
-                                0.0f, // case 0 - none
-                                0.5f, // case 1 - edge
-                                0.5f, // case 2 - edge + corner
-                                1.0f, // case 3 - corner
-                            };
-                            // clang-format on
-
-                            u32 mask = 0;
-
-                            for (int search_dir = 0; search_dir < 8; search_dir++)
-                            {
-                                int3 s;
-                                s[di % 3] = n[di % 3];
-                                s[(di + 1) % 3] = n[(di + 1) % 3] + search_dirs[search_dir][0];
-                                s[(di + 2) % 3] = n[(di + 2) % 3] + search_dirs[search_dir][1];
-
-                                if (s.x >= 0 && s.y >= 0 && s.z >= 0 && s.x < VX_GRID_SIZE &&
-                                    s.y < VX_GRID_SIZE && s.z < VX_GRID_SIZE)
-                                {
-                                    int si = pows3(s.x, s.y, s.z, VX_GRID_SIZE);
-                                    const voxel_leaf& svx = voxel_grid[si];
-                                    if (svx.flags & voxel_flag_solid)
-                                        mask |= 1 << search_dir;
-                                }
-                            }
-
-                            // NOTE(vinht): Trick, copy 0th bit to 8th bit, so
-                            // we can mask out 3 bits per corner without
-                            // special cases.
-                            mask |= (mask & 0x1) << 8;
-
-                            u32 maska = (mask >> 0) & 0x7;
-                            u32 maskb = (mask >> 2) & 0x7;
-                            u32 maskc = (mask >> 4) & 0x7;
-                            u32 maskd = (mask >> 6) & 0x7;
-                            u32 cnta = vx_popcnt(maska);
-                            u32 cntb = vx_popcnt(maskb);
-                            u32 cntc = vx_popcnt(maskc);
-                            u32 cntd = vx_popcnt(maskd);
-                            va.ao = maska == 0x5 ? symmetries[3] : symmetries[cnta];
-                            vb.ao = maskb == 0x5 ? symmetries[3] : symmetries[cntb];
-                            vc.ao = maskc == 0x5 ? symmetries[3] : symmetries[cntc];
-                            vd.ao = maskd == 0x5 ? symmetries[3] : symmetries[cntd];
-
-                            // indices
-                            int idx = new_vbo.size();
-                            int3 ta, tb;
-                            // NOTE(vinht): Flip triangulation based on sum of
-                            // AO values of the two diagonals to avoid
-                            // interpolation artifacts.
-                            if (va.ao + vc.ao < vb.ao + vd.ao)
-                            {
-                                ta = int3(idx + 0, idx + 1, idx + 2);
-                                tb = int3(idx + 0, idx + 2, idx + 3);
-                            }
-                            else
-                            {
-                                ta = int3(idx + 0, idx + 1, idx + 3);
-                                tb = int3(idx + 1, idx + 2, idx + 3);
-                            }
-                            // flip winding
-                            if (glm::dot(nm, float3(1.0f)) < 0.0f)
-                                std::swap(ta.y, ta.z), std::swap(tb.y, tb.z);
-
-                            new_vbo.add(va), new_vbo.add(vb), new_vbo.add(vc), new_vbo.add(vd);
-                            new_ibo.add(ta), new_ibo.add(tb);
-                        }
-                    }
-                }
-
-        voxed_gpu_state::mesh& m = gpu->voxel_mesh;
+        voxel_mesh_scheduler* scheduler = gpu->mesh_scheduler;
 
-        if (m.vertices)
-            gpu_buffer_destroy(platform.gpu, m.vertices), m.vertex_count = 0;
-        if (m.indices)
-            gpu_buffer_destroy(platform.gpu, m.indices), m.index_count = 0;
-
-        if (new_vbo.size() && new_ibo.size())
+        if (gpu->voxel_mesh_worker_count != cpu->config.mesh_worker_count)
         {
-            m.vertices =
-                gpu_buffer_create(platform.gpu, new_vbo.byte_size(), gpu_buffer_type::vertex);
-            m.indices =
-                gpu_buffer_create(platform.gpu, new_ibo.byte_size(), gpu_buffer_type::index);
-
-            gpu_buffer_update(platform.gpu, m.vertices, new_vbo.ptr(), new_vbo.byte_size(), 0);
-            gpu_buffer_update(platform.gpu, m.indices, new_ibo.ptr(), new_ibo.byte_size(), 0);
+            gpu->voxel_mesh_worker_count = cpu->config.mesh_worker_count;
+            voxel_mesh_scheduler_set_worker_count(scheduler, gpu->voxel_mesh_worker_count);
+            fprintf(stdout, "Started %u mesh workers\n", job_system_worker_count(scheduler->jobs));
+        }
 
-            m.vertex_count = new_vbo.size();
-            m.index_count = 3 * new_ibo.size();
+        if (cpu->voxel_grid_is_dirty)
+        {
+            if (cpu->voxel_mesh_needs_rebuild)
+            {
+                fprintf(stdout, "(Re)generating voxel mesh\n");
+                voxel_mesh_scheduler_rebuild(scheduler, voxel_grid);
+            }
+            else
+            {
+                voxel_mesh_scheduler_update(scheduler, voxel_grid, cpu->voxel_dirty_region);
+            }
+            gpu->voxel_mesh_changed_recently = true;
         }
 
-        gpu->voxel_mesh_changed_recently = true;
+        // The previous mesh is drawn until the new one arrives.
+        if (voxel_mesh_scheduler_run(scheduler, voxel_grid, edit_overlay, cpu->mesh_flags))
+        {
+            voxel_mesh_upload(gpu, platform.gpu);
+            gpu->voxel_mesh_face_count = scheduler->front->face_count;
+        }
     }
 
     //
@@ -1314,6 +1797,13 @@ void voxed_gpu_update(const voxed_cpu_state* cpu, voxed_gpu_state* gpu, const pl
             wcc.enabled[voxed_gpu_state::wire_cube_constants::erase] = erasing;
             wcc.enabled[voxed_gpu_state::wire_cube_constants::selection] = !erasing;
         }
+
+        bounds3i clip_box;
+        if (clip_mode_box(cpu, &clip_box))
+        {
+            wcc.enabled[voxed_gpu_state::wire_cube_constants::erase] = false;
+            wcc.enabled[voxed_gpu_state::wire_cube_constants::selection] = true;
+        }
     }
 
     //
@@ -1361,24 +1851,149 @@ void voxed_gui_update(voxed_cpu_state* cpu, const voxed_gpu_state* gpu)
     ImGui::Text("D -- delete");
     ImGui::Text("V -- voxel brush");
     ImGui::Text("B -- box brush");
+    ImGui::Text("S -- shape brush");
+    ImGui::Text("F -- fill brush");
+    ImGui::Text("C -- clip brush");
+    ImGui::Text("R -- rotate clipboard");
+    ImGui::Text("Ctrl+C/X/V/D -- copy/cut/paste/duplicate");
+    ImGui::Text("Esc -- drop paste/selection");
+    ImGui::Text("Ctrl+Z -- undo");
+    ImGui::Text("Ctrl+Y, Ctrl+Shift+Z -- redo");
     ImGui::Separator();
-    ImGui::Value("Resolution", VX_GRID_SIZE);
+    int resolution_index = 0;
+    for (int i = 0; i < vx_countof(resolutions); i++)
+        if (resolutions[i] == cpu->world->resolution)
+            resolution_index = i;
+    if (ImGui::Combo(
+            "Resolution", &resolution_index, resolution_names, vx_countof(resolution_names)))
+        world_resize(cpu, resolutions[resolution_index]);
     ImGui::Separator();
-    ImGui::Value("Voxel Leaf Bytes", (int)sizeof(voxel_leaf));
-    ImGui::Value("Voxel Grid Bytes", (int)sizeof(cpu->voxel_grid));
+    const usize world_bytes = voxel_world_byte_size(cpu->world);
+    ImGui::Value("Voxel Chunks", (int)cpu->world->chunks.size());
+    ImGui::Value("Encoded Chunks", (int)cpu->world->encoded_chunks.size());
+    ImGui::Text("Voxel Grid Bytes: %llu", (unsigned long long)world_bytes);
+    ImGui::Text(
+        "Bytes per Solid Voxel: %.2f",
+        cpu->stats.voxel_solid ? (double)world_bytes / cpu->stats.voxel_solid : 0.0);
     ImGui::Separator();
-    ImGui::Value("Total Voxels", pow3(VX_GRID_SIZE));
-    ImGui::Value("Empty Voxels", cpu->stats.voxel_empty);
-    ImGui::Value("Solid Voxels", cpu->stats.voxel_solid);
+    ImGui::Text("Total Voxels: %llu", (unsigned long long)pow3((u64)cpu->world->resolution));
+    ImGui::Text("Empty Voxels: %llu", (unsigned long long)cpu->stats.voxel_empty);
+    ImGui::Text("Solid Voxels: %llu", (unsigned long long)cpu->stats.voxel_solid);
+    if (cpu->stats.corrupt_chunks)
+        ImGui::Text("Corrupt Chunks: %u, read as empty", cpu->stats.corrupt_chunks);
     ImGui::Separator();
-    ImGui::Value("Vertices", gpu->voxel_mesh.vertex_count);
-    ImGui::Value("Triangles", gpu->voxel_mesh.index_count / 3);
+    const voxel_mesh_cache* mesh_cache = gpu->mesh_scheduler->front;
+    if (cpu->mesh_flags & voxel_mesh_flag_greedy)
+    {
+        // before -> after merging
+        u32 face_count = gpu->voxel_mesh_face_count;
+        ImGui::Text("Vertices: %u -> %u", 4 * face_count, mesh_cache->vertex_count);
+        ImGui::Text("Triangles: %u -> %u", 2 * face_count, mesh_cache->triangle_count);
+    }
+    else
+    {
+        ImGui::Value("Vertices", mesh_cache->vertex_count);
+        ImGui::Value("Triangles", mesh_cache->triangle_count);
+    }
+    if (voxel_mesh_scheduler_busy(gpu->mesh_scheduler))
+        ImGui::Text("Meshing...");
     ImGui::Separator();
     ImGui::Text("Selected Mode: %s", edit_mode_names[cpu->edit_mode]);
     ImGui::Text("Selected Brush: %s", edit_brush_names[cpu->edit_brush]);
+    if (cpu->edit_brush == edit_brush_shape)
+    {
+        auto& shape = cpu->shape_edit_state;
+        ImGui::Combo("Shape", &shape.shape, brush_shape_names, vx_countof(brush_shape_names));
+        ImGui::Combo("Shape Mode", &shape.mode, brush_mode_names, vx_countof(brush_mode_names));
+        if (shape.shape == voxel_brush_shape_ellipsoid)
+            ImGui::SliderFloat3("Radii", &shape.radii[0], 1.0f, 256.0f);
+        else
+            ImGui::SliderFloat("Radius", &shape.radius, 1.0f, 256.0f);
+        if (shape.shape >= voxel_brush_shape_cylinder)
+            ImGui::SliderFloat("Height", &shape.height, 1.0f, 512.0f);
+    }
+    if (cpu->edit_brush == edit_brush_fill)
+    {
+        auto& fill = cpu->fill_edit_state;
+        ImGui::Combo(
+            "Connectivity", &fill.connectivity, connectivity_names, vx_countof(connectivity_names));
+        ImGui::Combo("Match", &fill.match, match_names, vx_countof(match_names));
+        if (ImGui::Button("Find Floating Islands"))
+            floating_islands_update(cpu, false);
+        ImGui::SameLine();
+        if (ImGui::Button("Delete Floating Islands"))
+            floating_islands_update(cpu, true);
+        if (fill.floating_count >= 0)
+            ImGui::Text(
+                "Floating: %d islands, %llu voxels",
+                fill.floating_count,
+                (unsigned long long)fill.floating_voxels);
+    }
+    if (cpu->edit_brush == edit_brush_clip)
+    {
+        const auto& clip = cpu->clip_edit_state;
+        if (clip.has_selection)
+        {
+            const int3 size = clip.selection.max - clip.selection.min + 1;
+            ImGui::Text("Selection: %d x %d x %d", size.x, size.y, size.z);
+        }
+        if (ImGui::Button("Copy"))
+            clip_mode_copy(cpu, false);
+        ImGui::SameLine();
+        if (ImGui::Button("Cut"))
+            clip_mode_copy(cpu, true);
+        ImGui::SameLine();
+        if (ImGui::Button("Paste"))
+            clip_mode_paste_start(cpu);
+        if (clip.clipboard.voxel_count)
+        {
+            const int3 size = clip.clipboard.size;
+            ImGui::Text(
+                "Clipboard: %d x %d x %d, %llu voxels",
+                size.x,
+                size.y,
+                size.z,
+                (unsigned long long)clip.clipboard.voxel_count);
+
+            const char* axis_names[] = {"X", "Y", "Z"};
+            char label[32];
+            for (int mirror = 0; mirror < 2; mirror++)
+                for (int a = 0; a < axis_count; a++)
+                {
+                    std::snprintf(
+                        label, sizeof label, "%s %s", mirror ? "Mirror" : "Rotate", axis_names[a]);
+                    if (a > 0)
+                        ImGui::SameLine();
+                    if (ImGui::Button(label))
+                        clip_mode_transform(cpu, mirror != 0, (axis)a);
+                }
+        }
+    }
     ImGui::Separator();
     ImGui::CheckboxFlags("Ambient Occlusion", &cpu->render_flags, render_flag_ambient_occlusion);
     ImGui::CheckboxFlags("Directional Light", &cpu->render_flags, render_flag_directional_light);
+    if (ImGui::CheckboxFlags("Greedy Meshing", &cpu->mesh_flags, voxel_mesh_flag_greedy))
+        mark_dirty_all(cpu);
+    if (ImGui::SliderInt("Mesh Workers", &cpu->config.mesh_worker_count, -1, 16))
+        config_save(&cpu->config);
+    if (ImGui::SliderInt("Autosave Minutes", &cpu->config.autosave_minutes, 0, 30))
+        config_save(&cpu->config);
+    if (ImGui::SliderInt("Undo Megabytes", &cpu->config.undo_megabytes, 1, 1024))
+    {
+        voxel_history_set_budget(cpu->history, (usize)cpu->config.undo_megabytes MB);
+        config_save(&cpu->config);
+    }
+    if (ImGui::Button("Undo"))
+        history_step(cpu, true);
+    ImGui::SameLine();
+    if (ImGui::Button("Redo"))
+        history_step(cpu, false);
+    ImGui::Text(
+        "History: %d undo, %d redo, %.1f MB",
+        cpu->history->undo.size(),
+        cpu->history->redo.size(),
+        (double)cpu->history->byte_size / (1 MB));
+    ImGui::Checkbox("Stress Edits", &cpu->stress_edits);
     ImGui::Separator();
     ImGui::SliderFloat("Sun Theta", &cpu->skybox.sun_normalized_theta, 0.0f, 1.0f);
     ImGui::SliderFloat("Sun Phi", &cpu->skybox.sun_normalized_phi, 0.0f, 1.0f);
@@ -1398,31 +2013,104 @@ void voxed_gui_update(voxed_cpu_state* cpu, const voxed_gpu_state* gpu)
     ImGui::Separator();
     if (ImGui::Button("Save"))
     {
-        if (FILE* f = fopen("scene.vx", "wb"))
-        {
-            fwrite(cpu->voxel_grid, sizeof cpu->voxel_grid, 1, f);
-            fclose(f);
-            fprintf(stdout, "Saved scene\n");
-        }
+        scene_save(cpu, "scene.vx");
     }
     ImGui::SameLine();
     if (ImGui::Button("Load") || hack_instant_load)
     {
-        if (FILE* f = fopen("scene.vx", "rb"))
+        if (scene_load(cpu->world))
         {
-            fread(cpu->voxel_grid, sizeof cpu->voxel_grid, 1, f);
-            fclose(f);
-            fprintf(stdout, "Loaded scene\n");
-            cpu->voxel_grid_is_dirty = true;
+            world_resize(cpu, cpu->world->resolution);
+            cpu->unsaved_changes = false;
         }
         hack_instant_load = false;
     }
     ImGui::SameLine();
     if (ImGui::Button("Clear"))
     {
-        memset(cpu->voxel_grid, 0, sizeof(cpu->voxel_grid));
-        cpu->voxel_grid_is_dirty = true;
+        voxel_world_clear(cpu->world);
+        voxel_pyramid_build(&cpu->world_pyramid, cpu->world);
+        voxel_history_clear(cpu->history);
+        cpu->unsaved_changes = true;
+        mark_dirty_all(cpu);
+    }
+    if (ImGui::Button("Import .vox"))
+    {
+        if (voxel_vox_import(cpu->world, "scene.vox"))
+        {
+            // grow to the smallest resolution that fits the imported scene
+            i32 resolution = resolutions[vx_countof(resolutions) - 1];
+            for (int i = vx_countof(resolutions) - 1; i >= 0; i--)
+                if (resolutions[i] >= cpu->world->resolution)
+                    resolution = resolutions[i];
+            world_resize(cpu, resolution);
+        }
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export .vox"))
+    {
+        if (voxel_vox_export(cpu->world, "scene.vox"))
+            fprintf(stdout, "Exported scene.vox\n");
+    }
+    ImGui::Combo(
+        "Mesh Format",
+        &cpu->mesh_export_format,
+        voxel_mesh_format_extensions,
+        voxel_mesh_format_count);
+    if (ImGui::Button("Export Mesh"))
+    {
+        char path[32];
+        std::snprintf(
+            path, sizeof path, "scene.%s", voxel_mesh_format_extensions[cpu->mesh_export_format]);
+        if (voxel_mesh_export(
+                cpu->world,
+                cpu->scene_bounds,
+                cpu->mesh_flags,
+                (voxel_mesh_format)cpu->mesh_export_format,
+                path))
+            fprintf(stdout, "Exported %s\n", path);
     }
+    ImGui::SameLine();
+    if (ImGui::Button("Voxelize Mesh"))
+    {
+        // Reads back what Export Mesh writes, or a point cloud saved under
+        // that name, in the brush color where it has no colors.
+        char path[32];
+        std::snprintf(
+            path, sizeof path, "scene.%s", voxel_mesh_format_extensions[cpu->mesh_export_format]);
+        bool ok;
+        if (voxel_point_cloud_detect(path))
+        {
+            voxel_point_cloud_options options;
+            options.resolution = std::min(cpu->world->resolution, voxel_voxelize_max_resolution);
+            options.color = cpu->brush.color_rgb;
+            options.worker_count = cpu->config.mesh_worker_count;
+            voxel_point_cloud_stats stats;
+            ok = voxel_point_cloud_voxelize(cpu->world, path, options, &stats);
+            if (ok)
+                fprintf(
+                    stdout,
+                    "Voxelized %llu points at %.2f Mpoints/s\n",
+                    (unsigned long long)stats.point_count,
+                    (double)stats.point_count / std::max(stats.seconds, 1e-9) / 1e6);
+        }
+        else
+        {
+            voxel_triangle_mesh mesh;
+            voxel_voxelize_options options;
+            options.resolution = std::min(cpu->world->resolution, voxel_voxelize_max_resolution);
+            options.solid = true;
+            options.color = cpu->brush.color_rgb;
+            options.worker_count = cpu->config.mesh_worker_count;
+            ok = voxel_triangle_mesh_load(&mesh, path) && voxel_voxelize(cpu->world, mesh, options);
+        }
+        if (ok)
+            world_resize(cpu, cpu->world->resolution);
+    }
+    if (voxel_file_saver_busy(cpu->saver))
+        ImGui::ProgressBar(voxel_file_saver_progress(cpu->saver), ImVec2(-1, 0), cpu->save_status);
+    else if (cpu->save_status[0])
+        ImGui::Text("%s", cpu->save_status);
     ImGui::Separator();
     ImGui::Text("Rulers");
     static const char* plane_names[] = {"XY", "YZ", "ZX"};
@@ -1432,7 +2120,8 @@ void voxed_gui_update(voxed_cpu_state* cpu, const voxed_gpu_state* gpu)
         ImGui::PushID(i);
         ImGui::Text("%s", plane_names[i]);
         ImGui::SameLine();
-        ImGui::SliderInt("##slider", &ruler.offset, -VX_GRID_SIZE / 2, VX_GRID_SIZE / 2);
+        ImGui::SliderInt(
+            "##slider", &ruler.offset, -cpu->world->resolution / 2, cpu->world->resolution / 2);
         ImGui::SameLine();
         ImGui::Checkbox("##checkbox", &ruler.enabled);
         ImGui::PopID();
@@ -1574,9 +2263,17 @@ void voxed_frame_end(voxed* state)
     if (state->gpu->voxel_mesh_changed_recently)
     {
         state->cpu->voxel_grid_is_dirty = false;
+        state->cpu->voxel_dirty_region = empty_region;
+        state->cpu->voxel_mesh_needs_rebuild = false;
         state->gpu->voxel_mesh_changed_recently = false;
     }
 }
 
-void voxed_quit(voxed* /*state*/) {}
+void voxed_quit(voxed* state)
+{
+    voxel_mesh_scheduler_destroy(state->gpu->mesh_scheduler);
+    voxel_file_saver_destroy(state->cpu->saver);
+    voxel_history_destroy(state->cpu->history);
+    job_system_destroy(state->cpu->edit_jobs);
+}
 } // namespace vx
@@ -0,0 +1,360 @@
+#include "voxel/voxel_brush.h"
+
+#include <cstring>
+
+// SSE2 is part of x86-64, elsewhere the shapes are tested a voxel at a
+// time with the same math.
+#if defined(__SSE2__) || defined(_M_X64)
+#define VX_BRUSH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace vx
+{
+namespace
+{
+constexpr int chunk_rows = voxel_chunk_size * voxel_chunk_size;
+
+const bounds3i empty_bounds{int3{INT32_MAX}, int3{INT32_MIN}};
+
+// the brush with what the inside tests need, relative to a
+struct raster
+{
+    voxel_brush_shape shape;
+    voxel_brush_mode mode;
+    voxel_leaf leaf;
+    float3 a;
+
+    // spheres and ellipsoids
+    float3 inv_radius2;
+
+    // the other shapes, d is b - a and dd its squared length
+    float3 d;
+    float dd, inv_dd;
+    float radius, radius2;
+
+    // clipped to the world
+    bounds3i bounds;
+};
+
+// parts of the inside tests that are the same along a row
+struct raster_row
+{
+    // of ellipsoids
+    float ellipsoid;
+
+    // of dot(p - a, d) and of |p - a|^2 for the other shapes
+    float dot;
+    float length2;
+};
+
+// one chunk overlapping the bounds of the brush
+struct brush_job
+{
+    const raster* r;
+    voxel_chunk* chunk;
+
+    // copy of the chunk from before the brush and the changes to it, only
+    // when recording
+    bool record;
+    voxel_chunk before;
+    array<voxel_history_run> runs;
+
+    // voxels changed by row, and their box in local coordinates
+    u32 changed[chunk_rows];
+    bounds3i changed_box;
+};
+
+raster raster_build(const voxel_brush& brush, const voxel_world* world)
+{
+    raster r;
+    r.shape = brush.shape;
+    r.mode = brush.mode;
+    r.leaf = voxel_leaf{brush.leaf.color, voxel_flag_solid};
+    r.a = brush.a;
+
+    float3 radius = brush.shape == voxel_brush_shape_ellipsoid ? brush.radius
+                                                                : float3{brush.radius.x};
+    radius = glm::max(radius, float3{1e-3f});
+    r.inv_radius2 = 1.0f / (radius * radius);
+
+    r.d = brush.b - brush.a;
+    r.dd = glm::dot(r.d, r.d);
+    r.inv_dd = r.dd > 0.0f ? 1.0f / r.dd : 0.0f;
+    r.radius = radius.x;
+    r.radius2 = radius.x * radius.x;
+
+    const bounds3i b = voxel_brush_bounds(brush);
+    r.bounds.min = glm::max(b.min, int3{0});
+    r.bounds.max = glm::min(b.max, int3{world->resolution - 1});
+    return r;
+}
+
+raster_row row_begin(const raster& r, i32 y, i32 z)
+{
+    const float py = (float)y + 0.5f - r.a.y;
+    const float pz = (float)z + 0.5f - r.a.z;
+    raster_row row;
+    row.ellipsoid = py * py * r.inv_radius2.y + pz * pz * r.inv_radius2.z;
+    row.dot = py * r.d.y + pz * r.d.z;
+    row.length2 = py * py + pz * pz;
+    return row;
+}
+
+#if defined(VX_BRUSH_SSE2)
+// one bit each for the 4 voxels whose centers are w from a along x
+u32 inside4(const raster& r, const raster_row& row, __m128 w)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 w2 = _mm_mul_ps(w, w);
+
+    if (r.shape == voxel_brush_shape_sphere || r.shape == voxel_brush_shape_ellipsoid)
+    {
+        const __m128 e =
+            _mm_add_ps(_mm_mul_ps(w2, _mm_set1_ps(r.inv_radius2.x)), _mm_set1_ps(row.ellipsoid));
+        return (u32)_mm_movemask_ps(_mm_cmple_ps(e, one));
+    }
+
+    const __m128 dot = _mm_add_ps(_mm_set1_ps(row.dot), _mm_mul_ps(w, _mm_set1_ps(r.d.x)));
+    const __m128 length2 = _mm_add_ps(_mm_set1_ps(row.length2), w2);
+    const __m128 t = _mm_mul_ps(dot, _mm_set1_ps(r.inv_dd));
+    const __m128 radius2 = _mm_set1_ps(r.radius2);
+
+    __m128 in;
+    if (r.shape == voxel_brush_shape_capsule)
+    {
+        // distance to the closest point of the segment
+        const __m128 tc = _mm_min_ps(_mm_max_ps(t, zero), one);
+        const __m128 twice_dot = _mm_add_ps(dot, dot);
+        const __m128 d2 = _mm_sub_ps(
+            length2, _mm_mul_ps(tc, _mm_sub_ps(twice_dot, _mm_mul_ps(tc, _mm_set1_ps(r.dd)))));
+        in = _mm_cmple_ps(d2, radius2);
+    }
+    else
+    {
+        // distance to the axis, within the caps
+        const __m128 d2 = _mm_sub_ps(length2, _mm_mul_ps(dot, t));
+        __m128 limit = radius2;
+        if (r.shape == voxel_brush_shape_cone)
+        {
+            const __m128 rt = _mm_mul_ps(_mm_set1_ps(r.radius), _mm_sub_ps(one, t));
+            limit = _mm_mul_ps(rt, rt);
+        }
+        in = _mm_and_ps(_mm_cmpge_ps(t, zero), _mm_cmple_ps(t, one));
+        in = _mm_and_ps(in, _mm_cmple_ps(d2, limit));
+    }
+    return (u32)_mm_movemask_ps(in);
+}
+#else
+// same as inside4 for one voxel
+bool inside(const raster& r, const raster_row& row, float w)
+{
+    if (r.shape == voxel_brush_shape_sphere || r.shape == voxel_brush_shape_ellipsoid)
+        return w * w * r.inv_radius2.x + row.ellipsoid <= 1.0f;
+
+    const float dot = row.dot + w * r.d.x;
+    const float length2 = row.length2 + w * w;
+    const float t = dot * r.inv_dd;
+    if (r.shape == voxel_brush_shape_capsule)
+    {
+        const float tc = std::min(std::max(t, 0.0f), 1.0f);
+        return length2 - tc * ((dot + dot) - tc * r.dd) <= r.radius2;
+    }
+
+    float limit = r.radius2;
+    if (r.shape == voxel_brush_shape_cone)
+        limit = (r.radius * (1.0f - t)) * (r.radius * (1.0f - t));
+    return t >= 0.0f && t <= 1.0f && length2 - dot * t <= limit;
+}
+#endif
+
+// voxels lo_x to hi_x of a row of the chunk at base that are inside, bit x
+// for voxel x
+u32 row_inside(const raster& r, const int3& base, i32 y, i32 z, i32 lo_x, i32 hi_x)
+{
+    const raster_row row = row_begin(r, base.y + y, base.z + z);
+    const float w0 = (float)base.x + 0.5f - r.a.x;
+
+    u32 mask = 0;
+#if defined(VX_BRUSH_SSE2)
+    const __m128 steps = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+    for (i32 x = lo_x & ~3; x <= hi_x; x += 4)
+        mask |= inside4(r, row, _mm_add_ps(_mm_set1_ps(w0 + (float)x), steps)) << x;
+#else
+    for (i32 x = lo_x; x <= hi_x; x++)
+        mask |= u32(inside(r, row, w0 + (float)x)) << x;
+#endif
+    return mask & (~0u >> (voxel_chunk_mask - hi_x)) & (~0u << lo_x);
+}
+
+void brush_chunk(void* data)
+{
+    brush_job* job = (brush_job*)data;
+    const raster& r = *job->r;
+    voxel_chunk* chunk = job->chunk;
+    if (job->record)
+        voxel_chunk_copy(&job->before, chunk);
+
+    const int3 base = chunk->coords * voxel_chunk_size;
+    const int3 lo = glm::max(r.bounds.min - base, int3{0});
+    const int3 hi = glm::min(r.bounds.max - base, int3{voxel_chunk_mask});
+    const bool paint = r.mode == voxel_brush_mode_paint;
+    const bool fill = r.mode == voxel_brush_mode_union || paint;
+
+    // added once something is filled, so untouched chunks keep their palette
+    u32 index = fill ? ~0u : 0;
+    u32 indices[voxel_chunk_size];
+
+    // only then can voxels already have the leaf
+    bool had_leaf = false;
+    for (u32 i = 1; fill && i < chunk->palette_count; i++)
+        had_leaf = had_leaf || voxel_leaf_equal(chunk->palette[i], r.leaf);
+
+    job->changed_box = empty_bounds;
+    for (i32 row = 0; row < chunk_rows; row++)
+    {
+        const i32 y = row & voxel_chunk_mask;
+        const i32 z = row >> voxel_chunk_size_log2;
+        u32 in = 0;
+        if (y >= lo.y && y <= hi.y && z >= lo.z && z <= hi.z && lo.x <= hi.x)
+            in = row_inside(r, base, y, z, lo.x, hi.x);
+
+        u32 target;
+        if (r.mode == voxel_brush_mode_union)
+            target = in;
+        else if (r.mode == voxel_brush_mode_intersect)
+            target = in == ~0u ? 0 : ~in & voxel_chunk_solid_row(chunk, row);
+        else
+            target = in ? in & voxel_chunk_solid_row(chunk, row) : 0;
+
+        if (target && index == ~0u)
+            index = voxel_chunk_palette_add(chunk, r.leaf);
+
+        // voxels that already have the leaf stay as they are
+        if (target && had_leaf)
+        {
+            voxel_chunk_row_indices(chunk, row, indices);
+            u32 same = 0;
+            for (i32 x = 0; x < voxel_chunk_size; x++)
+                same |= u32(indices[x] == index) << x;
+            target &= ~same;
+        }
+
+        job->changed[row] = target;
+        if (!target)
+            continue;
+
+        job->changed_box.min = glm::min(job->changed_box.min, int3{glm::findLSB(target), y, z});
+        job->changed_box.max = glm::max(job->changed_box.max, int3{glm::findMSB(target), y, z});
+        while (target)
+        {
+            const i32 x = glm::findLSB(target);
+            const u32 rest = ~(target >> x);
+            const i32 count = rest ? glm::findLSB(rest) : voxel_chunk_size - x;
+            voxel_chunk_set_run(chunk, x + row * voxel_chunk_size, count, index);
+            target &= x + count < voxel_chunk_size ? ~0u << (x + count) : 0u;
+        }
+    }
+
+    if (job->record)
+        voxel_history_chunk_runs(&job->runs, &job->before, chunk, job->changed);
+}
+
+void add_region(bounds3i* region, const bounds3i& b)
+{
+    region->min = glm::min(region->min, b.min);
+    region->max = glm::max(region->max, b.max);
+}
+}
+
+bounds3i voxel_brush_bounds(const voxel_brush& brush)
+{
+    float3 mn, mx;
+    if (brush.shape == voxel_brush_shape_sphere || brush.shape == voxel_brush_shape_ellipsoid)
+    {
+        const float3 radius = brush.shape == voxel_brush_shape_ellipsoid ? brush.radius
+                                                                          : float3{brush.radius.x};
+        mn = brush.a - radius;
+        mx = brush.a + radius;
+    }
+    else
+    {
+        mn = glm::min(brush.a, brush.b) - brush.radius.x;
+        mx = glm::max(brush.a, brush.b) + brush.radius.x;
+    }
+
+    // voxels whose centers may be within
+    return bounds3i{int3{glm::floor(mn - 0.5f)}, int3{glm::floor(mx - 0.5f)} + 1};
+}
+
+bool voxel_brush_apply(
+    voxel_world* world,
+    const voxel_brush& brush,
+    job_system* jobs,
+    voxel_history* history,
+    bounds3i* out_region)
+{
+    const raster r = raster_build(brush, world);
+    const bool empty = glm::any(glm::greaterThan(r.bounds.min, r.bounds.max));
+    const bool record = history && !history->recording_overflowed;
+    bounds3i region = empty_bounds;
+
+    // Chunks are looked up and made writable up front, the chunk map is not
+    // safe to change from the workers.
+    array<voxel_chunk*> chunks;
+    if (r.mode == voxel_brush_mode_intersect)
+    {
+        array<int3> coords;
+        voxel_world_chunk_coords(world, &coords);
+        for (int i = 0; i < coords.size(); i++)
+            chunks.add(voxel_world_touch_chunk(world, coords[i]));
+    }
+    else if (!empty)
+    {
+        const int3 cmin = voxel_chunk_coords(r.bounds.min);
+        const int3 cmax = voxel_chunk_coords(r.bounds.max);
+        for (int cz = cmin.z; cz <= cmax.z; cz++)
+            for (int cy = cmin.y; cy <= cmax.y; cy++)
+                for (int cx = cmin.x; cx <= cmax.x; cx++)
+                {
+                    const int3 cc{cx, cy, cz};
+                    if (r.mode == voxel_brush_mode_union || voxel_world_find_chunk(world, cc))
+                        chunks.add(voxel_world_touch_chunk(world, cc));
+                }
+    }
+
+    array<brush_job> job_data(chunks.size());
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        job_data[i].r = &r;
+        job_data[i].chunk = chunks[i];
+        job_data[i].record = record;
+        job_system_submit(jobs, brush_chunk, &job_data[i]);
+    }
+    job_system_wait(jobs);
+
+    // in the order of the chunks, so the history does not depend on the workers
+    for (int i = 0; i < job_data.size(); i++)
+    {
+        brush_job& job = job_data[i];
+        if (job.record)
+        {
+            voxel_history_record_chunk(history, &job.before, job.chunk, job.runs);
+            voxel_chunk_free_copy(&job.before);
+        }
+
+        const int3 base = job.chunk->coords * voxel_chunk_size;
+        if (job.changed_box.min.x <= job.changed_box.max.x)
+            add_region(&region, bounds3i{base + job.changed_box.min, base + job.changed_box.max});
+
+        // chunks that were created or emptied by the brush, setting an empty
+        // voxel in an empty chunk releases it
+        if (!job.chunk->solid_count)
+            voxel_world_set(world, base, voxel_leaf{});
+    }
+
+    *out_region = region;
+    return region.min.x <= region.max.x;
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "common/job_system.h"
+#include "voxel/voxel_history.h"
+
+namespace vx
+{
+enum voxel_brush_shape
+{
+    voxel_brush_shape_sphere,
+    voxel_brush_shape_ellipsoid,
+    voxel_brush_shape_cylinder,
+    voxel_brush_shape_cone,
+    voxel_brush_shape_capsule,
+    voxel_brush_shape_count,
+};
+
+enum voxel_brush_mode
+{
+    // fill the shape with the leaf
+    voxel_brush_mode_union,
+    // empty the shape
+    voxel_brush_mode_subtract,
+    // empty everything outside of the shape
+    voxel_brush_mode_intersect,
+    // give the solid voxels in the shape the color of the leaf
+    voxel_brush_mode_paint,
+    voxel_brush_mode_count,
+};
+
+// A shape in voxel coordinates, where voxel p spans p to p + 1 and is inside
+// if its center is. Spheres and ellipsoids are centered at a, with radius.x
+// for spheres and radius per axis for ellipsoids. Cylinders, cones and
+// capsules run from a to b with radius.x, cones narrow down to a point at b.
+// a and b have to differ for cylinders and cones.
+struct voxel_brush
+{
+    voxel_brush_shape shape;
+    voxel_brush_mode mode;
+    float3 a, b;
+    float3 radius;
+
+    // only the color is used, the voxels of the shape are solid with union
+    voxel_leaf leaf;
+};
+
+// Inclusive box of the voxels the shape may cover, not clipped to any world.
+bounds3i voxel_brush_bounds(const voxel_brush& brush);
+
+// Apply the brush to the world. Chunks are split among the workers of jobs,
+// each chunk is rasterized by one worker, four voxels at a time where SIMD is
+// available. If history is not null it has to be recording and the changes
+// go into its transaction.
+//
+// Returns false if no voxel changed, otherwise out_region is the box of the
+// changed voxels.
+bool voxel_brush_apply(
+    voxel_world* world,
+    const voxel_brush& brush,
+    job_system* jobs,
+    voxel_history* history,
+    bounds3i* out_region);
+}
@@ -0,0 +1,682 @@
+#include "voxel/voxel_clip.h"
+
+#include <cstring>
+
+namespace vx
+{
+namespace
+{
+constexpr int chunk_rows = voxel_chunk_size * voxel_chunk_size;
+
+const bounds3i empty_bounds{int3{INT32_MAX}, int3{INT32_MIN}};
+
+i32 block_index(const voxel_clip& clip, const int3& coords)
+{
+    if (glm::any(glm::lessThan(coords, int3{0})) ||
+        glm::any(glm::greaterThanEqual(coords, clip.block_count)))
+        return -1;
+    const int3& n = clip.block_count;
+    return clip.block_indices[coords.x + (coords.y + coords.z * n.y) * n.x];
+}
+
+void block_indices_build(voxel_clip* clip)
+{
+    const int3& n = clip->block_count;
+    clip->block_indices.resize(n.x * n.y * n.z);
+    for (int i = 0; i < clip->block_indices.size(); i++)
+        clip->block_indices[i] = -1;
+    for (int i = 0; i < clip->blocks.size(); i++)
+    {
+        const int3& c = clip->blocks[i].coords;
+        clip->block_indices[c.x + (c.y + c.z * n.y) * n.x] = i;
+    }
+}
+
+// solid voxels in the rows before each row
+void row_firsts_build(voxel_clip_block* block)
+{
+    u32 count = 0;
+    for (i32 row = 0; row < chunk_rows; row++)
+    {
+        block->row_firsts[row] = (u16)count;
+        count += glm::bitCount(block->occupancy[row]);
+    }
+}
+
+//
+// copy
+//
+
+// a chunk overlapping the box being copied
+struct copy_job
+{
+    const voxel_chunk* chunk;
+    // the box in local coordinates of the chunk
+    int3 lo, hi;
+
+    voxel_clip_block block;
+    array<voxel_leaf> palette;
+    array<u16> indices;
+    u64 voxel_count;
+};
+
+void copy_chunk(void* data)
+{
+    copy_job* job = (copy_job*)data;
+    const voxel_chunk* chunk = job->chunk;
+    voxel_clip_block& block = job->block;
+    std::memset(block.occupancy, 0, sizeof block.occupancy);
+
+    const u32 x_mask = (~0u >> (voxel_chunk_mask - job->hi.x)) & (~0u << job->lo.x);
+    job->voxel_count = 0;
+    for (i32 z = job->lo.z; z <= job->hi.z; z++)
+        for (i32 y = job->lo.y; y <= job->hi.y; y++)
+        {
+            const i32 row = y + z * voxel_chunk_size;
+            block.occupancy[row] = voxel_chunk_solid_row(chunk, row) & x_mask;
+            job->voxel_count += glm::bitCount(block.occupancy[row]);
+        }
+    if (!job->voxel_count)
+        return;
+    row_firsts_build(&block);
+
+    // Chunks of a single leaf are common and need no indices, the rest get
+    // the leaves they use numbered in the order they come up.
+    if (chunk->palette_count == 2)
+    {
+        job->palette.add(chunk->palette[1]);
+        return;
+    }
+
+    array<u16> remap(chunk->palette_count);
+    std::memset(remap.ptr(), 0xff, remap.byte_size());
+    u32 entries[voxel_chunk_size];
+    for (i32 row = 0; row < chunk_rows; row++)
+    {
+        u32 bits = block.occupancy[row];
+        if (!bits)
+            continue;
+        voxel_chunk_row_indices(chunk, row, entries);
+        for (; bits; bits &= bits - 1)
+        {
+            const u32 e = entries[glm::findLSB(bits)];
+            if (remap[e] == 0xffff)
+            {
+                remap[e] = (u16)job->palette.size();
+                job->palette.add(chunk->palette[e]);
+            }
+            job->indices.add(remap[e]);
+        }
+    }
+    if (job->palette.size() == 1)
+        job->indices.clear();
+}
+
+//
+// transforms
+//
+
+// Axis i of the transformed clip is axis axes[i] of the clip before, mirrored
+// if flips[i] is set.
+struct transform
+{
+    int3 axes;
+    int3 flips;
+};
+
+struct transform_job
+{
+    voxel_clip* clip;
+    const array<u16>* indices;
+    array<u16>* transformed_indices;
+    transform t;
+    i32 block;
+};
+
+// Transposes the 32x32 bit matrix of the words, bit x of word y goes to bit
+// y of word x. Blocks of half the size are swapped across the diagonal, then
+// the blocks within them, 5 steps of 32 word operations.
+void transpose32(u32* words)
+{
+    u32 mask = 0x0000ffff;
+    for (int j = 16; j; j >>= 1, mask ^= mask << j)
+        for (int k = 0; k < 32; k = (k + j + 1) & ~j)
+        {
+            const u32 t = ((words[k] >> j) ^ words[k + j]) & mask;
+            words[k] ^= t << j;
+            words[k + j] ^= t;
+        }
+}
+
+u32 reverse32(u32 v)
+{
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+// swap the x and the other axis of dense u16 voxels, a 32x32 tile at a time
+void transpose_dense(const u16* in, u16* out, int other)
+{
+    const i32 stride = other == axis_y ? voxel_chunk_size : chunk_rows;
+    const i32 step = other == axis_y ? chunk_rows : voxel_chunk_size;
+    for (i32 s = 0; s < voxel_chunk_size; s++)
+    {
+        const u16* tile = in + s * step;
+        u16* tile_out = out + s * step;
+        for (i32 i = 0; i < voxel_chunk_size; i++)
+            for (i32 j = 0; j < voxel_chunk_size; j++)
+                tile_out[i * stride + j] = tile[j * stride + i];
+    }
+}
+
+void transform_block(void* data)
+{
+    const transform_job* job = (const transform_job*)data;
+    const transform& t = job->t;
+    voxel_clip* clip = job->clip;
+    voxel_clip_block& block = clip->blocks[job->block];
+    const bool dense = block.palette_count > 1;
+
+    // palette indices of all voxels, the transform goes from a to b and back
+    array<u16> dense_voxels(dense ? 2 * voxel_chunk_volume : 0);
+    u16* dense_a = dense ? dense_voxels.ptr() : nullptr;
+    u16* dense_b = dense ? dense_a + voxel_chunk_volume : nullptr;
+    if (dense)
+    {
+        const u16* indices = job->indices->ptr() + block.index_first;
+        for (i32 row = 0, n = 0; row < chunk_rows; row++)
+            for (u32 bits = block.occupancy[row]; bits; bits &= bits - 1)
+                dense_a[row * voxel_chunk_size + glm::findLSB(bits)] = indices[n++];
+    }
+
+    // Bring the axis that becomes x into the bits of the rows. which[i] is
+    // the axis before the transform along axis i of the voxels after this.
+    u32 occupancy[chunk_rows];
+    std::memcpy(occupancy, block.occupancy, sizeof occupancy);
+    int3 which{axis_x, axis_y, axis_z};
+    const u16* rows = dense_a;
+    if (t.axes.x == axis_y)
+    {
+        for (i32 z = 0; z < voxel_chunk_size; z++)
+            transpose32(occupancy + z * voxel_chunk_size);
+        if (dense)
+        {
+            transpose_dense(dense_a, dense_b, axis_y);
+            rows = dense_b;
+        }
+        which = int3{axis_y, axis_x, axis_z};
+    }
+    else if (t.axes.x == axis_z)
+    {
+        u32 words[voxel_chunk_size];
+        for (i32 y = 0; y < voxel_chunk_size; y++)
+        {
+            for (i32 z = 0; z < voxel_chunk_size; z++)
+                words[z] = occupancy[y + z * voxel_chunk_size];
+            transpose32(words);
+            for (i32 z = 0; z < voxel_chunk_size; z++)
+                occupancy[y + z * voxel_chunk_size] = words[z];
+        }
+        if (dense)
+        {
+            transpose_dense(dense_a, dense_b, axis_z);
+            rows = dense_b;
+        }
+        which = int3{axis_z, axis_y, axis_x};
+    }
+
+    // then move the rows to where y and z go, mirroring x within them
+    int3 position;
+    for (int i = 0; i < 3; i++)
+        position[which[i]] = i;
+    u16* rows_out = rows == dense_a ? dense_b : dense_a;
+    for (i32 z = 0; z < voxel_chunk_size; z++)
+        for (i32 y = 0; y < voxel_chunk_size; y++)
+        {
+            int3 from{0};
+            from[position[t.axes.y]] = t.flips.y ? voxel_chunk_mask - y : y;
+            from[position[t.axes.z]] = t.flips.z ? voxel_chunk_mask - z : z;
+            const i32 row = from.y + from.z * voxel_chunk_size;
+            const i32 row_out = y + z * voxel_chunk_size;
+            block.occupancy[row_out] = t.flips.x ? reverse32(occupancy[row]) : occupancy[row];
+            if (!dense)
+                continue;
+
+            const u16* in = rows + row * voxel_chunk_size;
+            u16* out = rows_out + row_out * voxel_chunk_size;
+            for (i32 x = 0; x < voxel_chunk_size; x++)
+                out[x] = in[t.flips.x ? voxel_chunk_mask - x : x];
+        }
+    row_firsts_build(&block);
+
+    if (dense)
+    {
+        u16* indices = job->transformed_indices->ptr() + block.index_first;
+        for (i32 row = 0, n = 0; row < chunk_rows; row++)
+            for (u32 bits = block.occupancy[row]; bits; bits &= bits - 1)
+                indices[n++] = rows_out[row * voxel_chunk_size + glm::findLSB(bits)];
+    }
+
+    const int3 coords = block.coords;
+    for (int i = 0; i < 3; i++)
+    {
+        const i32 c = coords[t.axes[i]];
+        block.coords[i] = t.flips[i] ? clip->block_count[i] - 1 - c : c;
+    }
+}
+
+void clip_transform(voxel_clip* clip, const transform& t, job_system* jobs)
+{
+    // Mirroring the grid of blocks as a whole keeps the blocks whole, the
+    // box only moves within the grid.
+    const int3 size = clip->size;
+    const int3 offset = clip->offset;
+    const int3 block_count = clip->block_count;
+    for (int i = 0; i < 3; i++)
+    {
+        clip->size[i] = size[t.axes[i]];
+        clip->block_count[i] = block_count[t.axes[i]];
+        const i32 padded = clip->block_count[i] * voxel_chunk_size;
+        clip->offset[i] = offset[t.axes[i]];
+        if (t.flips[i])
+            clip->offset[i] = padded - clip->offset[i] - clip->size[i];
+    }
+
+    array<u16> indices(clip->indices.size());
+    array<transform_job> job_data(clip->blocks.size());
+    for (int i = 0; i < clip->blocks.size(); i++)
+    {
+        job_data[i] = transform_job{clip, &clip->indices, &indices, t, i};
+        job_system_submit(jobs, transform_block, &job_data[i]);
+    }
+    job_system_wait(jobs);
+
+    std::swap(clip->indices, indices);
+    block_indices_build(clip);
+}
+
+//
+// paste
+//
+
+// chunk being pasted into, and the box of the voxels pasted
+struct paste_job
+{
+    const voxel_clip* clip;
+    int3 position;
+    i32 resolution;
+    voxel_chunk* chunk;
+
+    bool record;
+    voxel_chunk before;
+    array<voxel_history_run> runs;
+
+    u32 pasted[chunk_rows];
+    bounds3i pasted_box;
+};
+
+// Part of the clip at position within a chunk and the world, in local
+// coordinates of the chunk, and the blocks over it. False if there is none.
+bool chunk_overlap(
+    const voxel_clip& clip,
+    const int3& position,
+    i32 resolution,
+    const int3& chunk_coords,
+    int3* out_lo,
+    int3* out_hi,
+    int3* out_blocks_lo,
+    int3* out_blocks_hi)
+{
+    const int3 base = chunk_coords * voxel_chunk_size;
+    const int3 mn = glm::max(glm::max(position, base), int3{0});
+    const int3 mx = glm::min(position + clip.size - 1, base + voxel_chunk_mask);
+    const int3 lo = mn - base;
+    const int3 hi = glm::min(mx, int3{resolution - 1}) - base;
+    if (glm::any(glm::greaterThan(lo, hi)))
+        return false;
+
+    // chunk in coordinates of the grid of blocks
+    const int3 grid = base - position + clip.offset;
+    *out_lo = lo;
+    *out_hi = hi;
+    *out_blocks_lo = (grid + lo) >> voxel_chunk_size_log2;
+    *out_blocks_hi = (grid + hi) >> voxel_chunk_size_log2;
+    return true;
+}
+
+// set the bits of a row to their values, a run of equal values at a time
+void set_row(voxel_chunk* chunk, i32 row, u32 bits, const u32* values)
+{
+    while (bits)
+    {
+        const i32 x = glm::findLSB(bits);
+        i32 end = x + 1;
+        while (end < voxel_chunk_size && (bits >> end & 1u) && values[end] == values[x])
+            end++;
+        voxel_chunk_set_run(chunk, x + row * voxel_chunk_size, end - x, values[x]);
+        bits &= end < voxel_chunk_size ? ~0u << end : 0u;
+    }
+}
+
+void paste_chunk(void* data)
+{
+    paste_job* job = (paste_job*)data;
+    if (job->record)
+        voxel_chunk_copy(&job->before, job->chunk);
+    voxel_clip_paste_chunk(job->chunk, *job->clip, job->position, job->resolution, job->pasted);
+
+    job->pasted_box = empty_bounds;
+    for (i32 row = 0; row < chunk_rows; row++)
+    {
+        const u32 bits = job->pasted[row];
+        if (!bits)
+            continue;
+        const i32 y = row & voxel_chunk_mask;
+        const i32 z = row >> voxel_chunk_size_log2;
+        job->pasted_box.min = glm::min(job->pasted_box.min, int3{glm::findLSB(bits), y, z});
+        job->pasted_box.max = glm::max(job->pasted_box.max, int3{glm::findMSB(bits), y, z});
+    }
+
+    if (job->record)
+        voxel_history_chunk_runs(&job->runs, &job->before, job->chunk, job->pasted);
+}
+}
+
+void voxel_clip_copy(
+    voxel_clip* out,
+    const voxel_world* world,
+    const bounds3i& box,
+    job_system* jobs)
+{
+    out->blocks.clear();
+    out->palette.clear();
+    out->indices.clear();
+    out->voxel_count = 0;
+
+    const int3 mn = glm::max(box.min, int3{0});
+    const int3 mx = glm::min(box.max, int3{world->resolution - 1});
+    if (glm::any(glm::greaterThan(mn, mx)))
+    {
+        out->size = out->offset = out->block_count = int3{0};
+        out->block_indices.clear();
+        return;
+    }
+
+    // Chunks are looked up up front, looking one up may decode it, which is
+    // not safe to do from the workers.
+    const int3 cmin = voxel_chunk_coords(mn);
+    const int3 cmax = voxel_chunk_coords(mx);
+    out->size = mx - mn + 1;
+    out->offset = voxel_chunk_local(mn);
+    out->block_count = cmax - cmin + 1;
+
+    array<const voxel_chunk*> chunks;
+    for (int cz = cmin.z; cz <= cmax.z; cz++)
+        for (int cy = cmin.y; cy <= cmax.y; cy++)
+            for (int cx = cmin.x; cx <= cmax.x; cx++)
+            {
+                if (const voxel_chunk* chunk = voxel_world_find_chunk(world, int3{cx, cy, cz}))
+                    chunks.add(chunk);
+            }
+
+    array<copy_job> job_data(chunks.size());
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        copy_job& job = job_data[i];
+        const int3 base = chunks[i]->coords * voxel_chunk_size;
+        job.chunk = chunks[i];
+        job.lo = glm::max(mn - base, int3{0});
+        job.hi = glm::min(mx - base, int3{voxel_chunk_mask});
+        job.block.coords = chunks[i]->coords - cmin;
+        job_system_submit(jobs, copy_chunk, &job);
+    }
+    job_system_wait(jobs);
+
+    for (int i = 0; i < job_data.size(); i++)
+    {
+        copy_job& job = job_data[i];
+        if (!job.voxel_count)
+            continue;
+
+        voxel_clip_block& block = out->blocks.add(job.block);
+        block.palette_first = out->palette.size();
+        block.palette_count = job.palette.size();
+        block.index_first = out->indices.size();
+        for (int j = 0; j < job.palette.size(); j++)
+            out->palette.add(job.palette[j]);
+        if (job.indices.size())
+        {
+            out->indices.resize(block.index_first + job.indices.size());
+            std::memcpy(
+                out->indices.ptr() + block.index_first, job.indices.ptr(), job.indices.byte_size());
+        }
+        out->voxel_count += job.voxel_count;
+    }
+    block_indices_build(out);
+}
+
+void voxel_clip_rotate(voxel_clip* clip, axis a, job_system* jobs)
+{
+    // axis u becomes v and v becomes -u for the axes u and v after a
+    const int u = (a + 1) % 3;
+    const int v = (a + 2) % 3;
+    transform t{int3{axis_x, axis_y, axis_z}, int3{0}};
+    t.axes[u] = v;
+    t.axes[v] = u;
+    t.flips[u] = 1;
+    clip_transform(clip, t, jobs);
+}
+
+void voxel_clip_mirror(voxel_clip* clip, axis a, job_system* jobs)
+{
+    transform t{int3{axis_x, axis_y, axis_z}, int3{0}};
+    t.flips[a] = 1;
+    clip_transform(clip, t, jobs);
+}
+
+bool voxel_clip_paste(
+    voxel_world* world,
+    const voxel_clip& clip,
+    const int3& position,
+    job_system* jobs,
+    voxel_history* history,
+    bounds3i* out_region)
+{
+    const bool record = history && !history->recording_overflowed;
+    bounds3i region = empty_bounds;
+
+    // Chunks are made writable up front, the chunk map is not safe to
+    // change from the workers. Chunks without blocks over them are left
+    // alone.
+    const bounds3i b = voxel_clip_bounds(clip, position);
+    const int3 cmin = voxel_chunk_coords(glm::max(b.min, int3{0}));
+    const int3 cmax = voxel_chunk_coords(glm::min(b.max, int3{world->resolution - 1}));
+    array<voxel_chunk*> chunks;
+    for (int cz = cmin.z; cz <= cmax.z && clip.voxel_count; cz++)
+        for (int cy = cmin.y; cy <= cmax.y; cy++)
+            for (int cx = cmin.x; cx <= cmax.x; cx++)
+            {
+                const int3 cc{cx, cy, cz};
+                int3 lo, hi, blocks_lo, blocks_hi;
+                if (!chunk_overlap(
+                        clip, position, world->resolution, cc, &lo, &hi, &blocks_lo, &blocks_hi))
+                    continue;
+
+                bool blocks = false;
+                for (int bz = blocks_lo.z; bz <= blocks_hi.z; bz++)
+                    for (int by = blocks_lo.y; by <= blocks_hi.y; by++)
+                        for (int bx = blocks_lo.x; bx <= blocks_hi.x; bx++)
+                            blocks = blocks || block_index(clip, int3{bx, by, bz}) >= 0;
+                if (blocks)
+                    chunks.add(voxel_world_touch_chunk(world, cc));
+            }
+
+    array<paste_job> job_data(chunks.size());
+    for (int i = 0; i < chunks.size(); i++)
+    {
+        paste_job& job = job_data[i];
+        job.clip = &clip;
+        job.position = position;
+        job.resolution = world->resolution;
+        job.chunk = chunks[i];
+        job.record = record;
+        job_system_submit(jobs, paste_chunk, &job);
+    }
+    job_system_wait(jobs);
+
+    // in the order of the chunks, so the history does not depend on the workers
+    for (int i = 0; i < job_data.size(); i++)
+    {
+        paste_job& job = job_data[i];
+        if (job.record)
+        {
+            voxel_history_record_chunk(history, &job.before, job.chunk, job.runs);
+            voxel_chunk_free_copy(&job.before);
+        }
+
+        const int3 base = job.chunk->coords * voxel_chunk_size;
+        if (job.pasted_box.min.x <= job.pasted_box.max.x)
+        {
+            region.min = glm::min(region.min, base + job.pasted_box.min);
+            region.max = glm::max(region.max, base + job.pasted_box.max);
+        }
+
+        // blocks may have nothing in this chunk, setting an empty voxel in an
+        // empty chunk releases it
+        if (!job.chunk->solid_count)
+            voxel_world_set(world, base, voxel_leaf{});
+    }
+
+    *out_region = region;
+    return region.min.x <= region.max.x;
+}
+
+void voxel_clip_paste_chunk(
+    voxel_chunk* chunk,
+    const voxel_clip& clip,
+    const int3& position,
+    i32 resolution,
+    u32* out_rows)
+{
+    if (out_rows)
+        std::memset(out_rows, 0, chunk_rows * sizeof(u32));
+
+    int3 lo, hi, blocks_lo, blocks_hi;
+    if (!clip.voxel_count ||
+        !chunk_overlap(
+            clip, position, resolution, chunk->coords, &lo, &hi, &blocks_lo, &blocks_hi))
+        return;
+
+    const int3 grid = chunk->coords * voxel_chunk_size - position + clip.offset;
+    array<u32> entries;
+    u32 values[voxel_chunk_size];
+    for (int bz = blocks_lo.z; bz <= blocks_hi.z; bz++)
+        for (int by = blocks_lo.y; by <= blocks_hi.y; by++)
+            for (int bx = blocks_lo.x; bx <= blocks_hi.x; bx++)
+            {
+                const int3 coords{bx, by, bz};
+                const i32 b = block_index(clip, coords);
+                if (b < 0)
+                    continue;
+                const voxel_clip_block& block = clip.blocks[b];
+
+                // part of the chunk the block is over, local voxel x is
+                // voxel x + shift.x of the block
+                const int3 shift = grid - coords * voxel_chunk_size;
+                const int3 block_lo = glm::max(lo, -shift);
+                const int3 block_hi = glm::min(hi, voxel_chunk_mask - shift);
+                const u32 x_mask =
+                    (~0u >> (voxel_chunk_mask - block_hi.x)) & (~0u << block_lo.x);
+                const bool single = block.palette_count == 1;
+                const u16* indices = single ? nullptr : clip.indices.ptr() + block.index_first;
+
+                // Adding leaves may renumber the palette of the chunk, so
+                // room is made for the leaves of the block that are used
+                // here before adding any.
+                entries.resize(block.palette_count);
+                std::memset(entries.ptr(), 0, entries.byte_size());
+                u32 used = 0;
+                for (int pass = single ? 1 : 0; pass < 2; pass++)
+                {
+                    if (pass == 1)
+                    {
+                        voxel_chunk_palette_reserve(chunk, single ? 1 : used);
+                        for (u32 e = 0; e < block.palette_count; e++)
+                            if (single || entries[e])
+                                entries[e] = voxel_chunk_palette_add(
+                                    chunk, clip.palette[block.palette_first + e]);
+                    }
+
+                    for (i32 z = block_lo.z; z <= block_hi.z; z++)
+                        for (i32 y = block_lo.y; y <= block_hi.y; y++)
+                        {
+                            const i32 from = (y + shift.y) + (z + shift.z) * voxel_chunk_size;
+                            const u32 occupancy = block.occupancy[from];
+                            u32 bits = shift.x >= 0 ? occupancy >> shift.x
+                                                    : occupancy << -shift.x;
+                            bits &= x_mask;
+                            if (!bits)
+                                continue;
+
+                            const i32 row = y + z * voxel_chunk_size;
+                            if (single)
+                            {
+                                for (i32 x = 0; x < voxel_chunk_size; x++)
+                                    values[x] = entries[0];
+                                set_row(chunk, row, bits, values);
+                                if (out_rows)
+                                    out_rows[row] |= bits;
+                                continue;
+                            }
+
+                            for (u32 rest = bits; rest; rest &= rest - 1)
+                            {
+                                const i32 x = glm::findLSB(rest);
+                                const u32 before = occupancy & ((1u << (x + shift.x)) - 1);
+                                const u16 e =
+                                    indices[block.row_firsts[from] + glm::bitCount(before)];
+                                if (pass == 0)
+                                {
+                                    used += !entries[e];
+                                    entries[e] = 1;
+                                }
+                                else
+                                    values[x] = entries[e];
+                            }
+                            if (pass == 1)
+                            {
+                                set_row(chunk, row, bits, values);
+                                if (out_rows)
+                                    out_rows[row] |= bits;
+                            }
+                        }
+                }
+            }
+}
+
+u32 voxel_clip_row(const voxel_clip& clip, const int3& position, i32 x, i32 y, i32 z)
+{
+    // row in coordinates of the grid of blocks
+    const int3 grid = int3{x, y, z} - position + clip.offset;
+    const int3 mn = clip.offset;
+    const int3 mx = clip.offset + clip.size - 1;
+    if (!clip.voxel_count || grid.y < mn.y || grid.y > mx.y || grid.z < mn.z || grid.z > mx.z)
+        return 0;
+
+    const i32 row = (grid.y & voxel_chunk_mask) + (grid.z & voxel_chunk_mask) * voxel_chunk_size;
+    const i32 shift = grid.x & voxel_chunk_mask;
+    int3 coords = grid >> voxel_chunk_size_log2;
+    u32 bits = 0;
+    i32 b = block_index(clip, coords);
+    if (b >= 0)
+        bits |= clip.blocks[b].occupancy[row] >> shift;
+    coords.x++;
+    b = shift ? block_index(clip, coords) : -1;
+    if (b >= 0)
+        bits |= clip.blocks[b].occupancy[row] << (voxel_chunk_size - shift);
+    return bits;
+}
+}
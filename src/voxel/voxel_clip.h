@@ -0,0 +1,96 @@
+#pragma once
+
+#include "common/job_system.h"
+#include "voxel/voxel_history.h"
+
+namespace vx
+{
+// Blocks of voxel_chunk_size^3 voxels of a clip with at least one solid voxel.
+struct voxel_clip_block
+{
+    // position in blocks within the grid of the clip
+    int3 coords;
+
+    // solid voxels, bit x of row y + z * voxel_chunk_size
+    u32 occupancy[voxel_chunk_size * voxel_chunk_size];
+    // solid voxels in the rows before each row
+    u16 row_firsts[voxel_chunk_size * voxel_chunk_size];
+
+    // Leaves of the block, from palette_first on in the palette of the clip.
+    // With more than one leaf every solid voxel has an index into them, in
+    // row order from index_first on.
+    u32 palette_first;
+    u32 palette_count;
+    u32 index_first;
+};
+
+// The solid voxels of a box copied out of a world, to be pasted elsewhere.
+// Only blocks with solid voxels are kept, as occupancy bits plus indices into
+// a palette per block, and none of those for blocks of a single leaf. Empty
+// voxels are not part of a clip, pasting leaves the world there as it is.
+struct voxel_clip
+{
+    // the box copied, from offset on within a grid of block_count blocks
+    int3 size;
+    int3 offset;
+    int3 block_count;
+
+    array<voxel_clip_block> blocks;
+    // index into blocks of x + (y + z * block_count.y) * block_count.x, or -1
+    array<i32> block_indices;
+
+    array<voxel_leaf> palette;
+    array<u16> indices;
+
+    u64 voxel_count;
+};
+
+// Copy the solid voxels of box, clipped to the world. The blocks of the clip
+// start out as the chunks of the world, each copied by one of the workers of
+// jobs.
+void voxel_clip_copy(
+    voxel_clip* out,
+    const voxel_world* world,
+    const bounds3i& box,
+    job_system* jobs);
+
+// Rotate by 90 degrees around axis, counterclockwise looking down on it, or
+// mirror along it. Blocks are moved as a whole and the voxels within them
+// by transposing 32x32 tiles and reordering rows, a block per worker.
+void voxel_clip_rotate(voxel_clip* clip, axis a, job_system* jobs);
+void voxel_clip_mirror(voxel_clip* clip, axis a, job_system* jobs);
+
+// Box of the voxels of the clip when pasted at position, inclusive.
+inline bounds3i voxel_clip_bounds(const voxel_clip& clip, const int3& position)
+{
+    return bounds3i{position, position + clip.size - 1};
+}
+
+// Paste the solid voxels of the clip into the world with the lowest corner of
+// its box at position. Chunks are split among the workers of jobs. If history
+// is not null it has to be recording and the changes go into its transaction.
+//
+// Returns false if nothing was pasted, otherwise out_region is the box of the
+// voxels pasted.
+bool voxel_clip_paste(
+    voxel_world* world,
+    const voxel_clip& clip,
+    const int3& position,
+    job_system* jobs,
+    voxel_history* history,
+    bounds3i* out_region);
+
+// Paste the part of the clip at position that falls into chunk, leaving out
+// voxels at or beyond resolution. out_rows gets the voxels pasted by row, bit
+// x of row y + z * voxel_chunk_size, unless it is null.
+void voxel_clip_paste_chunk(
+    voxel_chunk* chunk,
+    const voxel_clip& clip,
+    const int3& position,
+    i32 resolution,
+    u32* out_rows);
+
+// Solid voxels of the clip at position in the row at y, z of the world from
+// x on, bit i for voxel x + i.
+u32 voxel_clip_row(const voxel_clip& clip, const int3& position, i32 x, i32 y, i32 z);
+}
@@ -0,0 +1,669 @@
+#include "voxel/voxel_components.h"
+
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+namespace vx
+{
+namespace
+{
+constexpr int chunk_rows = voxel_chunk_size * voxel_chunk_size;
+
+const bounds3i empty_bounds{int3{INT32_MAX}, int3{INT32_MIN}};
+
+bool chunk_in_world(const voxel_world* world, const int3& chunk_coords)
+{
+    const i32 chunks = (world->resolution + voxel_chunk_mask) >> voxel_chunk_size_log2;
+    return glm::all(glm::greaterThanEqual(chunk_coords, int3{0})) &&
+           glm::all(glm::lessThan(chunk_coords, int3{chunks}));
+}
+
+// palette index of leaf in chunk, 0 if it has none
+u32 palette_find(const voxel_chunk* chunk, const voxel_leaf& leaf)
+{
+    for (u32 i = 1; i < chunk->palette_count; i++)
+        if (voxel_leaf_equal(chunk->palette[i], leaf))
+            return i;
+    return 0;
+}
+
+// voxels of a row with palette index, bit x for voxel x
+u32 row_index_mask(const voxel_chunk* chunk, i32 row, u32 index)
+{
+    u32 indices[voxel_chunk_size];
+    voxel_chunk_row_indices(chunk, row, indices);
+    u32 mask = 0;
+    for (i32 x = 0; x < voxel_chunk_size; x++)
+        mask |= u32(indices[x] == index) << x;
+    return mask;
+}
+
+// rows of a chunk reached by voxel_flood_select
+struct flood_chunk
+{
+    // voxels that match the seed, and those reached but not spread yet
+    u32 match[chunk_rows];
+    u32 pending[chunk_rows];
+
+    // the chunks around it by (dx + 1) + (dy + 1) * 3 + (dz + 1) * 9, -1 if
+    // nothing in them matches, -2 until looked up
+    i32 neighbors[27];
+};
+
+struct flood_row
+{
+    i32 chunk;
+    i32 row;
+};
+
+struct flood
+{
+    const voxel_world* world;
+    voxel_leaf leaf;
+    voxel_match match;
+
+    // chunk indices by key, -1 for chunks without solid voxels
+    std::unordered_map<u64, i32> indices;
+    array<flood_chunk> chunks;
+    array<flood_row> stack;
+
+    voxel_region* region;
+};
+
+// index of the chunk in region, added on first use, -1 if nothing in it matches
+i32 flood_chunk_index(flood* f, const int3& chunk_coords)
+{
+    const u64 key = voxel_chunk_key(chunk_coords);
+    auto it = f->indices.find(key);
+    if (it != f->indices.end())
+        return it->second;
+
+    const voxel_chunk* chunk = chunk_in_world(f->world, chunk_coords)
+                                   ? voxel_world_find_chunk(f->world, chunk_coords)
+                                   : nullptr;
+    const u32 index = chunk && f->match == voxel_match_color ? palette_find(chunk, f->leaf) : 0;
+    if (!chunk || (f->match == voxel_match_color && !index))
+    {
+        f->indices[key] = -1;
+        return -1;
+    }
+
+    const i32 c = f->chunks.size();
+    f->indices[key] = c;
+    f->region->chunk_coords.add(chunk_coords);
+    f->region->rows.resize((c + 1) * chunk_rows);
+
+    flood_chunk& fc = f->chunks.add();
+    std::memset(fc.pending, 0, sizeof fc.pending);
+    for (i32& n : fc.neighbors)
+        n = -2;
+    for (i32 row = 0; row < chunk_rows; row++)
+    {
+        const u32 solid = voxel_chunk_solid_row(chunk, row);
+        fc.match[row] = solid && index ? solid & row_index_mask(chunk, row, index) : solid;
+    }
+    return c;
+}
+
+// queue seeds of a row for spreading, dy and dz may step into the next chunks
+void flood_push(flood* f, i32 c, i32 dx, i32 y, i32 z, u32 seeds)
+{
+    const int3 step{dx, y >> voxel_chunk_size_log2, z >> voxel_chunk_size_log2};
+    if (step != int3{0})
+    {
+        const int n = (step.x + 1) + (step.y + 1) * 3 + (step.z + 1) * 9;
+        if (f->chunks[c].neighbors[n] == -2)
+        {
+            const i32 neighbor = flood_chunk_index(f, f->region->chunk_coords[c] + step);
+            f->chunks[c].neighbors[n] = neighbor;
+        }
+        c = f->chunks[c].neighbors[n];
+    }
+    if (c < 0)
+        return;
+
+    const i32 row = (y & voxel_chunk_mask) + (z & voxel_chunk_mask) * voxel_chunk_size;
+    flood_chunk& fc = f->chunks[c];
+    seeds &= fc.match[row] & ~f->region->rows[c * chunk_rows + row];
+    if (!seeds)
+        return;
+    if (!fc.pending[row])
+        f->stack.add(flood_row{c, row});
+    fc.pending[row] |= seeds;
+}
+
+// matching voxels x_first to x_last of a row of a chunk
+struct label_run
+{
+    u16 row;
+    u8 x_first;
+    u8 x_last;
+    // palette index with voxel_match_color, 0 otherwise
+    u32 entry;
+};
+
+struct label_chunk
+{
+    const voxel_chunk* chunk;
+    int3 coords;
+
+    // sorted by row and x, those of row r from row_starts[r] to row_starts[r + 1]
+    array<label_run> runs;
+    u32 row_starts[chunk_rows + 1];
+    // union-find index of the first run
+    u32 first;
+
+    // the chunks around it by (dx + 1) + (dy + 1) * 3 + (dz + 1) * 9, or -1
+    i32 neighbors[27];
+};
+
+struct label_context
+{
+    voxel_connectivity connectivity;
+    voxel_match match;
+    array<label_chunk> chunks;
+    std::atomic<u32>* parent;
+};
+
+struct label_job
+{
+    label_context* ctx;
+    i32 chunk;
+};
+
+// Lock-free union-find. Roots are always linked below the root with the
+// lower index, which keeps the links free of cycles whatever order the
+// workers get to them in, and makes the root of a set its lowest index.
+u32 find_root(std::atomic<u32>* parent, u32 i)
+{
+    for (;;)
+    {
+        u32 p = parent[i].load(std::memory_order_relaxed);
+        if (p == i)
+            return i;
+        const u32 up = parent[p].load(std::memory_order_relaxed);
+        // path halving, losing the race only means a longer path
+        if (up != p)
+            parent[i].compare_exchange_weak(p, up, std::memory_order_relaxed);
+        i = up;
+    }
+}
+
+void unite(std::atomic<u32>* parent, u32 a, u32 b)
+{
+    for (;;)
+    {
+        a = find_root(parent, a);
+        b = find_root(parent, b);
+        if (a == b)
+            return;
+        if (a < b)
+            std::swap(a, b);
+        u32 expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, std::memory_order_relaxed))
+            return;
+    }
+}
+
+void label_runs(void* data)
+{
+    const label_job* job = (const label_job*)data;
+    label_chunk& lc = job->ctx->chunks[job->chunk];
+    const bool color = job->ctx->match == voxel_match_color;
+
+    u32 indices[voxel_chunk_size];
+    for (i32 row = 0; row < chunk_rows; row++)
+    {
+        lc.row_starts[row] = lc.runs.size();
+        u32 solid = voxel_chunk_solid_row(lc.chunk, row);
+        if (solid && color)
+            voxel_chunk_row_indices(lc.chunk, row, indices);
+
+        while (solid)
+        {
+            const i32 x = glm::findLSB(solid);
+            const u32 rest = ~(solid >> x);
+            i32 last = (rest ? glm::findLSB(rest) : voxel_chunk_size - x) + x - 1;
+            u32 entry = 0;
+            if (color)
+            {
+                // split at every change of leaf
+                entry = indices[x];
+                for (i32 i = x + 1; i <= last; i++)
+                    if (indices[i] != entry)
+                    {
+                        last = i - 1;
+                        break;
+                    }
+            }
+
+            lc.runs.add(label_run{u16(row), u8(x), u8(last), entry});
+            solid &= last + 1 < voxel_chunk_size ? ~0u << (last + 1) : 0u;
+        }
+    }
+    lc.row_starts[chunk_rows] = lc.runs.size();
+}
+
+// join run a of chunk lc with the runs of row of chunk t within x_first to x_last
+void join_row(
+    const label_context* ctx,
+    const label_chunk& lc,
+    const label_run& a,
+    u32 a_index,
+    i32 t,
+    i32 row,
+    i32 x_first,
+    i32 x_last)
+{
+    const label_chunk& tc = ctx->chunks[t];
+    const bool same_chunk = &tc == &lc;
+    const label_run* runs = tc.runs.ptr();
+    const label_run* end = runs + tc.row_starts[row + 1];
+    const label_run* b = std::lower_bound(
+        runs + tc.row_starts[row], end, x_first, [](const label_run& r, i32 x) {
+            return r.x_last < x;
+        });
+    for (; b != end && b->x_first <= x_last; b++)
+    {
+        bool match = b->entry == a.entry;
+        if (!same_chunk && ctx->match == voxel_match_color)
+            match = voxel_leaf_equal(lc.chunk->palette[a.entry], tc.chunk->palette[b->entry]);
+        if (match)
+            unite(ctx->parent, a_index, tc.first + u32(b - runs));
+    }
+}
+
+// Join every run of a chunk with the runs it touches that come after it in
+// z, y, x order, within the chunk or in the chunks after it. Each pair of
+// neighboring voxels is looked at once.
+void label_join(void* data)
+{
+    const label_job* job = (const label_job*)data;
+    const label_context* ctx = job->ctx;
+    const label_chunk& lc = ctx->chunks[job->chunk];
+
+    // The neighbors after a voxel are the next voxel of its row and those of
+    // the rows after it, y + 1 and z + 1 for 6 connectivity, all rows around
+    // it with a higher z or the same z and a higher y otherwise. Diagonal
+    // neighbors widen the run by a voxel either way.
+    const bool diagonal = ctx->connectivity == voxel_connectivity_26;
+    const int2 row_steps[] = {{1, 0}, {0, 1}, {-1, 1}, {1, 1}};
+    const int row_step_count = diagonal ? 4 : 2;
+    const i32 widen = diagonal ? 1 : 0;
+
+    for (int i = 0; i < lc.runs.size(); i++)
+    {
+        const label_run& a = lc.runs[i];
+        const u32 a_index = lc.first + i;
+        const i32 y = a.row & voxel_chunk_mask;
+        const i32 z = a.row >> voxel_chunk_size_log2;
+
+        // the voxel after the row, in the next chunk along x
+        const i32 next_x = lc.neighbors[2 + 3 + 9];
+        if (a.x_last == voxel_chunk_mask && next_x >= 0)
+            join_row(ctx, lc, a, a_index, next_x, a.row, 0, 0);
+
+        for (int s = 0; s < row_step_count; s++)
+        {
+            const i32 ny = y + row_steps[s].x;
+            const i32 nz = z + row_steps[s].y;
+            const i32 cy = ny < 0 ? -1 : ny >> voxel_chunk_size_log2;
+            const i32 cz = nz >> voxel_chunk_size_log2;
+            const i32 row = (ny & voxel_chunk_mask) + (nz & voxel_chunk_mask) * voxel_chunk_size;
+            const i32* neighbors = &lc.neighbors[(cy + 1) * 3 + (cz + 1) * 9];
+
+            const i32 x_first = a.x_first - widen;
+            const i32 x_last = a.x_last + widen;
+            if (neighbors[1] >= 0)
+                join_row(
+                    ctx,
+                    lc,
+                    a,
+                    a_index,
+                    neighbors[1],
+                    row,
+                    std::max(x_first, 0),
+                    std::min(x_last, voxel_chunk_mask));
+            if (x_first < 0 && neighbors[0] >= 0)
+                join_row(
+                    ctx,
+                    lc,
+                    a,
+                    a_index,
+                    neighbors[0],
+                    row,
+                    voxel_chunk_mask,
+                    voxel_chunk_mask);
+            if (x_last > voxel_chunk_mask && neighbors[2] >= 0)
+                join_row(ctx, lc, a, a_index, neighbors[2], row, 0, 0);
+        }
+    }
+}
+
+bool coords_before(const int3& a, const int3& b)
+{
+    if (a.z != b.z)
+        return a.z < b.z;
+    if (a.y != b.y)
+        return a.y < b.y;
+    return a.x < b.x;
+}
+
+void region_clear(voxel_region* region)
+{
+    region->chunk_coords.clear();
+    region->rows.clear();
+    region->voxel_count = 0;
+    region->bounds = empty_bounds;
+}
+
+// count the voxels of the region and drop the chunks without any
+void region_finish(voxel_region* region)
+{
+    int kept = 0;
+    for (int c = 0; c < region->chunk_coords.size(); c++)
+    {
+        const u32* rows = &region->rows[c * chunk_rows];
+        const int3 base = region->chunk_coords[c] * voxel_chunk_size;
+        u64 count = 0;
+        for (i32 row = 0; row < chunk_rows; row++)
+        {
+            if (!rows[row])
+                continue;
+            const int3 p = base + int3{0, row & voxel_chunk_mask, row >> voxel_chunk_size_log2};
+            count += glm::bitCount(rows[row]);
+            region->bounds.min = glm::min(
+                region->bounds.min,
+                p + int3{glm::findLSB(rows[row]), 0, 0});
+            region->bounds.max = glm::max(
+                region->bounds.max,
+                p + int3{glm::findMSB(rows[row]), 0, 0});
+        }
+        if (!count)
+            continue;
+
+        region->voxel_count += count;
+        if (kept != c)
+        {
+            region->chunk_coords[kept] = region->chunk_coords[c];
+            std::memcpy(&region->rows[kept * chunk_rows], rows, chunk_rows * sizeof(u32));
+        }
+        kept++;
+    }
+    region->chunk_coords.resize(kept);
+    region->rows.resize(kept * chunk_rows);
+}
+}
+
+bool voxel_flood_select(
+    voxel_region* out,
+    const voxel_world* world,
+    const int3& seed,
+    voxel_connectivity connectivity,
+    voxel_match match)
+{
+    region_clear(out);
+    const bool in_world = glm::all(glm::greaterThanEqual(seed, int3{0})) &&
+                          glm::all(glm::lessThan(seed, int3{world->resolution}));
+    if (!in_world || !(voxel_world_get(world, seed).flags & voxel_flag_solid))
+        return false;
+
+    flood f;
+    f.world = world;
+    f.leaf = voxel_world_get(world, seed);
+    f.match = match;
+    f.region = out;
+
+    const int3 local = voxel_chunk_local(seed);
+    const i32 c = flood_chunk_index(&f, voxel_chunk_coords(seed));
+    flood_push(&f, c, 0, local.y, local.z, 1u << local.x);
+
+    const bool diagonal = connectivity == voxel_connectivity_26;
+    while (f.stack.size())
+    {
+        const flood_row next = f.stack[f.stack.size() - 1];
+        f.stack.resize(f.stack.size() - 1);
+
+        flood_chunk& fc = f.chunks[next.chunk];
+        u32& visited = out->rows[next.chunk * chunk_rows + next.row];
+        const u32 free = fc.match[next.row] & ~visited;
+        const u32 reached = voxel_row_fill_runs(fc.pending[next.row] & free, free);
+        fc.pending[next.row] = 0;
+        if (!reached)
+            continue;
+        visited |= reached;
+
+        // Reached voxels seed the rows next to theirs, shifted a voxel either
+        // way for diagonal neighbors. Voxels at the ends of the row seed the
+        // rows of the chunks before and after along x.
+        const i32 y = next.row & voxel_chunk_mask;
+        const i32 z = next.row >> voxel_chunk_size_log2;
+        const u32 spread = diagonal ? reached | (reached << 1) | (reached >> 1) : reached;
+        for (i32 dz = -1; dz <= 1; dz++)
+            for (i32 dy = -1; dy <= 1; dy++)
+            {
+                const bool face = dy == 0 || dz == 0;
+                if (!diagonal && !face)
+                    continue;
+                if (dy != 0 || dz != 0)
+                    flood_push(&f, next.chunk, 0, y + dy, z + dz, spread);
+                if (!diagonal && (dy != 0 || dz != 0))
+                    continue;
+                if (reached >> voxel_chunk_mask)
+                    flood_push(&f, next.chunk, 1, y + dy, z + dz, 1u);
+                if (reached & 1u)
+                    flood_push(&f, next.chunk, -1, y + dy, z + dz, 1u << voxel_chunk_mask);
+            }
+    }
+
+    region_finish(out);
+    return true;
+}
+
+bool voxel_region_fill(
+    voxel_world* world,
+    const voxel_region& region,
+    const voxel_leaf& leaf,
+    voxel_history* history)
+{
+    const bool record = history && !history->recording_overflowed;
+    const bool solid = (leaf.flags & voxel_flag_solid) != 0;
+    voxel_chunk before = {};
+    array<voxel_history_run> runs;
+    u32 changed[chunk_rows];
+    bool any = false;
+
+    for (int c = 0; c < region.chunk_coords.size(); c++)
+    {
+        const int3& cc = region.chunk_coords[c];
+        if (!solid && !voxel_world_find_chunk(world, cc))
+            continue;
+        voxel_chunk* chunk = voxel_world_touch_chunk(world, cc);
+        if (record)
+            voxel_chunk_copy(&before, chunk);
+
+        // voxels that already have the leaf stay as they are
+        const bool had_leaf = solid && palette_find(chunk, leaf);
+        const u32 index = solid ? voxel_chunk_palette_add(chunk, leaf) : 0;
+        const u32* rows = &region.rows[c * chunk_rows];
+        for (i32 row = 0; row < chunk_rows; row++)
+        {
+            u32 target = rows[row];
+            if (target && !solid)
+                target &= voxel_chunk_solid_row(chunk, row);
+            else if (target && had_leaf)
+                target &= ~row_index_mask(chunk, row, index);
+
+            changed[row] = target;
+            any = any || target;
+            while (target)
+            {
+                const i32 x = glm::findLSB(target);
+                const u32 rest = ~(target >> x);
+                const i32 count = rest ? glm::findLSB(rest) : voxel_chunk_size - x;
+                voxel_chunk_set_run(chunk, x + row * voxel_chunk_size, count, index);
+                target &= x + count < voxel_chunk_size ? ~0u << (x + count) : 0u;
+            }
+        }
+
+        if (record)
+        {
+            voxel_history_chunk_runs(&runs, &before, chunk, changed);
+            voxel_history_record_chunk(history, &before, chunk, runs);
+        }
+
+        // setting an empty voxel in an empty chunk releases it
+        if (!chunk->solid_count)
+            voxel_world_set(world, cc * voxel_chunk_size, voxel_leaf{});
+    }
+
+    if (record)
+        voxel_chunk_free_copy(&before);
+    return any;
+}
+
+void voxel_components_label(
+    voxel_components* out,
+    const voxel_world* world,
+    voxel_connectivity connectivity,
+    voxel_match match,
+    job_system* jobs)
+{
+    out->components.clear();
+    out->chunk_coords.clear();
+    out->run_offsets.clear();
+    out->runs.clear();
+
+    label_context ctx;
+    ctx.connectivity = connectivity;
+    ctx.match = match;
+
+    // Chunks are looked up up front, looking one up may decode it, which is
+    // not safe to do from the workers.
+    voxel_world_chunk_coords(world, &out->chunk_coords);
+    std::sort(
+        out->chunk_coords.ptr(),
+        out->chunk_coords.ptr() + out->chunk_coords.size(),
+        coords_before);
+    std::unordered_map<u64, i32> indices;
+    ctx.chunks.resize(out->chunk_coords.size());
+    for (int c = 0; c < out->chunk_coords.size(); c++)
+    {
+        ctx.chunks[c].coords = out->chunk_coords[c];
+        ctx.chunks[c].chunk = voxel_world_find_chunk(world, out->chunk_coords[c]);
+        indices[voxel_chunk_key(out->chunk_coords[c])] = c;
+    }
+    for (int c = 0; c < ctx.chunks.size(); c++)
+        for (int i = 0; i < 27; i++)
+        {
+            const int3 step{i % 3 - 1, i / 3 % 3 - 1, i / 9 - 1};
+            const auto it = indices.find(voxel_chunk_key(ctx.chunks[c].coords + step));
+            ctx.chunks[c].neighbors[i] = it != indices.end() ? it->second : -1;
+        }
+
+    array<label_job> job_data(ctx.chunks.size());
+    for (int c = 0; c < ctx.chunks.size(); c++)
+    {
+        job_data[c] = label_job{&ctx, c};
+        job_system_submit(jobs, label_runs, &job_data[c]);
+    }
+    job_system_wait(jobs);
+
+    u32 run_count = 0;
+    for (int c = 0; c < ctx.chunks.size(); c++)
+    {
+        ctx.chunks[c].first = run_count;
+        run_count += ctx.chunks[c].runs.size();
+    }
+    ctx.parent = new std::atomic<u32>[run_count];
+    for (u32 i = 0; i < run_count; i++)
+        ctx.parent[i].store(i, std::memory_order_relaxed);
+
+    for (int c = 0; c < ctx.chunks.size(); c++)
+        job_system_submit(jobs, label_join, &job_data[c]);
+    job_system_wait(jobs);
+
+    // roots are the lowest index of their set, so they come up first
+    out->runs.resize(run_count);
+    out->run_offsets.resize(ctx.chunks.size() + 1);
+    for (int c = 0; c < ctx.chunks.size(); c++)
+    {
+        const label_chunk& lc = ctx.chunks[c];
+        const int3 base = lc.coords * voxel_chunk_size;
+        out->run_offsets[c] = lc.first;
+        for (int i = 0; i < lc.runs.size(); i++)
+        {
+            const label_run& r = lc.runs[i];
+            const u32 index = lc.first + i;
+            const u32 root = find_root(ctx.parent, index);
+            const u32 component =
+                root == index ? out->components.size() : out->runs[root].component;
+            if (root == index)
+                out->components.add(voxel_component{0, empty_bounds, false});
+            out->runs[index] = voxel_component_run{r.row, r.x_first, r.x_last, component};
+
+            voxel_component& comp = out->components[component];
+            const int3 first =
+                base + int3{r.x_first, r.row & voxel_chunk_mask, r.row >> voxel_chunk_size_log2};
+            comp.voxel_count += r.x_last - r.x_first + 1;
+            comp.bounds.min = glm::min(comp.bounds.min, first);
+            comp.bounds.max = glm::max(comp.bounds.max, first + int3{r.x_last - r.x_first, 0, 0});
+            comp.grounded = comp.grounded || first.y == 0;
+        }
+    }
+    out->run_offsets[ctx.chunks.size()] = run_count;
+
+    delete[] ctx.parent;
+}
+
+i32 voxel_components_find(const voxel_components& components, const int3& p)
+{
+    const int3 cc = voxel_chunk_coords(p);
+    const int3* coords = components.chunk_coords.ptr();
+    const int3* end = coords + components.chunk_coords.size();
+    const int3* it = std::lower_bound(coords, end, cc, coords_before);
+    if (it == end || *it != cc)
+        return -1;
+
+    const int c = (int)(it - coords);
+    // the first run of the row that does not end before p
+    const int3 local = voxel_chunk_local(p);
+    const u32 row = u32(local.y + local.z * voxel_chunk_size);
+    const u32 key = row * voxel_chunk_size + u32(local.x);
+    const voxel_component_run* runs = components.runs.ptr();
+    const voxel_component_run* first = runs + components.run_offsets[c];
+    const voxel_component_run* last = runs + components.run_offsets[c + 1];
+    const voxel_component_run* run =
+        std::lower_bound(first, last, key, [](const voxel_component_run& r, u32 k) {
+            return r.row * u32(voxel_chunk_size) + r.x_last < k;
+        });
+    if (run == last || run->row != row || run->x_first > local.x)
+        return -1;
+    return (i32)run->component;
+}
+
+void voxel_components_floating(voxel_region* out, const voxel_components& components)
+{
+    region_clear(out);
+    for (int c = 0; c < components.chunk_coords.size(); c++)
+    {
+        bool added = false;
+        for (u32 i = components.run_offsets[c]; i < components.run_offsets[c + 1]; i++)
+        {
+            const voxel_component_run& r = components.runs[i];
+            if (components.components[r.component].grounded)
+                continue;
+            if (!added)
+            {
+                out->chunk_coords.add(components.chunk_coords[c]);
+                out->rows.resize(out->chunk_coords.size() * chunk_rows);
+                added = true;
+            }
+            const u32 bits = (~0u >> (voxel_chunk_mask - r.x_last)) & (~0u << r.x_first);
+            out->rows[(out->chunk_coords.size() - 1) * chunk_rows + r.row] |= bits;
+        }
+    }
+    region_finish(out);
+}
+}
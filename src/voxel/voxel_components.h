@@ -0,0 +1,105 @@
+#pragma once
+
+#include "common/job_system.h"
+#include "voxel/voxel_history.h"
+
+namespace vx
+{
+enum voxel_connectivity
+{
+    // voxels sharing a face
+    voxel_connectivity_6,
+    // voxels sharing a face, an edge or a corner
+    voxel_connectivity_26,
+    voxel_connectivity_count,
+};
+
+enum voxel_match
+{
+    // any solid voxel connects to any other
+    voxel_match_solid,
+    // solid voxels only connect to ones with the same leaf
+    voxel_match_color,
+    voxel_match_count,
+};
+
+// A set of voxels as row masks of the chunks they are in, bit x of row
+// y + z * voxel_chunk_size for local voxel x, y, z.
+struct voxel_region
+{
+    array<int3> chunk_coords;
+    // voxel_chunk_size^2 rows per chunk, in the order of chunk_coords
+    array<u32> rows;
+
+    u64 voxel_count;
+    // inclusive box of the voxels
+    bounds3i bounds;
+};
+
+// Select the solid voxels connected to seed, going through voxels that match
+// it. The region is spread a row of 32 voxels at a time, visiting only the
+// chunks it reaches. Returns false if seed is not solid.
+bool voxel_flood_select(
+    voxel_region* out,
+    const voxel_world* world,
+    const int3& seed,
+    voxel_connectivity connectivity,
+    voxel_match match);
+
+// Set every voxel of the region to leaf, an empty leaf deletes them. If
+// history is not null it has to be recording and the changes go into its
+// transaction. Returns false if no voxel changed.
+bool voxel_region_fill(
+    voxel_world* world,
+    const voxel_region& region,
+    const voxel_leaf& leaf,
+    voxel_history* history);
+
+struct voxel_component
+{
+    u64 voxel_count;
+    // inclusive box of the voxels
+    bounds3i bounds;
+    // has a voxel on the ground plane y = 0, components without one float
+    bool grounded;
+};
+
+// run of voxels x_first to x_last in a row of a chunk, see voxel_region
+struct voxel_component_run
+{
+    u16 row;
+    u8 x_first;
+    u8 x_last;
+    u32 component;
+};
+
+// The connected components of the solid voxels of a world.
+struct voxel_components
+{
+    array<voxel_component> components;
+
+    // the chunks with solid voxels sorted by z, y and x, and their runs sorted
+    // by row and x, those of chunk i from run_offsets[i] to run_offsets[i + 1]
+    array<int3> chunk_coords;
+    array<u32> run_offsets;
+    array<voxel_component_run> runs;
+};
+
+// Label the connected components of the world. Each chunk is split into runs
+// of matching voxels by one of the workers of jobs, which then joins them with
+// the touching runs of its own chunk and of the chunks after it through a
+// lock-free union-find. Components are numbered in the order of their first
+// run.
+void voxel_components_label(
+    voxel_components* out,
+    const voxel_world* world,
+    voxel_connectivity connectivity,
+    voxel_match match,
+    job_system* jobs);
+
+// component of the voxel at p, -1 for empty voxels
+i32 voxel_components_find(const voxel_components& components, const int3& p);
+
+// the voxels of the components that are not grounded
+void voxel_components_floating(voxel_region* out, const voxel_components& components);
+}
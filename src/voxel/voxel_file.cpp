@@ -0,0 +1,623 @@
+#include "voxel/voxel_file.h"
+
+#include <cstring>
+
+namespace vx
+{
+namespace
+{
+static_assert(sizeof(voxel_leaf) == 16, "Palette hashing and file layout assume a 16 byte leaf");
+static_assert(voxel_chunk_volume <= 65536, "Run lengths and palette indices must fit 16 bits");
+
+// Legacy files are raw dumps of the structs of the time. Their layouts are
+// pinned here, so they stay readable when the structs change.
+struct legacy_leaf
+{
+    float color[3];
+    u32 flags;
+};
+
+constexpr i32 legacy_grid_size = 16;
+constexpr usize legacy_grid_bytes =
+    legacy_grid_size * legacy_grid_size * legacy_grid_size * sizeof(legacy_leaf);
+
+constexpr i32 legacy_chunk_size = 32;
+struct legacy_chunk
+{
+    i32 coords[3];
+    u32 solid_count;
+    legacy_leaf voxels[legacy_chunk_size * legacy_chunk_size * legacy_chunk_size];
+};
+
+struct palette
+{
+    array<voxel_leaf> leaves;
+
+    // open addressing over leaves, index + 1 or 0 for an empty slot
+    array<u16> slots;
+};
+
+void palette_insert_slot(palette* p, u16 index)
+{
+    u32 mask = (u32)p->slots.size() - 1;
+    u32 i = voxel_leaf_hash(p->leaves[index]) & mask;
+    while (p->slots[i])
+        i = (i + 1) & mask;
+    p->slots[i] = index + 1;
+}
+
+u16 palette_index(palette* p, const voxel_leaf& leaf)
+{
+    // keep the table at most half full
+    if (2 * (p->leaves.size() + 1) > p->slots.size())
+    {
+        int size = std::max(64, 2 * p->slots.size());
+        p->slots.resize(0);
+        p->slots.resize(size);
+        for (int i = 0; i < p->leaves.size(); i++)
+            palette_insert_slot(p, (u16)i);
+    }
+
+    u32 mask = (u32)p->slots.size() - 1;
+    u32 i = voxel_leaf_hash(leaf) & mask;
+    while (u16 slot = p->slots[i])
+    {
+        if (voxel_leaf_equal(p->leaves[slot - 1], leaf))
+            return slot - 1;
+        i = (i + 1) & mask;
+    }
+
+    p->leaves.add(leaf);
+    p->slots[i] = (u16)p->leaves.size();
+    return (u16)(p->leaves.size() - 1);
+}
+
+void put(array<u8>* out, const void* src, usize size)
+{
+    int at = out->size();
+    out->resize(at + (int)size);
+    std::memcpy(out->ptr() + at, src, size);
+}
+
+template<typename T>
+bool get(const u8** p, const u8* end, T* out)
+{
+    if ((usize)(end - *p) < sizeof(T))
+        return false;
+    std::memcpy(out, *p, sizeof(T));
+    *p += sizeof(T);
+    return true;
+}
+
+// True if chunk coords of chunk_size voxels lie within resolution. Checked
+// before scaling them to voxels, which could overflow otherwise.
+bool chunk_coords_valid(const i32 coords[3], i32 chunk_size, i32 resolution)
+{
+    const i32 chunk_count = (resolution + chunk_size - 1) / chunk_size;
+    for (int i = 0; i < 3; i++)
+        if (coords[i] < 0 || coords[i] >= chunk_count)
+            return false;
+    return true;
+}
+
+// takes over the mapping, null if it does not hold a valid scene file
+voxel_file_source* source_create(mapped_file* file)
+{
+    voxel_file_source* source = new voxel_file_source;
+    source->file = *file;
+    source->ref_count = 1;
+    *file = mapped_file{};
+
+    if (!voxel_file_parse(&source->view, source->file.data, source->file.size))
+    {
+        voxel_file_source_release(source);
+        return nullptr;
+    }
+    return source;
+}
+
+// queue the chunks of source for decoding on first access
+void load_encoded(voxel_world* world, voxel_file_source* source)
+{
+    voxel_world_clear(world);
+    voxel_world_resize(world, source->view.header->resolution);
+
+    for (u32 i = 0; i < source->view.header->chunk_count; i++)
+    {
+        const voxel_file_chunk_entry& entry = source->view.chunks[i];
+        if (!chunk_coords_valid(entry.coords, voxel_chunk_size, world->resolution))
+            continue;
+        int3 coords{entry.coords[0], entry.coords[1], entry.coords[2]};
+        world->encoded_chunks[voxel_chunk_key(coords)] = i;
+    }
+
+    if (!world->encoded_chunks.empty())
+    {
+        voxel_file_source_retain(source);
+        world->source = source;
+    }
+}
+
+bool load_legacy(voxel_world* world, const u8* data, usize size)
+{
+    if (size == legacy_grid_bytes)
+    {
+        const legacy_leaf* leaves = (const legacy_leaf*)data;
+
+        voxel_world_clear(world);
+        voxel_world_resize(world, legacy_grid_size);
+
+        for (int z = 0; z < legacy_grid_size; z++)
+            for (int y = 0; y < legacy_grid_size; y++)
+                for (int x = 0; x < legacy_grid_size; x++)
+                {
+                    const legacy_leaf& l =
+                        leaves[x + y * legacy_grid_size + z * legacy_grid_size * legacy_grid_size];
+                    if (!(l.flags & voxel_flag_solid))
+                        continue;
+
+                    voxel_leaf leaf;
+                    leaf.color = float3{l.color[0], l.color[1], l.color[2]};
+                    leaf.flags = l.flags;
+                    voxel_world_set(world, int3{x, y, z}, leaf);
+                }
+        return true;
+    }
+
+    i32 resolution;
+    u32 chunk_count;
+    const u8* p = data;
+    if (!get(&p, data + size, &resolution) || !get(&p, data + size, &chunk_count) ||
+        resolution <= 0 || resolution > voxel_world_max_resolution ||
+        size != 8 + (u64)chunk_count * sizeof(legacy_chunk))
+        return false;
+
+    const legacy_chunk* chunks = (const legacy_chunk*)p;
+    for (u32 i = 0; i < chunk_count; i++)
+        if (!chunk_coords_valid(chunks[i].coords, legacy_chunk_size, resolution))
+            return false;
+
+    voxel_world_clear(world);
+    voxel_world_resize(world, resolution);
+
+    for (u32 i = 0; i < chunk_count; i++)
+    {
+        const legacy_chunk* lc = &chunks[i];
+        int3 base = int3{lc->coords[0], lc->coords[1], lc->coords[2]} * legacy_chunk_size;
+        if (!lc->solid_count)
+            continue;
+
+        for (int z = 0; z < legacy_chunk_size; z++)
+            for (int y = 0; y < legacy_chunk_size; y++)
+                for (int x = 0; x < legacy_chunk_size; x++)
+                {
+                    const legacy_leaf& l =
+                        lc->voxels[x + (y + z * legacy_chunk_size) * legacy_chunk_size];
+                    if (!(l.flags & voxel_flag_solid))
+                        continue;
+
+                    voxel_leaf leaf;
+                    leaf.color = float3{l.color[0], l.color[1], l.color[2]};
+                    leaf.flags = l.flags;
+                    voxel_world_set(world, base + int3{x, y, z}, leaf);
+                }
+    }
+    return true;
+}
+}
+
+void voxel_chunk_encode(const voxel_chunk* chunk, array<u8>* out_bytes)
+{
+    struct run
+    {
+        u16 length_minus_one;
+        u16 index;
+    };
+
+    palette p;
+    array<run> runs;
+
+    // Leaves of the chunk palette are distinct, so runs of equal
+    // indices are runs of equal leaves.
+    u32 prev = 0;
+    u32 row[voxel_chunk_size];
+    for (int i = 0; i < voxel_chunk_volume; i++)
+    {
+        if ((i & voxel_chunk_mask) == 0)
+            voxel_chunk_row_indices(chunk, i >> voxel_chunk_size_log2, row);
+        u32 index = row[i & voxel_chunk_mask];
+        if (i > 0 && index == prev)
+        {
+            runs[runs.size() - 1].length_minus_one++;
+            continue;
+        }
+
+        runs.add(run{0, palette_index(&p, chunk->palette[index])});
+        prev = index;
+    }
+
+    u16 palette_count = (u16)p.leaves.size();
+    put(out_bytes, &palette_count, sizeof palette_count);
+    for (int i = 0; i < p.leaves.size(); i++)
+    {
+        const voxel_leaf& leaf = p.leaves[i];
+        put(out_bytes, &leaf.color, sizeof leaf.color);
+        put(out_bytes, &leaf.flags, sizeof leaf.flags);
+    }
+
+    const bool wide = palette_count > 256;
+    for (int i = 0; i < runs.size(); i++)
+    {
+        put(out_bytes, &runs[i].length_minus_one, sizeof(u16));
+        if (wide)
+            put(out_bytes, &runs[i].index, sizeof(u16));
+        else
+            put(out_bytes, &runs[i].index, sizeof(u8));
+    }
+}
+
+bool voxel_chunk_decode(voxel_chunk* chunk, const u8* bytes, usize size)
+{
+    const u8* p = bytes;
+    const u8* end = bytes + size;
+
+    u16 palette_count;
+    if (!get(&p, end, &palette_count) || !palette_count ||
+        (usize)(end - p) < palette_count * sizeof(voxel_leaf))
+        return false;
+
+    // file palette index to chunk palette index
+    array<u32> indices(palette_count);
+    voxel_chunk_palette_reserve(chunk, palette_count);
+    for (int i = 0; i < palette_count; i++)
+    {
+        voxel_leaf leaf;
+        std::memcpy(&leaf.color, p, sizeof leaf.color);
+        std::memcpy(&leaf.flags, p + sizeof leaf.color, sizeof leaf.flags);
+        indices[i] = voxel_chunk_palette_add(chunk, leaf);
+        p += sizeof(voxel_leaf);
+    }
+
+    const bool wide = palette_count > 256;
+    i32 filled = 0;
+
+    while (filled < voxel_chunk_volume)
+    {
+        u16 length_minus_one;
+        u16 index = 0;
+        u8 narrow_index;
+        if (!get(&p, end, &length_minus_one))
+            return false;
+        if (wide ? !get(&p, end, &index) : !get(&p, end, &narrow_index))
+            return false;
+        if (!wide)
+            index = narrow_index;
+
+        i32 length = length_minus_one + 1;
+        if (index >= palette_count || length > voxel_chunk_volume - filled)
+            return false;
+
+        voxel_chunk_set_run(chunk, filled, length, indices[index]);
+        filled += length;
+    }
+
+    return p == end;
+}
+
+bool voxel_file_parse(voxel_file_view* view, const u8* data, usize size)
+{
+    if (size < sizeof(voxel_file_header))
+        return false;
+
+    const voxel_file_header* header = (const voxel_file_header*)data;
+    if (header->magic != voxel_file_magic)
+        return false;
+
+    if (header->version > voxel_file_version)
+    {
+        fprintf(stdout, "Scene file version %u is newer than this build\n", header->version);
+        return false;
+    }
+
+    if (header->chunk_size != voxel_chunk_size || header->resolution <= 0 ||
+        header->resolution > voxel_world_max_resolution)
+        return false;
+
+    u64 table_end =
+        sizeof(voxel_file_header) + (u64)header->chunk_count * sizeof(voxel_file_chunk_entry);
+    if (table_end > size)
+        return false;
+
+    const voxel_file_chunk_entry* chunks =
+        (const voxel_file_chunk_entry*)(data + sizeof(voxel_file_header));
+    for (u32 i = 0; i < header->chunk_count; i++)
+    {
+        if (chunks[i].offset < table_end || chunks[i].offset > size ||
+            chunks[i].size > size - chunks[i].offset ||
+            chunks[i].solid_count > voxel_chunk_volume ||
+            !chunk_coords_valid(chunks[i].coords, voxel_chunk_size, header->resolution))
+            return false;
+    }
+
+    view->data = data;
+    view->size = size;
+    view->header = header;
+    view->chunks = chunks;
+    return true;
+}
+
+bool voxel_file_read_chunk(const voxel_file_view* view, u32 index, voxel_chunk* chunk)
+{
+    assert(index < view->header->chunk_count);
+    const voxel_file_chunk_entry& entry = view->chunks[index];
+
+    chunk->coords = int3{entry.coords[0], entry.coords[1], entry.coords[2]};
+    return voxel_chunk_decode(chunk, view->data + entry.offset, entry.size) &&
+           chunk->solid_count == entry.solid_count;
+}
+
+void voxel_file_source_retain(voxel_file_source* source)
+{
+    source->ref_count++;
+}
+
+void voxel_file_source_release(voxel_file_source* source)
+{
+    if (--source->ref_count > 0)
+        return;
+    unmap_file(&source->file);
+    delete source;
+}
+
+void voxel_file_snapshot_take(voxel_file_snapshot* snapshot, const voxel_world* world)
+{
+    snapshot->resolution = world->resolution;
+    snapshot->source = world->source;
+    if (snapshot->source)
+        voxel_file_source_retain(snapshot->source);
+
+    snapshot->chunks.clear();
+    for (const auto& kv : world->chunks)
+    {
+        voxel_chunk* chunk = kv.second;
+        if (!chunk->solid_count)
+            continue;
+
+        voxel_chunk_retain(chunk);
+        snapshot->chunks.add(voxel_file_snapshot_chunk{kv.first, chunk, chunk->saved_index});
+    }
+    for (const auto& kv : world->encoded_chunks)
+        snapshot->chunks.add(voxel_file_snapshot_chunk{kv.first, nullptr, kv.second});
+
+    std::sort(
+        snapshot->chunks.ptr(),
+        snapshot->chunks.ptr() + snapshot->chunks.size(),
+        [](const voxel_file_snapshot_chunk& a, const voxel_file_snapshot_chunk& b) {
+            return a.key < b.key;
+        });
+}
+
+void voxel_file_snapshot_release(voxel_file_snapshot* snapshot)
+{
+    for (int i = 0; i < snapshot->chunks.size(); i++)
+    {
+        if (const voxel_chunk* chunk = snapshot->chunks[i].chunk)
+            voxel_chunk_release(const_cast<voxel_chunk*>(chunk));
+    }
+    snapshot->chunks.clear();
+
+    if (snapshot->source)
+        voxel_file_source_release(snapshot->source);
+    snapshot->source = nullptr;
+}
+
+bool voxel_file_write_snapshot(
+    const voxel_file_snapshot* snapshot,
+    const char* path,
+    std::atomic<u32>* chunks_written)
+{
+    char tmp_path[1024];
+    if (std::snprintf(tmp_path, sizeof tmp_path, "%s.tmp", path) >= (int)sizeof tmp_path)
+        return false;
+
+    FILE* f = std::fopen(tmp_path, "wb");
+    if (!f)
+    {
+        fprintf(stdout, "Could not open %s for writing\n", tmp_path);
+        return false;
+    }
+
+    const int count = snapshot->chunks.size();
+
+    voxel_file_header header{};
+    header.magic = voxel_file_magic;
+    header.version = voxel_file_version;
+    header.resolution = snapshot->resolution;
+    header.chunk_size = voxel_chunk_size;
+    header.chunk_count = (u32)count;
+
+    // Chunks are written as they are encoded, so only one of them is in
+    // memory at a time. The chunk table in front of them is written last,
+    // once their offsets are known.
+    array<voxel_file_chunk_entry> entries;
+    entries.resize(count);
+    std::memset(entries.ptr(), 0, entries.byte_size());
+
+    bool ok = std::fwrite(&header, sizeof header, 1, f) == 1;
+    if (count)
+        ok = ok && std::fwrite(entries.ptr(), entries.byte_size(), 1, f) == 1;
+
+    const voxel_file_view* view = snapshot->source ? &snapshot->source->view : nullptr;
+    u64 offset = sizeof header + entries.byte_size();
+    array<u8> encoded;
+
+    for (int i = 0; ok && i < count; i++)
+    {
+        const voxel_file_snapshot_chunk& saved = snapshot->chunks[i];
+        voxel_file_chunk_entry& entry = entries[i];
+        const u8* bytes;
+
+        if (saved.source_index != voxel_chunk_not_saved)
+        {
+            assert(view);
+            entry = view->chunks[saved.source_index];
+            bytes = view->data + entry.offset;
+        }
+        else
+        {
+            encoded.clear();
+            voxel_chunk_encode(saved.chunk, &encoded);
+            entry.coords[0] = saved.chunk->coords.x;
+            entry.coords[1] = saved.chunk->coords.y;
+            entry.coords[2] = saved.chunk->coords.z;
+            entry.solid_count = saved.chunk->solid_count;
+            entry.size = encoded.byte_size();
+            bytes = encoded.ptr();
+        }
+
+        entry.offset = offset;
+        offset += entry.size;
+        ok = std::fwrite(bytes, entry.size, 1, f) == 1;
+
+        if (chunks_written)
+            chunks_written->store(i + 1, std::memory_order_relaxed);
+    }
+
+    ok = ok && std::fseek(f, sizeof header, SEEK_SET) == 0;
+    if (count)
+        ok = ok && std::fwrite(entries.ptr(), entries.byte_size(), 1, f) == 1;
+    ok = std::fclose(f) == 0 && ok;
+    ok = ok && replace_file(tmp_path, path);
+
+    if (!ok)
+    {
+        fprintf(stdout, "Could not write %s\n", path);
+        std::remove(tmp_path);
+    }
+    return ok;
+}
+
+void voxel_file_snapshot_saved(
+    const voxel_file_snapshot* snapshot,
+    voxel_world* world,
+    const char* path)
+{
+    // Loading or clearing the world replaces its source, there is nothing
+    // left to match the written file up with then.
+    if (world->source != snapshot->source)
+        return;
+
+    auto find = [snapshot](u64 key) {
+        const voxel_file_snapshot_chunk* begin = snapshot->chunks.ptr();
+        const voxel_file_snapshot_chunk* end = begin + snapshot->chunks.size();
+        const voxel_file_snapshot_chunk* it = std::lower_bound(
+            begin, end, key, [](const voxel_file_snapshot_chunk& c, u64 k) { return c.key < k; });
+        return it != end && it->key == key ? (int)(it - begin) : -1;
+    };
+
+    // Encoded chunks are only ever dropped or decoded, all of those left
+    // were written from the snapshot. Check anyway, they cannot be decoded
+    // from the old source once the world switched over.
+    for (const auto& kv : world->encoded_chunks)
+    {
+        int i = find(kv.first);
+        if (i < 0 || snapshot->chunks[i].chunk || snapshot->chunks[i].source_index != kv.second)
+            return;
+    }
+
+    mapped_file file;
+    if (!map_file(path, &file))
+        return;
+    voxel_file_source* source = source_create(&file);
+    if (!source)
+        return;
+    if (source->view.header->chunk_count != (u32)snapshot->chunks.size())
+    {
+        voxel_file_source_release(source);
+        return;
+    }
+
+    for (auto& kv : world->encoded_chunks)
+        kv.second = (u32)find(kv.first);
+
+    // a chunk changed since the snapshot was copied, so only the snapshot
+    // still holds the chunk that was written
+    for (auto& kv : world->chunks)
+    {
+        int i = find(kv.first);
+        bool unchanged = i >= 0 && snapshot->chunks[i].chunk == kv.second;
+        kv.second->saved_index = unchanged ? (u32)i : voxel_chunk_not_saved;
+    }
+
+    if (world->source)
+        voxel_file_source_release(world->source);
+    world->source = source;
+}
+
+bool voxel_file_save(const voxel_world* world, const char* path)
+{
+    voxel_file_snapshot snapshot;
+    voxel_file_snapshot_take(&snapshot, world);
+    bool ok = voxel_file_write_snapshot(&snapshot, path, nullptr);
+    voxel_file_snapshot_release(&snapshot);
+    return ok;
+}
+
+bool voxel_file_load(voxel_world* world, const char* path)
+{
+    mapped_file file;
+    if (!map_file(path, &file))
+        return false;
+
+    u32 magic = 0;
+    if (file.size >= sizeof magic)
+        std::memcpy(&magic, file.data, sizeof magic);
+
+    // load into a world of its own, so a corrupt file does not lose the scene
+    voxel_world* loaded = voxel_world_create(1);
+    bool ok;
+    if (magic == voxel_file_magic)
+    {
+        voxel_file_source* source = source_create(&file);
+        ok = source != nullptr;
+        if (ok)
+        {
+            load_encoded(loaded, source);
+            voxel_file_source_release(source);
+        }
+    }
+    else
+    {
+        ok = load_legacy(loaded, file.data, file.size);
+        unmap_file(&file);
+    }
+
+    if (ok)
+        voxel_world_swap(world, loaded);
+    else
+        fprintf(stdout, "%s is not a valid scene file\n", path);
+
+    voxel_world_destroy(loaded);
+    return ok;
+}
+
+bool voxel_file_convert_legacy(const char* legacy_path, const char* path)
+{
+    mapped_file file;
+    if (!map_file(legacy_path, &file))
+    {
+        fprintf(stdout, "Could not read %s\n", legacy_path);
+        return false;
+    }
+
+    voxel_world* world = voxel_world_create(legacy_grid_size);
+    bool ok = load_legacy(world, file.data, file.size);
+    unmap_file(&file);
+    if (!ok)
+        fprintf(stdout, "%s is not a legacy scene file\n", legacy_path);
+
+    ok = ok && voxel_file_save(world, path);
+    voxel_world_destroy(world);
+    return ok;
+}
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+#include "common/array.h"
+#include "platform/filesystem.h"
+
+#include <atomic>
+
+namespace vx
+{
+// Scene file layout, all values little endian:
+//
+//   voxel_file_header
+//   voxel_file_chunk_entry[chunk_count]
+//   encoded chunks, at the offsets given by their entries
+//
+// Chunks are encoded on their own, so any of them can be decoded without
+// touching the others. An encoded chunk is a palette of the distinct voxels
+// in it followed by runs of palette indices in voxel_chunk_index order:
+//
+//   u16 palette_count
+//   palette_count x {f32 r, f32 g, f32 b, u32 flags}
+//   runs of {u16 length - 1, u8 index} or {u16 length - 1, u16 index} when
+//   palette_count is above 256, until the chunk is covered
+//
+// Empty voxels are stored as voxel_leaf{}, whatever color they had.
+constexpr u32 voxel_file_magic = 0x43535856; // "VXSC"
+constexpr u32 voxel_file_version = 1;
+
+struct voxel_file_header
+{
+    u32 magic;
+    u32 version;
+    i32 resolution;
+    u32 chunk_size;
+    u32 chunk_count;
+    u32 reserved;
+};
+
+struct voxel_file_chunk_entry
+{
+    i32 coords[3];
+    u32 solid_count;
+    u64 offset;
+    u64 size;
+};
+
+static_assert(sizeof(voxel_file_header) == 24, "Scene file header layout changed");
+static_assert(sizeof(voxel_file_chunk_entry) == 32, "Scene file chunk entry layout changed");
+
+// A scene file in memory, checked by voxel_file_parse. Points into the
+// bytes it was parsed from.
+struct voxel_file_view
+{
+    const u8* data;
+    usize size;
+    const voxel_file_header* header;
+    const voxel_file_chunk_entry* chunks;
+};
+
+// A mapped scene file that worlds decode chunks from on first access,
+// shared by reference count between a world and its copies.
+struct voxel_file_source
+{
+    mapped_file file;
+    voxel_file_view view;
+    i32 ref_count;
+};
+
+void voxel_file_source_retain(voxel_file_source* source);
+void voxel_file_source_release(voxel_file_source* source);
+
+void voxel_chunk_encode(const voxel_chunk* chunk, array<u8>* out_bytes);
+
+// into an empty chunk, false if the bytes do not cover exactly one chunk
+bool voxel_chunk_decode(voxel_chunk* chunk, const u8* bytes, usize size);
+
+// validates the header and the chunk table, not the chunks themselves
+bool voxel_file_parse(voxel_file_view* view, const u8* data, usize size);
+
+// decode the chunk of the given chunk table entry into an empty chunk
+bool voxel_file_read_chunk(const voxel_file_view* view, u32 index, voxel_chunk* chunk);
+
+// The chunks of a world at one point in time, for saving on another thread
+// while the world keeps changing. Decoded chunks are shared with the world,
+// which copies them before changing them, see voxel_world_touch_chunk.
+struct voxel_file_snapshot_chunk
+{
+    u64 key;
+
+    // null for a chunk that is still encoded in source
+    const voxel_chunk* chunk;
+
+    // chunk table index into source of the encoded chunk, or the saved
+    // index of the decoded chunk
+    u32 source_index;
+};
+
+struct voxel_file_snapshot
+{
+    i32 resolution;
+    voxel_file_source* source;
+
+    // sorted by key, so saving the same world twice gives the same file
+    array<voxel_file_snapshot_chunk> chunks;
+};
+
+// Takes references to the chunks and the source of world, which must only be
+// released on the thread changing world. Cheap, no voxels are copied.
+void voxel_file_snapshot_take(voxel_file_snapshot* snapshot, const voxel_world* world);
+void voxel_file_snapshot_release(voxel_file_snapshot* snapshot);
+
+// Writes next to path and then replaces it, so worlds still decoding chunks
+// from the file at path keep working. Only reads the snapshot, so it can run
+// on any thread. Chunks with an encoding in the source are copied over as
+// they are, only chunks changed since they were loaded or saved get encoded.
+// chunks_written counts up as chunks are written if not null.
+bool voxel_file_write_snapshot(
+    const voxel_file_snapshot* snapshot,
+    const char* path,
+    std::atomic<u32>* chunks_written);
+
+// After snapshot was written to path, make the written file the source of
+// world, so later saves copy the chunks that have not changed since. Leaves
+// world as it is if it was loaded or cleared in the meantime.
+void voxel_file_snapshot_saved(
+    const voxel_file_snapshot* snapshot,
+    voxel_world* world,
+    const char* path);
+
+// save on the calling thread, see voxel_file_write_snapshot
+bool voxel_file_save(const voxel_world* world, const char* path);
+
+// Replaces the contents of world, which is left untouched on failure. The
+// file is mapped and its chunks are decoded when first accessed, so opening
+// is quick however large the scene is. Files written before the format
+// existed are decoded right away, see voxel_file_convert_legacy.
+bool voxel_file_load(voxel_world* world, const char* path);
+
+// Rewrites a legacy scene.vx in the current format. Two legacy layouts exist:
+// the raw 16^3 voxel_leaf array of the fixed size grid, and the resolution
+// and chunk count followed by raw voxel_chunk structs.
+bool voxel_file_convert_legacy(const char* legacy_path, const char* path);
+}
@@ -0,0 +1,74 @@
+#include "voxel/voxel_file_saver.h"
+
+#include <cstring>
+
+namespace vx
+{
+static void save_run(void* data)
+{
+    voxel_file_saver* saver = (voxel_file_saver*)data;
+    saver->ok = voxel_file_write_snapshot(&saver->snapshot, saver->path, &saver->chunks_written);
+    saver->finished.store(true, std::memory_order_release);
+}
+
+voxel_file_saver* voxel_file_saver_create()
+{
+    voxel_file_saver* saver = new voxel_file_saver;
+    saver->jobs = job_system_create(1);
+    saver->world = nullptr;
+    saver->snapshot.source = nullptr;
+    saver->chunks_written = 0;
+    saver->finished = false;
+    saver->ok = false;
+    return saver;
+}
+
+void voxel_file_saver_destroy(voxel_file_saver* saver)
+{
+    // Destroying the job system finishes the save in progress.
+    job_system_destroy(saver->jobs);
+    if (saver->world)
+        voxel_file_snapshot_release(&saver->snapshot);
+    delete saver;
+}
+
+bool voxel_file_saver_start(voxel_file_saver* saver, voxel_world* world, const char* path)
+{
+    if (saver->world)
+        return false;
+    if (std::strlen(path) >= sizeof saver->path)
+        return false;
+
+    std::strcpy(saver->path, path);
+    saver->world = world;
+    saver->chunks_written = 0;
+    saver->finished = false;
+    saver->ok = false;
+    voxel_file_snapshot_take(&saver->snapshot, world);
+
+    job_system_submit(saver->jobs, save_run, saver);
+    return true;
+}
+
+bool voxel_file_saver_poll(voxel_file_saver* saver, bool* out_ok)
+{
+    if (!saver->world || !saver->finished.load(std::memory_order_acquire))
+        return false;
+
+    if (saver->ok)
+        voxel_file_snapshot_saved(&saver->snapshot, saver->world, saver->path);
+    voxel_file_snapshot_release(&saver->snapshot);
+
+    saver->world = nullptr;
+    *out_ok = saver->ok;
+    return true;
+}
+
+float voxel_file_saver_progress(const voxel_file_saver* saver)
+{
+    int count = saver->snapshot.chunks.size();
+    if (!saver->world || count == 0)
+        return 1.0f;
+    return (float)saver->chunks_written.load(std::memory_order_relaxed) / (float)count;
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "common/job_system.h"
+#include "voxel/voxel_file.h"
+
+namespace vx
+{
+// Saves worlds on a worker thread, one at a time. Starting a save only takes
+// a snapshot of the world, so editing can go on while it is written.
+struct voxel_file_saver
+{
+    job_system* jobs;
+
+    // the save in progress, world is null if there is none
+    voxel_world* world;
+    voxel_file_snapshot snapshot;
+    char path[1024];
+
+    std::atomic<u32> chunks_written;
+    std::atomic<bool> finished;
+    bool ok;
+};
+
+voxel_file_saver* voxel_file_saver_create();
+
+// waits for the save in progress, without updating its world
+void voxel_file_saver_destroy(voxel_file_saver* saver);
+
+// Start saving world to path, false if a save is already in progress. The
+// world must stay alive until the save finished.
+bool voxel_file_saver_start(voxel_file_saver* saver, voxel_world* world, const char* path);
+
+// Call once per frame. Returns true once the save in progress finished and
+// tells whether it succeeded. A successful save becomes the source of its
+// world, see voxel_file_snapshot_saved.
+bool voxel_file_saver_poll(voxel_file_saver* saver, bool* out_ok);
+
+inline bool voxel_file_saver_busy(const voxel_file_saver* saver)
+{
+    return saver->world != nullptr;
+}
+
+// fraction of the chunks of the save in progress written so far
+float voxel_file_saver_progress(const voxel_file_saver* saver);
+}
@@ -0,0 +1,479 @@
+#include "voxel/voxel_history.h"
+
+namespace vx
+{
+static const bounds3i empty_region{int3{INT32_MAX}, int3{INT32_MIN}};
+
+// empty leaves all read back as the zero leaf
+static voxel_leaf normalized(const voxel_leaf& leaf)
+{
+    return (leaf.flags & voxel_flag_solid) ? leaf : voxel_leaf{float3{0.0f}, 0};
+}
+
+static usize transaction_byte_size(const voxel_history_transaction* tx)
+{
+    return sizeof(voxel_history_transaction) + tx->runs.byte_size() + tx->leaves.byte_size() +
+           tx->leaf_slots.byte_size();
+}
+
+static void leaf_slot_insert(array<u32>* slots, const voxel_leaf& leaf, u32 index)
+{
+    const u32 mask = (u32)slots->size() - 1;
+    u32 s = voxel_leaf_hash(leaf) & mask;
+    while ((*slots)[s])
+        s = (s + 1) & mask;
+    (*slots)[s] = index + 1;
+}
+
+static u32 leaf_index(voxel_history_transaction* tx, const voxel_leaf& leaf)
+{
+    // Slots stay at most half full.
+    if (2 * (tx->leaves.size() + 1) > tx->leaf_slots.size())
+    {
+        array<u32> slots(std::max(16, 2 * tx->leaf_slots.size()));
+        for (int i = 0; i < tx->leaves.size(); i++)
+            leaf_slot_insert(&slots, tx->leaves[i], i);
+        tx->leaf_slots = slots;
+    }
+
+    const u32 mask = (u32)tx->leaf_slots.size() - 1;
+    for (u32 s = voxel_leaf_hash(leaf) & mask;; s = (s + 1) & mask)
+    {
+        const u32 slot = tx->leaf_slots[s];
+        if (!slot)
+        {
+            tx->leaves.add(leaf);
+            tx->leaf_slots[s] = (u32)tx->leaves.size();
+            return (u32)tx->leaves.size() - 1;
+        }
+        if (voxel_leaf_equal(tx->leaves[slot - 1], leaf))
+            return slot - 1;
+    }
+}
+
+static void transactions_clear(voxel_history* history, array<voxel_history_transaction*>* list)
+{
+    for (int i = 0; i < list->size(); i++)
+    {
+        history->byte_size -= transaction_byte_size((*list)[i]);
+        delete (*list)[i];
+    }
+    list->clear();
+}
+
+// drop the first count transactions of list
+static void transactions_drop(
+    voxel_history* history,
+    array<voxel_history_transaction*>* list,
+    int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        history->byte_size -= transaction_byte_size((*list)[i]);
+        delete (*list)[i];
+    }
+    for (int i = count; i < list->size(); i++)
+        (*list)[i - count] = (*list)[i];
+    list->resize(list->size() - count);
+}
+
+// The oldest undo steps go first. Of the redo steps, the first one is the
+// furthest from the current world.
+static void evict(voxel_history* history)
+{
+    int count = 0;
+    usize size = history->byte_size;
+    while (size > history->budget && count < history->undo.size())
+        size -= transaction_byte_size(history->undo[count++]);
+    transactions_drop(history, &history->undo, count);
+
+    count = 0;
+    while (size > history->budget && count < history->redo.size())
+        size -= transaction_byte_size(history->redo[count++]);
+    transactions_drop(history, &history->redo, count);
+}
+
+// Add a change of count voxels from row order index i on of a chunk to the
+// recording, extending its last run where possible. False once it grew over
+// the budget.
+static bool record(
+    voxel_history* history,
+    const int3& chunk_coords,
+    i32 i,
+    i32 count,
+    u32 before,
+    u32 after)
+{
+    voxel_history_transaction* tx = history->recording;
+    if (tx->runs.size())
+    {
+        voxel_history_run& last = tx->runs[tx->runs.size() - 1];
+        if (last.chunk_coords == chunk_coords && last.before == before && last.after == after &&
+            last.first + last.count_minus_one + 1 == i)
+        {
+            last.count_minus_one += (u16)count;
+            return true;
+        }
+    }
+
+    tx->runs.add(voxel_history_run{chunk_coords, (u16)i, (u16)(count - 1), before, after});
+    if (transaction_byte_size(tx) <= history->budget)
+        return true;
+
+    tx->runs.clear();
+    tx->leaves.clear();
+    tx->leaf_slots.clear();
+    history->recording_overflowed = true;
+    return false;
+}
+
+// write leaf to the voxels of run, as boxes of a partial row, of whole rows
+// and of whole planes
+static void run_fill(voxel_world* world, const voxel_history_run& run, const voxel_leaf& leaf)
+{
+    const i32 n = voxel_chunk_size;
+    const int3 base = run.chunk_coords * n;
+    const i32 end = run.first + run.count_minus_one + 1;
+    for (i32 i = run.first; i < end;)
+    {
+        const i32 row = i >> voxel_chunk_size_log2;
+        const int3 l{i & voxel_chunk_mask, row & voxel_chunk_mask, row >> voxel_chunk_size_log2};
+        int3 size;
+        if (l.x != 0 || end - i < n)
+            size = int3{std::min(n - l.x, end - i), 1, 1};
+        else if (l.y != 0 || end - i < n * n)
+            size = int3{n, std::min(n - l.y, (end - i) / n), 1};
+        else
+            size = int3{n, n, (end - i) / (n * n)};
+
+        voxel_world_fill(world, bounds3i{base + l, base + l + size - 1}, leaf);
+        i += size.x * size.y * size.z;
+    }
+}
+
+voxel_history* voxel_history_create(usize budget)
+{
+    voxel_history* history = new voxel_history;
+    history->budget = budget;
+    history->byte_size = 0;
+    history->recording = nullptr;
+    history->recording_overflowed = false;
+    return history;
+}
+
+void voxel_history_destroy(voxel_history* history)
+{
+    voxel_history_clear(history);
+    delete history->recording;
+    delete history;
+}
+
+void voxel_history_clear(voxel_history* history)
+{
+    transactions_clear(history, &history->undo);
+    transactions_clear(history, &history->redo);
+}
+
+void voxel_history_set_budget(voxel_history* history, usize budget)
+{
+    history->budget = budget;
+    evict(history);
+}
+
+void voxel_history_begin(voxel_history* history)
+{
+    assert(!history->recording);
+    history->recording = new voxel_history_transaction;
+    history->recording->region = empty_region;
+    history->recording_overflowed = false;
+}
+
+void voxel_history_end(voxel_history* history)
+{
+    voxel_history_transaction* tx = history->recording;
+    history->recording = nullptr;
+
+    if (history->recording_overflowed)
+        voxel_history_clear(history);
+    if (history->recording_overflowed || !tx->runs.size())
+    {
+        delete tx;
+        return;
+    }
+
+    transactions_clear(history, &history->redo);
+    history->undo.add(tx);
+    history->byte_size += transaction_byte_size(tx);
+    evict(history);
+}
+
+void voxel_history_set(
+    voxel_history* history,
+    voxel_world* world,
+    const int3& p,
+    const voxel_leaf& leaf)
+{
+    assert(history->recording);
+    if (!voxel_world_contains(world, p))
+        return;
+
+    const voxel_leaf before = normalized(voxel_world_get(world, p));
+    const voxel_leaf after = normalized(leaf);
+    if (voxel_leaf_equal(before, after))
+        return;
+
+    if (!history->recording_overflowed)
+    {
+        voxel_history_transaction* tx = history->recording;
+        const int3 l = voxel_chunk_local(p);
+        if (record(
+                history,
+                voxel_chunk_coords(p),
+                l.x + ((l.y + (l.z << voxel_chunk_size_log2)) << voxel_chunk_size_log2),
+                1,
+                leaf_index(tx, before),
+                leaf_index(tx, after)))
+        {
+            tx->region.min = glm::min(tx->region.min, p);
+            tx->region.max = glm::max(tx->region.max, p);
+        }
+    }
+    voxel_world_set(world, p, leaf);
+}
+
+void voxel_history_fill(
+    voxel_history* history,
+    voxel_world* world,
+    const bounds3i& b,
+    const voxel_leaf& leaf)
+{
+    assert(history->recording);
+    bounds3i clipped;
+    clipped.min = glm::max(b.min, int3{0});
+    clipped.max = glm::min(b.max, int3{world->resolution - 1});
+    if (glm::any(glm::greaterThan(clipped.min, clipped.max)))
+        return;
+
+    voxel_history_transaction* tx = history->recording;
+    const voxel_leaf after = normalized(leaf);
+    const bool solid = (after.flags & voxel_flag_solid) != 0;
+    const u32 after_index = history->recording_overflowed ? 0 : leaf_index(tx, after);
+    const voxel_leaf empty{float3{0.0f}, 0};
+
+    int3 cmin = voxel_chunk_coords(clipped.min);
+    int3 cmax = voxel_chunk_coords(clipped.max);
+    for (int cz = cmin.z; cz <= cmax.z && !history->recording_overflowed; cz++)
+        for (int cy = cmin.y; cy <= cmax.y && !history->recording_overflowed; cy++)
+            for (int cx = cmin.x; cx <= cmax.x && !history->recording_overflowed; cx++)
+            {
+                const int3 cc{cx, cy, cz};
+                const voxel_chunk* chunk = voxel_world_find_chunk(world, cc);
+                if (!chunk && !solid)
+                    continue;
+
+                const int3 base = cc * voxel_chunk_size;
+                const int3 lo = glm::max(clipped.min - base, int3{0});
+                const int3 hi = glm::min(clipped.max - base, int3{voxel_chunk_mask});
+
+                // the last palette entry seen, voxels mostly repeat it
+                u32 entries[voxel_chunk_size] = {};
+                u32 last = ~0u;
+                u32 before_index = 0;
+                bool same = false;
+                bool changed = false;
+                for (int z = lo.z; z <= hi.z && !history->recording_overflowed; z++)
+                    for (int y = lo.y; y <= hi.y && !history->recording_overflowed; y++)
+                    {
+                        const i32 row = y + (z << voxel_chunk_size_log2);
+                        if (chunk)
+                            voxel_chunk_row_indices(chunk, row, entries);
+
+                        for (int x = lo.x; x <= hi.x; x++)
+                        {
+                            if (entries[x] != last)
+                            {
+                                last = entries[x];
+                                const voxel_leaf& before = chunk ? chunk->palette[last] : empty;
+                                same = voxel_leaf_equal(before, after);
+                                if (!same)
+                                    before_index = leaf_index(tx, before);
+                            }
+                            if (same)
+                                continue;
+
+                            changed = true;
+                            const i32 i = x + (row << voxel_chunk_size_log2);
+                            if (!record(history, cc, i, 1, before_index, after_index))
+                                break;
+                        }
+                    }
+
+                if (changed && !history->recording_overflowed)
+                {
+                    tx->region.min = glm::min(tx->region.min, base + lo);
+                    tx->region.max = glm::max(tx->region.max, base + hi);
+                }
+            }
+
+    voxel_world_fill(world, clipped, leaf);
+}
+
+void voxel_history_chunk_runs(
+    array<voxel_history_run>* out_runs,
+    const voxel_chunk* before,
+    const voxel_chunk* after,
+    const u32* changed_rows)
+{
+    out_runs->clear();
+    u32 before_row[voxel_chunk_size];
+    u32 after_row[voxel_chunk_size];
+    for (i32 row = 0; row < voxel_chunk_volume / voxel_chunk_size; row++)
+    {
+        u32 mask = changed_rows[row];
+        if (!mask)
+            continue;
+
+        voxel_chunk_row_indices(before, row, before_row);
+        voxel_chunk_row_indices(after, row, after_row);
+
+        // Runs of neighbors in the mask with the same entries before and
+        // after, a run starts where either entry differs from its left one.
+        u32 starts = 1;
+        for (i32 x = 1; x < voxel_chunk_size; x++)
+            starts |= u32(before_row[x] != before_row[x - 1] || after_row[x] != after_row[x - 1])
+                      << x;
+        starts = (starts | ~(mask << 1)) & mask;
+
+        while (mask)
+        {
+            const i32 x = glm::findLSB(mask);
+            const u32 b = before_row[x];
+            const u32 a = after_row[x];
+
+            // up to the next start or gap in the mask
+            const u32 rest = ~mask | (starts & ~(1u << x));
+            const u32 after_x = x + 1 < voxel_chunk_size ? rest >> (x + 1) << (x + 1) : 0u;
+            const i32 end = after_x ? glm::findLSB(after_x) : voxel_chunk_size;
+            mask &= end < voxel_chunk_size ? ~0u << end : 0u;
+
+            // runs go on across rows
+            const i32 i = x + (row << voxel_chunk_size_log2);
+            if (out_runs->size())
+            {
+                voxel_history_run& last = (*out_runs)[out_runs->size() - 1];
+                if (last.before == b && last.after == a &&
+                    last.first + last.count_minus_one + 1 == i)
+                {
+                    last.count_minus_one += (u16)(end - x);
+                    continue;
+                }
+            }
+            out_runs->add(voxel_history_run{after->coords, (u16)i, (u16)(end - x - 1), b, a});
+        }
+    }
+}
+
+void voxel_history_record_chunk(
+    voxel_history* history,
+    const voxel_chunk* before,
+    const voxel_chunk* after,
+    const array<voxel_history_run>& runs)
+{
+    assert(history->recording);
+    if (history->recording_overflowed)
+        return;
+
+    voxel_history_transaction* tx = history->recording;
+    bounds3i changed = empty_region;
+
+    // palette entries of either chunk to leaves of the transaction, ~0u
+    // until used, chunk palettes stay small
+    array<u32> before_leaves(before->palette_count);
+    array<u32> after_leaves(after->palette_count);
+    std::memset(before_leaves.ptr(), 0xff, before_leaves.byte_size());
+    std::memset(after_leaves.ptr(), 0xff, after_leaves.byte_size());
+
+    for (int r = 0; r < runs.size(); r++)
+    {
+        const voxel_history_run& run = runs[r];
+        const u32 b = run.before;
+        const u32 a = run.after;
+        if (before_leaves[b] == ~0u)
+            before_leaves[b] = leaf_index(tx, before->palette[b]);
+        if (after_leaves[a] == ~0u)
+            after_leaves[a] = leaf_index(tx, after->palette[a]);
+        if (!record(
+                history,
+                run.chunk_coords,
+                run.first,
+                run.count_minus_one + 1,
+                before_leaves[b],
+                after_leaves[a]))
+            return;
+
+        // the whole rows or planes a run spans beyond its first one
+        const i32 last = run.first + run.count_minus_one;
+        const i32 first_row = run.first >> voxel_chunk_size_log2;
+        const i32 last_row = last >> voxel_chunk_size_log2;
+        int3 mn{
+            run.first & voxel_chunk_mask,
+            first_row & voxel_chunk_mask,
+            first_row >> voxel_chunk_size_log2};
+        int3 mx{
+            last & voxel_chunk_mask,
+            last_row & voxel_chunk_mask,
+            last_row >> voxel_chunk_size_log2};
+        if (first_row != last_row)
+        {
+            mn.x = 0;
+            mx.x = voxel_chunk_mask;
+        }
+        if (mn.z != mx.z)
+        {
+            mn.y = 0;
+            mx.y = voxel_chunk_mask;
+        }
+        changed.min = glm::min(changed.min, mn);
+        changed.max = glm::max(changed.max, mx);
+    }
+
+    if (changed.min.x <= changed.max.x)
+    {
+        const int3 base = after->coords * voxel_chunk_size;
+        tx->region.min = glm::min(tx->region.min, base + changed.min);
+        tx->region.max = glm::max(tx->region.max, base + changed.max);
+    }
+}
+
+bool voxel_history_undo(voxel_history* history, voxel_world* world, bounds3i* out_region)
+{
+    assert(!history->recording);
+    if (!history->undo.size())
+        return false;
+
+    voxel_history_transaction* tx = history->undo[history->undo.size() - 1];
+    history->undo.resize(history->undo.size() - 1);
+    for (int i = tx->runs.size() - 1; i >= 0; i--)
+        run_fill(world, tx->runs[i], tx->leaves[tx->runs[i].before]);
+
+    history->redo.add(tx);
+    *out_region = tx->region;
+    return true;
+}
+
+bool voxel_history_redo(voxel_history* history, voxel_world* world, bounds3i* out_region)
+{
+    assert(!history->recording);
+    if (!history->redo.size())
+        return false;
+
+    voxel_history_transaction* tx = history->redo[history->redo.size() - 1];
+    history->redo.resize(history->redo.size() - 1);
+    for (int i = 0; i < tx->runs.size(); i++)
+        run_fill(world, tx->runs[i], tx->leaves[tx->runs[i].after]);
+
+    history->undo.add(tx);
+    *out_region = tx->region;
+    return true;
+}
+}
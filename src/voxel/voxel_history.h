@@ -0,0 +1,104 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+#include "common/array.h"
+
+namespace vx
+{
+// count voxels of a chunk from first on in row order, see voxel_chunk_set_run,
+// that all changed from leaf before to leaf after of their transaction
+struct voxel_history_run
+{
+    int3 chunk_coords;
+    u16 first;
+    u16 count_minus_one;
+    u32 before;
+    u32 after;
+};
+
+struct voxel_history_transaction
+{
+    array<voxel_history_run> runs;
+
+    // distinct leaves of the runs, looked up through open addressing over
+    // leaf_slots which hold index + 1 or 0 for an empty slot
+    array<voxel_leaf> leaves;
+    array<u32> leaf_slots;
+
+    // inclusive box of the changed voxels
+    bounds3i region;
+};
+
+// Undo and redo as sparse deltas. The edits made through the history between
+// voxel_history_begin and voxel_history_end form a transaction, which records
+// the voxels they changed along with their leaves before and after. Undoing
+// or redoing it takes time in proportion to those, not to the world.
+//
+// Changes are recorded as runs of neighboring voxels with the same leaves, so
+// boxes cost little more than their rows. Once the transactions go over the
+// budget the oldest are dropped. A transaction that does not fit by itself
+// clears the history, since the ones before it could no longer be undone.
+struct voxel_history
+{
+    usize budget;
+    usize byte_size;
+
+    // the newest transaction is last in both
+    array<voxel_history_transaction*> undo;
+    array<voxel_history_transaction*> redo;
+
+    // the transaction between begin and end, null outside of them
+    voxel_history_transaction* recording;
+    bool recording_overflowed;
+};
+
+voxel_history* voxel_history_create(usize budget);
+void voxel_history_destroy(voxel_history* history);
+
+// drop all transactions, for changes to the world made around the history
+void voxel_history_clear(voxel_history* history);
+
+// drops the oldest transactions if they no longer fit
+void voxel_history_set_budget(voxel_history* history, usize budget);
+
+// Start a transaction. The redo transactions are dropped once it ends with
+// any changes.
+void voxel_history_begin(voxel_history* history);
+void voxel_history_end(voxel_history* history);
+
+// same as voxel_world_set and voxel_world_fill, recording the changes
+void voxel_history_set(
+    voxel_history* history,
+    voxel_world* world,
+    const int3& p,
+    const voxel_leaf& leaf);
+void voxel_history_fill(
+    voxel_history* history,
+    voxel_world* world,
+    const bounds3i& b,
+    const voxel_leaf& leaf);
+
+// Runs of the changes to a chunk made around the history, for edits that
+// change several chunks at once on other threads. Safe to call from any
+// thread, the runs hold palette indices of before and after instead of
+// leaves. before is a copy of the chunk from before the changes, see
+// voxel_chunk_copy, and changed_rows has bit x of row y + z * voxel_chunk_size
+// set for every voxel that changed.
+void voxel_history_chunk_runs(
+    array<voxel_history_run>* out_runs,
+    const voxel_chunk* before,
+    const voxel_chunk* after,
+    const u32* changed_rows);
+
+// add runs from voxel_history_chunk_runs to the transaction
+void voxel_history_record_chunk(
+    voxel_history* history,
+    const voxel_chunk* before,
+    const voxel_chunk* after,
+    const array<voxel_history_run>& runs);
+
+// Revert the newest transaction, or apply the newest one undone again. False
+// if there is none, otherwise out_region is the box of voxels that changed.
+bool voxel_history_undo(voxel_history* history, voxel_world* world, bounds3i* out_region);
+bool voxel_history_redo(voxel_history* history, voxel_world* world, bounds3i* out_region);
+}
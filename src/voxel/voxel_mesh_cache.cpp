@@ -0,0 +1,171 @@
+#include "voxel/voxel_mesh_cache.h"
+
+namespace vx
+{
+// Chunks which grow past their capacity are moved to the end of the arrays.
+// Once more than half of the arrays is unused, the ranges are packed again.
+static const u32 compact_min_vertices = 1 << 16;
+
+static u32 capacity_with_slack(u32 count) { return count + count / 4 + 32; }
+
+static void range_write(voxel_mesh_cache* cache, voxel_mesh_range& r, const voxel_mesh& mesh)
+{
+    r.vertex_count = mesh.vertices.size();
+    r.triangle_count = mesh.triangles.size();
+    r.face_count = mesh.face_count;
+
+    for (u32 i = 0; i < r.vertex_count; i++)
+        cache->vertices[r.vertex_offset + i] = mesh.vertices[i];
+
+    const int3 base((i32)r.vertex_offset);
+    for (u32 i = 0; i < r.triangle_count; i++)
+        cache->triangles[r.triangle_offset + i] = mesh.triangles[i] + base;
+    for (u32 i = r.triangle_count; i < r.triangle_capacity; i++)
+        cache->triangles[r.triangle_offset + i] = int3(0);
+
+    cache->vertex_count += r.vertex_count;
+    cache->triangle_count += r.triangle_count;
+    cache->face_count += r.face_count;
+
+    voxel_mesh_patch& p = cache->patches.add();
+    p.vertex_offset = r.vertex_offset;
+    p.vertex_count = r.vertex_count;
+    p.triangle_offset = r.triangle_offset;
+    p.triangle_count = r.triangle_capacity;
+}
+
+static void range_reset(voxel_mesh_cache* cache, voxel_mesh_range& r)
+{
+    cache->vertex_count -= r.vertex_count;
+    cache->triangle_count -= r.triangle_count;
+    cache->face_count -= r.face_count;
+    r.vertex_count = r.triangle_count = r.face_count = 0;
+}
+
+// Drop the contents of the range, it keeps its place and capacity.
+static void range_release(voxel_mesh_cache* cache, voxel_mesh_range& r)
+{
+    for (u32 i = 0; i < r.triangle_count; i++)
+        cache->triangles[r.triangle_offset + i] = int3(0);
+
+    if (r.triangle_count)
+    {
+        voxel_mesh_patch& p = cache->patches.add();
+        p.vertex_offset = r.vertex_offset;
+        p.vertex_count = 0;
+        p.triangle_offset = r.triangle_offset;
+        p.triangle_count = r.triangle_count;
+    }
+
+    range_reset(cache, r);
+}
+
+static void range_allocate(voxel_mesh_cache* cache, voxel_mesh_range& r, const voxel_mesh& mesh)
+{
+    r.vertex_offset = cache->vertices.size();
+    r.vertex_capacity = capacity_with_slack(mesh.vertices.size());
+    r.triangle_offset = cache->triangles.size();
+    r.triangle_capacity = capacity_with_slack(mesh.triangles.size());
+
+    cache->vertices.resize(r.vertex_offset + r.vertex_capacity);
+    cache->triangles.resize(r.triangle_offset + r.triangle_capacity);
+}
+
+static void compact(voxel_mesh_cache* cache)
+{
+    array<voxel_vertex> vertices;
+    array<int3> triangles;
+
+    for (auto it = cache->ranges.begin(); it != cache->ranges.end();)
+    {
+        voxel_mesh_range& r = it->second;
+        if (!r.vertex_count)
+        {
+            it = cache->ranges.erase(it);
+            continue;
+        }
+
+        u32 vertex_offset = vertices.size(), triangle_offset = triangles.size();
+        u32 vertex_capacity = capacity_with_slack(r.vertex_count);
+        u32 triangle_capacity = capacity_with_slack(r.triangle_count);
+
+        vertices.resize(vertex_offset + vertex_capacity);
+        triangles.resize(triangle_offset + triangle_capacity);
+
+        for (u32 i = 0; i < r.vertex_count; i++)
+            vertices[vertex_offset + i] = cache->vertices[r.vertex_offset + i];
+
+        const int3 rebase = int3((i32)vertex_offset) - int3((i32)r.vertex_offset);
+        for (u32 i = 0; i < r.triangle_count; i++)
+            triangles[triangle_offset + i] = cache->triangles[r.triangle_offset + i] + rebase;
+
+        r.vertex_offset = vertex_offset, r.vertex_capacity = vertex_capacity;
+        r.triangle_offset = triangle_offset, r.triangle_capacity = triangle_capacity;
+        ++it;
+    }
+
+    std::swap(cache->vertices, vertices);
+    std::swap(cache->triangles, triangles);
+    cache->patches.clear();
+    cache->patch_all = true;
+}
+
+void voxel_mesh_cache_set_chunk(
+    voxel_mesh_cache* cache,
+    const int3& chunk_coords,
+    const voxel_mesh& mesh)
+{
+    u64 key = voxel_chunk_key(chunk_coords);
+    auto it = cache->ranges.find(key);
+
+    if (!mesh.vertices.size())
+    {
+        // The range stays allocated as slack until the next compaction,
+        // it is likely to be reused by the next edit.
+        if (it != cache->ranges.end())
+            range_release(cache, it->second);
+    }
+    else if (it == cache->ranges.end())
+    {
+        voxel_mesh_range& r = cache->ranges[key];
+        r = voxel_mesh_range{};
+        range_allocate(cache, r, mesh);
+        range_write(cache, r, mesh);
+    }
+    else
+    {
+        voxel_mesh_range& r = it->second;
+        if ((u32)mesh.vertices.size() <= r.vertex_capacity &&
+            (u32)mesh.triangles.size() <= r.triangle_capacity)
+        {
+            range_reset(cache, r);
+        }
+        else
+        {
+            range_release(cache, r);
+            range_allocate(cache, r, mesh);
+        }
+        range_write(cache, r, mesh);
+    }
+
+    u32 unused = cache->vertices.size() - cache->vertex_count;
+    if (cache->vertices.size() > (int)compact_min_vertices && unused > cache->vertex_count)
+        compact(cache);
+}
+
+void voxel_mesh_cache_clear(voxel_mesh_cache* cache)
+{
+    cache->ranges.clear();
+    cache->vertices.clear();
+    cache->triangles.clear();
+    cache->vertex_count = cache->triangle_count = cache->face_count = 0;
+    cache->patches.clear();
+    cache->patch_all = true;
+}
+
+void voxel_mesh_cache_clear_patches(voxel_mesh_cache* cache)
+{
+    cache->patches.clear();
+    cache->patch_all = false;
+}
+}
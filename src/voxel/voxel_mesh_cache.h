@@ -0,0 +1,55 @@
+#pragma once
+
+#include "voxel/voxel_mesher.h"
+
+#include <unordered_map>
+
+namespace vx
+{
+// Part of the cache arrays owned by a single chunk. The capacities include
+// some slack, so a chunk can usually be remeshed in place after an edit.
+struct voxel_mesh_range
+{
+    u32 vertex_offset, vertex_count, vertex_capacity;
+    u32 triangle_offset, triangle_count, triangle_capacity;
+    u32 face_count;
+};
+
+// Part of the cache arrays changed since the patches were last cleared.
+struct voxel_mesh_patch
+{
+    u32 vertex_offset, vertex_count;
+    u32 triangle_offset, triangle_count;
+};
+
+// Meshes of all chunks of a world, packed into one vertex and triangle array
+// so they can be drawn with a single call. Replacing the mesh of a chunk
+// records which parts of the arrays changed, so the caller can patch the gpu
+// buffers instead of uploading everything.
+//
+// Unused triangle capacity is filled with degenerate triangles.
+struct voxel_mesh_cache
+{
+    std::unordered_map<u64, voxel_mesh_range> ranges;
+    array<voxel_vertex> vertices;
+    array<int3> triangles;
+
+    // totals over all chunks, without slack
+    u32 vertex_count, triangle_count, face_count;
+
+    array<voxel_mesh_patch> patches;
+
+    // the arrays were rebuilt or compacted, patches do not cover the changes
+    bool patch_all;
+};
+
+void voxel_mesh_cache_clear(voxel_mesh_cache* cache);
+
+// replace the mesh of a single chunk, an empty mesh removes it
+void voxel_mesh_cache_set_chunk(
+    voxel_mesh_cache* cache,
+    const int3& chunk_coords,
+    const voxel_mesh& mesh);
+
+void voxel_mesh_cache_clear_patches(voxel_mesh_cache* cache);
+}
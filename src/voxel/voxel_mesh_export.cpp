@@ -0,0 +1,524 @@
+#include "voxel/voxel_mesh_export.h"
+#include "platform/filesystem.h"
+
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace vx
+{
+const char* const voxel_mesh_format_extensions[voxel_mesh_format_count] = {"ply", "obj", "glb"};
+
+namespace
+{
+// Meshes the chunks of a world one at a time, always in the same order. The
+// binary formats need the totals before the first vertex, so they mesh every
+// chunk twice: once to count and once to write.
+struct chunk_mesher
+{
+    const voxel_world* world;
+    u32 flags;
+    float3 origin;
+    float3 voxel_size;
+
+    // Sorted by key, the order of the chunk maps changes as chunks are
+    // decoded and equal worlds should give equal files.
+    array<int3> chunk_coords;
+
+    // the chunk meshed last, vertex indices start at 0
+    voxel_mesh mesh;
+};
+
+void chunk_mesher_init(
+    chunk_mesher* m,
+    const voxel_world* world,
+    const bounds3f& scene_bounds,
+    u32 flags)
+{
+    m->world = world;
+    m->flags = flags;
+    m->origin = scene_bounds.min;
+    m->voxel_size = extents(scene_bounds) / (float)world->resolution;
+
+    voxel_world_chunk_coords(world, &m->chunk_coords);
+    if (m->chunk_coords.size())
+    {
+        std::sort(
+            m->chunk_coords.ptr(),
+            m->chunk_coords.ptr() + m->chunk_coords.size(),
+            [](const int3& a, const int3& b) { return voxel_chunk_key(a) < voxel_chunk_key(b); });
+    }
+}
+
+void chunk_mesher_build(chunk_mesher* m, int i)
+{
+    voxel_mesh_clear(&m->mesh);
+    if (const voxel_chunk* chunk = voxel_world_find_chunk(m->world, m->chunk_coords[i]))
+        voxel_mesh_build_chunk(&m->mesh, m->world, chunk, m->flags);
+}
+
+float3 vertex_position(const chunk_mesher* m, const voxel_vertex& v)
+{
+    return m->origin + float3(voxel_vertex_position(v)) * m->voxel_size;
+}
+
+// what the editor draws with ambient occlusion on and directional light off
+float3 vertex_color(const voxel_vertex& v)
+{
+    float ao = glm::smoothstep(0.0f, 1.0f, 1.0f - voxel_vertex_ao(v));
+    return voxel_vertex_color(v) * (0.25f + 0.75f * ao);
+}
+
+u8 unorm8(float v)
+{
+    return u8(glm::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// glTF vertex colors are linear, voxel colors are displayed as they are
+float srgb_to_linear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+void put_bytes(u8** p, const void* data, usize size)
+{
+    std::memcpy(*p, data, size);
+    *p += size;
+}
+
+bool write_at(FILE* f, u64 offset, const array<u8>& bytes)
+{
+    return !bytes.size() ||
+           (file_seek(f, offset) && std::fwrite(bytes.ptr(), bytes.size(), 1, f) == 1);
+}
+
+struct mesh_totals
+{
+    u64 vertex_count;
+    u64 triangle_count;
+    bounds3f position_bounds;
+};
+
+void count_meshes(chunk_mesher* m, mesh_totals* out_totals)
+{
+    *out_totals = mesh_totals{0, 0, bounds3f{float3{FLT_MAX}, float3{-FLT_MAX}}};
+    for (int i = 0; i < m->chunk_coords.size(); i++)
+    {
+        chunk_mesher_build(m, i);
+        out_totals->vertex_count += m->mesh.vertices.size();
+        out_totals->triangle_count += m->mesh.triangles.size();
+        for (int j = 0; j < m->mesh.vertices.size(); j++)
+        {
+            float3 p = vertex_position(m, m->mesh.vertices[j]);
+            out_totals->position_bounds.min = glm::min(out_totals->position_bounds.min, p);
+            out_totals->position_bounds.max = glm::max(out_totals->position_bounds.max, p);
+        }
+    }
+}
+
+constexpr usize ply_vertex_size = 3 * sizeof(float) + 3 * sizeof(float) + 3;
+constexpr usize ply_face_size = 1 + 3 * sizeof(u32);
+
+bool write_ply(FILE* f, chunk_mesher* m)
+{
+    mesh_totals totals;
+    count_meshes(m, &totals);
+
+    int header_size = std::fprintf(
+        f,
+        "ply\n"
+        "format binary_little_endian 1.0\n"
+        "comment voxed\n"
+        "element vertex %llu\n"
+        "property float x\n"
+        "property float y\n"
+        "property float z\n"
+        "property float nx\n"
+        "property float ny\n"
+        "property float nz\n"
+        "property uchar red\n"
+        "property uchar green\n"
+        "property uchar blue\n"
+        "element face %llu\n"
+        "property list uchar uint vertex_indices\n"
+        "end_header\n",
+        (unsigned long long)totals.vertex_count,
+        (unsigned long long)totals.triangle_count);
+    if (header_size < 0)
+        return false;
+
+    // All vertices come before all faces, the vertices and faces of every
+    // chunk are written straight into their place in the file.
+    const u64 vertices_at = (u64)header_size;
+    const u64 faces_at = vertices_at + totals.vertex_count * ply_vertex_size;
+
+    array<u8> vertex_bytes;
+    array<u8> face_bytes;
+    u64 vertex_base = 0;
+    u64 triangle_base = 0;
+    bool ok = true;
+    for (int i = 0; ok && i < m->chunk_coords.size(); i++)
+    {
+        chunk_mesher_build(m, i);
+        const voxel_mesh& mesh = m->mesh;
+
+        vertex_bytes.resize(mesh.vertices.size() * ply_vertex_size);
+        u8* p = vertex_bytes.size() ? vertex_bytes.ptr() : nullptr;
+        for (int j = 0; j < mesh.vertices.size(); j++)
+        {
+            const voxel_vertex& v = mesh.vertices[j];
+            float3 position = vertex_position(m, v);
+            float3 normal = voxel_mesh_normals[voxel_vertex_normal(v)];
+            float3 color = vertex_color(v);
+            u8 rgb[3] = {unorm8(color.r), unorm8(color.g), unorm8(color.b)};
+            put_bytes(&p, &position, sizeof position);
+            put_bytes(&p, &normal, sizeof normal);
+            put_bytes(&p, rgb, sizeof rgb);
+        }
+
+        face_bytes.resize(mesh.triangles.size() * ply_face_size);
+        p = face_bytes.size() ? face_bytes.ptr() : nullptr;
+        for (int j = 0; j < mesh.triangles.size(); j++)
+        {
+            const int3& t = mesh.triangles[j];
+            u8 count = 3;
+            u32 indices[3] = {
+                u32(vertex_base + t.x), u32(vertex_base + t.y), u32(vertex_base + t.z)};
+            put_bytes(&p, &count, sizeof count);
+            put_bytes(&p, indices, sizeof indices);
+        }
+
+        ok = write_at(f, vertices_at + vertex_base * ply_vertex_size, vertex_bytes) &&
+             write_at(f, faces_at + triangle_base * ply_face_size, face_bytes);
+        vertex_base += mesh.vertices.size();
+        triangle_base += mesh.triangles.size();
+    }
+    return ok;
+}
+
+// Formatting floats is most of the time spent writing text. Positions are on
+// the voxel grid and colors have 8 bits, so every number is formatted once
+// up front and copied from then on.
+struct obj_number
+{
+    char text[16];
+};
+
+struct obj_numbers
+{
+    array<obj_number> coordinates[3];
+    obj_number colors[256];
+};
+
+void obj_numbers_init(obj_numbers* numbers, const chunk_mesher* m)
+{
+    for (int axis = 0; axis < 3; axis++)
+    {
+        array<obj_number>& coordinates = numbers->coordinates[axis];
+        coordinates.resize(m->world->resolution + 1);
+        for (int i = 0; i < coordinates.size(); i++)
+        {
+            float x = m->origin[axis] + (float)i * m->voxel_size[axis];
+            std::snprintf(coordinates[i].text, sizeof coordinates[i].text, "%.7g", x);
+        }
+    }
+    for (int i = 0; i < 256; i++)
+        std::snprintf(numbers->colors[i].text, sizeof numbers->colors[i].text, "%.4g", i / 255.0f);
+}
+
+void put_text(array<char>* out, const char* s)
+{
+    int at = out->size();
+    int size = (int)std::strlen(s);
+    out->resize(at + size);
+    std::memcpy(out->ptr() + at, s, size);
+}
+
+void put_uint(array<char>* out, u64 v)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = char('0' + v % 10);
+        v /= 10;
+    } while (v);
+
+    int at = out->size();
+    out->resize(at + n);
+    for (int i = 0; i < n; i++)
+        (*out)[at + i] = digits[n - 1 - i];
+}
+
+bool write_obj(FILE* f, chunk_mesher* m)
+{
+    obj_numbers numbers;
+    obj_numbers_init(&numbers, m);
+
+    array<char> text;
+    put_text(&text, "# voxed\n");
+    for (int i = 0; i < 6; i++)
+    {
+        char line[64];
+        const float3& n = voxel_mesh_normals[i];
+        std::snprintf(line, sizeof line, "vn %g %g %g\n", n.x, n.y, n.z);
+        put_text(&text, line);
+    }
+    bool ok = std::fwrite(text.ptr(), text.size(), 1, f) == 1;
+
+    // Text can be streamed as it is, no counting pass needed.
+    u64 vertex_base = 1;
+    for (int i = 0; ok && i < m->chunk_coords.size(); i++)
+    {
+        chunk_mesher_build(m, i);
+        const voxel_mesh& mesh = m->mesh;
+
+        text.clear();
+        for (int j = 0; j < mesh.vertices.size(); j++)
+        {
+            const voxel_vertex& v = mesh.vertices[j];
+            int3 position = voxel_vertex_position(v);
+            float3 color = vertex_color(v);
+            put_text(&text, "v ");
+            for (int axis = 0; axis < 3; axis++)
+            {
+                put_text(&text, numbers.coordinates[axis][position[axis]].text);
+                put_text(&text, " ");
+            }
+            put_text(&text, numbers.colors[unorm8(color.r)].text);
+            put_text(&text, " ");
+            put_text(&text, numbers.colors[unorm8(color.g)].text);
+            put_text(&text, " ");
+            put_text(&text, numbers.colors[unorm8(color.b)].text);
+            put_text(&text, "\n");
+        }
+
+        // the corners of a triangle share its normal
+        for (int j = 0; j < mesh.triangles.size(); j++)
+        {
+            const int3& t = mesh.triangles[j];
+            u64 n = voxel_vertex_normal(mesh.vertices[t.x]) + 1;
+            put_text(&text, "f");
+            for (int k = 0; k < 3; k++)
+            {
+                put_text(&text, " ");
+                put_uint(&text, vertex_base + t[k]);
+                put_text(&text, "//");
+                put_uint(&text, n);
+            }
+            put_text(&text, "\n");
+        }
+
+        ok = !text.size() || std::fwrite(text.ptr(), text.size(), 1, f) == 1;
+        vertex_base += mesh.vertices.size();
+    }
+    return ok;
+}
+
+constexpr u32 glb_magic = 0x46546c67;  // "glTF"
+constexpr u32 glb_version = 2;
+constexpr u32 glb_chunk_json = 0x4e4f534a;
+constexpr u32 glb_chunk_bin = 0x004e4942;
+
+// position, normal and rgba8 color interleaved
+constexpr usize glb_vertex_size = 3 * sizeof(float) + 3 * sizeof(float) + 4;
+
+bool write_glb(FILE* f, chunk_mesher* m)
+{
+    mesh_totals totals;
+    count_meshes(m, &totals);
+
+    const u64 vertex_bytes_size = totals.vertex_count * glb_vertex_size;
+    const u64 index_bytes_size = totals.triangle_count * 3 * sizeof(u32);
+    const u64 bin_size = vertex_bytes_size + index_bytes_size;
+
+    // Accessor bounds are printed with enough digits to read back as the exact
+    // floats in the buffer, loaders check them.
+    const bounds3f& b = totals.position_bounds;
+    char json[2048];
+    int json_size;
+    if (totals.triangle_count == 0)
+    {
+        json_size = std::snprintf(
+            json,
+            sizeof json,
+            "{\"asset\":{\"version\":\"2.0\",\"generator\":\"voxed\"},"
+            "\"scene\":0,\"scenes\":[{}]}");
+    }
+    else
+    {
+        json_size = std::snprintf(
+            json,
+            sizeof json,
+            "{\"asset\":{\"version\":\"2.0\",\"generator\":\"voxed\"},"
+            "\"scene\":0,\"scenes\":[{\"nodes\":[0]}],\"nodes\":[{\"mesh\":0}],"
+            "\"meshes\":[{\"primitives\":[{\"attributes\":"
+            "{\"POSITION\":0,\"NORMAL\":1,\"COLOR_0\":2},\"indices\":3}]}],"
+            "\"buffers\":[{\"byteLength\":%llu}],"
+            "\"bufferViews\":["
+            "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%llu,\"byteStride\":%u,"
+            "\"target\":34962},"
+            "{\"buffer\":0,\"byteOffset\":%llu,\"byteLength\":%llu,\"target\":34963}],"
+            "\"accessors\":["
+            "{\"bufferView\":0,\"byteOffset\":0,\"componentType\":5126,\"count\":%llu,"
+            "\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+            "{\"bufferView\":0,\"byteOffset\":12,\"componentType\":5126,\"count\":%llu,"
+            "\"type\":\"VEC3\"},"
+            "{\"bufferView\":0,\"byteOffset\":24,\"componentType\":5121,\"normalized\":true,"
+            "\"count\":%llu,\"type\":\"VEC4\"},"
+            "{\"bufferView\":1,\"byteOffset\":0,\"componentType\":5125,\"count\":%llu,"
+            "\"type\":\"SCALAR\"}]}",
+            (unsigned long long)bin_size,
+            (unsigned long long)vertex_bytes_size,
+            (u32)glb_vertex_size,
+            (unsigned long long)vertex_bytes_size,
+            (unsigned long long)index_bytes_size,
+            (unsigned long long)totals.vertex_count,
+            b.min.x,
+            b.min.y,
+            b.min.z,
+            b.max.x,
+            b.max.y,
+            b.max.z,
+            (unsigned long long)totals.vertex_count,
+            (unsigned long long)totals.vertex_count,
+            (unsigned long long)(totals.triangle_count * 3));
+    }
+    if (json_size < 0 || json_size >= (int)sizeof json - 3)
+        return false;
+
+    // chunks are padded to 4 bytes, json with spaces
+    while (json_size % 4)
+        json[json_size++] = ' ';
+
+    const bool has_bin = totals.triangle_count != 0;
+    const u64 json_at = 12 + 8;
+    const u64 bin_at = json_at + json_size + 8;
+    const u64 total_size = has_bin ? bin_at + bin_size : json_at + json_size;
+    if (total_size > 0xffffffffu)
+    {
+        fprintf(stdout, "The mesh is too large for a .glb file\n");
+        return false;
+    }
+
+    u32 header[5] = {glb_magic, glb_version, (u32)total_size, (u32)json_size, glb_chunk_json};
+    u32 bin_header[2] = {(u32)bin_size, glb_chunk_bin};
+    bool ok = std::fwrite(header, sizeof header, 1, f) == 1 &&
+              std::fwrite(json, json_size, 1, f) == 1 &&
+              (!has_bin || std::fwrite(bin_header, sizeof bin_header, 1, f) == 1);
+
+    const u64 indices_at = bin_at + vertex_bytes_size;
+    array<u8> vertex_bytes;
+    array<u8> index_bytes;
+    u64 vertex_base = 0;
+    u64 triangle_base = 0;
+    for (int i = 0; ok && has_bin && i < m->chunk_coords.size(); i++)
+    {
+        chunk_mesher_build(m, i);
+        const voxel_mesh& mesh = m->mesh;
+
+        vertex_bytes.resize(mesh.vertices.size() * glb_vertex_size);
+        u8* p = vertex_bytes.size() ? vertex_bytes.ptr() : nullptr;
+        for (int j = 0; j < mesh.vertices.size(); j++)
+        {
+            const voxel_vertex& v = mesh.vertices[j];
+            float3 position = vertex_position(m, v);
+            float3 normal = voxel_mesh_normals[voxel_vertex_normal(v)];
+            float3 color = vertex_color(v);
+            u8 rgba[4] = {
+                unorm8(srgb_to_linear(color.r)),
+                unorm8(srgb_to_linear(color.g)),
+                unorm8(srgb_to_linear(color.b)),
+                255};
+            put_bytes(&p, &position, sizeof position);
+            put_bytes(&p, &normal, sizeof normal);
+            put_bytes(&p, rgba, sizeof rgba);
+        }
+
+        index_bytes.resize(mesh.triangles.size() * 3 * sizeof(u32));
+        p = index_bytes.size() ? index_bytes.ptr() : nullptr;
+        for (int j = 0; j < mesh.triangles.size(); j++)
+        {
+            const int3& t = mesh.triangles[j];
+            u32 indices[3] = {
+                u32(vertex_base + t.x), u32(vertex_base + t.y), u32(vertex_base + t.z)};
+            put_bytes(&p, indices, sizeof indices);
+        }
+
+        ok = write_at(f, bin_at + vertex_base * glb_vertex_size, vertex_bytes) &&
+             write_at(f, indices_at + triangle_base * 3 * sizeof(u32), index_bytes);
+        vertex_base += mesh.vertices.size();
+        triangle_base += mesh.triangles.size();
+    }
+    return ok;
+}
+}
+
+bool voxel_mesh_format_from_path(const char* path, voxel_mesh_format* out_format)
+{
+    const char* dot = std::strrchr(path, '.');
+    if (!dot)
+        return false;
+
+    for (int i = 0; i < voxel_mesh_format_count; i++)
+    {
+        const char* ext = voxel_mesh_format_extensions[i];
+        usize n = std::strlen(ext);
+        if (std::strlen(dot + 1) != n)
+            continue;
+
+        usize j = 0;
+        while (j < n && std::tolower((unsigned char)dot[1 + j]) == ext[j])
+            j++;
+        if (j == n)
+        {
+            *out_format = (voxel_mesh_format)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool voxel_mesh_export(
+    const voxel_world* world,
+    const bounds3f& scene_bounds,
+    u32 mesh_flags,
+    voxel_mesh_format format,
+    const char* path)
+{
+    FILE* f = std::fopen(path, "wb");
+    if (!f)
+    {
+        fprintf(stdout, "Could not open %s for writing\n", path);
+        return false;
+    }
+
+    chunk_mesher m;
+    chunk_mesher_init(&m, world, scene_bounds, mesh_flags);
+
+    bool ok = false;
+    switch (format)
+    {
+        case voxel_mesh_format_ply:
+            ok = write_ply(f, &m);
+            break;
+        case voxel_mesh_format_obj:
+            ok = write_obj(f, &m);
+            break;
+        case voxel_mesh_format_glb:
+            ok = write_glb(f, &m);
+            break;
+        default:
+            break;
+    }
+    ok = std::fclose(f) == 0 && ok;
+
+    if (!ok)
+    {
+        fprintf(stdout, "Could not write %s\n", path);
+        std::remove(path);
+    }
+    return ok;
+}
+}
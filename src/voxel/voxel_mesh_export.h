@@ -0,0 +1,38 @@
+#pragma once
+
+#include "voxel/voxel_mesher.h"
+
+namespace vx
+{
+// Mesh files for other tools, written without a window or GPU. Positions are
+// mapped into scene_bounds the way the editor draws them and the colors have
+// its ambient occlusion baked in. Chunks are meshed one at a time and written
+// out as they are done, the mesh of the whole world is never held in memory.
+enum voxel_mesh_format
+{
+    // binary little endian, float positions and normals, uchar colors
+    voxel_mesh_format_ply,
+
+    // text, colors follow the positions of the v lines
+    voxel_mesh_format_obj,
+
+    // binary glTF 2.0, colors in COLOR_0 are linear
+    voxel_mesh_format_glb,
+
+    voxel_mesh_format_count,
+};
+
+// file extensions without the dot, by format
+extern const char* const voxel_mesh_format_extensions[voxel_mesh_format_count];
+
+// false if the extension of path is none of voxel_mesh_format_extensions
+bool voxel_mesh_format_from_path(const char* path, voxel_mesh_format* out_format);
+
+// mesh_flags are voxel_mesh_flag, the file is removed again on failure
+bool voxel_mesh_export(
+    const voxel_world* world,
+    const bounds3f& scene_bounds,
+    u32 mesh_flags,
+    voxel_mesh_format format,
+    const char* path);
+}
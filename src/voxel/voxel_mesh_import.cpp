@@ -0,0 +1,255 @@
+#include "voxel/voxel_mesh_import.h"
+#include "platform/filesystem.h"
+#include "voxel/voxel_mesh_export.h"
+#include "voxel/voxel_ply.h"
+
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace vx
+{
+namespace
+{
+constexpr u32 white = 0xffffffffu;
+
+u32 pack_color(const float3& color)
+{
+    int3 c = int3{glm::clamp(color, float3{0.0f}, float3{1.0f}) * 255.0f + 0.5f};
+    return u32(c.x) | u32(c.y) << 8 | u32(c.z) << 16 | 0xff000000u;
+}
+
+// false if an index is past the positions
+bool indices_valid(const voxel_triangle_mesh& mesh)
+{
+    const u32 count = (u32)mesh.positions.size();
+    for (int i = 0; i < mesh.indices.size(); i++)
+        if (mesh.indices[i] >= count)
+            return false;
+    return true;
+}
+
+//
+// obj
+//
+
+// a line starting with the single letter keyword c
+bool obj_keyword(const text_range& t, char c)
+{
+    return t.end - t.p >= 2 && t.p[0] == c && text_is_blank(t.p[1]);
+}
+
+bool load_obj(voxel_triangle_mesh* mesh, const char* data, usize size)
+{
+    // count first, so the arrays are allocated once
+    int vertex_count = 0;
+    int face_count = 0;
+    for (text_range t{data, data + size}; t.p < t.end; text_skip_line(&t))
+    {
+        vertex_count += obj_keyword(t, 'v');
+        face_count += obj_keyword(t, 'f');
+    }
+    mesh->positions.reserve(vertex_count);
+    mesh->colors.reserve(vertex_count);
+    mesh->indices.reserve(3 * face_count);
+
+    bool any_colors = false;
+    for (text_range t{data, data + size}; t.p < t.end; text_skip_line(&t))
+    {
+        text_skip_blanks(&t);
+        if (obj_keyword(t, 'v'))
+        {
+            // x y z, x y z w or x y z r g b
+            t.p++;
+            double v[7];
+            int n = 0;
+            for (; n < 7; n++)
+            {
+                text_skip_blanks(&t);
+                if (!text_parse_float(&t, &v[n]))
+                    break;
+            }
+            if (n < 3)
+                return false;
+
+            mesh->positions.add(float3((float)v[0], (float)v[1], (float)v[2]));
+            if (n >= 6)
+            {
+                float3 color((float)v[n - 3], (float)v[n - 2], (float)v[n - 1]);
+                mesh->colors.add(pack_color(color));
+                any_colors = true;
+            }
+            else
+                mesh->colors.add(white);
+        }
+        else if (obj_keyword(t, 'f'))
+        {
+            t.p++;
+            u32 first = 0;
+            u32 previous = 0;
+            for (int n = 0;; n++)
+            {
+                // v, v/vt, v//vn or v/vt/vn, negative indices count back
+                text_skip_blanks(&t);
+                i64 index;
+                if (!text_parse_int(&t, &index))
+                    break;
+                while (t.p < t.end && !text_is_blank(*t.p) && *t.p != '\n')
+                    t.p++;
+
+                index = index < 0 ? index + mesh->positions.size() : index - 1;
+                if (index < 0 || index > (i64)UINT32_MAX)
+                    return false;
+
+                if (n == 0)
+                    first = (u32)index;
+                else if (n >= 2)
+                {
+                    mesh->indices.add(first);
+                    mesh->indices.add(previous);
+                    mesh->indices.add((u32)index);
+                }
+                previous = (u32)index;
+            }
+        }
+    }
+
+    if (!any_colors)
+        mesh->colors = array<u32>();
+    return indices_valid(*mesh);
+}
+
+//
+// ply
+//
+
+bool load_ply_element(
+    voxel_triangle_mesh* mesh,
+    ply_reader* r,
+    const ply_header& h,
+    const ply_element& e)
+{
+    const ply_property* properties = h.properties.size() ? h.properties.ptr() : nullptr;
+    properties += e.first_property;
+
+    // nothing to read, however many there are
+    if (!e.property_count && !e.vertex)
+        return true;
+
+    bool colors = false;
+    for (int i = 0; i < e.property_count; i++)
+        colors = colors || properties[i].role == ply_role_red;
+
+    if (e.vertex)
+    {
+        if (e.count > INT32_MAX)
+            return false;
+        mesh->positions.resize((int)e.count);
+        if (colors)
+            mesh->colors.resize((int)e.count);
+    }
+    else if (e.face)
+    {
+        if (e.count > INT32_MAX / 3)
+            return false;
+        mesh->indices.reserve(3 * (int)e.count);
+    }
+
+    for (i64 i = 0; i < e.count && r->ok; i++)
+    {
+        float3 position{0.0f};
+        float3 color{1.0f};
+        for (int j = 0; j < e.property_count; j++)
+        {
+            const ply_property& prop = properties[j];
+            if (!prop.list)
+            {
+                double v = ply_read(r, prop.type);
+                if (prop.role >= ply_role_x && prop.role <= ply_role_z)
+                    position[prop.role - ply_role_x] = (float)v;
+                else if (prop.role >= ply_role_red && prop.role <= ply_role_blue)
+                    color[prop.role - ply_role_red] = (float)(v / ply_type_color_scales[prop.type]);
+                continue;
+            }
+
+            double n = ply_read(r, prop.count_type);
+            if (!(n >= 0.0))
+                return false;
+
+            u32 first = 0;
+            u32 previous = 0;
+            for (u32 k = 0; k < (u32)n && r->ok; k++)
+            {
+                double v = ply_read(r, prop.type);
+                if (prop.role != ply_role_vertex_indices)
+                    continue;
+                if (!(v >= 0.0 && v <= (double)UINT32_MAX))
+                    return false;
+
+                if (k == 0)
+                    first = (u32)v;
+                else if (k >= 2)
+                {
+                    mesh->indices.add(first);
+                    mesh->indices.add(previous);
+                    mesh->indices.add((u32)v);
+                }
+                previous = (u32)v;
+            }
+        }
+
+        if (e.vertex)
+        {
+            mesh->positions[(int)i] = position;
+            if (colors)
+                mesh->colors[(int)i] = pack_color(color);
+        }
+    }
+    return r->ok;
+}
+
+bool load_ply(voxel_triangle_mesh* mesh, const char* data, usize size)
+{
+    text_range t{data, data + size};
+    ply_header h;
+    if (!ply_parse_header(&t, &h))
+        return false;
+
+    ply_reader r{(const u8*)t.p, (const u8*)t.end, h.format, true};
+    for (int i = 0; i < h.elements.size(); i++)
+        if (!load_ply_element(mesh, &r, h, h.elements[i]))
+            return false;
+
+    return indices_valid(*mesh);
+}
+}
+
+bool voxel_triangle_mesh_load(voxel_triangle_mesh* mesh, const char* path)
+{
+    voxel_mesh_format format;
+    if (!voxel_mesh_format_from_path(path, &format) || format == voxel_mesh_format_glb)
+    {
+        fprintf(stdout, "%s is not an .obj or .ply mesh\n", path);
+        return false;
+    }
+
+    mapped_file file;
+    if (!map_file(path, &file))
+    {
+        fprintf(stdout, "Could not read %s\n", path);
+        return false;
+    }
+
+    voxel_triangle_mesh loaded;
+    const char* data = (const char*)file.data;
+    bool ok = format == voxel_mesh_format_obj ? load_obj(&loaded, data, file.size)
+                                              : load_ply(&loaded, data, file.size);
+    unmap_file(&file);
+
+    if (ok)
+        std::swap(*mesh, loaded);
+    else
+        fprintf(stdout, "%s is not a valid mesh file\n", path);
+    return ok;
+}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "common/array.h"
+#include "common/geometry.h"
+
+namespace vx
+{
+// Triangle meshes read from .obj and .ply files, the input of the voxelizer.
+// Only positions, vertex colors and faces are read, polygons are split into
+// triangle fans.
+struct voxel_triangle_mesh
+{
+    array<float3> positions;
+
+    // 8-bit RGBA by position, empty if the file has no vertex colors
+    array<u32> colors;
+
+    // three position indices per triangle
+    array<u32> indices;
+};
+
+// Replaces the contents of mesh, the format is picked by the extension of
+// path. OBJ colors are the MeshLab "v x y z r g b" extension. PLY files may
+// be ascii or binary of either byte order.
+bool voxel_triangle_mesh_load(voxel_triangle_mesh* mesh, const char* path);
+}
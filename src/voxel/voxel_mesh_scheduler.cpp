@@ -0,0 +1,233 @@
+#include "voxel/voxel_mesh_scheduler.h"
+
+namespace vx
+{
+struct voxel_mesh_job
+{
+    voxel_mesh_job* next;
+    voxel_mesh_scheduler* scheduler;
+    u64 epoch, generation;
+    u32 flags;
+    voxel_mesh_snapshot snapshot;
+    voxel_mesh mesh;
+};
+
+// Every job holds a snapshot of its chunk (~0.5 MB), so only keep a few
+// of them per worker in flight.
+static const u32 jobs_in_flight_per_worker = 4;
+
+static void job_run(void* data)
+{
+    voxel_mesh_job* job = (voxel_mesh_job*)data;
+    voxel_mesh_clear(&job->mesh);
+    voxel_mesh_build_snapshot(&job->mesh, &job->snapshot, job->flags);
+    mpsc_list_push(&job->scheduler->finished, job);
+}
+
+static voxel_mesh_cache* target_cache(voxel_mesh_scheduler* s)
+{
+    return s->back ? s->back : s->front;
+}
+
+static void apply(
+    voxel_mesh_scheduler* s,
+    const int3& chunk_coords,
+    u64 generation,
+    const voxel_mesh& mesh)
+{
+    u64& applied = s->applied_generations[voxel_chunk_key(chunk_coords)];
+    if (generation < applied)
+        return;
+    applied = generation;
+    voxel_mesh_cache_set_chunk(target_cache(s), chunk_coords, mesh);
+}
+
+static void collect(voxel_mesh_scheduler* s)
+{
+    voxel_mesh_job* job = mpsc_list_take_all(&s->finished);
+    while (job)
+    {
+        voxel_mesh_job* next = job->next;
+
+        if (job->epoch == s->epoch)
+        {
+            apply(s, job->snapshot.chunk.coords, job->generation, job->mesh);
+            s->epoch_in_flight--;
+        }
+
+        s->in_flight--;
+        s->free_jobs.add(job);
+        job = next;
+    }
+}
+
+static void submit(
+    voxel_mesh_scheduler* s,
+    const voxel_world* world,
+    const int3& chunk_coords,
+    const voxel_mesh_overlay* overlay,
+    u32 flags)
+{
+    u64 generation = ++s->generation;
+
+    if (!voxel_world_find_chunk(world, chunk_coords) &&
+        !voxel_mesh_overlay_fills_chunk(world, overlay, chunk_coords))
+    {
+        voxel_mesh empty;
+        voxel_mesh_clear(&empty);
+        apply(s, chunk_coords, generation, empty);
+        return;
+    }
+
+    voxel_mesh_job* job;
+    if (s->free_jobs.size())
+    {
+        job = s->free_jobs[s->free_jobs.size() - 1];
+        s->free_jobs.resize(s->free_jobs.size() - 1);
+    }
+    else
+    {
+        job = new voxel_mesh_job();
+    }
+
+    job->scheduler = s;
+    job->epoch = s->epoch;
+    job->generation = generation;
+    job->flags = flags;
+    voxel_mesh_snapshot_take(&job->snapshot, world, chunk_coords, overlay);
+
+    s->in_flight++;
+    s->epoch_in_flight++;
+    job_system_submit(s->jobs, job_run, job);
+}
+
+static void enqueue(voxel_mesh_scheduler* s, const int3& chunk_coords)
+{
+    if (s->queued_keys.insert(voxel_chunk_key(chunk_coords)).second)
+        s->queued.add(chunk_coords);
+}
+
+static void wait_idle(voxel_mesh_scheduler* s)
+{
+    // Destroying the job system runs the remaining jobs.
+    job_system_destroy(s->jobs);
+    s->jobs = nullptr;
+    collect(s);
+    assert(s->in_flight == 0);
+}
+
+voxel_mesh_scheduler* voxel_mesh_scheduler_create(i32 worker_count)
+{
+    voxel_mesh_scheduler* s = new voxel_mesh_scheduler;
+    s->jobs = nullptr;
+    voxel_mesh_cache_clear(&s->caches[0]);
+    voxel_mesh_cache_clear(&s->caches[1]);
+    s->front = &s->caches[0];
+    s->back = nullptr;
+    s->queued_head = 0;
+    s->epoch = s->generation = 0;
+    s->in_flight = s->epoch_in_flight = 0;
+    voxel_mesh_scheduler_set_worker_count(s, worker_count);
+    return s;
+}
+
+void voxel_mesh_scheduler_destroy(voxel_mesh_scheduler* s)
+{
+    wait_idle(s);
+    for (int i = 0; i < s->free_jobs.size(); i++)
+    {
+        voxel_chunk_free_copy(&s->free_jobs[i]->snapshot.chunk);
+        delete s->free_jobs[i];
+    }
+    delete s;
+}
+
+void voxel_mesh_scheduler_set_worker_count(voxel_mesh_scheduler* s, i32 worker_count)
+{
+    if (s->jobs)
+        wait_idle(s);
+    s->jobs = job_system_create(worker_count);
+    s->max_in_flight = jobs_in_flight_per_worker * std::max(job_system_worker_count(s->jobs), 1u);
+}
+
+void voxel_mesh_scheduler_rebuild(voxel_mesh_scheduler* s, const voxel_world* world)
+{
+    s->epoch++;
+    s->epoch_in_flight = 0;
+    s->applied_generations.clear();
+
+    s->back = s->front == &s->caches[0] ? &s->caches[1] : &s->caches[0];
+    voxel_mesh_cache_clear(s->back);
+
+    s->queued.clear();
+    s->queued_head = 0;
+    s->queued_keys.clear();
+
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+    for (int i = 0; i < coords.size(); i++)
+        enqueue(s, coords[i]);
+}
+
+void voxel_mesh_scheduler_update(
+    voxel_mesh_scheduler* s,
+    const voxel_world* world,
+    const bounds3i& region)
+{
+    bounds3i chunks;
+    if (!voxel_mesh_affected_chunks(world, region, &chunks))
+        return;
+
+    for (int z = chunks.min.z; z <= chunks.max.z; z++)
+        for (int y = chunks.min.y; y <= chunks.max.y; y++)
+            for (int x = chunks.min.x; x <= chunks.max.x; x++)
+                enqueue(s, int3{x, y, z});
+}
+
+bool voxel_mesh_scheduler_run(
+    voxel_mesh_scheduler* s,
+    const voxel_world* world,
+    const voxel_mesh_overlay* overlay,
+    u32 flags)
+{
+    voxel_mesh_cache* front = s->front;
+
+    // Without workers the jobs run during submit, collecting between the
+    // batches keeps the number of live snapshots bounded.
+    for (;;)
+    {
+        collect(s);
+
+        if (s->queued_head == s->queued.size() || s->in_flight >= s->max_in_flight)
+            break;
+
+        while (s->queued_head < s->queued.size() && s->in_flight < s->max_in_flight)
+        {
+            int3 chunk_coords = s->queued[s->queued_head++];
+            s->queued_keys.erase(voxel_chunk_key(chunk_coords));
+            submit(s, world, chunk_coords, overlay, flags);
+        }
+    }
+
+    if (s->queued_head == s->queued.size())
+    {
+        s->queued.clear();
+        s->queued_head = 0;
+    }
+
+    if (s->back && s->queued_head == s->queued.size() && s->epoch_in_flight == 0)
+    {
+        fprintf(stdout, "Voxel mesh rebuild finished\n");
+        s->front = s->back;
+        s->back = nullptr;
+        s->front->patch_all = true;
+    }
+
+    return s->front != front || front->patch_all || front->patches.size();
+}
+
+bool voxel_mesh_scheduler_busy(const voxel_mesh_scheduler* s)
+{
+    return s->queued_head < s->queued.size() || s->in_flight > 0;
+}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "common/job_system.h"
+#include "voxel/voxel_mesh_cache.h"
+
+#include <unordered_set>
+
+namespace vx
+{
+struct voxel_mesh_job;
+
+// Meshes chunks on the worker threads of a job system. Chunks are snapshot
+// when their job is submitted, so the world can keep changing while they are
+// meshed, and finished meshes are handed back through a lock-free list.
+//
+// Finished chunks are written into the front cache, which is the one drawn,
+// replacing their previous mesh. A rebuild goes into the back cache instead
+// and only replaces the front cache once all of its chunks have finished, so
+// the previous mesh stays on screen until then.
+struct voxel_mesh_scheduler
+{
+    job_system* jobs;
+    u32 max_in_flight;
+
+    voxel_mesh_cache caches[2];
+    voxel_mesh_cache* front;
+
+    // the cache being rebuilt, null if there is no rebuild in progress
+    voxel_mesh_cache* back;
+
+    // chunks waiting to be submitted
+    array<int3> queued;
+    int queued_head;
+    std::unordered_set<u64> queued_keys;
+
+    // Results from before the last rebuild are dropped. Otherwise a result is
+    // only used if it was submitted after the mesh the cache has for the chunk.
+    u64 epoch, generation;
+    std::unordered_map<u64, u64> applied_generations;
+
+    u32 in_flight, epoch_in_flight;
+    mpsc_list<voxel_mesh_job> finished;
+    array<voxel_mesh_job*> free_jobs;
+};
+
+// worker_count as in job_system_create
+voxel_mesh_scheduler* voxel_mesh_scheduler_create(i32 worker_count);
+
+// waits for all jobs in flight
+void voxel_mesh_scheduler_destroy(voxel_mesh_scheduler* scheduler);
+
+// restart the job system with a new number of workers
+void voxel_mesh_scheduler_set_worker_count(voxel_mesh_scheduler* scheduler, i32 worker_count);
+
+// start meshing every chunk of the world into a new mesh
+void voxel_mesh_scheduler_rebuild(voxel_mesh_scheduler* scheduler, const voxel_world* world);
+
+// queue the chunks affected by changes to the voxels in the inclusive box region
+void voxel_mesh_scheduler_update(
+    voxel_mesh_scheduler* scheduler,
+    const voxel_world* world,
+    const bounds3i& region);
+
+// Apply finished chunks and submit queued ones, call once per frame. Queued
+// chunks are snapshot from world, with overlay drawn over it unless it is
+// null. Changes to the overlay are passed to voxel_mesh_scheduler_update as
+// the union of its old and new box. Returns true if the front cache changed.
+bool voxel_mesh_scheduler_run(
+    voxel_mesh_scheduler* scheduler,
+    const voxel_world* world,
+    const voxel_mesh_overlay* overlay,
+    u32 flags);
+
+// are there chunks queued or in flight?
+bool voxel_mesh_scheduler_busy(const voxel_mesh_scheduler* scheduler);
+}
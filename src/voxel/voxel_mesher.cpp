@@ -0,0 +1,568 @@
+#include "voxel/voxel_mesher.h"
+#include "voxel/voxel_clip.h"
+
+namespace vx
+{
+namespace
+{
+struct face
+{
+    u16 color;
+    float ao[4];
+};
+
+bool face_equal(const face& a, const face& b)
+{
+    return a.color == b.color && a.ao[0] == b.ao[0] && a.ao[1] == b.ao[1] && a.ao[2] == b.ao[2] &&
+           a.ao[3] == b.ao[3];
+}
+
+// l is in chunk local coordinates and may point outside of the chunk
+bool solid_at(const voxel_world* world, const voxel_chunk* chunk, const int3& l)
+{
+    if (glm::all(glm::greaterThanEqual(l, int3{0})) &&
+        glm::all(glm::lessThan(l, int3{voxel_chunk_size})))
+        return voxel_chunk_is_solid(chunk, voxel_chunk_index(l));
+    return voxel_world_is_solid(world, chunk->coords * voxel_chunk_size + l);
+}
+
+// Occupancy of a chunk and a one voxel border around it, stored as 64-bit
+// columns along x. Voxel l (local, -1..voxel_chunk_size) is bit l.x + 1 of
+// column (l.y + 1) + (l.z + 1) * occupancy_size.
+constexpr int occupancy_size = voxel_mesh_border_size;
+constexpr u64 occupancy_chunk_bits = (1ull << voxel_chunk_size) - 1;
+static_assert(occupancy_size <= 64, "Occupancy columns must fit into 64 bits");
+
+struct chunk_occupancy
+{
+    u64 columns[occupancy_size * occupancy_size];
+
+    // exposed faces per direction, bit x of entry y + z * voxel_chunk_size
+    u64 faces[6][voxel_chunk_size * voxel_chunk_size];
+
+    // slices along x holding any face, per direction
+    u64 x_slices[6];
+};
+
+int occupancy_column(int y, int z)
+{
+    return (y + 1) + (z + 1) * occupancy_size;
+}
+
+bool occupied(const chunk_occupancy& occ, const int3& l)
+{
+    return ((occ.columns[occupancy_column(l.y, l.z)] >> (l.x + 1)) & 1) != 0;
+}
+
+void occupancy_columns_build(u64* columns, const voxel_world* world, const voxel_chunk* chunk)
+{
+    const int n = voxel_chunk_size;
+
+    // the chunk and its 26 neighbors, indexed by offset + 1 per axis
+    const voxel_chunk* neighbors[27];
+    for (int dz = -1; dz <= 1; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+            for (int dx = -1; dx <= 1; dx++)
+            {
+                int3 d{dx, dy, dz};
+                neighbors[(dx + 1) + (dy + 1) * 3 + (dz + 1) * 9] =
+                    d == int3{0} ? chunk : voxel_world_find_chunk(world, chunk->coords + d);
+            }
+
+    for (int z = -1; z <= n; z++)
+        for (int y = -1; y <= n; y++)
+        {
+            int cy = y < 0 ? 0 : y < n ? 1 : 2;
+            int cz = z < 0 ? 0 : z < n ? 1 : 2;
+            int ly = y & voxel_chunk_mask, lz = z & voxel_chunk_mask;
+            u64 column = 0;
+
+            for (int cx = 0; cx < 3; cx++)
+            {
+                const voxel_chunk* c = neighbors[cx + cy * 3 + cz * 9];
+                if (!c)
+                    continue;
+
+                if (cx == 1)
+                {
+                    column |= u64(voxel_chunk_solid_row(c, ly + lz * n)) << 1;
+                    continue;
+                }
+
+                int x = cx == 0 ? -1 : n;
+                if (voxel_chunk_is_solid(c, voxel_chunk_index(int3{x & voxel_chunk_mask, ly, lz})))
+                    column |= 1ull << (x + 1);
+            }
+
+            columns[occupancy_column(y, z)] = column;
+        }
+}
+
+void occupancy_faces_build(chunk_occupancy* occ)
+{
+    const int n = voxel_chunk_size;
+
+    // A face is exposed where a solid voxel meets an empty one. Along x that
+    // is a shift within the column, along y and z a neighboring column.
+    for (int z = 0; z < n; z++)
+        for (int y = 0; y < n; y++)
+        {
+            int i = y + z * n;
+            u64 c = occ->columns[occupancy_column(y, z)];
+            u64 self = (c >> 1) & occupancy_chunk_bits;
+
+            occ->faces[0][i] = ((c & ~(c >> 1)) >> 1) & occupancy_chunk_bits;
+            occ->faces[1][i] = self & ~(occ->columns[occupancy_column(y + 1, z)] >> 1);
+            occ->faces[2][i] = self & ~(occ->columns[occupancy_column(y, z + 1)] >> 1);
+            occ->faces[3][i] = ((c & ~(c << 1)) >> 1) & occupancy_chunk_bits;
+            occ->faces[4][i] = self & ~(occ->columns[occupancy_column(y - 1, z)] >> 1);
+            occ->faces[5][i] = self & ~(occ->columns[occupancy_column(y, z - 1)] >> 1);
+        }
+
+    for (int di = 0; di < 6; di++)
+    {
+        occ->x_slices[di] = 0;
+        for (int i = 0; i < n * n; i++)
+            occ->x_slices[di] |= occ->faces[di][i];
+    }
+}
+
+// Gather the faces of slice s in direction di into rows, using the same
+// (i, j) layout as the mesher: i along axis (di + 1) % 3, j along (di + 2) % 3.
+void occupancy_slice_faces(const chunk_occupancy& occ, int di, int s, u64* rows)
+{
+    const int n = voxel_chunk_size;
+    const u64* faces = occ.faces[di];
+
+    for (int j = 0; j < n; j++)
+        rows[j] = 0;
+
+    switch (di % 3)
+    {
+        case axis_x: // i = y, j = z
+            if ((occ.x_slices[di] >> s) & 1)
+                for (int j = 0; j < n; j++)
+                    for (int i = 0; i < n; i++)
+                        rows[j] |= ((faces[i + j * n] >> s) & 1) << i;
+            break;
+        case axis_y: // i = z, j = x
+            for (int i = 0; i < n; i++)
+                for (u64 bits = faces[s + i * n]; bits; bits &= bits - 1)
+                    rows[vx_ctz64(bits)] |= 1ull << i;
+            break;
+        case axis_z: // i = x, j = y
+            for (int j = 0; j < n; j++)
+                rows[j] = faces[j + s * n];
+            break;
+    }
+}
+
+// n is the empty voxel in front of the face, solid(l) tests a voxel in chunk
+// local coordinates
+template<typename SolidFn>
+void face_ao(const SolidFn& solid, const int3& n, int di, float* ao)
+{
+    // ambient occlusion
+    //
+    // Credits to:
+    // https://0fps.net/2013/07/03/ambient-occlusion-for-minecraft-like-worlds/
+    //
+    // Search all the s's around x in the normal
+    // direction.
+    //
+    //   top view   side views
+    //   [s][s][s]  [s][s][s]  [s][s][s]  [s][s][s]  [s][s][s]
+    //   [s][x][s]     [x]        [x]        [x]        [x]
+    //   [s][s][s]
+    //
+    //   [7][6][5]  [1][2][3]  [3][4][5]  [5][6][7]  [7][0][1]
+    //   [0][x][4]     [x]        [x]        [x]        [x]
+    //   [1][2][3]
+    //
+    // With this layout we can mask 3 bits at the time
+    // in offsets of two like so:
+    //
+    //   012345670
+    //   aaa||||||
+    //     bbb||||
+    //       ccc||
+    //         ddd
+
+    // clang-format off
+    static const int2 search_dirs[] =
+    {
+        int2(-1, +0), // 0
+        int2(-1, -1), // 1
+        int2(+0, -1), // 2
+        int2(+1, -1), // 3
+        int2(+1, +0), // 4
+        int2(+1, +1), // 5
+        int2(+0, +1), // 6
+        int2(-1, +1), // 7
+    };
+    static const float symmetries[] =
+    {
+        0.0f, // case 0 - none
+        0.5f, // case 1 - edge
+        0.5f, // case 2 - edge + corner
+        1.0f, // case 3 - corner
+    };
+    // clang-format on
+
+    u32 mask = 0;
+
+    for (int search_dir = 0; search_dir < 8; search_dir++)
+    {
+        int3 s;
+        s[di % 3] = n[di % 3];
+        s[(di + 1) % 3] = n[(di + 1) % 3] + search_dirs[search_dir][0];
+        s[(di + 2) % 3] = n[(di + 2) % 3] + search_dirs[search_dir][1];
+
+        if (solid(s))
+            mask |= 1 << search_dir;
+    }
+
+    // NOTE(vinht): Trick, copy 0th bit to 8th bit, so
+    // we can mask out 3 bits per corner without
+    // special cases.
+    mask |= (mask & 0x1) << 8;
+
+    for (int corner = 0; corner < 4; corner++)
+    {
+        u32 corner_mask = (mask >> (2 * corner)) & 0x7;
+        ao[corner] = corner_mask == 0x5 ? symmetries[3] : symmetries[vx_popcnt(corner_mask)];
+    }
+}
+
+// Emit a quad covering w x h faces starting from voxel c, w along the first
+// and h along the second tangent axis of the face.
+void emit_quad(voxel_mesh* mesh, int di, const int3& c, int w, int h, const face& f)
+{
+    int axis = di % 3, u = (di + 1) % 3, v = (di + 2) % 3;
+
+    // position
+    //   take the corner of the voxel at the origin of the grid
+    //   move to the face plane along the face normal
+    //   move to one of the face corners, stretched over the quad
+    int3 pos = c;
+    pos[axis] += di / 3 ? 0 : 1;
+    int3 fca = pos, fcb = pos, fcc = pos, fcd = pos;
+    fcb[u] += w;
+    fcc[u] += w, fcc[v] += h;
+    fcd[v] += h;
+
+    // color, normal & ambient occlusion
+    voxel_vertex va, vb, vc, vd;
+    va = voxel_vertex_pack(fca, di, u32(2.0f * f.ao[0]), f.color);
+    vb = voxel_vertex_pack(fcb, di, u32(2.0f * f.ao[1]), f.color);
+    vc = voxel_vertex_pack(fcc, di, u32(2.0f * f.ao[2]), f.color);
+    vd = voxel_vertex_pack(fcd, di, u32(2.0f * f.ao[3]), f.color);
+
+    // indices
+    int idx = mesh->vertices.size();
+    int3 ta, tb;
+    // NOTE(vinht): Flip triangulation based on sum of
+    // AO values of the two diagonals to avoid
+    // interpolation artifacts.
+    if (f.ao[0] + f.ao[2] < f.ao[1] + f.ao[3])
+    {
+        ta = int3(idx + 0, idx + 1, idx + 2);
+        tb = int3(idx + 0, idx + 2, idx + 3);
+    }
+    else
+    {
+        ta = int3(idx + 0, idx + 1, idx + 3);
+        tb = int3(idx + 1, idx + 2, idx + 3);
+    }
+    // flip winding
+    if (di / 3)
+        std::swap(ta.y, ta.z), std::swap(tb.y, tb.z);
+
+    mesh->vertices.add(va), mesh->vertices.add(vb), mesh->vertices.add(vc), mesh->vertices.add(vd);
+    mesh->triangles.add(ta), mesh->triangles.add(tb);
+}
+} // namespace
+
+const float3 voxel_mesh_normals[6] = {
+    float3{+1.0f, 0.0f, 0.0f},
+    float3{0.0f, +1.0f, 0.0f},
+    float3{0.0f, 0.0f, +1.0f},
+    float3{-1.0f, 0.0f, 0.0f},
+    float3{0.0f, -1.0f, 0.0f},
+    float3{0.0f, 0.0f, -1.0f},
+};
+
+void voxel_mesh_clear(voxel_mesh* mesh)
+{
+    mesh->vertices.clear();
+    mesh->triangles.clear();
+    mesh->face_count = 0;
+}
+
+// Mesh a chunk. Neighbors are looked up in occ, or in world if occ is null.
+void build_chunk(
+    voxel_mesh* mesh,
+    const voxel_chunk* chunk,
+    const chunk_occupancy* occ,
+    const voxel_world* world,
+    u32 flags)
+{
+    const int n = voxel_chunk_size;
+    const int3 base = chunk->coords * voxel_chunk_size;
+    const bool greedy = (flags & voxel_mesh_flag_greedy) != 0;
+    const bool reference = occ == nullptr;
+
+    // faces of the current slice, bit i of rows[j] marks faces[i + j * n]
+    face faces[voxel_chunk_size * voxel_chunk_size];
+    u64 rows[voxel_chunk_size];
+
+    auto solid_reference = [&](const int3& l) { return solid_at(world, chunk, l); };
+    auto solid_occupancy = [&](const int3& l) { return occupied(*occ, l); };
+
+    // for each face direction:
+    //   for each slice of the chunk along the face normal:
+    //     mark faces of solid voxels whose neighbor is empty or out of bounds
+    //     emit quads for the marked faces, merging them if greedy
+
+    for (int di = 0; di < 6; di++)
+    {
+        const int axis = di % 3, u = (di + 1) % 3, v = (di + 2) % 3;
+        int3 d(0);
+        d[axis] = di / 3 ? -1 : 1;
+
+        for (int s = 0; s < n; s++)
+        {
+            if (reference)
+            {
+                for (int j = 0; j < n; j++)
+                {
+                    rows[j] = 0;
+                    for (int i = 0; i < n; i++)
+                    {
+                        int3 l;
+                        l[axis] = s, l[u] = i, l[v] = j;
+
+                        // only process solid voxels
+                        if (!voxel_chunk_is_solid(chunk, voxel_chunk_index(l)))
+                            continue;
+
+                        if (!solid_reference(l + d))
+                            rows[j] |= 1ull << i;
+                    }
+                }
+            }
+            else
+            {
+                occupancy_slice_faces(*occ, di, s, rows);
+            }
+
+            for (int j = 0; j < n; j++)
+                for (u64 bits = rows[j]; bits; bits &= bits - 1)
+                {
+                    int i = (int)vx_ctz64(bits);
+                    int3 l;
+                    l[axis] = s, l[u] = i, l[v] = j;
+
+                    face& f = faces[i + j * n];
+                    f.color =
+                        voxel_color_pack_rgb565(voxel_chunk_get(chunk, voxel_chunk_index(l)).color);
+                    if (reference)
+                        face_ao(solid_reference, l + d, di, f.ao);
+                    else
+                        face_ao(solid_occupancy, l + d, di, f.ao);
+                    mesh->face_count++;
+                }
+
+            for (int j = 0; j < n; j++)
+                while (rows[j])
+                {
+                    int i = (int)vx_ctz64(rows[j]);
+                    const face& f = faces[i + j * n];
+                    int w = 1, h = 1;
+
+                    // Only merge along an axis if the AO is constant along
+                    // it. The merged quad then has exactly the corner values
+                    // of the faces it replaces, so shading and the
+                    // triangulation flip stay the same.
+                    if (greedy && f.ao[0] == f.ao[1] && f.ao[3] == f.ao[2])
+                        while (i + w < n && ((rows[j] >> (i + w)) & 1) &&
+                               face_equal(faces[i + w + j * n], f))
+                            w++;
+
+                    u64 span = ((1ull << w) - 1) << i;
+
+                    if (greedy && f.ao[0] == f.ao[3] && f.ao[1] == f.ao[2])
+                        for (; j + h < n; h++)
+                        {
+                            bool row_matches = (rows[j + h] & span) == span;
+                            for (int k = 0; k < w && row_matches; k++)
+                                row_matches = face_equal(faces[i + k + (j + h) * n], f);
+                            if (!row_matches)
+                                break;
+                        }
+
+                    for (int y = 0; y < h; y++)
+                        rows[j + y] &= ~span;
+
+                    int3 l;
+                    l[axis] = s, l[u] = i, l[v] = j;
+                    emit_quad(mesh, di, base + l, w, h, f);
+                }
+        }
+    }
+}
+
+void voxel_mesh_build_chunk(
+    voxel_mesh* mesh,
+    const voxel_world* world,
+    const voxel_chunk* chunk,
+    u32 flags)
+{
+    // worlds are clamped to voxel_world_max_resolution, which fits
+    assert(world->resolution <= voxel_vertex_max_coordinate);
+
+    if (flags & voxel_mesh_flag_reference)
+    {
+        build_chunk(mesh, chunk, nullptr, world, flags);
+        return;
+    }
+
+    chunk_occupancy occ;
+    occupancy_columns_build(occ.columns, world, chunk);
+    occupancy_faces_build(&occ);
+    build_chunk(mesh, chunk, &occ, nullptr, flags);
+}
+
+// Box of the overlay in local coordinates of the chunk, clipped to the world
+// and to border voxels at -1 and voxel_chunk_size. False if nothing is left.
+static bool overlay_local_box(
+    const voxel_world* world,
+    const voxel_mesh_overlay* overlay,
+    const int3& chunk_coords,
+    int3* out_lo,
+    int3* out_hi)
+{
+    if (!overlay)
+        return false;
+
+    const int3 base = chunk_coords * voxel_chunk_size;
+    const int3 mn = glm::max(overlay->box.min, int3{0});
+    const int3 mx = glm::min(overlay->box.max, int3{world->resolution - 1});
+    *out_lo = glm::max(mn - base, int3{-1});
+    *out_hi = glm::min(mx - base, int3{voxel_chunk_size});
+    return !glm::any(glm::greaterThan(*out_lo, *out_hi));
+}
+
+bool voxel_mesh_overlay_fills_chunk(
+    const voxel_world* world,
+    const voxel_mesh_overlay* overlay,
+    const int3& chunk_coords)
+{
+    int3 lo, hi;
+    if (!overlay || !(overlay->clip || (overlay->leaf.flags & voxel_flag_solid)) ||
+        !overlay_local_box(world, overlay, chunk_coords, &lo, &hi))
+        return false;
+
+    // only touching the border of the chunk is not enough
+    return glm::all(glm::greaterThanEqual(hi, int3{0})) &&
+           glm::all(glm::lessThan(lo, int3{voxel_chunk_size}));
+}
+
+void voxel_mesh_snapshot_take(
+    voxel_mesh_snapshot* snapshot,
+    const voxel_world* world,
+    const int3& chunk_coords,
+    const voxel_mesh_overlay* overlay)
+{
+    assert(world->resolution <= voxel_vertex_max_coordinate);
+    const voxel_chunk* chunk = voxel_world_find_chunk(world, chunk_coords);
+    if (chunk)
+        voxel_chunk_copy(&snapshot->chunk, chunk);
+    else
+        voxel_chunk_copy_empty(&snapshot->chunk, chunk_coords);
+
+    int3 lo, hi;
+    const bool overlaps = overlay_local_box(world, overlay, chunk_coords, &lo, &hi);
+    if (overlaps && overlay->clip)
+        voxel_clip_paste_chunk(
+            &snapshot->chunk, *overlay->clip, overlay->box.min, world->resolution, nullptr);
+    else if (overlaps)
+    {
+        const int3 inner_lo = glm::max(lo, int3{0});
+        const int3 inner_hi = glm::min(hi, int3{voxel_chunk_mask});
+        if (!glm::any(glm::greaterThan(inner_lo, inner_hi)))
+        {
+            const u32 index = voxel_chunk_palette_add(&snapshot->chunk, overlay->leaf);
+            voxel_chunk_fill_box(&snapshot->chunk, inner_lo, inner_hi, index);
+        }
+    }
+
+    // The copy already has the overlay, of the neighbors only the border
+    // voxels are read and those get it drawn over their bits.
+    occupancy_columns_build(snapshot->occupancy, world, &snapshot->chunk);
+    if (!overlaps)
+        return;
+
+    const u64 bits = (~0ull >> (63 - (hi.x - lo.x))) << (lo.x + 1);
+    const bool solid = (overlay->leaf.flags & voxel_flag_solid) != 0;
+    const int3 base = chunk_coords * voxel_chunk_size;
+    for (int z = lo.z; z <= hi.z; z++)
+        for (int y = lo.y; y <= hi.y; y++)
+        {
+            u64& column = snapshot->occupancy[occupancy_column(y, z)];
+            if (overlay->clip)
+            {
+                // voxels -1 to 30 of the row, then 31 and 32
+                const voxel_clip& clip = *overlay->clip;
+                const int3 p = overlay->box.min;
+                const i32 wx = base.x - 1;
+                const i32 wy = base.y + y;
+                const i32 wz = base.z + z;
+                const u64 first = voxel_clip_row(clip, p, wx, wy, wz);
+                const u64 last = voxel_clip_row(clip, p, wx + voxel_chunk_size, wy, wz);
+                column |= (first | ((last & 3) << 32)) & bits;
+            }
+            else
+                column = solid ? column | bits : column & ~bits;
+        }
+}
+
+void voxel_mesh_build_snapshot(voxel_mesh* mesh, const voxel_mesh_snapshot* snapshot, u32 flags)
+{
+    chunk_occupancy occ;
+    std::copy(
+        snapshot->occupancy, snapshot->occupancy + occupancy_size * occupancy_size, occ.columns);
+    occupancy_faces_build(&occ);
+    build_chunk(mesh, &snapshot->chunk, &occ, nullptr, flags & ~voxel_mesh_flag_reference);
+}
+
+bool voxel_mesh_affected_chunks(
+    const voxel_world* world,
+    const bounds3i& region,
+    bounds3i* out_chunks)
+{
+    // A voxel affects the culling and AO of the faces of all voxels
+    // within one step of it, so grow the region by one voxel.
+    int3 mn = glm::max(region.min - 1, int3(0));
+    int3 mx = glm::min(region.max + 1, int3(world->resolution - 1));
+    if (glm::any(glm::greaterThan(mn, mx)))
+        return false;
+
+    out_chunks->min = voxel_chunk_coords(mn);
+    out_chunks->max = voxel_chunk_coords(mx);
+    return true;
+}
+
+void voxel_mesh_build(voxel_mesh* mesh, const voxel_world* world, u32 flags)
+{
+    voxel_mesh_clear(mesh);
+
+    array<int3> coords;
+    voxel_world_chunk_coords(world, &coords);
+    for (int i = 0; i < coords.size(); i++)
+    {
+        if (const voxel_chunk* chunk = voxel_world_find_chunk(world, coords[i]))
+            voxel_mesh_build_chunk(mesh, world, chunk, flags);
+    }
+}
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+#include "common/array.h"
+
+namespace vx
+{
+enum voxel_mesh_flag
+{
+    // merge coplanar faces with equal color and ambient occlusion into larger quads
+    voxel_mesh_flag_greedy = 1 << 0,
+
+    // Cull faces and sample AO with per-voxel neighbor lookups instead of the
+    // occupancy bit columns. Produces the same mesh, slower; kept as a
+    // reference for benchmarks.
+    voxel_mesh_flag_reference = 1 << 1,
+};
+
+// A mesh vertex packed into two words:
+//
+//   word 0: x (12 bits), y (12 bits), normal (3 bits), ao (2 bits)
+//   word 1: z (12 bits), color (16 bits, rgb565)
+//
+// Positions are corners of the voxel grid, 0..resolution per axis, the shader
+// maps them into the scene bounds. The normal indexes voxel_mesh_normals and
+// ao is the occlusion in steps of 0.5.
+struct voxel_vertex
+{
+    u32 xy_normal_ao;
+    u32 z_color;
+};
+
+static_assert(sizeof(voxel_vertex) == 8, "Voxel vertices must stay packed");
+
+constexpr i32 voxel_vertex_max_coordinate = (1 << 12) - 1;
+static_assert(
+    voxel_world_max_resolution <= voxel_vertex_max_coordinate,
+    "Worlds must fit into the coordinates of voxel vertices");
+
+// +x, +y, +z, -x, -y, -z
+extern const float3 voxel_mesh_normals[6];
+
+inline u16 voxel_color_pack_rgb565(const float3& color)
+{
+    u32 r = u32(glm::clamp(color.r, 0.0f, 1.0f) * 31.0f + 0.5f);
+    u32 g = u32(glm::clamp(color.g, 0.0f, 1.0f) * 63.0f + 0.5f);
+    u32 b = u32(glm::clamp(color.b, 0.0f, 1.0f) * 31.0f + 0.5f);
+    return u16(r | (g << 5) | (b << 11));
+}
+
+inline float3 voxel_color_unpack_rgb565(u16 color)
+{
+    return float3{
+        (color & 0x1f) / 31.0f, ((color >> 5) & 0x3f) / 63.0f, ((color >> 11) & 0x1f) / 31.0f};
+}
+
+inline voxel_vertex voxel_vertex_pack(const int3& pos, u32 normal, u32 ao_steps, u16 color)
+{
+    voxel_vertex v;
+    v.xy_normal_ao = u32(pos.x) | (u32(pos.y) << 12) | (normal << 24) | (ao_steps << 27);
+    v.z_color = u32(pos.z) | (u32(color) << 12);
+    return v;
+}
+
+inline int3 voxel_vertex_position(const voxel_vertex& v)
+{
+    return int3{v.xy_normal_ao & 0xfff, (v.xy_normal_ao >> 12) & 0xfff, v.z_color & 0xfff};
+}
+
+inline u32 voxel_vertex_normal(const voxel_vertex& v) { return (v.xy_normal_ao >> 24) & 0x7; }
+
+inline float voxel_vertex_ao(const voxel_vertex& v)
+{
+    return 0.5f * ((v.xy_normal_ao >> 27) & 0x3);
+}
+
+inline float3 voxel_vertex_color(const voxel_vertex& v)
+{
+    return voxel_color_unpack_rgb565(u16(v.z_color >> 12));
+}
+
+struct voxel_mesh
+{
+    array<voxel_vertex> vertices;
+    array<int3> triangles;
+
+    // exposed voxel faces, before any merging
+    u32 face_count;
+};
+
+void voxel_mesh_clear(voxel_mesh* mesh);
+
+// Append the faces of a single chunk. Faces are only merged within the chunk,
+// neighbors across chunk boundaries are looked up in the world.
+void voxel_mesh_build_chunk(
+    voxel_mesh* mesh,
+    const voxel_world* world,
+    const voxel_chunk* chunk,
+    u32 flags);
+
+// Copy of a chunk and the occupancy of a one voxel border around it, enough to
+// mesh the chunk without access to the world. Meant for meshing on another
+// thread while the world keeps changing.
+constexpr i32 voxel_mesh_border_size = voxel_chunk_size + 2;
+
+struct voxel_mesh_snapshot
+{
+    voxel_chunk chunk;
+    u64 occupancy[voxel_mesh_border_size * voxel_mesh_border_size];
+};
+
+struct voxel_clip;
+
+// A box of voxels drawn over the world while meshing, without changing it.
+// Meant for previews of edits, moving the box only needs the chunks of its
+// old and new box remeshed, not a copy of the world.
+struct voxel_mesh_overlay
+{
+    // inclusive, clipped to the world when meshing
+    bounds3i box;
+    voxel_leaf leaf;
+
+    // If not null the solid voxels of the clip pasted at box.min are drawn
+    // instead of filling the box with leaf, box is then voxel_clip_bounds.
+    const voxel_clip* clip;
+};
+
+// True if the overlay puts solid voxels into the chunk, which then needs a
+// mesh even if the world has no chunk there. overlay may be null.
+bool voxel_mesh_overlay_fills_chunk(
+    const voxel_world* world,
+    const voxel_mesh_overlay* overlay,
+    const int3& chunk_coords);
+
+// Snapshot the chunk of the world at chunk_coords with the overlay, if not
+// null, drawn over it and its border. A chunk missing from the world is taken
+// as empty. snapshot is either zeroed or taken before, its chunk is freed with
+// voxel_chunk_free_copy.
+void voxel_mesh_snapshot_take(
+    voxel_mesh_snapshot* snapshot,
+    const voxel_world* world,
+    const int3& chunk_coords,
+    const voxel_mesh_overlay* overlay);
+
+// same as voxel_mesh_build_chunk, voxel_mesh_flag_reference is ignored
+void voxel_mesh_build_snapshot(voxel_mesh* mesh, const voxel_mesh_snapshot* snapshot, u32 flags);
+
+// Find the inclusive range of chunks whose mesh depends on the voxels in the
+// inclusive box region. Returns false if there are none.
+bool voxel_mesh_affected_chunks(
+    const voxel_world* world,
+    const bounds3i& region,
+    bounds3i* out_chunks);
+
+// clear the mesh and build all chunks of the world into it
+void voxel_mesh_build(voxel_mesh* mesh, const voxel_world* world, u32 flags);
+}
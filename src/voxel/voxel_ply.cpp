@@ -0,0 +1,301 @@
+#include "voxel/voxel_ply.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace vx
+{
+namespace
+{
+// old and new names by type
+const char* const ply_type_names[ply_type_count][2] = {
+    {"char", "int8"},
+    {"uchar", "uint8"},
+    {"short", "int16"},
+    {"ushort", "uint16"},
+    {"int", "int32"},
+    {"uint", "uint32"},
+    {"float", "float32"},
+    {"double", "float64"},
+};
+
+bool parse_ply_type(const text_word& w, ply_type* out_type)
+{
+    for (int i = 0; i < ply_type_count; i++)
+    {
+        if (text_word_is(w, ply_type_names[i][0]) || text_word_is(w, ply_type_names[i][1]))
+        {
+            *out_type = (ply_type)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+ply_role vertex_role(const text_word& name)
+{
+    if (text_word_is(name, "x"))
+        return ply_role_x;
+    if (text_word_is(name, "y"))
+        return ply_role_y;
+    if (text_word_is(name, "z"))
+        return ply_role_z;
+    if (text_word_is(name, "red") || text_word_is(name, "r") ||
+        text_word_is(name, "diffuse_red"))
+        return ply_role_red;
+    if (text_word_is(name, "green") || text_word_is(name, "g") ||
+        text_word_is(name, "diffuse_green"))
+        return ply_role_green;
+    if (text_word_is(name, "blue") || text_word_is(name, "b") ||
+        text_word_is(name, "diffuse_blue"))
+        return ply_role_blue;
+    return ply_role_none;
+}
+
+}
+
+//
+// text
+//
+
+void text_skip_line(text_range* t)
+{
+    const void* newline = std::memchr(t->p, '\n', t->end - t->p);
+    t->p = newline ? (const char*)newline + 1 : t->end;
+}
+
+bool text_parse_int(text_range* t, i64* out)
+{
+    const char* p = t->p;
+    bool negative = false;
+    if (p < t->end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+    if (p == t->end || !text_is_digit(*p))
+        return false;
+
+    i64 v = 0;
+    for (; p < t->end && text_is_digit(*p); p++)
+    {
+        if (v > (INT64_MAX - 9) / 10)
+            return false;
+        v = v * 10 + (*p - '0');
+    }
+
+    t->p = p;
+    *out = negative ? -v : v;
+    return true;
+}
+
+// strtod needs a null terminator and goes through the locale. Scans have
+// tens of millions of numbers and this is several times faster, exact to a
+// few units in the last place, which is plenty for floats.
+bool text_parse_float(text_range* t, double* out)
+{
+    static const double powers_of_10[] = {
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    const char* p = t->p;
+    bool negative = false;
+    if (p < t->end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    // the first 19 significant digits, the exponent accounts for the rest
+    u64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    for (; p < t->end && text_is_digit(*p); p++)
+    {
+        any_digits = true;
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }
+        else
+            exponent++;
+    }
+    if (p < t->end && *p == '.')
+    {
+        for (p++; p < t->end && text_is_digit(*p); p++)
+        {
+            any_digits = true;
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+    if (!any_digits)
+        return false;
+
+    if (p < t->end && (*p == 'e' || *p == 'E'))
+    {
+        text_range e{p + 1, t->end};
+        i64 e10;
+        if (text_parse_int(&e, &e10))
+        {
+            exponent += (int)glm::clamp(e10, (i64)-1000, (i64)1000);
+            p = e.p;
+        }
+    }
+
+    double v = (double)mantissa;
+    if (mantissa == 0)
+        v = 0.0;
+    else if (exponent >= 0 && exponent <= 22)
+        v *= powers_of_10[exponent];
+    else if (exponent < 0 && exponent >= -22)
+        v /= powers_of_10[-exponent];
+    else
+        v *= std::pow(10.0, exponent);
+
+    t->p = p;
+    *out = negative ? -v : v;
+    return true;
+}
+
+text_word text_next_word(text_range* t)
+{
+    text_skip_blanks(t);
+    const char* start = t->p;
+    while (t->p < t->end && !text_is_blank(*t->p) && *t->p != '\n')
+        t->p++;
+    return text_word{start, (int)(t->p - start)};
+}
+
+bool text_word_is(const text_word& w, const char* s)
+{
+    return w.size == (int)std::strlen(s) && std::memcmp(w.p, s, w.size) == 0;
+}
+
+//
+// ply
+//
+
+const int ply_type_sizes[ply_type_count] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+const double ply_type_color_scales[ply_type_count] = {
+    127.0, 255.0, 32767.0, 65535.0, 2147483647.0, 4294967295.0, 1.0, 1.0};
+
+bool ply_parse_header(text_range* t, ply_header* h)
+{
+    if (!text_word_is(text_next_word(t), "ply"))
+        return false;
+    text_skip_line(t);
+
+    bool has_format = false;
+    for (; t->p < t->end; text_skip_line(t))
+    {
+        text_word keyword = text_next_word(t);
+        if (text_word_is(keyword, "end_header"))
+        {
+            text_skip_line(t);
+            return has_format;
+        }
+
+        if (text_word_is(keyword, "format"))
+        {
+            text_word format = text_next_word(t);
+            if (text_word_is(format, "ascii"))
+                h->format = ply_format_ascii;
+            else if (text_word_is(format, "binary_little_endian"))
+                h->format = ply_format_binary_little_endian;
+            else if (text_word_is(format, "binary_big_endian"))
+                h->format = ply_format_binary_big_endian;
+            else
+                return false;
+            has_format = true;
+        }
+        else if (text_word_is(keyword, "element"))
+        {
+            ply_element& e = h->elements.add();
+            text_word name = text_next_word(t);
+            e.vertex = text_word_is(name, "vertex");
+            e.face = text_word_is(name, "face");
+            e.first_property = h->properties.size();
+            e.property_count = 0;
+            text_skip_blanks(t);
+            if (!text_parse_int(t, &e.count) || e.count < 0)
+                return false;
+        }
+        else if (text_word_is(keyword, "property"))
+        {
+            if (!h->elements.size())
+                return false;
+            ply_element& e = h->elements[h->elements.size() - 1];
+            ply_property& prop = h->properties.add();
+            e.property_count++;
+
+            text_word type = text_next_word(t);
+            prop.list = text_word_is(type, "list");
+            if (prop.list && !parse_ply_type(text_next_word(t), &prop.count_type))
+                return false;
+            if (!parse_ply_type(prop.list ? text_next_word(t) : type, &prop.type))
+                return false;
+
+            text_word name = text_next_word(t);
+            prop.role = ply_role_none;
+            if (e.vertex && !prop.list)
+                prop.role = vertex_role(name);
+            else if (e.face && prop.list &&
+                     (text_word_is(name, "vertex_indices") || text_word_is(name, "vertex_index")))
+                prop.role = ply_role_vertex_indices;
+        }
+        // comment, obj_info and anything else are skipped
+    }
+    return false;
+}
+
+int ply_record_size(const ply_header& h, const ply_element& e)
+{
+    if (h.format == ply_format_ascii)
+        return 0;
+
+    int size = 0;
+    for (int i = 0; i < e.property_count; i++)
+    {
+        const ply_property& prop = h.properties[e.first_property + i];
+        if (prop.list)
+            return 0;
+        size += ply_type_sizes[prop.type];
+    }
+    return size;
+}
+
+double ply_read(ply_reader* r, ply_type type)
+{
+    if (r->format == ply_format_ascii)
+    {
+        text_range t{(const char*)r->p, (const char*)r->end};
+        while (t.p < t.end && (text_is_blank(*t.p) || *t.p == '\n'))
+            t.p++;
+
+        double v;
+        if (!text_parse_float(&t, &v))
+        {
+            r->ok = false;
+            r->p = r->end;
+            return 0.0;
+        }
+        r->p = (const u8*)t.p;
+        return v;
+    }
+
+    const int size = ply_type_sizes[type];
+    if (r->end - r->p < size)
+    {
+        r->ok = false;
+        r->p = r->end;
+        return 0.0;
+    }
+
+    const double v = ply_decode(r->p, type, r->format);
+    r->p += size;
+    return v;
+}
+}
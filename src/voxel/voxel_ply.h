@@ -0,0 +1,196 @@
+#pragma once
+
+#include "common/array.h"
+
+#include <cstring>
+#include <utility>
+
+namespace vx
+{
+//
+// text
+//
+
+// Text of a mapped file or a block read from one, not null terminated.
+struct text_range
+{
+    const char* p;
+    const char* end;
+};
+
+inline bool text_is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool text_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+inline void text_skip_blanks(text_range* t)
+{
+    while (t->p < t->end && text_is_blank(*t->p))
+        t->p++;
+}
+
+// past the next newline
+void text_skip_line(text_range* t);
+
+// false and t unchanged if t does not start with a number
+bool text_parse_int(text_range* t, i64* out);
+bool text_parse_float(text_range* t, double* out);
+
+// a blank separated word of the current line
+struct text_word
+{
+    const char* p;
+    int size;
+};
+
+text_word text_next_word(text_range* t);
+bool text_word_is(const text_word& w, const char* s);
+
+//
+// ply
+//
+
+enum ply_type
+{
+    ply_type_int8,
+    ply_type_uint8,
+    ply_type_int16,
+    ply_type_uint16,
+    ply_type_int32,
+    ply_type_uint32,
+    ply_type_float32,
+    ply_type_float64,
+    ply_type_count,
+};
+
+extern const int ply_type_sizes[ply_type_count];
+
+// full intensity of color properties
+extern const double ply_type_color_scales[ply_type_count];
+
+enum ply_format
+{
+    ply_format_ascii,
+    ply_format_binary_little_endian,
+    ply_format_binary_big_endian,
+};
+
+// what a property is read into
+enum ply_role
+{
+    ply_role_none,
+    ply_role_x,
+    ply_role_y,
+    ply_role_z,
+    ply_role_red,
+    ply_role_green,
+    ply_role_blue,
+    ply_role_vertex_indices,
+};
+
+struct ply_property
+{
+    ply_type type;
+    bool list;
+    ply_type count_type;
+    ply_role role;
+};
+
+struct ply_element
+{
+    bool vertex;
+    bool face;
+    i64 count;
+
+    // range of the properties of the header
+    int first_property;
+    int property_count;
+};
+
+struct ply_header
+{
+    ply_format format;
+    array<ply_element> elements;
+    array<ply_property> properties;
+};
+
+// leaves t at the first byte of the body
+bool ply_parse_header(text_range* t, ply_header* h);
+
+// bytes of every record of e, 0 if it has lists or the format is ascii
+int ply_record_size(const ply_header& h, const ply_element& e);
+
+// A failed read clears ok and reads zeroes from then on.
+struct ply_reader
+{
+    const u8* p;
+    const u8* end;
+    ply_format format;
+    bool ok;
+};
+
+double ply_read(ply_reader* r, ply_type type);
+
+// a value of a binary body at p
+inline double ply_decode(const u8* p, ply_type type, ply_format format)
+{
+    // Every platform we build for is little endian.
+    const int size = ply_type_sizes[type];
+    u8 bytes[8];
+    std::memcpy(bytes, p, size);
+    if (format == ply_format_binary_big_endian)
+        for (int i = 0; i < size / 2; i++)
+            std::swap(bytes[i], bytes[size - 1 - i]);
+
+    switch (type)
+    {
+        case ply_type_int8:
+            return (double)(i8)bytes[0];
+        case ply_type_uint8:
+            return (double)bytes[0];
+        case ply_type_int16:
+        {
+            i16 v;
+            std::memcpy(&v, bytes, sizeof v);
+            return v;
+        }
+        case ply_type_uint16:
+        {
+            u16 v;
+            std::memcpy(&v, bytes, sizeof v);
+            return v;
+        }
+        case ply_type_int32:
+        {
+            i32 v;
+            std::memcpy(&v, bytes, sizeof v);
+            return v;
+        }
+        case ply_type_uint32:
+        {
+            u32 v;
+            std::memcpy(&v, bytes, sizeof v);
+            return v;
+        }
+        case ply_type_float32:
+        {
+            float v;
+            std::memcpy(&v, bytes, sizeof v);
+            return v;
+        }
+        case ply_type_float64:
+        {
+            double v;
+            std::memcpy(&v, bytes, sizeof v);
+            return v;
+        }
+        default:
+            return 0.0;
+    }
+}
+}
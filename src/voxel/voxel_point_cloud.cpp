@@ -0,0 +1,678 @@
+#include "voxel/voxel_point_cloud.h"
+#include "common/job_system.h"
+#include "platform/filesystem.h"
+#include "voxel/voxel_mesh_export.h"
+#include "voxel/voxel_ply.h"
+#include "voxel/voxel_voxelizer.h"
+
+#include <cfloat>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <utility>
+
+namespace vx
+{
+namespace
+{
+// bytes of the file binned by one job
+constexpr int block_size = 1 << 20;
+
+// longest line of text files
+constexpr int max_line_size = 4096;
+
+// headers are read whole from the start of the file
+constexpr int max_header_size = 64 << 10;
+
+// voxel keys are the chunk index above the index of the voxel in the chunk
+constexpr int key_voxel_bits = 3 * voxel_chunk_size_log2;
+constexpr u64 key_voxel_mask = (1ull << key_voxel_bits) - 1;
+
+// slots of the voxel table of a block to start with
+constexpr int min_slot_count = 1 << 12;
+
+enum cloud_format
+{
+    cloud_format_xyz,
+    cloud_format_ply,
+};
+
+// a vertex property of binary records
+struct cloud_field
+{
+    int offset;
+    ply_type type;
+    ply_role role;
+};
+
+struct cloud
+{
+    FILE* file;
+    cloud_format format;
+    float3 color;
+
+    // of ply files, the vertex element is the only one read
+    ply_header header;
+    int vertex_element;
+    bool colored;
+
+    // bytes of a vertex of binary files and the properties read from it
+    int record_size;
+    array<cloud_field> fields;
+
+    u64 body_offset;
+    i64 vertex_count;
+
+    // read position
+    i64 points_left;
+    array<char> carry;
+    bool end;
+    bool failed;
+
+    // voxel coordinates are (position - origin) * scale, in double, so
+    // georeferenced scans far from the origin keep their precision
+    glm::dvec3 origin;
+    double scale;
+    i32 resolution;
+    i32 grid;
+};
+
+struct voxel_sum
+{
+    u64 key;
+    float3 color;
+    u32 count;
+};
+
+// A block of the file and what a job made of it.
+struct cloud_block
+{
+    const cloud* c;
+    array<char> bytes;
+    int size;
+
+    // vertices of ply files, lines are counted as they are read otherwise
+    int record_count;
+
+    bool ok;
+    u64 point_count;
+    glm::dvec3 min;
+    glm::dvec3 max;
+
+    // The points added up by voxel, sorted by key once the block is done.
+    // Slots index sums by the hash of their keys, -1 if free.
+    array<voxel_sum> sums;
+    array<i32> slots;
+};
+
+//
+// reading
+//
+
+bool has_xyz_extension(const char* path)
+{
+    const char* dot = std::strrchr(path, '.');
+    if (!dot || std::strlen(dot) != 4)
+        return false;
+    for (int i = 0; i < 3; i++)
+        if ((dot[1 + i] | 0x20) != "xyz"[i])
+            return false;
+    return true;
+}
+
+bool cloud_open(cloud* c, const char* path)
+{
+    c->file = std::fopen(path, "rb");
+    if (!c->file)
+    {
+        fprintf(stdout, "Could not read %s\n", path);
+        return false;
+    }
+
+    voxel_mesh_format format;
+    if (has_xyz_extension(path))
+    {
+        c->format = cloud_format_xyz;
+        c->body_offset = 0;
+        c->vertex_count = INT64_MAX;
+        return true;
+    }
+    if (!voxel_mesh_format_from_path(path, &format) || format != voxel_mesh_format_ply)
+    {
+        fprintf(stdout, "%s is not an .xyz or .ply point cloud\n", path);
+        return false;
+    }
+
+    c->format = cloud_format_ply;
+    array<char> header(max_header_size);
+    const usize read = std::fread(header.ptr(), 1, header.size(), c->file);
+    text_range t{header.ptr(), header.ptr() + read};
+    if (!ply_parse_header(&t, &c->header))
+    {
+        fprintf(stdout, "%s is not a valid PLY file\n", path);
+        return false;
+    }
+
+    // Only elements of fixed size records are skipped to get to the
+    // vertices, which scanners write first anyway.
+    c->body_offset = (u64)(t.p - header.ptr());
+    c->vertex_element = -1;
+    for (int i = 0; i < c->header.elements.size() && c->vertex_element < 0; i++)
+    {
+        const ply_element& e = c->header.elements[i];
+        const int record_size = ply_record_size(c->header, e);
+        if (e.vertex)
+            c->vertex_element = i;
+        else if (e.count && !record_size)
+        {
+            fprintf(stdout, "%s has elements before its vertices that cannot be skipped\n", path);
+            return false;
+        }
+        else
+            c->body_offset += (u64)e.count * record_size;
+    }
+    if (c->vertex_element < 0)
+    {
+        fprintf(stdout, "%s has no vertices\n", path);
+        return false;
+    }
+
+    const ply_element& vertices = c->header.elements[c->vertex_element];
+    c->vertex_count = vertices.count;
+    c->record_size = ply_record_size(c->header, vertices);
+    if (c->header.format != ply_format_ascii && !c->record_size)
+    {
+        fprintf(stdout, "%s has vertices of different sizes\n", path);
+        return false;
+    }
+
+    c->colored = false;
+    int offset = 0;
+    for (int i = 0; i < vertices.property_count; i++)
+    {
+        const ply_property& prop = c->header.properties[vertices.first_property + i];
+        c->colored = c->colored || prop.role == ply_role_red;
+        if (prop.role != ply_role_none)
+            c->fields.add(cloud_field{offset, prop.type, prop.role});
+        offset += ply_type_sizes[prop.type];
+    }
+    return true;
+}
+
+bool cloud_rewind(cloud* c)
+{
+    c->points_left = c->vertex_count;
+    c->carry.clear();
+    c->end = false;
+    c->failed = false;
+    return file_seek(c->file, c->body_offset);
+}
+
+// false at the end of the file or on failure
+bool cloud_read(cloud* c, cloud_block* b)
+{
+    b->size = 0;
+    b->record_count = 0;
+    if (c->end || c->points_left <= 0)
+        return false;
+
+    // binary vertices, whole records only
+    if (c->format == cloud_format_ply && c->header.format != ply_format_ascii)
+    {
+        const i64 count = std::min(c->points_left, (i64)(block_size / c->record_size));
+        b->bytes.resize((int)count * c->record_size);
+        if (std::fread(b->bytes.ptr(), c->record_size, (usize)count, c->file) != (usize)count)
+        {
+            fprintf(stdout, "Point cloud ends before its last vertex\n");
+            c->failed = true;
+            return false;
+        }
+        b->size = b->bytes.size();
+        b->record_count = (int)count;
+        c->points_left -= count;
+        return true;
+    }
+
+    // text, whole lines only, the rest is carried over to the next block
+    b->bytes.resize(block_size + max_line_size);
+    const int carried = c->carry.size();
+    if (carried)
+        std::memcpy(b->bytes.ptr(), c->carry.ptr(), carried);
+    const usize read = std::fread(b->bytes.ptr() + carried, 1, block_size, c->file);
+    b->size = carried + (int)read;
+    c->end = read < (usize)block_size;
+    c->carry.clear();
+
+    const char* p = b->bytes.ptr();
+    int line_end = b->size;
+    if (!c->end)
+    {
+        while (line_end > 0 && p[line_end - 1] != '\n')
+            line_end--;
+        if (b->size - line_end > max_line_size || line_end == 0)
+        {
+            fprintf(stdout, "Point cloud has lines longer than %d bytes\n", max_line_size);
+            c->failed = true;
+            return false;
+        }
+        c->carry.resize(b->size - line_end);
+        if (c->carry.size())
+            std::memcpy(c->carry.ptr(), p + line_end, c->carry.size());
+        b->size = line_end;
+    }
+
+    // ascii vertices, up to the lines of the elements after them
+    if (c->format == cloud_format_ply)
+    {
+        int lines = 0;
+        int i = 0;
+        for (; i < b->size && lines < c->points_left; i++)
+            lines += p[i] == '\n';
+        if (lines < c->points_left && i > 0 && p[i - 1] != '\n')
+            lines++;
+        b->size = i;
+        b->record_count = lines;
+        c->points_left -= lines;
+        if (c->end && c->points_left > 0)
+        {
+            fprintf(stdout, "Point cloud ends before its last vertex\n");
+            c->failed = true;
+            return false;
+        }
+    }
+    return b->size > 0;
+}
+
+//
+// points
+//
+
+// Calls fn with the position and color of every point of the block with a
+// finite position. False if the block is not valid.
+template<typename Fn>
+bool visit_points(const cloud_block* b, Fn fn)
+{
+    const cloud* c = b->c;
+    if (c->format == cloud_format_xyz)
+    {
+        for (text_range t{b->bytes.ptr(), b->bytes.ptr() + b->size}; t.p < t.end;
+             text_skip_line(&t))
+        {
+            double v[7];
+            int n = 0;
+            for (; n < 7; n++)
+            {
+                text_skip_blanks(&t);
+                if (!text_parse_float(&t, &v[n]))
+                    break;
+            }
+            if (n < 3)
+                continue;
+
+            const glm::dvec3 p{v[0], v[1], v[2]};
+            float3 color = c->color;
+            if (n == 6 || n == 7)
+                color = float3((float)v[n - 3], (float)v[n - 2], (float)v[n - 1]) / 255.0f;
+            if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+                fn(p, color);
+        }
+        return true;
+    }
+
+    // Binary records are only decoded where the properties read are,
+    // scans carry normals, intensities and more in them.
+    if (c->header.format != ply_format_ascii)
+    {
+        const u8* record = (const u8*)b->bytes.ptr();
+        for (int i = 0; i < b->record_count; i++, record += c->record_size)
+        {
+            glm::dvec3 p{0.0};
+            float3 color = c->colored ? float3{1.0f} : c->color;
+            for (int j = 0; j < c->fields.size(); j++)
+            {
+                const cloud_field& f = c->fields[j];
+                const double v = ply_decode(record + f.offset, f.type, c->header.format);
+                if (f.role >= ply_role_x && f.role <= ply_role_z)
+                    p[f.role - ply_role_x] = v;
+                else if (f.role >= ply_role_red && f.role <= ply_role_blue)
+                    color[f.role - ply_role_red] = (float)(v / ply_type_color_scales[f.type]);
+            }
+            if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+                fn(p, color);
+        }
+        return true;
+    }
+
+    const ply_element& e = c->header.elements[c->vertex_element];
+    const ply_property* properties = c->header.properties.ptr() + e.first_property;
+    ply_reader r{
+        (const u8*)b->bytes.ptr(), (const u8*)b->bytes.ptr() + b->size, c->header.format, true};
+    for (int i = 0; i < b->record_count && r.ok; i++)
+    {
+        glm::dvec3 p{0.0};
+        float3 color = c->colored ? float3{1.0f} : c->color;
+        for (int j = 0; j < e.property_count; j++)
+        {
+            const ply_property& prop = properties[j];
+            if (prop.list)
+            {
+                const double n = ply_read(&r, prop.count_type);
+                for (int k = 0; k < (int)n && r.ok; k++)
+                    ply_read(&r, prop.type);
+                continue;
+            }
+
+            const double v = ply_read(&r, prop.type);
+            if (prop.role >= ply_role_x && prop.role <= ply_role_z)
+                p[prop.role - ply_role_x] = v;
+            else if (prop.role >= ply_role_red && prop.role <= ply_role_blue)
+                color[prop.role - ply_role_red] = (float)(v / ply_type_color_scales[prop.type]);
+        }
+        if (std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z))
+            fn(p, color);
+    }
+    return r.ok;
+}
+
+void bound_block(void* data)
+{
+    cloud_block* b = (cloud_block*)data;
+    b->point_count = 0;
+    b->min = glm::dvec3{DBL_MAX};
+    b->max = glm::dvec3{-DBL_MAX};
+    b->ok = visit_points(b, [b](const glm::dvec3& p, const float3&) {
+        b->min = glm::min(b->min, p);
+        b->max = glm::max(b->max, p);
+        b->point_count++;
+    });
+}
+
+u32 slot_of(u64 key, int slot_count)
+{
+    return (u32)((key * 0x9e3779b97f4a7c15ull) >> 32) & (slot_count - 1);
+}
+
+// the sum of the voxel of key, added if new
+voxel_sum& find_sum(cloud_block* b, u64 key)
+{
+    const int mask = b->slots.size() - 1;
+    for (u32 i = slot_of(key, b->slots.size());; i = (i + 1) & mask)
+    {
+        const i32 slot = b->slots[i];
+        if (slot >= 0 && b->sums[slot].key == key)
+            return b->sums[slot];
+        if (slot >= 0)
+            continue;
+
+        // at most half full, grown by rehashing
+        if (2 * (b->sums.size() + 1) > b->slots.size())
+        {
+            b->slots.resize(2 * b->slots.size());
+            std::fill(b->slots.ptr(), b->slots.ptr() + b->slots.size(), -1);
+            for (int j = 0; j < b->sums.size(); j++)
+            {
+                u32 k = slot_of(b->sums[j].key, b->slots.size());
+                while (b->slots[k] >= 0)
+                    k = (k + 1) & (b->slots.size() - 1);
+                b->slots[k] = j;
+            }
+            return find_sum(b, key);
+        }
+
+        b->slots[i] = b->sums.size();
+        voxel_sum& sum = b->sums.add();
+        sum.key = key;
+        sum.color = float3{0.0f};
+        sum.count = 0;
+        return sum;
+    }
+}
+
+// This is the thread local part. Points are added up in a table by voxel,
+// in file order, so the colors do not depend on the worker count, and
+// every voxel is written into the world once per block.
+void bin_block(void* data)
+{
+    cloud_block* b = (cloud_block*)data;
+    const cloud* c = b->c;
+    b->point_count = 0;
+    b->sums.clear();
+    if (b->slots.size() < min_slot_count)
+        b->slots.resize(min_slot_count);
+    std::fill(b->slots.ptr(), b->slots.ptr() + b->slots.size(), -1);
+
+    b->ok = visit_points(b, [b, c](const glm::dvec3& p, const float3& color) {
+        const glm::dvec3 v = glm::floor((p - c->origin) * c->scale);
+        const int3 voxel = glm::clamp(int3{v}, int3{0}, int3{c->resolution - 1});
+        const int3 chunk = voxel_chunk_coords(voxel);
+        const u64 chunk_index = chunk.x + c->grid * (chunk.y + (u64)c->grid * chunk.z);
+        const u64 local = (u64)voxel_chunk_index(voxel_chunk_local(voxel));
+        voxel_sum& sum = find_sum(b, chunk_index << key_voxel_bits | local);
+        sum.color += color;
+        sum.count++;
+        b->point_count++;
+    });
+
+    // by chunk, so the world is searched once per chunk
+    std::sort(
+        b->sums.ptr(), b->sums.ptr() + b->sums.size(), [](const voxel_sum& x, const voxel_sum& y) {
+            return x.key < y.key;
+        });
+}
+
+// Runs fn on the blocks of the file, a set of a block per worker at a time.
+// The next set is read while the workers are busy with one, and merge runs
+// on the main thread on the blocks done, in file order.
+template<typename Merge>
+bool run_pass(cloud* c, job_system* jobs, array<cloud_block>* sets, job_fn fn, Merge merge)
+{
+    if (!cloud_rewind(c))
+        return false;
+
+    int counts[2] = {0, 0};
+    auto read_set = [c, sets, &counts](int s) {
+        counts[s] = 0;
+        while (counts[s] < sets[s].size() && cloud_read(c, &sets[s][counts[s]]))
+            counts[s]++;
+    };
+    auto submit_set = [jobs, sets, fn, &counts](int s) {
+        for (int i = 0; i < counts[s]; i++)
+            job_system_submit(jobs, fn, &sets[s][i]);
+    };
+
+    bool ok = true;
+    read_set(0);
+    submit_set(0);
+    for (int s = 0; counts[s] && ok; s ^= 1)
+    {
+        read_set(s ^ 1);
+        job_system_wait(jobs);
+        submit_set(s ^ 1);
+        for (int i = 0; i < counts[s]; i++)
+        {
+            ok = ok && sets[s][i].ok;
+            if (ok)
+                merge(sets[s][i]);
+        }
+    }
+    job_system_wait(jobs);
+    return ok && !c->failed;
+}
+
+// Color sums of the voxels of each chunk by chunk index, with the point
+// count in flags, until all points are in.
+using chunk_sums = std::unordered_map<u64, voxel_leaf*>;
+
+void add_sums(chunk_sums* sums, const cloud_block& b)
+{
+    voxel_leaf* leaves = nullptr;
+    u64 chunk_index = ~0ull;
+    for (int i = 0; i < b.sums.size(); i++)
+    {
+        const voxel_sum& sum = b.sums[i];
+        if (sum.key >> key_voxel_bits != chunk_index)
+        {
+            chunk_index = sum.key >> key_voxel_bits;
+            voxel_leaf*& chunk = (*sums)[chunk_index];
+            if (!chunk)
+                chunk = (voxel_leaf*)std::calloc(voxel_chunk_volume, sizeof(voxel_leaf));
+            if (!chunk)
+                fatal("Out of memory while voxelizing");
+            leaves = chunk;
+        }
+
+        voxel_leaf& leaf = leaves[sum.key & key_voxel_mask];
+        leaf.color += sum.color;
+        leaf.flags += sum.count;
+    }
+}
+
+u64 finish_voxels(const cloud* c, voxel_world* world, const chunk_sums& sums)
+{
+    u64 voxel_count = 0;
+    for (auto& entry : sums)
+    {
+        const u64 chunk_index = entry.first;
+        const int3 coords{
+            (int)(chunk_index % c->grid),
+            (int)(chunk_index / c->grid % c->grid),
+            (int)(chunk_index / c->grid / c->grid)};
+        voxel_chunk* chunk = voxel_world_touch_chunk(world, coords);
+
+        // at most a leaf per voxel, reserved so the indices are packed once
+        u32 count = 0;
+        for (i32 i = 0; i < voxel_chunk_volume; i++)
+            count += entry.second[i].flags != 0;
+        voxel_chunk_palette_reserve(chunk, count);
+
+        for (i32 i = 0; i < voxel_chunk_volume; i++)
+        {
+            const voxel_leaf& sum = entry.second[i];
+            if (sum.flags)
+                voxel_chunk_set(
+                    chunk,
+                    i,
+                    voxel_leaf{sum.color / (float)sum.flags, voxel_flag_solid});
+        }
+        voxel_count += chunk->solid_count;
+    }
+    return voxel_count;
+}
+
+bool voxelize_cloud(cloud* c, voxel_world* world, i32 worker_count, voxel_point_cloud_stats* stats)
+{
+    job_system* jobs = job_system_create(worker_count);
+    const int blocks = std::max((int)job_system_worker_count(jobs), 1);
+    array<cloud_block> sets[2];
+    for (array<cloud_block>& set : sets)
+    {
+        set.resize(blocks);
+        for (int i = 0; i < blocks; i++)
+            set[i].c = c;
+    }
+
+    glm::dvec3 min{DBL_MAX};
+    glm::dvec3 max{-DBL_MAX};
+    chunk_sums sums;
+    stats->point_count = 0;
+    bool ok = run_pass(c, jobs, sets, bound_block, [&](const cloud_block& b) {
+        min = glm::min(min, b.min);
+        max = glm::max(max, b.max);
+        stats->point_count += b.point_count;
+    });
+
+    if (ok)
+    {
+        const glm::dvec3 size = max - min;
+        const double longest = std::max(size.x, std::max(size.y, size.z));
+        c->origin = stats->point_count ? min : glm::dvec3{0.0};
+        c->scale = longest > 0.0 ? c->resolution / longest : 1.0;
+        ok = run_pass(c, jobs, sets, bin_block, [&sums](const cloud_block& b) {
+            add_sums(&sums, b);
+        });
+    }
+    job_system_destroy(jobs);
+
+    if (ok)
+        stats->voxel_count = finish_voxels(c, world, sums);
+    for (auto& entry : sums)
+        std::free(entry.second);
+    return ok;
+}
+}
+
+bool voxel_point_cloud_detect(const char* path)
+{
+    if (has_xyz_extension(path))
+        return true;
+
+    voxel_mesh_format format;
+    if (!voxel_mesh_format_from_path(path, &format) || format != voxel_mesh_format_ply)
+        return false;
+
+    FILE* f = std::fopen(path, "rb");
+    if (!f)
+        return false;
+    array<char> data(max_header_size);
+    const usize read = std::fread(data.ptr(), 1, data.size(), f);
+    std::fclose(f);
+
+    text_range t{data.ptr(), data.ptr() + read};
+    ply_header header;
+    if (!ply_parse_header(&t, &header))
+        return false;
+
+    bool vertices = false;
+    for (int i = 0; i < header.elements.size(); i++)
+    {
+        const ply_element& e = header.elements[i];
+        if (e.face && e.count)
+            return false;
+        vertices = vertices || e.vertex;
+    }
+    return vertices;
+}
+
+bool voxel_point_cloud_voxelize(
+    voxel_world* world,
+    const char* path,
+    const voxel_point_cloud_options& options,
+    voxel_point_cloud_stats* stats)
+{
+    if (options.resolution < 1 || options.resolution > voxel_voxelize_max_resolution)
+    {
+        fprintf(
+            stdout,
+            "Voxelize resolution %d is not in 1..%d\n",
+            options.resolution,
+            voxel_voxelize_max_resolution);
+        return false;
+    }
+
+    using clock = std::chrono::steady_clock;
+    const clock::time_point start = clock::now();
+
+    cloud c;
+    c.file = nullptr;
+    c.color = options.color;
+    c.resolution = options.resolution;
+    c.grid = (options.resolution + voxel_chunk_mask) >> voxel_chunk_size_log2;
+    c.colored = false;
+    c.record_size = 0;
+
+    voxel_world* voxelized = voxel_world_create(options.resolution);
+    bool ok = cloud_open(&c, path) && voxelize_cloud(&c, voxelized, options.worker_count, stats);
+    if (c.file)
+        std::fclose(c.file);
+
+    if (ok)
+    {
+        voxel_world_swap(world, voxelized);
+        stats->seconds = std::chrono::duration<double>(clock::now() - start).count();
+    }
+    else
+        fprintf(stdout, "Could not voxelize %s\n", path);
+    voxel_world_destroy(voxelized);
+    return ok;
+}
+}
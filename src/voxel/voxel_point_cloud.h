@@ -0,0 +1,45 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+
+namespace vx
+{
+struct voxel_point_cloud_options
+{
+    // voxels along the longest side of the cloud, also the resolution of the world
+    i32 resolution;
+
+    // of points without colors
+    float3 color;
+
+    // as in job_system_create
+    i32 worker_count;
+};
+
+struct voxel_point_cloud_stats
+{
+    // points read, not counting those with coordinates that are not finite
+    u64 point_count;
+    u64 voxel_count;
+    double seconds;
+};
+
+// True for .xyz files and .ply files without faces, which are read as point
+// clouds rather than as meshes.
+bool voxel_point_cloud_detect(const char* path);
+
+// Voxels holding any points become solid, colored with the average color of
+// their points. The cloud is scaled uniformly to fit the world and placed in
+// its min corner. XYZ lines are "x y z", "x y z r g b" or "x y z i r g b"
+// with colors from 0 to 255, lines that are not are skipped.
+//
+// The file is streamed twice in blocks, once for the bounds and once for the
+// points, so memory does not grow with its size. Each worker bins a block of
+// points by voxel and adds up their colors before they are written into the
+// world, which is replaced and left untouched on failure.
+bool voxel_point_cloud_voxelize(
+    voxel_world* world,
+    const char* path,
+    const voxel_point_cloud_options& options,
+    voxel_point_cloud_stats* stats);
+}
@@ -0,0 +1,172 @@
+#include "voxel/voxel_pyramid.h"
+#include "voxel/voxel_file.h"
+#include "common/math_utils.h"
+
+namespace vx
+{
+static void set_bit(array<u64>& bits, u32 i, bool value)
+{
+    u64 mask = 1ull << (i & 63);
+    if (value)
+        bits[i >> 6] |= mask;
+    else
+        bits[i >> 6] &= ~mask;
+}
+
+// summarize a base level block from the voxels of its chunk
+static void update_base_block(voxel_pyramid* pyramid, const voxel_world* world, const int3& block)
+{
+    const i32 n = 1 << voxel_pyramid_base_level;
+    static_assert(voxel_chunk_size % n == 0, "Base level blocks must not straddle chunks");
+
+    voxel_pyramid_level& level = pyramid->levels[0];
+    const int3 mn = block * n;
+    const voxel_chunk* chunk = voxel_world_find_chunk(world, voxel_chunk_coords(mn));
+
+    u32 solid = 0;
+    if (chunk)
+    {
+        const int3 l = voxel_chunk_local(mn);
+        for (int z = l.z; z < l.z + n; z++)
+            for (int y = l.y; y < l.y + n; y++)
+                for (int x = l.x; x < l.x + n; x++)
+                    solid += voxel_chunk_is_solid(chunk, voxel_chunk_index(int3{x, y, z}));
+    }
+
+    // Voxels outside of the world are never solid.
+    bool inside = glm::all(glm::lessThanEqual(mn + n, int3{world->resolution}));
+
+    u32 i = voxel_pyramid_block_index(level, block);
+    set_bit(level.any, i, solid != 0);
+    set_bit(level.all, i, inside && solid == n * n * n);
+}
+
+// summarize a block from its 8 children on the level below
+static void update_block(voxel_pyramid* pyramid, int li, const int3& block)
+{
+    const voxel_pyramid_level& child = pyramid->levels[li - 1];
+    voxel_pyramid_level& level = pyramid->levels[li];
+
+    bool any = false, all = true;
+    for (int i = 0; i < 8; i++)
+    {
+        int3 c = 2 * block + int3{i & 1, (i >> 1) & 1, (i >> 2) & 1};
+        if (glm::any(glm::greaterThanEqual(c, int3{child.size})))
+        {
+            all = false;
+            continue;
+        }
+        any = any || voxel_pyramid_any(child, c);
+        all = all && voxel_pyramid_all(child, c);
+    }
+
+    u32 i = voxel_pyramid_block_index(level, block);
+    set_bit(level.any, i, any);
+    set_bit(level.all, i, all);
+}
+
+void voxel_pyramid_build(voxel_pyramid* pyramid, const voxel_world* world)
+{
+    pyramid->resolution = world->resolution;
+    int level_count = 1;
+    while ((1 << (voxel_pyramid_base_level + level_count - 1)) < world->resolution)
+        level_count++;
+    pyramid->levels.resize(level_count);
+
+    for (int li = 0; li < level_count; li++)
+    {
+        const i32 k = voxel_pyramid_base_level + li;
+        voxel_pyramid_level& level = pyramid->levels[li];
+        level.size = (world->resolution + (1 << k) - 1) >> k;
+
+        int words = (pow3(level.size) + 63) / 64;
+        level.any.resize(words);
+        level.all.resize(words);
+        for (int i = 0; i < words; i++)
+            level.any[i] = level.all[i] = 0;
+    }
+
+    const i32 blocks_per_chunk = voxel_chunk_size >> voxel_pyramid_base_level;
+    for (const auto& kv : world->chunks)
+    {
+        int3 base = kv.second->coords * blocks_per_chunk;
+        for (int z = 0; z < blocks_per_chunk; z++)
+            for (int y = 0; y < blocks_per_chunk; y++)
+                for (int x = 0; x < blocks_per_chunk; x++)
+                {
+                    // chunks on the edge may reach past a world of odd resolution
+                    int3 block = base + int3{x, y, z};
+                    if (glm::all(glm::lessThan(block, int3{pyramid->levels[0].size})))
+                        update_base_block(pyramid, world, block);
+                }
+    }
+
+    // Chunks that are still encoded are summarized from their solid count,
+    // decoding them would defeat lazy loading. Their blocks count as
+    // partially solid even if the chunk claims to be full, so rays through
+    // them walk the voxels and decode the chunk, which checks the count,
+    // before anything is hit.
+    voxel_pyramid_level& base_level = pyramid->levels[0];
+    for (const auto& kv : world->encoded_chunks)
+    {
+        const voxel_file_chunk_entry& entry = world->source->view.chunks[kv.second];
+        int3 base = int3{entry.coords[0], entry.coords[1], entry.coords[2]} * blocks_per_chunk;
+
+        for (int z = 0; z < blocks_per_chunk; z++)
+            for (int y = 0; y < blocks_per_chunk; y++)
+                for (int x = 0; x < blocks_per_chunk; x++)
+                {
+                    int3 block = base + int3{x, y, z};
+                    if (glm::any(glm::greaterThanEqual(block, int3{base_level.size})))
+                        continue;
+
+                    u32 i = voxel_pyramid_block_index(base_level, block);
+                    set_bit(base_level.any, i, entry.solid_count != 0);
+                }
+    }
+
+    for (int li = 1; li < pyramid->levels.size(); li++)
+    {
+        i32 size = pyramid->levels[li].size;
+        for (int z = 0; z < size; z++)
+            for (int y = 0; y < size; y++)
+                for (int x = 0; x < size; x++)
+                    update_block(pyramid, li, int3{x, y, z});
+    }
+}
+
+void voxel_pyramid_update(voxel_pyramid* pyramid, const voxel_world* world, const bounds3i& region)
+{
+    assert(pyramid->resolution == world->resolution);
+
+    int3 mn = glm::max(region.min, int3{0});
+    int3 mx = glm::min(region.max, int3{world->resolution - 1});
+    if (glm::any(glm::greaterThan(mn, mx)))
+        return;
+
+    for (int li = 0; li < pyramid->levels.size(); li++)
+    {
+        i32 k = voxel_pyramid_base_level + li;
+        int3 bmn = mn >> k, bmx = mx >> k;
+
+        for (int z = bmn.z; z <= bmx.z; z++)
+            for (int y = bmn.y; y <= bmx.y; y++)
+                for (int x = bmn.x; x <= bmx.x; x++)
+                {
+                    if (li == 0)
+                        update_base_block(pyramid, world, int3{x, y, z});
+                    else
+                        update_block(pyramid, li, int3{x, y, z});
+                }
+    }
+}
+
+usize voxel_pyramid_byte_size(const voxel_pyramid* pyramid)
+{
+    usize size = sizeof(voxel_pyramid);
+    for (int i = 0; i < pyramid->levels.size(); i++)
+        size += sizeof(voxel_pyramid_level) + pyramid->levels[i].any.byte_size() +
+                pyramid->levels[i].all.byte_size();
+    return size;
+}
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+#include "common/array.h"
+
+namespace vx
+{
+// Occupancy of the world at block granularity. Level k holds one bit per
+// block of 2^(voxel_pyramid_base_level + k) voxels per axis telling whether
+// any of its voxels are solid, and one whether all of them are. The top
+// level is a single block covering the whole world.
+//
+// Levels below the base would cost more memory than the chunks they
+// summarize for sparse worlds, queries read those voxels directly.
+constexpr i32 voxel_pyramid_base_level = 3;
+
+struct voxel_pyramid_level
+{
+    i32 size;
+    array<u64> any;
+    array<u64> all;
+};
+
+struct voxel_pyramid
+{
+    i32 resolution;
+    array<voxel_pyramid_level> levels;
+};
+
+// size the pyramid to the world and summarize all of its chunks
+void voxel_pyramid_build(voxel_pyramid* pyramid, const voxel_world* world);
+
+// resummarize the blocks containing the voxels in the inclusive box region
+void voxel_pyramid_update(voxel_pyramid* pyramid, const voxel_world* world, const bounds3i& region);
+
+inline u32 voxel_pyramid_block_index(const voxel_pyramid_level& level, const int3& block)
+{
+    return (u32)(block.x + level.size * (block.y + level.size * block.z));
+}
+
+inline bool voxel_pyramid_any(const voxel_pyramid_level& level, const int3& block)
+{
+    u32 i = voxel_pyramid_block_index(level, block);
+    return (level.any[i >> 6] >> (i & 63)) & 1;
+}
+
+inline bool voxel_pyramid_all(const voxel_pyramid_level& level, const int3& block)
+{
+    u32 i = voxel_pyramid_block_index(level, block);
+    return (level.all[i >> 6] >> (i & 63)) & 1;
+}
+
+usize voxel_pyramid_byte_size(const voxel_pyramid* pyramid);
+}
@@ -0,0 +1,269 @@
+#include "voxel/voxel_raycast.h"
+
+namespace vx
+{
+namespace
+{
+// a ray in grid units, origin at the grid corner and one unit per voxel
+struct grid_ray
+{
+    float3 o, d;
+    int3 step;
+    float3 t_delta;
+};
+
+// cells crossed by a grid ray, one at a time
+struct grid_walk
+{
+    int3 cell;
+    float3 t_max;
+
+    // where the ray entered cell and the axis of the face it entered through
+    float t;
+    int axis;
+};
+
+// remembers the last chunk looked up, consecutive cells mostly share one
+struct chunk_lookup
+{
+    int3 coords;
+    const voxel_chunk* chunk;
+};
+
+bool grid_ray_begin(
+    grid_ray* gr,
+    grid_walk* walk,
+    i32 resolution,
+    const ray& r,
+    const bounds3f& scene_bounds)
+{
+    const float res = (float)resolution;
+    const float3 voxel_extents = extents(scene_bounds) / res;
+
+    // Scaling the direction as well keeps t in ray units.
+    const float3 o = (r.origin - scene_bounds.min) / voxel_extents;
+    const float3 d = r.direction / voxel_extents;
+    if (d == float3{0.0f})
+        return false;
+
+    // clip the ray against the grid
+    float t_enter = 0.0f, t_exit = INFINITY;
+    int enter_axis = -1;
+    for (int i = 0; i < 3; i++)
+    {
+        if (d[i] == 0.0f)
+        {
+            if (o[i] < 0.0f || o[i] > res)
+                return false;
+            continue;
+        }
+
+        float t0 = (0.0f - o[i]) / d[i];
+        float t1 = (res - o[i]) / d[i];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        if (t0 > t_enter)
+            t_enter = t0, enter_axis = i;
+        t_exit = std::min(t_exit, t1);
+    }
+
+    if (t_enter > t_exit)
+        return false;
+
+    gr->o = o;
+    gr->d = d;
+    for (int i = 0; i < 3; i++)
+    {
+        gr->step[i] = d[i] > 0.0f ? 1 : d[i] < 0.0f ? -1 : 0;
+        gr->t_delta[i] = d[i] != 0.0f ? std::abs(1.0f / d[i]) : INFINITY;
+    }
+
+    // A ray starting inside the grid has no entry face, use the face the
+    // ray points at the most.
+    if (enter_axis < 0)
+    {
+        float3 ad = glm::abs(d);
+        enter_axis = ad.x >= ad.y && ad.x >= ad.z ? 0 : ad.y >= ad.z ? 1 : 2;
+    }
+
+    const float3 p = o + t_enter * d;
+    walk->cell = glm::clamp(int3{glm::floor(p)}, int3{0}, int3{resolution - 1});
+    walk->t = t_enter;
+    walk->axis = enter_axis;
+    return true;
+}
+
+// where the ray leaves walk.cell along each axis
+void grid_walk_reset(grid_walk* walk, const grid_ray& gr)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (gr.step[i] == 0)
+            walk->t_max[i] = INFINITY;
+        else
+            walk->t_max[i] = (walk->cell[i] + (gr.step[i] > 0) - gr.o[i]) / gr.d[i];
+    }
+}
+
+// step into the neighbor across the closest cell boundary
+void grid_walk_step(grid_walk* walk, const grid_ray& gr)
+{
+    const float3& t_max = walk->t_max;
+    int axis = t_max.x < t_max.y ? (t_max.x < t_max.z ? 0 : 2) : (t_max.y < t_max.z ? 1 : 2);
+    walk->axis = axis;
+    walk->t = t_max[axis];
+    walk->cell[axis] += gr.step[axis];
+    walk->t_max[axis] += gr.t_delta[axis];
+}
+
+bool is_solid(chunk_lookup* lookup, const voxel_world* world, const int3& cell)
+{
+    int3 cc = voxel_chunk_coords(cell);
+    if (cc != lookup->coords)
+    {
+        lookup->coords = cc;
+        lookup->chunk = voxel_world_find_chunk(world, cc);
+    }
+
+    return lookup->chunk &&
+           voxel_chunk_is_solid(lookup->chunk, voxel_chunk_index(voxel_chunk_local(cell)));
+}
+
+void hit_from_walk(
+    voxel_raycast_hit* out_hit,
+    const ray& r,
+    const grid_ray& gr,
+    const grid_walk& walk)
+{
+    out_hit->t = walk.t;
+    out_hit->position = r.origin + r.direction * walk.t;
+    out_hit->voxel_coords = walk.cell;
+    out_hit->normal = float3{0.0f};
+    out_hit->normal[walk.axis] = gr.d[walk.axis] > 0.0f ? -1.0f : 1.0f;
+}
+}
+
+bool voxel_world_raycast(
+    const voxel_world* world,
+    const ray& r,
+    const bounds3f& scene_bounds,
+    voxel_raycast_hit* out_hit)
+{
+    grid_ray gr;
+    grid_walk walk;
+    if (!grid_ray_begin(&gr, &walk, world->resolution, r, scene_bounds))
+        return false;
+
+    grid_walk_reset(&walk, gr);
+    chunk_lookup lookup{int3{INT32_MIN}, nullptr};
+
+    for (;;)
+    {
+        if (is_solid(&lookup, world, walk.cell))
+        {
+            hit_from_walk(out_hit, r, gr, walk);
+            return true;
+        }
+
+        grid_walk_step(&walk, gr);
+        if (walk.cell[walk.axis] < 0 || walk.cell[walk.axis] >= world->resolution)
+            return false;
+    }
+}
+
+bool voxel_pyramid_raycast(
+    const voxel_pyramid* pyramid,
+    const voxel_world* world,
+    const ray& r,
+    const bounds3f& scene_bounds,
+    voxel_raycast_hit* out_hit)
+{
+    assert(pyramid->resolution == world->resolution);
+
+    grid_ray gr;
+    grid_walk walk;
+    if (!grid_ray_begin(&gr, &walk, world->resolution, r, scene_bounds))
+        return false;
+
+    chunk_lookup lookup{int3{INT32_MIN}, nullptr};
+    const int top = pyramid->levels.size() - 1;
+    int li = top;
+
+    for (;;)
+    {
+        // Descend to the coarsest block around the cell that is empty. A
+        // block that is entirely solid is hit where the ray enters it.
+        int3 block = walk.cell >> (voxel_pyramid_base_level + li);
+        for (;;)
+        {
+            const voxel_pyramid_level& level = pyramid->levels[li];
+            if (!voxel_pyramid_any(level, block))
+                break;
+
+            if (voxel_pyramid_all(level, block))
+            {
+                hit_from_walk(out_hit, r, gr, walk);
+                return true;
+            }
+
+            if (li == 0)
+                break;
+
+            li--;
+            block = walk.cell >> (voxel_pyramid_base_level + li);
+        }
+
+        const i32 k = voxel_pyramid_base_level + li;
+        if (li == 0 && voxel_pyramid_any(pyramid->levels[0], block))
+        {
+            // walk the voxels of a partially solid base block
+            grid_walk_reset(&walk, gr);
+            do
+            {
+                if (is_solid(&lookup, world, walk.cell))
+                {
+                    hit_from_walk(out_hit, r, gr, walk);
+                    return true;
+                }
+                grid_walk_step(&walk, gr);
+                if (walk.cell[walk.axis] < 0 || walk.cell[walk.axis] >= world->resolution)
+                    return false;
+            } while ((walk.cell[walk.axis] >> k) == block[walk.axis]);
+        }
+        else
+        {
+            // skip the empty block, leaving through the closest boundary
+            const int3 mn = block << k;
+            const int3 mx = glm::min(mn + (1 << k), int3{world->resolution});
+
+            float t = INFINITY;
+            int axis = walk.axis;
+            for (int i = 0; i < 3; i++)
+            {
+                if (gr.step[i] == 0)
+                    continue;
+
+                float ti = ((gr.step[i] > 0 ? mx[i] : mn[i]) - gr.o[i]) / gr.d[i];
+                if (ti < t)
+                    t = ti, axis = i;
+            }
+
+            // Keep the cell inside the block on the other axes so rounding
+            // can never move the walk backwards.
+            const float3 p = gr.o + t * gr.d;
+            int3 cell = glm::clamp(int3{glm::floor(p)}, mn, mx - 1);
+            cell[axis] = gr.step[axis] > 0 ? mx[axis] : mn[axis] - 1;
+
+            walk.cell = cell;
+            walk.t = std::max(t, walk.t);
+            walk.axis = axis;
+        }
+
+        if (walk.cell[walk.axis] < 0 || walk.cell[walk.axis] >= world->resolution)
+            return false;
+
+        // the next block may well be empty at a coarser level again
+        li = std::min(li + 1, top);
+    }
+}
+}
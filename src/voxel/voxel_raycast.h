@@ -0,0 +1,38 @@
+#pragma once
+
+#include "voxel/voxel_pyramid.h"
+#include "voxel/voxel_world.h"
+
+namespace vx
+{
+struct voxel_raycast_hit
+{
+    float t;
+    float3 position;
+    int3 voxel_coords;
+
+    // normal of the face the ray entered the voxel through
+    float3 normal;
+};
+
+// Find the first solid voxel along the ray. The world is mapped onto
+// scene_bounds with resolution voxels per axis and t is in the units of the
+// ray. Walks the cells the ray crosses one by one (3D-DDA, Amanatides & Woo),
+// so the cost scales with the distance travelled through the grid.
+bool voxel_world_raycast(
+    const voxel_world* world,
+    const ray& r,
+    const bounds3f& scene_bounds,
+    voxel_raycast_hit* out_hit);
+
+// Same as voxel_world_raycast, but steps over blocks the pyramid knows to be
+// empty as a whole and stops at blocks it knows to be solid, so the cost scales
+// with the detail near the ray instead. Voxels are only read inside partially
+// solid base level blocks.
+bool voxel_pyramid_raycast(
+    const voxel_pyramid* pyramid,
+    const voxel_world* world,
+    const ray& r,
+    const bounds3f& scene_bounds,
+    voxel_raycast_hit* out_hit);
+}
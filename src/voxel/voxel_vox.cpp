@@ -0,0 +1,913 @@
+#include "voxel/voxel_vox.h"
+#include "platform/filesystem.h"
+
+#include <cstring>
+
+namespace vx
+{
+namespace
+{
+constexpr u32 chunk_id(const char (&id)[5])
+{
+    return u32(u8(id[0])) | u32(u8(id[1])) << 8 | u32(u8(id[2])) << 16 | u32(u8(id[3])) << 24;
+}
+
+constexpr i32 vox_version = 150;
+
+// Chunks are {u32 id, i32 content size, i32 children size} followed by their
+// content and their children. Every read is checked against the end of the
+// chunk, a failed read sets ok and reads zeroes from then on.
+struct reader
+{
+    const u8* p;
+    const u8* end;
+    bool ok;
+};
+
+u32 read_u32(reader* r)
+{
+    u32 v = 0;
+    if (r->end - r->p < 4)
+    {
+        r->ok = false;
+        r->p = r->end;
+        return 0;
+    }
+    std::memcpy(&v, r->p, 4);
+    r->p += 4;
+    return v;
+}
+
+i32 read_i32(reader* r)
+{
+    return (i32)read_u32(r);
+}
+
+// dict strings are not null terminated
+struct vox_string
+{
+    const char* data;
+    i32 size;
+};
+
+vox_string read_string(reader* r)
+{
+    i32 size = read_i32(r);
+    if (size < 0 || r->end - r->p < size)
+    {
+        r->ok = false;
+        r->p = r->end;
+        return vox_string{nullptr, 0};
+    }
+
+    vox_string s{(const char*)r->p, size};
+    r->p += size;
+    return s;
+}
+
+bool string_equal(const vox_string& s, const char* value)
+{
+    return s.size == (i32)std::strlen(value) && std::memcmp(s.data, value, s.size) == 0;
+}
+
+void skip_dict(reader* r)
+{
+    i32 count = read_i32(r);
+    for (i32 i = 0; r->ok && i < count; i++)
+    {
+        read_string(r);
+        read_string(r);
+    }
+}
+
+// p' = rotation * p + translation, rotations are signed axis permutations
+struct vox_transform
+{
+    int3 rows[3];
+    int3 translation;
+};
+
+vox_transform identity_transform()
+{
+    vox_transform t;
+    t.rows[0] = int3{1, 0, 0};
+    t.rows[1] = int3{0, 1, 0};
+    t.rows[2] = int3{0, 0, 1};
+    t.translation = int3{0};
+    return t;
+}
+
+int3 rotate(const vox_transform& t, const int3& p)
+{
+    int3 q;
+    for (int i = 0; i < 3; i++)
+        q[i] = t.rows[i].x * p.x + t.rows[i].y * p.y + t.rows[i].z * p.z;
+    return q;
+}
+
+int3 transform_point(const vox_transform& t, const int3& p)
+{
+    return rotate(t, p) + t.translation;
+}
+
+// parent * child, applying child first
+vox_transform compose(const vox_transform& parent, const vox_transform& child)
+{
+    vox_transform t;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            t.rows[i][j] = parent.rows[i].x * child.rows[0][j] +
+                           parent.rows[i].y * child.rows[1][j] +
+                           parent.rows[i].z * child.rows[2][j];
+    t.translation = transform_point(parent, child.translation);
+    return t;
+}
+
+// Bits 0-1 and 2-3 give the column of the nonzero entry in the first and the
+// second row, bits 4-6 flip the sign of the rows.
+bool decode_rotation(u32 bits, vox_transform* t)
+{
+    int c0 = bits & 3, c1 = (bits >> 2) & 3;
+    if (c0 > 2 || c1 > 2 || c0 == c1)
+        return false;
+
+    int columns[3] = {c0, c1, 3 - c0 - c1};
+    for (int i = 0; i < 3; i++)
+    {
+        t->rows[i] = int3{0};
+        t->rows[i][columns[i]] = (bits >> (4 + i)) & 1 ? -1 : 1;
+    }
+    return true;
+}
+
+// the first frame of a transform node, the others are animation
+bool read_frame(reader* r, vox_transform* t)
+{
+    i32 count = read_i32(r);
+    for (i32 i = 0; r->ok && i < count; i++)
+    {
+        vox_string key = read_string(r);
+        vox_string value = read_string(r);
+        if (!r->ok)
+            break;
+
+        char text[64];
+        if (value.size >= (i32)sizeof text)
+            continue;
+        std::memcpy(text, value.data, value.size);
+        text[value.size] = 0;
+
+        if (string_equal(key, "_r"))
+        {
+            if (!decode_rotation((u32)std::atoi(text), t))
+                return false;
+        }
+        else if (string_equal(key, "_t"))
+        {
+            // Bounded so that composing transforms cannot overflow.
+            int3& p = t->translation;
+            if (std::sscanf(text, "%d %d %d", &p.x, &p.y, &p.z) != 3 ||
+                glm::any(glm::greaterThan(glm::abs(p), int3{1 << 24})))
+                return false;
+        }
+    }
+    return r->ok;
+}
+
+// MagicaVoxel's palette for files without an RGBA chunk, as ABGR
+void default_palette(u32* palette)
+{
+    // A 6x6x6 color cube without black, followed by ramps of red, green,
+    // blue and gray.
+    static const u32 cube[] = {0xff, 0xcc, 0x99, 0x66, 0x33, 0x00};
+    static const u32 ramp[] = {0xee, 0xdd, 0xbb, 0xaa, 0x88, 0x77, 0x55, 0x44, 0x22, 0x11};
+
+    int i = 0;
+    palette[i++] = 0;
+    for (u32 r : cube)
+        for (u32 g : cube)
+            for (u32 b : cube)
+                if (r | g | b)
+                    palette[i++] = 0xff000000 | b << 16 | g << 8 | r;
+    for (int shift = 0; shift < 24; shift += 8)
+        for (u32 v : ramp)
+            palette[i++] = 0xff000000 | v << shift;
+    for (u32 v : ramp)
+        palette[i++] = 0xff000000 | v << 16 | v << 8 | v;
+    assert(i == 256);
+}
+
+struct vox_model
+{
+    int3 size;
+
+    // x, y, z and palette index per voxel, pointing into the file
+    const u8* voxels;
+    u32 voxel_count;
+};
+
+enum node_type
+{
+    node_transform,
+    node_group,
+    node_shape,
+};
+
+struct vox_node
+{
+    node_type type;
+    vox_transform transform;
+
+    // child nodes of transforms and groups, models of shapes
+    array<i32> children;
+};
+
+struct vox_scene
+{
+    array<vox_model> models;
+    std::unordered_map<i32, vox_node> nodes;
+
+    // by palette index, index 0 is never used by voxels
+    u32 palette[256];
+};
+
+bool read_node(reader* r, u32 id, vox_scene* s)
+{
+    i32 node_id = read_i32(r);
+    skip_dict(r);
+
+    vox_node n;
+    n.type = id == chunk_id("nTRN") ? node_transform
+             : id == chunk_id("nGRP") ? node_group
+                                      : node_shape;
+    n.transform = identity_transform();
+
+    if (n.type == node_transform)
+    {
+        n.children.add(read_i32(r));
+        read_i32(r); // reserved
+        read_i32(r); // layer
+        i32 frame_count = read_i32(r);
+        if (frame_count > 0 && !read_frame(r, &n.transform))
+            return false;
+    }
+    else
+    {
+        i32 count = read_i32(r);
+        for (i32 i = 0; r->ok && i < count; i++)
+        {
+            n.children.add(read_i32(r));
+            if (n.type == node_shape)
+                skip_dict(r);
+        }
+    }
+
+    if (r->ok)
+        s->nodes[node_id] = n;
+    return r->ok;
+}
+
+bool parse(vox_scene* s, const u8* data, usize size)
+{
+    reader r{data, data + size, true};
+    if (read_u32(&r) != chunk_id("VOX "))
+        return false;
+    read_i32(&r); // version
+
+    if (read_u32(&r) != chunk_id("MAIN"))
+        return false;
+    i32 main_content = read_i32(&r);
+    read_i32(&r); // children
+    if (!r.ok || main_content < 0 || r.end - r.p < main_content)
+        return false;
+    r.p += main_content;
+
+    default_palette(s->palette);
+    int3 size_of_next{0};
+
+    // The children of MAIN are read up to the end of the file, none of the
+    // other chunks have children of their own.
+    while (r.ok && r.p < r.end)
+    {
+        u32 id = read_u32(&r);
+        i32 content_size = read_i32(&r);
+        i32 children_size = read_i32(&r);
+        if (!r.ok || content_size < 0 || children_size < 0 || r.end - r.p < content_size)
+            return false;
+
+        reader c{r.p, r.p + content_size, true};
+        r.p += content_size;
+
+        if (id == chunk_id("SIZE"))
+        {
+            size_of_next.x = read_i32(&c);
+            size_of_next.y = read_i32(&c);
+            size_of_next.z = read_i32(&c);
+            if (glm::any(glm::lessThanEqual(size_of_next, int3{0})) ||
+                glm::any(glm::greaterThan(size_of_next, int3{voxel_vox_max_resolution})))
+                return false;
+        }
+        else if (id == chunk_id("XYZI"))
+        {
+            u32 count = read_u32(&c);
+            if (size_of_next == int3{0} || (u64)(c.end - c.p) < 4 * (u64)count)
+                return false;
+
+            s->models.add(vox_model{size_of_next, c.p, count});
+            size_of_next = int3{0};
+        }
+        else if (id == chunk_id("RGBA"))
+        {
+            for (int i = 0; i < 255; i++)
+                s->palette[i + 1] = read_u32(&c);
+        }
+        else if (id == chunk_id("nTRN") || id == chunk_id("nGRP") || id == chunk_id("nSHP"))
+        {
+            if (!read_node(&c, id, s))
+                return false;
+        }
+
+        if (!c.ok)
+            return false;
+    }
+    return r.ok;
+}
+
+struct placement
+{
+    const vox_model* model;
+
+    // applied to voxels relative to the model center
+    vox_transform transform;
+};
+
+// walk the scene graph down from node_id
+bool place(
+    const vox_scene& s,
+    i32 node_id,
+    const vox_transform& parent,
+    int depth,
+    array<placement>* out)
+{
+    // Graphs deeper than this are cyclic in practice.
+    if (depth > 64)
+        return false;
+
+    auto it = s.nodes.find(node_id);
+    if (it == s.nodes.end())
+        return false;
+
+    const vox_node& n = it->second;
+    if (n.type == node_shape)
+    {
+        for (int i = 0; i < n.children.size(); i++)
+        {
+            i32 model_index = n.children[i];
+            if (model_index < 0 || model_index >= s.models.size())
+                return false;
+            out->add(placement{&s.models[model_index], parent});
+        }
+        return true;
+    }
+
+    vox_transform t = n.type == node_transform ? compose(parent, n.transform) : parent;
+    for (int i = 0; i < n.children.size(); i++)
+    {
+        if (!place(s, n.children[i], t, depth + 1, out))
+            return false;
+    }
+    return true;
+}
+
+// remembers the chunk of the last voxel written, voxels of a model come in runs
+struct chunk_cursor
+{
+    int3 coords;
+    voxel_chunk* chunk;
+};
+
+void put_voxel(voxel_world* world, chunk_cursor* cursor, const int3& p, const voxel_leaf& leaf)
+{
+    int3 cc = voxel_chunk_coords(p);
+    if (cc != cursor->coords)
+    {
+        cursor->coords = cc;
+        cursor->chunk = voxel_world_touch_chunk(world, cc);
+    }
+
+    voxel_chunk_set(cursor->chunk, voxel_chunk_index(voxel_chunk_local(p)), leaf);
+}
+
+bool import_scene(voxel_world* world, const vox_scene& s)
+{
+    // Turns MagicaVoxel's z up into y up, keeping handedness.
+    vox_transform to_world;
+    to_world.rows[0] = int3{1, 0, 0};
+    to_world.rows[1] = int3{0, 0, 1};
+    to_world.rows[2] = int3{0, -1, 0};
+    to_world.translation = int3{0};
+
+    array<placement> placements;
+    if (s.nodes.empty())
+    {
+        // models are relative to their center, put the corner at the origin instead
+        for (int i = 0; i < s.models.size(); i++)
+        {
+            vox_transform t = to_world;
+            t.translation = rotate(to_world, s.models[i].size / 2);
+            placements.add(placement{&s.models[i], t});
+        }
+    }
+    else if (!place(s, 0, to_world, 0, &placements))
+        return false;
+
+    if (placements.size() == 0)
+        return true;
+
+    // bounds of the transformed model boxes
+    int3 mn{INT32_MAX}, mx{INT32_MIN};
+    for (int i = 0; i < placements.size(); i++)
+    {
+        const placement& pl = placements[i];
+        int3 half = pl.model->size / 2;
+        int3 a = transform_point(pl.transform, -half);
+        int3 b = transform_point(pl.transform, pl.model->size - 1 - half);
+        mn = glm::min(mn, glm::min(a, b));
+        mx = glm::max(mx, glm::max(a, b));
+    }
+
+    i64 extent = 0;
+    for (int i = 0; i < 3; i++)
+        extent = std::max(extent, (i64)mx[i] - mn[i] + 1);
+    if (extent > voxel_vox_max_resolution)
+    {
+        fprintf(
+            stdout,
+            "Scene is %lld voxels wide, at most %d fit\n",
+            (long long)extent,
+            voxel_vox_max_resolution);
+        return false;
+    }
+    voxel_world_resize(world, std::max(world->resolution, (i32)extent));
+
+    voxel_leaf leaves[256];
+    for (int i = 0; i < 256; i++)
+    {
+        u32 c = s.palette[i];
+        leaves[i].color = float3{c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff} / 255.0f;
+        leaves[i].flags = voxel_flag_solid;
+    }
+
+    chunk_cursor cursor{int3{INT32_MIN}, nullptr};
+    for (int i = 0; i < placements.size(); i++)
+    {
+        const vox_model& m = *placements[i].model;
+        vox_transform t = placements[i].transform;
+        t.translation += rotate(t, -(m.size / 2)) - mn;
+
+        for (u32 j = 0; j < m.voxel_count; j++)
+        {
+            const u8* v = m.voxels + 4 * j;
+            if (v[3] == 0 || v[0] >= m.size.x || v[1] >= m.size.y || v[2] >= m.size.z)
+                continue;
+            put_voxel(world, &cursor, transform_point(t, int3{v[0], v[1], v[2]}), leaves[v[3]]);
+        }
+    }
+    return true;
+}
+
+//
+// export
+//
+
+u32 pack_color(const float3& color)
+{
+    int3 c = int3{glm::clamp(color, float3{0.0f}, float3{1.0f}) * 255.0f + 0.5f};
+    return 0xff000000 | u32(c.z) << 16 | u32(c.y) << 8 | u32(c.x);
+}
+
+int color_distance(u32 a, u32 b)
+{
+    int d = 0;
+    for (int shift = 0; shift < 24; shift += 8)
+    {
+        int x = int((a >> shift) & 0xff) - int((b >> shift) & 0xff);
+        d += x * x;
+    }
+    return d;
+}
+
+// colors sharing the top 5 bits per channel
+struct color_bucket
+{
+    u64 count;
+    u64 sum[3];
+};
+
+constexpr i32 color_bucket_count = 1 << 15;
+
+u32 bucket_key(u32 c)
+{
+    return (c >> 3 & 0x1f) | (c >> 11 & 0x1f) << 5 | (c >> 19 & 0x1f) << 10;
+}
+
+void bucket_add(color_bucket* b, u32 c, u64 count)
+{
+    b->count += count;
+    for (int i = 0; i < 3; i++)
+        b->sum[i] += count * ((c >> (8 * i)) & 0xff);
+}
+
+// the mean color of the bucket
+u32 bucket_color(const color_bucket& b)
+{
+    u32 c = 0xff000000;
+    for (int i = 0; i < 3; i++)
+        c |= u32((b.sum[i] + b.count / 2) / b.count) << (8 * i);
+    return c;
+}
+
+// The palette of an export and the palette index of every color in the world.
+// Up to 255 colors are kept as they are, more are bucketed and the 255 most
+// used buckets are kept.
+struct vox_palette
+{
+    u32 colors[256];
+    int color_count;
+
+    // palette indices by color, unless bucketed
+    std::unordered_map<u32, u8> indices;
+
+    // Searching the palette once per color is too slow for millions of colors.
+    // Colors are looked up by their top 6 bits per channel instead, each cell
+    // searched when first used. 0 marks cells not searched.
+    array<u8> cell_indices;
+    bool bucketed;
+};
+
+constexpr i32 color_cell_count = 1 << 18;
+
+u8 nearest_color(const vox_palette& palette, u32 color)
+{
+    int best = 1;
+    for (int i = 2; i <= palette.color_count; i++)
+        if (color_distance(palette.colors[i], color) < color_distance(palette.colors[best], color))
+            best = i;
+    return (u8)best;
+}
+
+u8 palette_index(vox_palette* palette, u32 color)
+{
+    if (!palette->bucketed)
+        return palette->indices.find(color)->second;
+
+    u32 key = (color >> 2 & 0x3f) | (color >> 10 & 0x3f) << 6 | (color >> 18 & 0x3f) << 12;
+    u8& index = palette->cell_indices[key];
+    if (!index)
+        index = nearest_color(*palette, (color & 0xfffcfcfc) | 0x020202);
+    return index;
+}
+
+void build_palette(const voxel_world* world, const array<int3>& chunk_coords, vox_palette* palette)
+{
+    // Colors are counted by bucket as soon as there are too many to keep,
+    // scans and noisy paint have millions.
+    std::unordered_map<u32, u64> counts;
+    array<color_bucket> buckets;
+    palette->bucketed = false;
+
+    for (int i = 0; i < chunk_coords.size(); i++)
+    {
+        const voxel_chunk* chunk = voxel_world_find_chunk(world, chunk_coords[i]);
+        if (!chunk)
+            continue;
+
+        // voxels mostly share the palette entry of the one before
+        u32 last = 0;
+        u32 last_color = 0;
+        u64* last_count = nullptr;
+        color_bucket* last_bucket = nullptr;
+        u32 entries[voxel_chunk_size];
+        for (int j = 0; j < voxel_chunk_volume; j++)
+        {
+            if ((j & voxel_chunk_mask) == 0)
+                voxel_chunk_row_indices(chunk, j >> voxel_chunk_size_log2, entries);
+            const u32 entry = entries[j & voxel_chunk_mask];
+            if (!entry)
+                continue;
+
+            if (entry != last)
+            {
+                last = entry;
+                last_color = pack_color(chunk->palette[entry].color);
+                if (!palette->bucketed)
+                    last_count = &counts[last_color];
+
+                if (!palette->bucketed && counts.size() > 255)
+                {
+                    palette->bucketed = true;
+                    buckets.resize(color_bucket_count);
+                    for (const auto& kv : counts)
+                        bucket_add(&buckets[bucket_key(kv.first)], kv.first, kv.second);
+                    counts.clear();
+                }
+                if (palette->bucketed)
+                    last_bucket = &buckets[bucket_key(last_color)];
+            }
+
+            if (palette->bucketed)
+                bucket_add(last_bucket, last_color, 1);
+            else
+                (*last_count)++;
+        }
+    }
+
+    u32* colors = palette->colors;
+    std::memset(colors, 0, 256 * sizeof(u32));
+    int color_count = 0;
+
+    if (!palette->bucketed)
+    {
+        for (const auto& kv : counts)
+            colors[++color_count] = kv.first;
+    }
+    else
+    {
+        struct ranked_bucket
+        {
+            u64 count;
+            u32 rank;
+            u32 key;
+        };
+
+        // Buckets used equally often are taken in an order that spreads them
+        // over the color cube, the bits of the channels are interleaved and
+        // reversed. Smooth gradients have many such ties.
+        array<ranked_bucket> sorted;
+        for (u32 key = 0; key < (u32)color_bucket_count; key++)
+        {
+            if (!buckets[key].count)
+                continue;
+
+            u32 rank = 0;
+            for (int bit = 0; bit < 5; bit++)
+                for (int channel = 0; channel < 3; channel++)
+                    rank = rank << 1 | ((key >> (5 * channel + 4 - bit)) & 1);
+            u32 reversed = 0;
+            for (int bit = 0; bit < 15; bit++)
+                reversed |= ((rank >> bit) & 1) << (14 - bit);
+            sorted.add(ranked_bucket{buckets[key].count, reversed, key});
+        }
+        std::sort(
+            sorted.ptr(),
+            sorted.ptr() + sorted.size(),
+            [](const ranked_bucket& a, const ranked_bucket& b) {
+                return a.count != b.count ? a.count > b.count : a.rank < b.rank;
+            });
+
+        for (int i = 0; i < std::min(sorted.size(), 255); i++)
+            colors[++color_count] = bucket_color(buckets[sorted[i].key]);
+    }
+
+    // Sorting makes exports of the same world identical.
+    std::sort(colors + 1, colors + 1 + color_count);
+    palette->color_count = color_count;
+
+    if (!palette->bucketed)
+    {
+        for (const auto& kv : counts)
+            palette->indices[kv.first] = nearest_color(*palette, kv.first);
+    }
+    else
+        palette->cell_indices.resize(color_cell_count);
+}
+
+void put_u32(array<u8>* out, u32 v)
+{
+    int at = out->size();
+    out->resize(at + 4);
+    std::memcpy(out->ptr() + at, &v, 4);
+}
+
+void put_string(array<u8>* out, const char* s)
+{
+    i32 size = (i32)std::strlen(s);
+    put_u32(out, (u32)size);
+    int at = out->size();
+    out->resize(at + size);
+    std::memcpy(out->ptr() + at, s, size);
+}
+
+bool write_chunk(FILE* f, u32 id, const array<u8>& content)
+{
+    u32 header[3] = {id, (u32)content.size(), 0};
+    return std::fwrite(header, sizeof header, 1, f) == 1 &&
+           (!content.size() || std::fwrite(content.ptr(), content.size(), 1, f) == 1);
+}
+}
+
+bool voxel_vox_import(voxel_world* world, const char* path)
+{
+    mapped_file file;
+    if (!map_file(path, &file))
+    {
+        fprintf(stdout, "Could not read %s\n", path);
+        return false;
+    }
+
+    // Voxels are read straight from the mapping, only the chunk table and
+    // the scene graph are parsed up front.
+    vox_scene s;
+    bool ok = parse(&s, file.data, file.size);
+
+    voxel_world* imported = voxel_world_create(world->resolution);
+    ok = ok && import_scene(imported, s);
+    unmap_file(&file);
+
+    if (ok)
+        voxel_world_swap(world, imported);
+    else
+        fprintf(stdout, "%s is not a valid .vox file\n", path);
+
+    voxel_world_destroy(imported);
+    return ok;
+}
+
+bool voxel_vox_export(const voxel_world* world, const char* path)
+{
+    FILE* f = std::fopen(path, "wb");
+    if (!f)
+    {
+        fprintf(stdout, "Could not open %s for writing\n", path);
+        return false;
+    }
+
+    array<int3> chunk_coords;
+    voxel_world_chunk_coords(world, &chunk_coords);
+
+    vox_palette palette;
+    build_palette(world, chunk_coords, &palette);
+
+    const i32 n = voxel_vox_model_size;
+    static_assert(voxel_vox_model_size % voxel_chunk_size == 0, "Chunks must not straddle models");
+    const int3 tiles{(world->resolution + n - 1) / n};
+
+    u32 header[5] = {chunk_id("VOX "), vox_version, chunk_id("MAIN"), 0, 0};
+    bool ok = std::fwrite(header, sizeof header, 1, f) == 1;
+
+    // Every model is written, empty ones included, so the models cover
+    // the whole world and importing it places it the same.
+    array<u8> content;
+    array<int3> translations;
+    for (int tz = 0; ok && tz < tiles.z; tz++)
+        for (int ty = 0; ok && ty < tiles.y; ty++)
+            for (int tx = 0; ok && tx < tiles.x; tx++)
+            {
+                const int3 mn = int3{tx, ty, tz} * n;
+                const int3 size = glm::min(int3{n}, int3{world->resolution} - mn);
+
+                content.clear();
+                put_u32(&content, (u32)size.x);
+                put_u32(&content, (u32)size.z);
+                put_u32(&content, (u32)size.y);
+                ok = write_chunk(f, chunk_id("SIZE"), content);
+
+                const int3 cmin = voxel_chunk_coords(mn);
+                const int3 cmax = voxel_chunk_coords(mn + size - 1);
+                u32 count = 0;
+                for (int cz = cmin.z; cz <= cmax.z; cz++)
+                    for (int cy = cmin.y; cy <= cmax.y; cy++)
+                        for (int cx = cmin.x; cx <= cmax.x; cx++)
+                            if (const voxel_chunk* c = voxel_world_find_chunk(world, {cx, cy, cz}))
+                                count += c->solid_count;
+
+                content.resize(4 + 4 * count);
+                std::memcpy(content.ptr(), &count, 4);
+                u8* xyzi = content.ptr() + 4;
+
+                u8 last_index = 0;
+
+                for (int cz = cmin.z; cz <= cmax.z; cz++)
+                    for (int cy = cmin.y; cy <= cmax.y; cy++)
+                        for (int cx = cmin.x; cx <= cmax.x; cx++)
+                        {
+                            const voxel_chunk* chunk =
+                                voxel_world_find_chunk(world, int3{cx, cy, cz});
+                            if (!chunk)
+                                continue;
+
+                            // voxels mostly share the palette entry of the one before
+                            const int3 base = int3{cx, cy, cz} * voxel_chunk_size - mn;
+                            u32 last = 0;
+                            u32 entries[voxel_chunk_size];
+                            for (int j = 0; j < voxel_chunk_volume; j++)
+                            {
+                                if ((j & voxel_chunk_mask) == 0)
+                                    voxel_chunk_row_indices(
+                                        chunk,
+                                        j >> voxel_chunk_size_log2,
+                                        entries);
+                                const u32 entry = entries[j & voxel_chunk_mask];
+                                if (!entry)
+                                    continue;
+
+                                if (entry != last)
+                                {
+                                    last = entry;
+                                    last_index = palette_index(
+                                        &palette,
+                                        pack_color(chunk->palette[entry].color));
+                                }
+
+                                int3 l = base + (int3{j,
+                                                      j >> voxel_chunk_size_log2,
+                                                      j >> (2 * voxel_chunk_size_log2)} &
+                                                 voxel_chunk_mask);
+                                xyzi[0] = u8(l.x);
+                                xyzi[1] = u8(size.z - 1 - l.z);
+                                xyzi[2] = u8(l.y);
+                                xyzi[3] = last_index;
+                                xyzi += 4;
+                            }
+                        }
+
+                ok = ok && write_chunk(f, chunk_id("XYZI"), content);
+
+                // inverse of the placement on import, see import_scene
+                translations.add(
+                    int3{mn.x + size.x / 2, size.z / 2 - size.z + 1 - mn.z, mn.y + size.y / 2});
+            }
+
+    // root transform, a group of all models, and a transform and a shape per model
+    content.clear();
+    put_u32(&content, 0);
+    put_u32(&content, 0);
+    put_u32(&content, 1);
+    put_u32(&content, ~0u);
+    put_u32(&content, ~0u);
+    put_u32(&content, 1);
+    put_u32(&content, 0);
+    ok = ok && write_chunk(f, chunk_id("nTRN"), content);
+
+    content.clear();
+    put_u32(&content, 1);
+    put_u32(&content, 0);
+    put_u32(&content, (u32)translations.size());
+    for (int i = 0; i < translations.size(); i++)
+        put_u32(&content, 2 + 2 * i);
+    ok = ok && write_chunk(f, chunk_id("nGRP"), content);
+
+    for (int i = 0; ok && i < translations.size(); i++)
+    {
+        char t[64];
+        std::snprintf(
+            t,
+            sizeof t,
+            "%d %d %d",
+            translations[i].x,
+            translations[i].y,
+            translations[i].z);
+
+        content.clear();
+        put_u32(&content, 2 + 2 * i);
+        put_u32(&content, 0);
+        put_u32(&content, 3 + 2 * i);
+        put_u32(&content, ~0u);
+        put_u32(&content, 0);
+        put_u32(&content, 1);
+        put_u32(&content, 1);
+        put_string(&content, "_t");
+        put_string(&content, t);
+        ok = write_chunk(f, chunk_id("nTRN"), content);
+
+        content.clear();
+        put_u32(&content, 3 + 2 * i);
+        put_u32(&content, 0);
+        put_u32(&content, 1);
+        put_u32(&content, i);
+        put_u32(&content, 0);
+        ok = ok && write_chunk(f, chunk_id("nSHP"), content);
+    }
+
+    // the RGBA chunk starts at palette index 1
+    content.clear();
+    for (int i = 1; i < 256; i++)
+        put_u32(&content, palette.colors[i]);
+    put_u32(&content, 0);
+    ok = ok && write_chunk(f, chunk_id("RGBA"), content);
+
+    // patch the size of the children of MAIN
+    long end = std::ftell(f);
+    u32 children = (u32)(end - (long)sizeof header);
+    ok = ok && end > 0 && std::fseek(f, 4 * sizeof(u32), SEEK_SET) == 0 &&
+         std::fwrite(&children, sizeof children, 1, f) == 1;
+    ok = std::fclose(f) == 0 && ok;
+
+    if (!ok)
+    {
+        fprintf(stdout, "Could not write %s\n", path);
+        std::remove(path);
+    }
+    return ok;
+}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "voxel/voxel_world.h"
+
+namespace vx
+{
+// MagicaVoxel .vox files. Models are placed by the scene graph of the file
+// (nTRN, nGRP and nSHP nodes) when it has one, at the origin otherwise. The
+// z up axis of MagicaVoxel becomes y.
+//
+// Models are at most voxel_vox_model_size voxels per axis, larger worlds are
+// exported as a grid of models.
+constexpr i32 voxel_vox_model_size = 256;
+
+// scenes any wider are rejected on import
+constexpr i32 voxel_vox_max_resolution = 2048;
+
+// Replaces the contents of world, which is left untouched on failure. The
+// resolution grows to fit the scene, which is placed in the min corner.
+bool voxel_vox_import(voxel_world* world, const char* path);
+
+// Colors are reduced to the 255 of a .vox palette, similar colors are merged
+// if there are more.
+bool voxel_vox_export(const voxel_world* world, const char* path);
+}
@@ -0,0 +1,943 @@
+#include "voxel/voxel_voxelizer.h"
+#include "common/job_system.h"
+
+#include <cfloat>
+#include <cstdint>
+#include <cstring>
+
+namespace vx
+{
+namespace
+{
+// Voxels are tested as boxes a little smaller than a voxel and triangles
+// are moved a little further than that against their normal. Faces lying on
+// voxel boundaries then overlap the voxel behind them only, instead of the
+// voxels on both sides and the ones next to them.
+constexpr float box_half = 0.5f - 1.0f / 1024.0f;
+constexpr float inset = 1.0f / 512.0f;
+
+// cap on the per slice chunk counts of binning, in u32
+constexpr i64 max_slice_count_size = 16 << 20;
+
+struct voxelizer
+{
+    const voxel_triangle_mesh* mesh;
+    bool colored;
+    float3 color;
+
+    // voxel coordinates are (position - origin) * scale
+    float3 origin;
+    float scale;
+
+    i32 resolution;
+    i32 triangle_count;
+
+    // chunks per axis and in total, chunk indices are x + grid * (y + grid * z)
+    i32 grid;
+    i32 chunk_count;
+
+    // Triangle counts by slice and chunk while binning, which turn into
+    // where each slice writes its triangles in bins.
+    i32 slice_count;
+    array<u32> slice_counts;
+
+    // triangle indices by chunk, those of chunk c start at bin_offsets[c]
+    array<u32> bin_offsets;
+    array<u32> bins;
+
+    // by chunk, null for chunks without solid voxels
+    array<voxel_chunk*> chunks;
+};
+
+// one slice of triangles or one chunk
+struct voxelize_job
+{
+    voxelizer* vz;
+    i32 index;
+};
+
+// std::floor and std::ceil are library calls unless SSE 4.1 is enabled,
+// which we do not build with. These are for voxel coordinates, which are
+// nowhere near the limits of an int.
+int floor_int(float x)
+{
+    const int i = (int)x;
+    return i - (x < (float)i);
+}
+
+int ceil_int(float x)
+{
+    const int i = (int)x;
+    return i + (x > (float)i);
+}
+
+int3 chunk_coords(const voxelizer* vz, i32 c)
+{
+    return int3{c % vz->grid, (c / vz->grid) % vz->grid, c / (vz->grid * vz->grid)};
+}
+
+i32 chunk_index(const voxelizer* vz, const int3& coords)
+{
+    return coords.x + vz->grid * (coords.y + vz->grid * coords.z);
+}
+
+bool chunk_in_grid(const voxelizer* vz, const int3& coords)
+{
+    return glm::all(glm::greaterThanEqual(coords, int3{0})) &&
+           glm::all(glm::lessThan(coords, int3{vz->grid}));
+}
+
+// false if a position is not finite
+bool fit_mesh(voxelizer* vz)
+{
+    const voxel_triangle_mesh& mesh = *vz->mesh;
+    bounds3f b{float3{FLT_MAX}, float3{-FLT_MAX}};
+    for (int i = 0; i < mesh.indices.size(); i++)
+    {
+        const float3& p = mesh.positions[mesh.indices[i]];
+        if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z))
+            return false;
+        b.min = glm::min(b.min, p);
+        b.max = glm::max(b.max, p);
+    }
+
+    const float3 size = extents(b);
+    const float longest = std::max(size.x, std::max(size.y, size.z));
+    vz->origin = mesh.indices.size() ? b.min : float3{0.0f};
+    vz->scale = longest > 0.0f ? (float)vz->resolution / longest : 1.0f;
+    return true;
+}
+
+//
+// triangles
+//
+
+// a triangle in voxel coordinates, moved against its normal by inset
+struct triangle
+{
+    float3 v[3];
+
+    // not normalized, zero for degenerate triangles
+    float3 normal;
+};
+
+triangle load_triangle(const voxelizer* vz, i32 t)
+{
+    const voxel_triangle_mesh& mesh = *vz->mesh;
+    triangle tri;
+    for (int i = 0; i < 3; i++)
+        tri.v[i] = (mesh.positions[mesh.indices[3 * t + i]] - vz->origin) * vz->scale;
+
+    tri.normal = glm::cross(tri.v[1] - tri.v[0], tri.v[2] - tri.v[0]);
+    const float length = glm::length(tri.normal);
+    if (length > 0.0f)
+    {
+        const float3 shift = tri.normal * (-inset / length);
+        for (int i = 0; i < 3; i++)
+            tri.v[i] += shift;
+    }
+    return tri;
+}
+
+// The voxels whose boxes the bounds of the triangle overlap, clipped to the
+// world. Empty if min > max on any axis.
+bounds3i voxel_range(const voxelizer* vz, const triangle& tri)
+{
+    const float3 mn = glm::min(tri.v[0], glm::min(tri.v[1], tri.v[2]));
+    const float3 mx = glm::max(tri.v[0], glm::max(tri.v[1], tri.v[2]));
+    const float3 lo = mn - 0.5f - box_half;
+    const float3 hi = mx - 0.5f + box_half;
+    const int3 min{ceil_int(lo.x), ceil_int(lo.y), ceil_int(lo.z)};
+    const int3 max{floor_int(hi.x), floor_int(hi.y), floor_int(hi.z)};
+    return bounds3i{glm::max(min, int3{0}), glm::min(max, int3{vz->resolution - 1})};
+}
+
+bool range_empty(const bounds3i& b)
+{
+    return b.min.x > b.max.x || b.min.y > b.max.y || b.min.z > b.max.z;
+}
+
+// The separating axis test of Akenine-Möller, for cubes of half size half.
+// Besides the axes of the cube, which the voxel range of the triangle takes
+// care of, the axes are the normal of the triangle and the cross products of
+// its edges with the axes of the cube. The triangle is projected onto them
+// once, cubes take one dot product per axis.
+constexpr int separating_axis_count = 10;
+
+struct separating_axes
+{
+    float3 axes[separating_axis_count];
+    float min[separating_axis_count];
+    float max[separating_axis_count];
+    float radius[separating_axis_count];
+};
+
+void separating_axes_init(separating_axes* s, const triangle& tri, float half)
+{
+    float3 axes[separating_axis_count];
+    axes[0] = tri.normal;
+    for (int i = 0; i < 3; i++)
+    {
+        const float3 e = tri.v[(i + 1) % 3] - tri.v[i];
+        axes[1 + 3 * i] = float3{0.0f, -e.z, e.y};
+        axes[2 + 3 * i] = float3{e.z, 0.0f, -e.x};
+        axes[3 + 3 * i] = float3{-e.y, e.x, 0.0f};
+    }
+
+    for (int i = 0; i < separating_axis_count; i++)
+    {
+        const float3& a = axes[i];
+        const float p0 = glm::dot(a, tri.v[0]);
+        const float p1 = glm::dot(a, tri.v[1]);
+        const float p2 = glm::dot(a, tri.v[2]);
+        s->axes[i] = a;
+        s->min[i] = std::min(p0, std::min(p1, p2));
+        s->max[i] = std::max(p0, std::max(p1, p2));
+        s->radius[i] = half * (std::abs(a.x) + std::abs(a.y) + std::abs(a.z));
+    }
+}
+
+// for cubes inside of the voxel range of the triangle
+bool separating_axes_overlap(const separating_axes& s, const float3& center)
+{
+    for (int i = 0; i < separating_axis_count; i++)
+    {
+        const float d = glm::dot(s.axes[i], center);
+        if (d + s.radius[i] < s.min[i] || d - s.radius[i] > s.max[i])
+            return false;
+    }
+    return true;
+}
+
+// for any cube, the axes of the cube included
+bool triangle_overlaps_box(const triangle& tri, const float3& center, float half)
+{
+    const float3 mn = glm::min(tri.v[0], glm::min(tri.v[1], tri.v[2])) - center;
+    const float3 mx = glm::max(tri.v[0], glm::max(tri.v[1], tri.v[2])) - center;
+    if (glm::any(glm::greaterThan(mn, float3{half})) || glm::any(glm::lessThan(mx, float3{-half})))
+        return false;
+
+    separating_axes s;
+    separating_axes_init(&s, tri, half);
+    return separating_axes_overlap(s, center);
+}
+
+// Vertex colors interpolated at the point of the triangle closest to the
+// projection of p onto its plane. Close enough to the closest point for
+// picking a color.
+struct color_sampler
+{
+    float3 colors[3];
+    float3 origin;
+    float3 e1;
+    float3 e2;
+    float d11;
+    float d12;
+    float d22;
+    float inverse_det;
+};
+
+float3 unpack_color(u32 c)
+{
+    return float3{c & 0xff, (c >> 8) & 0xff, (c >> 16) & 0xff} / 255.0f;
+}
+
+void color_sampler_init(color_sampler* s, const voxelizer* vz, i32 t, const triangle& tri)
+{
+    for (int i = 0; i < 3; i++)
+        s->colors[i] = vz->colored ? unpack_color(vz->mesh->colors[vz->mesh->indices[3 * t + i]])
+                                   : vz->color;
+    s->origin = tri.v[0];
+    s->e1 = tri.v[1] - tri.v[0];
+    s->e2 = tri.v[2] - tri.v[0];
+    s->d11 = glm::dot(s->e1, s->e1);
+    s->d12 = glm::dot(s->e1, s->e2);
+    s->d22 = glm::dot(s->e2, s->e2);
+    const float det = s->d11 * s->d22 - s->d12 * s->d12;
+    s->inverse_det = det > 0.0f ? 1.0f / det : 0.0f;
+}
+
+float3 color_sample(const color_sampler& s, const float3& p)
+{
+    if (s.inverse_det == 0.0f)
+        return (s.colors[0] + s.colors[1] + s.colors[2]) / 3.0f;
+
+    const float3 d = p - s.origin;
+    const float d1 = glm::dot(d, s.e1);
+    const float d2 = glm::dot(d, s.e2);
+    float b1 = std::max((s.d22 * d1 - s.d12 * d2) * s.inverse_det, 0.0f);
+    float b2 = std::max((s.d11 * d2 - s.d12 * d1) * s.inverse_det, 0.0f);
+    float b0 = std::max(1.0f - b1 - b2, 0.0f);
+    const float sum = b0 + b1 + b2;
+    return (b0 * s.colors[0] + b1 * s.colors[1] + b2 * s.colors[2]) / sum;
+}
+
+//
+// binning
+//
+
+// calls fn with the index of every chunk the triangle overlaps
+template<typename Fn>
+void visit_chunks(const voxelizer* vz, const triangle& tri, const bounds3i& range, Fn fn)
+{
+    const int3 lo = voxel_chunk_coords(range.min);
+    const int3 hi = voxel_chunk_coords(range.max);
+    const bool single = lo == hi;
+
+    int3 c;
+    for (c.z = lo.z; c.z <= hi.z; c.z++)
+        for (c.y = lo.y; c.y <= hi.y; c.y++)
+            for (c.x = lo.x; c.x <= hi.x; c.x++)
+            {
+                // Long thin triangles across the diagonal of their bounds
+                // miss most of the chunks in them.
+                const float half = 0.5f * voxel_chunk_size;
+                if (single || triangle_overlaps_box(tri, float3(c * voxel_chunk_size) + half, half))
+                    fn(chunk_index(vz, c));
+            }
+}
+
+// the triangles of slice s are [slice_begin(s), slice_begin(s + 1))
+i32 slice_begin(const voxelizer* vz, i32 s)
+{
+    return (i32)((i64)vz->triangle_count * s / vz->slice_count);
+}
+
+void count_slice(void* data)
+{
+    const voxelize_job* job = (voxelize_job*)data;
+    voxelizer* vz = job->vz;
+    u32* counts = vz->slice_counts.ptr() + (i64)job->index * vz->chunk_count;
+
+    const i32 end = slice_begin(vz, job->index + 1);
+    for (i32 t = slice_begin(vz, job->index); t < end; t++)
+    {
+        const triangle tri = load_triangle(vz, t);
+        const bounds3i range = voxel_range(vz, tri);
+        if (!range_empty(range))
+            visit_chunks(vz, tri, range, [counts](i32 c) { counts[c]++; });
+    }
+}
+
+void bin_slice(void* data)
+{
+    const voxelize_job* job = (voxelize_job*)data;
+    voxelizer* vz = job->vz;
+    u32* cursors = vz->slice_counts.ptr() + (i64)job->index * vz->chunk_count;
+    u32* bins = vz->bins.ptr();
+
+    const i32 end = slice_begin(vz, job->index + 1);
+    for (i32 t = slice_begin(vz, job->index); t < end; t++)
+    {
+        const triangle tri = load_triangle(vz, t);
+        const bounds3i range = voxel_range(vz, tri);
+        if (!range_empty(range))
+            visit_chunks(vz, tri, range, [cursors, bins, t](i32 c) { bins[cursors[c]++] = t; });
+    }
+}
+
+template<typename T>
+void run_jobs(job_system* jobs, job_fn fn, array<T>* job_data)
+{
+    for (int i = 0; i < job_data->size(); i++)
+        job_system_submit(jobs, fn, &(*job_data)[i]);
+    job_system_wait(jobs);
+}
+
+// Each slice of triangles is binned by one job, so the triangles of a chunk
+// stay in mesh order and the result does not depend on the worker count.
+// False if there are too many.
+bool bin_triangles(voxelizer* vz, job_system* jobs)
+{
+    const i32 workers = std::max((i32)job_system_worker_count(jobs), 1);
+    const i64 max_slices = std::max(max_slice_count_size / vz->chunk_count, (i64)1);
+    vz->slice_count = (i32)std::min((i64)(4 * workers), max_slices);
+    vz->slice_count = std::min(vz->slice_count, std::max(vz->triangle_count, 1));
+    vz->slice_counts.resize(vz->slice_count * vz->chunk_count);
+
+    array<voxelize_job> job_data;
+    for (i32 s = 0; s < vz->slice_count; s++)
+        job_data.add(voxelize_job{vz, s});
+    run_jobs(jobs, count_slice, &job_data);
+
+    vz->bin_offsets.resize(vz->chunk_count + 1);
+    u64 total = 0;
+    for (i32 c = 0; c < vz->chunk_count; c++)
+    {
+        vz->bin_offsets[c] = (u32)total;
+        for (i32 s = 0; s < vz->slice_count; s++)
+        {
+            u32& count = vz->slice_counts[s * vz->chunk_count + c];
+            const u32 cursor = (u32)total;
+            total += count;
+            count = cursor;
+        }
+        if (total > (u64)INT32_MAX)
+            return false;
+    }
+    vz->bin_offsets[vz->chunk_count] = (u32)total;
+
+    vz->bins.resize((int)total);
+    run_jobs(jobs, bin_slice, &job_data);
+    vz->slice_counts = array<u32>();
+    return true;
+}
+
+//
+// surfaces
+//
+
+// Rows of 32 voxels along x, bit x of rows[y + 32 * z].
+constexpr int chunk_rows = voxel_chunk_size * voxel_chunk_size;
+
+// A chunk being voxelized. Sums count the triangles overlapping each voxel
+// in flags and add up their colors until the chunk is done. The rows with
+// any of those are remembered, so the pages of sums nothing overlaps are
+// never touched.
+struct chunk_hits
+{
+    voxel_chunk* chunk;
+    int3 min;
+    voxel_leaf* sums;
+    u32 rows[chunk_rows];
+};
+
+void add_hit(chunk_hits* hits, const int3& p, const float3& color)
+{
+    const int3 local = p - hits->min;
+    voxel_leaf& leaf = hits->sums[voxel_chunk_index(local)];
+    leaf.color += color;
+    leaf.flags++;
+    hits->rows[local.y + voxel_chunk_size * local.z] |= 1u << local.x;
+}
+
+void voxelize_triangle(
+    chunk_hits* hits,
+    const color_sampler& colors,
+    const triangle& tri,
+    const bounds3i& r)
+{
+    const float3 an = glm::abs(tri.normal);
+    separating_axes axes;
+    separating_axes_init(&axes, tri, box_half);
+
+    // degenerate triangles, test every voxel of the range
+    const int3 extent = r.max - r.min;
+    if (std::max(an.x, std::max(an.y, an.z)) <= 0.0f || (extent.x | extent.y | extent.z) <= 1)
+    {
+        int3 p;
+        for (p.z = r.min.z; p.z <= r.max.z; p.z++)
+            for (p.y = r.min.y; p.y <= r.max.y; p.y++)
+                for (p.x = r.min.x; p.x <= r.max.x; p.x++)
+                {
+                    const float3 center = float3(p) + 0.5f;
+                    if (separating_axes_overlap(axes, center))
+                        add_hit(hits, p, color_sample(colors, center));
+                }
+        return;
+    }
+
+    // Walks the columns along the axis the triangle faces most, and only
+    // tests the voxels of each column that pass the test against its normal.
+    // Those are solved for from the same interval the test uses, so slivers
+    // whose normals are mostly rounding error lose no voxels.
+    const int w = an.x > an.y ? (an.x > an.z ? 0 : 2) : (an.y > an.z ? 1 : 2);
+    const int u = (w + 1) % 3;
+    const int v = (w + 2) % 3;
+    const float inverse_w = 1.0f / tri.normal[w];
+    float lowest = (axes.min[0] - axes.radius[0]) * inverse_w;
+    float highest = (axes.max[0] + axes.radius[0]) * inverse_w;
+    if (inverse_w < 0.0f)
+        std::swap(lowest, highest);
+    lowest -= 0.5f + 1.0f / 64.0f;
+    highest += 1.0f / 64.0f - 0.5f;
+
+    int3 p;
+    for (p[v] = r.min[v]; p[v] <= r.max[v]; p[v]++)
+        for (p[u] = r.min[u]; p[u] <= r.max[u]; p[u]++)
+        {
+            const float du = tri.normal[u] * (p[u] + 0.5f);
+            const float dv = tri.normal[v] * (p[v] + 0.5f);
+            const float column = (du + dv) * inverse_w;
+            const int w_min = std::max(ceil_int(lowest - column), r.min[w]);
+            const int w_max = std::min(floor_int(highest - column), r.max[w]);
+            for (p[w] = w_min; p[w] <= w_max; p[w]++)
+            {
+                const float3 center = float3(p) + 0.5f;
+                if (separating_axes_overlap(axes, center))
+                    add_hit(hits, p, color_sample(colors, center));
+            }
+        }
+}
+
+void voxelize_chunk(void* data)
+{
+    const voxelize_job* job = (voxelize_job*)data;
+    const voxelizer* vz = job->vz;
+    voxel_chunk* chunk = vz->chunks[job->index];
+    chunk_hits hits;
+    hits.chunk = chunk;
+    hits.min = chunk->coords * voxel_chunk_size;
+    hits.sums = (voxel_leaf*)std::calloc(voxel_chunk_volume, sizeof(voxel_leaf));
+    if (!hits.sums)
+        fatal("Out of memory while voxelizing");
+    std::memset(hits.rows, 0, sizeof hits.rows);
+    const bounds3i chunk_box{hits.min, hits.min + voxel_chunk_mask};
+
+    const u32 end = vz->bin_offsets[job->index + 1];
+    for (u32 i = vz->bin_offsets[job->index]; i < end; i++)
+    {
+        const i32 t = (i32)vz->bins[i];
+        const triangle tri = load_triangle(vz, t);
+        const bounds3i range = voxel_range(vz, tri);
+
+        color_sampler colors;
+        color_sampler_init(&colors, vz, t, tri);
+
+        // most triangles of a fine mesh are inside of a single voxel
+        if (range.min == range.max)
+        {
+            const float3 center = float3(range.min) + 0.5f;
+            add_hit(&hits, range.min, color_sample(colors, center));
+            continue;
+        }
+
+        const bounds3i r{glm::max(range.min, chunk_box.min), glm::min(range.max, chunk_box.max)};
+        if (!range_empty(r))
+            voxelize_triangle(&hits, colors, tri, r);
+    }
+
+    // at most a leaf per voxel hit, reserved so the indices are packed once
+    u32 hit_count = 0;
+    for (int r = 0; r < chunk_rows; r++)
+        hit_count += vx_popcnt(hits.rows[r]);
+    voxel_chunk_palette_reserve(chunk, hit_count);
+
+    for (int r = 0; r < chunk_rows; r++)
+    {
+        for (u32 row = hits.rows[r]; row; row &= row - 1)
+        {
+            const i32 i = voxel_chunk_index(
+                int3{glm::findLSB(row), r & voxel_chunk_mask, r >> voxel_chunk_size_log2});
+            const voxel_leaf& sum = hits.sums[i];
+            voxel_chunk_set(chunk, i, voxel_leaf{sum.color / (float)sum.flags, voxel_flag_solid});
+        }
+    }
+    std::free(hits.sums);
+}
+
+void voxelize_surfaces(voxelizer* vz, voxel_world* world, job_system* jobs)
+{
+    // Chunks are allocated up front, the chunk map is not safe to
+    // change from the workers.
+    vz->chunks.resize(vz->chunk_count);
+    array<voxelize_job> job_data;
+    for (i32 c = 0; c < vz->chunk_count; c++)
+    {
+        vz->chunks[c] = nullptr;
+        if (vz->bin_offsets[c] == vz->bin_offsets[c + 1])
+            continue;
+        vz->chunks[c] = voxel_world_touch_chunk(world, chunk_coords(vz, c));
+        job_data.add(voxelize_job{vz, c});
+    }
+
+    // the fullest chunks first, so no worker is left with a large one at the end
+    if (job_data.size())
+    {
+        const voxelizer* v = vz;
+        std::stable_sort(
+            job_data.ptr(),
+            job_data.ptr() + job_data.size(),
+            [v](const voxelize_job& a, const voxelize_job& b) {
+                return v->bin_offsets[a.index + 1] - v->bin_offsets[a.index] >
+                       v->bin_offsets[b.index + 1] - v->bin_offsets[b.index];
+            });
+    }
+    run_jobs(jobs, voxelize_chunk, &job_data);
+
+    vz->bins = array<u32>();
+    vz->bin_offsets = array<u32>();
+
+    // chunks only touched by the bounds of a triangle, setting an empty voxel
+    // in an empty chunk releases it
+    for (i32 c = 0; c < vz->chunk_count; c++)
+    {
+        if (vz->chunks[c] && !vz->chunks[c]->solid_count)
+        {
+            voxel_world_set(world, vz->chunks[c]->coords * voxel_chunk_size, voxel_leaf{});
+            vz->chunks[c] = nullptr;
+        }
+    }
+}
+
+//
+// interiors
+//
+
+// Flood fill of the outside, from the border of the world. Chunks without
+// surface voxels are flooded as a whole, those with surface voxels by rows.
+
+enum flood_state : u8
+{
+    flood_state_empty,
+    flood_state_outside,
+    flood_state_surface,
+};
+
+struct flood_chunk
+{
+    bool queued;
+    u32 solid[chunk_rows];
+
+    // reached from the border, voxels past the end of the world start out so
+    u32 outside[chunk_rows];
+};
+
+struct flood
+{
+    voxelizer* vz;
+    array<u8> states;
+
+    // by chunk, into chunks for surface chunks
+    array<i32> flood_indices;
+    array<flood_chunk> chunks;
+
+    array<i32> stack;
+};
+
+// a face of a chunk, bit y of face[z] for x faces, bit x of face[z] for y
+// faces and bit x of face[y] for z faces
+using face_mask = u32[voxel_chunk_size];
+
+const int3 side_directions[signed_axis_count] = {
+    int3{-1, 0, 0}, int3{1, 0, 0}, int3{0, -1, 0}, int3{0, 1, 0}, int3{0, 0, -1}, int3{0, 0, 1}};
+
+signed_axis opposite(signed_axis side)
+{
+    return (signed_axis)(side ^ 1);
+}
+
+// the voxels of row y, z of the chunk at chunk_min inside of the world
+u32 row_in_world(const voxelizer* vz, const int3& chunk_min, int y, int z)
+{
+    const int x_count = std::min(vz->resolution - chunk_min.x, voxel_chunk_size);
+    if (chunk_min.y + y >= vz->resolution || chunk_min.z + z >= vz->resolution)
+        return 0;
+    return x_count >= 32 ? ~0u : (1u << x_count) - 1;
+}
+
+// a chunk with surface voxels or one to fill whole, fc is null for those
+struct flood_job
+{
+    const voxelizer* vz;
+    i32 chunk;
+    flood_chunk* fc;
+};
+
+void flood_chunk_init(void* data)
+{
+    const flood_job* job = (flood_job*)data;
+    flood_chunk& fc = *job->fc;
+    const voxel_chunk* chunk = job->vz->chunks[job->chunk];
+    const int3 chunk_min = chunk->coords * voxel_chunk_size;
+
+    for (int r = 0; r < chunk_rows; r++)
+    {
+        fc.solid[r] = voxel_chunk_solid_row(chunk, r);
+        fc.outside[r] = ~row_in_world(job->vz, chunk_min, r & voxel_chunk_mask, r >> 5);
+    }
+}
+
+void get_face(const flood_chunk& fc, signed_axis side, face_mask out)
+{
+    const int last = voxel_chunk_size - 1;
+    const bool max_side = (side & 1) != 0;
+    for (int i = 0; i < voxel_chunk_size; i++)
+    {
+        switch (side / 2)
+        {
+            case axis_x:
+            {
+                u32 bits = 0;
+                for (int y = 0; y < voxel_chunk_size; y++)
+                    bits |= ((fc.outside[y + 32 * i] >> (max_side ? last : 0)) & 1) << y;
+                out[i] = bits;
+                break;
+            }
+            case axis_y:
+                out[i] = fc.outside[(max_side ? last : 0) + 32 * i];
+                break;
+            default:
+                out[i] = fc.outside[i + 32 * (max_side ? last : 0)];
+                break;
+        }
+    }
+}
+
+// Marks the voxels of mask on a face as outside, unless solid. True if
+// any of them were not outside before.
+bool enter_face(flood_chunk* fc, signed_axis side, const face_mask mask)
+{
+    const int last = voxel_chunk_size - 1;
+    const bool max_side = (side & 1) != 0;
+    bool changed = false;
+    for (int i = 0; i < voxel_chunk_size; i++)
+    {
+        if (!mask[i])
+            continue;
+        switch (side / 2)
+        {
+            case axis_x:
+            {
+                const int x = max_side ? last : 0;
+                for (int y = 0; y < voxel_chunk_size; y++)
+                {
+                    const u32 bit = ((mask[i] >> y) & 1) << x;
+                    u32& row = fc->outside[y + 32 * i];
+                    const u32 enter = bit & ~fc->solid[y + 32 * i] & ~row;
+                    row |= enter;
+                    changed = changed || enter;
+                }
+                break;
+            }
+            default:
+            {
+                const int r = side / 2 == axis_y ? (max_side ? last : 0) + 32 * i
+                                                 : i + 32 * (max_side ? last : 0);
+                const u32 enter = mask[i] & ~fc->solid[r] & ~fc->outside[r];
+                fc->outside[r] |= enter;
+                changed = changed || enter;
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+// spread the outside inside of the chunk, sweeping back and forth until it stops
+void flood_chunk_spread(flood_chunk* fc)
+{
+    for (bool changed = true; changed;)
+    {
+        changed = false;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            for (int i = 0; i < chunk_rows; i++)
+            {
+                const int r = pass ? chunk_rows - 1 - i : i;
+                const int y = r & voxel_chunk_mask;
+                const int z = r >> voxel_chunk_size_log2;
+
+                u32 seeds = fc->outside[r];
+                if (y > 0)
+                    seeds |= fc->outside[r - 1];
+                if (y < voxel_chunk_size - 1)
+                    seeds |= fc->outside[r + 1];
+                if (z > 0)
+                    seeds |= fc->outside[r - voxel_chunk_size];
+                if (z < voxel_chunk_size - 1)
+                    seeds |= fc->outside[r + voxel_chunk_size];
+
+                const u32 free = ~fc->solid[r];
+                const u32 outside = voxel_row_fill_runs(seeds & free, free) | fc->outside[r];
+                if (outside != fc->outside[r])
+                {
+                    fc->outside[r] = outside;
+                    changed = true;
+                }
+            }
+        }
+    }
+}
+
+bool face_empty(const face_mask mask)
+{
+    u32 any = 0;
+    for (int i = 0; i < voxel_chunk_size; i++)
+        any |= mask[i];
+    return !any;
+}
+
+void flood_enter(flood* f, i32 c, signed_axis side, const face_mask mask)
+{
+    switch (f->states[c])
+    {
+        case flood_state_empty:
+            if (face_empty(mask))
+                break;
+            f->states[c] = flood_state_outside;
+            f->stack.add(c);
+            break;
+        case flood_state_surface:
+        {
+            flood_chunk* fc = &f->chunks[f->flood_indices[c]];
+            if (enter_face(fc, side, mask) && !fc->queued)
+            {
+                fc->queued = true;
+                f->stack.add(c);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void flood_outside(flood* f)
+{
+    static const face_mask all{
+        ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u,
+        ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u, ~0u};
+    const voxelizer* vz = f->vz;
+
+    for (i32 c = 0; c < vz->chunk_count; c++)
+    {
+        const int3 coords = chunk_coords(vz, c);
+        for (int side = 0; side < signed_axis_count; side++)
+        {
+            const int3 n = coords + side_directions[side];
+            if (!chunk_in_grid(vz, n))
+                flood_enter(f, c, (signed_axis)side, all);
+        }
+    }
+
+    while (f->stack.size())
+    {
+        const i32 c = f->stack[f->stack.size() - 1];
+        f->stack.resize(f->stack.size() - 1);
+
+        flood_chunk* fc = nullptr;
+        if (f->states[c] == flood_state_surface)
+        {
+            fc = &f->chunks[f->flood_indices[c]];
+            fc->queued = false;
+            flood_chunk_spread(fc);
+        }
+
+        const int3 coords = chunk_coords(vz, c);
+        for (int side = 0; side < signed_axis_count; side++)
+        {
+            const int3 n = coords + side_directions[side];
+            if (!chunk_in_grid(vz, n))
+                continue;
+
+            face_mask mask;
+            if (fc)
+                get_face(*fc, (signed_axis)side, mask);
+            flood_enter(f, chunk_index(vz, n), opposite((signed_axis)side), fc ? mask : all);
+        }
+    }
+}
+
+void fill_chunk(void* data)
+{
+    const flood_job* job = (flood_job*)data;
+    const voxelizer* vz = job->vz;
+    voxel_chunk* chunk = vz->chunks[job->chunk];
+    const int3 chunk_min = chunk->coords * voxel_chunk_size;
+    const u32 index = voxel_chunk_palette_add(chunk, voxel_leaf{vz->color, voxel_flag_solid});
+
+    for (int r = 0; r < chunk_rows; r++)
+    {
+        u32 inside = row_in_world(vz, chunk_min, r & voxel_chunk_mask, r >> 5);
+        if (job->fc)
+            inside &= ~job->fc->solid[r] & ~job->fc->outside[r];
+
+        for (; inside; inside &= inside - 1)
+            voxel_chunk_set_index(
+                chunk,
+                voxel_chunk_index(
+                    int3{glm::findLSB(inside), r & voxel_chunk_mask, r >> voxel_chunk_size_log2}),
+                index);
+    }
+}
+
+void fill_interiors(voxelizer* vz, voxel_world* world, job_system* jobs)
+{
+    flood f;
+    f.vz = vz;
+    f.states.resize(vz->chunk_count);
+    f.flood_indices.resize(vz->chunk_count);
+
+    i32 surface_count = 0;
+    for (i32 c = 0; c < vz->chunk_count; c++)
+    {
+        f.states[c] = vz->chunks[c] ? flood_state_surface : flood_state_empty;
+        f.flood_indices[c] = vz->chunks[c] ? surface_count++ : -1;
+    }
+
+    f.chunks.resize(surface_count);
+    array<flood_job> job_data;
+    for (i32 c = 0; c < vz->chunk_count; c++)
+        if (vz->chunks[c])
+            job_data.add(flood_job{vz, c, &f.chunks[f.flood_indices[c]]});
+    run_jobs(jobs, flood_chunk_init, &job_data);
+
+    flood_outside(&f);
+
+    // Whatever was not reached is inside, chunks reached by none of
+    // their faces are filled whole.
+    job_data.clear();
+    for (i32 c = 0; c < vz->chunk_count; c++)
+    {
+        if (f.states[c] == flood_state_empty)
+        {
+            vz->chunks[c] = voxel_world_touch_chunk(world, chunk_coords(vz, c));
+            job_data.add(flood_job{vz, c, nullptr});
+        }
+        else if (f.states[c] == flood_state_surface)
+            job_data.add(flood_job{vz, c, &f.chunks[f.flood_indices[c]]});
+    }
+    run_jobs(jobs, fill_chunk, &job_data);
+}
+}
+
+bool voxel_voxelize(
+    voxel_world* world,
+    const voxel_triangle_mesh& mesh,
+    const voxel_voxelize_options& options)
+{
+    if (options.resolution < 1 || options.resolution > voxel_voxelize_max_resolution)
+    {
+        fprintf(
+            stdout,
+            "Voxelize resolution %d is not in 1..%d\n",
+            options.resolution,
+            voxel_voxelize_max_resolution);
+        return false;
+    }
+
+    voxelizer vz;
+    vz.mesh = &mesh;
+    vz.colored = mesh.colors.size() && mesh.colors.size() == mesh.positions.size();
+    vz.color = options.color;
+    vz.resolution = options.resolution;
+    vz.triangle_count = mesh.indices.size() / 3;
+    vz.grid = (options.resolution + voxel_chunk_mask) >> voxel_chunk_size_log2;
+    vz.chunk_count = vz.grid * vz.grid * vz.grid;
+    if (!fit_mesh(&vz))
+    {
+        fprintf(stdout, "Mesh has positions that are not finite\n");
+        return false;
+    }
+
+    job_system* jobs = job_system_create(options.worker_count);
+    voxel_world* voxelized = voxel_world_create(options.resolution);
+
+    bool ok = bin_triangles(&vz, jobs);
+    if (ok)
+    {
+        voxelize_surfaces(&vz, voxelized, jobs);
+        if (options.solid)
+            fill_interiors(&vz, voxelized, jobs);
+    }
+    else
+        fprintf(stdout, "Mesh has too many triangles to voxelize at once\n");
+    job_system_destroy(jobs);
+
+    if (ok)
+        voxel_world_swap(world, voxelized);
+    voxel_world_destroy(voxelized);
+    return ok;
+}
+}
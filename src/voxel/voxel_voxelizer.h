@@ -0,0 +1,44 @@
+#pragma once
+
+#include "voxel/voxel_mesh_import.h"
+#include "voxel/voxel_mesher.h"
+#include "voxel/voxel_world.h"
+
+namespace vx
+{
+// largest world the mesher can draw, which also keeps the dense chunk tables of
+// the voxelizer small
+constexpr i32 voxel_voxelize_max_resolution = voxel_vertex_max_coordinate;
+
+struct voxel_voxelize_options
+{
+    // voxels along the longest side of the mesh, also the resolution of the world
+    i32 resolution;
+
+    // also fill the space enclosed by the surface
+    bool solid;
+
+    // of meshes without vertex colors and of filled interiors
+    float3 color;
+
+    // as in job_system_create
+    i32 worker_count;
+};
+
+// Conservative voxelization: every voxel a triangle overlaps becomes solid,
+// colored by the vertex colors of the triangles overlapping it. The mesh is
+// scaled uniformly to fit the world and placed in its min corner. Faces lying
+// on voxel boundaries belong to the voxel behind them, so meshes exported from
+// a world voxelize back into the same voxels.
+//
+// Triangles are binned by the chunks they overlap and every chunk is
+// voxelized by one worker, so workers never share a voxel. Interiors are what
+// a flood fill from the border of the world does not reach, leaky meshes
+// stay hollow.
+//
+// Replaces the contents of world, which is left untouched on failure.
+bool voxel_voxelize(
+    voxel_world* world,
+    const voxel_triangle_mesh& mesh,
+    const voxel_voxelize_options& options);
+}
@@ -0,0 +1,698 @@
+#include "voxel/voxel_world.h"
+#include "voxel/voxel_file.h"
+
+#include <cstring>
+
+namespace vx
+{
+static u32 index_word_count(u32 bits_log2)
+{
+    return voxel_chunk_volume >> (5 - bits_log2);
+}
+
+// Slots store index + 1 in 16 bits, which caps the widest palette one
+// short of what its fields could address.
+static u32 palette_limit(u32 bits_log2)
+{
+    return std::min(1u << (1u << bits_log2), 65535u);
+}
+
+// the lowest bit of every field of a word
+static u32 field_lowest_bits(u32 bits_log2)
+{
+    return ~0u / ((1u << (1u << bits_log2)) - 1);
+}
+
+// the lowest bit of every field of word that is not 0
+static u32 solid_fields(u32 word, u32 bits_log2)
+{
+    for (u32 shift = 1; shift < (1u << bits_log2); shift *= 2)
+        word |= word >> shift;
+    return word & field_lowest_bits(bits_log2);
+}
+
+static void* chunk_realloc(void* p, usize size)
+{
+    p = std::realloc(p, size);
+    if (!p)
+        fatal("Out of memory while allocating voxel chunk");
+    return p;
+}
+
+static void palette_slot_insert(voxel_chunk* chunk, u32 index)
+{
+    u32 mask = chunk->palette_slot_count - 1;
+    u32 i = voxel_leaf_hash(chunk->palette[index]) & mask;
+    while (chunk->palette_slots[i])
+        i = (i + 1) & mask;
+    chunk->palette_slots[i] = (u16)(index + 1);
+}
+
+// Size the palette for capacity leaves and rebuild its slots, which are
+// kept at most half full. The empty leaf is never looked up.
+static void palette_resize(voxel_chunk* chunk, u32 capacity)
+{
+    chunk->palette =
+        (voxel_leaf*)chunk_realloc(chunk->palette, capacity * sizeof(voxel_leaf));
+    chunk->palette_capacity = capacity;
+
+    u32 slot_count = 8;
+    while (slot_count < 2 * capacity)
+        slot_count *= 2;
+    if (slot_count != chunk->palette_slot_count)
+    {
+        chunk->palette_slots =
+            (u16*)chunk_realloc(chunk->palette_slots, slot_count * sizeof(u16));
+        chunk->palette_slot_count = slot_count;
+    }
+
+    std::memset(chunk->palette_slots, 0, slot_count * sizeof(u16));
+    for (u32 i = 1; i < chunk->palette_count; i++)
+        palette_slot_insert(chunk, i);
+}
+
+// Drop the palette entries no voxel uses and repack the indices into the
+// narrowest fields holding the rest and extra more leaves. A quarter of the
+// fields is left free, so that a few new leaves do not repack right away.
+static void chunk_repack(voxel_chunk* chunk, u32 extra)
+{
+    // Words of empty voxels are skipped, they stay 0 and the chunks being
+    // filled are mostly empty.
+    const u32 old_bits_log2 = chunk->index_bits_log2;
+    const u32 old_fields = 32 >> old_bits_log2;
+    const u32 old_mask = (1u << (1u << old_bits_log2)) - 1;
+    const u32 old_word_count = index_word_count(old_bits_log2);
+
+    array<u32> remap(chunk->palette_count);
+    remap[0] = 1;
+    for (u32 w = 0; w < old_word_count; w++)
+        for (u32 word = chunk->indices[w]; word; word >>= 1u << old_bits_log2)
+            remap[word & old_mask] = 1;
+
+    u32 count = 0;
+    for (u32 i = 0; i < chunk->palette_count; i++)
+        if (remap[i])
+        {
+            chunk->palette[count] = chunk->palette[i];
+            remap[i] = count++;
+        }
+
+    const u32 needed = count + extra;
+    u32 bits_log2 = 0;
+    while (bits_log2 < voxel_chunk_max_index_bits_log2 &&
+           palette_limit(bits_log2) - palette_limit(bits_log2) / 4 < needed)
+        bits_log2++;
+    assert(needed <= palette_limit(bits_log2));
+
+    const u32 fields_log2 = 5 - bits_log2;
+    u32* indices = (u32*)std::calloc(index_word_count(bits_log2), sizeof(u32));
+    if (!indices)
+        fatal("Out of memory while allocating voxel chunk");
+    for (u32 w = 0; w < old_word_count; w++)
+    {
+        u32 word = chunk->indices[w];
+        for (u32 i = w * old_fields; word; i++, word >>= 1u << old_bits_log2)
+            indices[i >> fields_log2] |= remap[word & old_mask]
+                                         << ((i & ((1u << fields_log2) - 1)) << bits_log2);
+    }
+
+    std::free(chunk->indices);
+    chunk->indices = indices;
+    chunk->index_bits_log2 = bits_log2;
+    chunk->palette_count = count;
+    chunk->palette_last = 0;
+    palette_resize(chunk, std::max(needed, 4u));
+}
+
+void voxel_chunk_copy(voxel_chunk* dst, const voxel_chunk* src)
+{
+    voxel_leaf* palette = dst->palette;
+    u16* palette_slots = dst->palette_slots;
+    u32* indices = dst->indices;
+    const bool same_slots = dst->palette_slot_count == src->palette_slot_count;
+    const bool same_indices = palette && dst->index_bits_log2 == src->index_bits_log2;
+
+    *dst = *src;
+    dst->palette = (voxel_leaf*)chunk_realloc(palette, src->palette_capacity * sizeof(voxel_leaf));
+    std::memcpy(dst->palette, src->palette, src->palette_count * sizeof(voxel_leaf));
+
+    dst->palette_slots = same_slots ? palette_slots
+                                    : (u16*)chunk_realloc(
+                                          palette_slots, src->palette_slot_count * sizeof(u16));
+    std::memcpy(dst->palette_slots, src->palette_slots, src->palette_slot_count * sizeof(u16));
+
+    const usize index_bytes = index_word_count(src->index_bits_log2) * sizeof(u32);
+    dst->indices = same_indices ? indices : (u32*)chunk_realloc(indices, index_bytes);
+    std::memcpy(dst->indices, src->indices, index_bytes);
+}
+
+void voxel_chunk_free_copy(voxel_chunk* chunk)
+{
+    std::free(chunk->palette);
+    std::free(chunk->palette_slots);
+    std::free(chunk->indices);
+}
+
+static void chunk_free(voxel_chunk* chunk)
+{
+    voxel_chunk_free_copy(chunk);
+    std::free(chunk);
+}
+
+// set every voxel of the chunk to leaf, dropping the rest of the palette
+static void chunk_reset(voxel_chunk* chunk, const voxel_leaf& leaf)
+{
+    const bool solid = (leaf.flags & voxel_flag_solid) != 0;
+    if (chunk->index_bits_log2 != 0)
+    {
+        std::free(chunk->indices);
+        chunk->indices = (u32*)chunk_realloc(nullptr, index_word_count(0) * sizeof(u32));
+        chunk->index_bits_log2 = 0;
+    }
+    std::memset(chunk->indices, solid ? 0xff : 0, index_word_count(0) * sizeof(u32));
+
+    chunk->palette_count = 1;
+    chunk->palette_last = 0;
+    palette_resize(chunk, 4);
+    if (solid)
+        voxel_chunk_palette_add(chunk, leaf);
+    chunk->solid_count = solid ? voxel_chunk_volume : 0;
+}
+
+static voxel_chunk* chunk_alloc(const int3& chunk_coords)
+{
+    voxel_chunk* chunk = (voxel_chunk*)std::calloc(1, sizeof(voxel_chunk));
+    u32* indices = (u32*)std::calloc(index_word_count(0), sizeof(u32));
+    if (!chunk || !indices)
+        fatal("Out of memory while allocating voxel chunk");
+    chunk->coords = chunk_coords;
+    chunk->ref_count = 1;
+    chunk->saved_index = voxel_chunk_not_saved;
+    chunk->indices = indices;
+
+    palette_resize(chunk, 4);
+    chunk->palette[0] = voxel_leaf{float3{0.0f}, 0};
+    chunk->palette_count = 1;
+    return chunk;
+}
+
+void voxel_chunk_copy_empty(voxel_chunk* dst, const int3& chunk_coords)
+{
+    voxel_chunk* empty = chunk_alloc(chunk_coords);
+    voxel_chunk_copy(dst, empty);
+    chunk_free(empty);
+}
+
+static void chunk_release(voxel_world* world, voxel_chunk* chunk)
+{
+    world->chunks.erase(voxel_chunk_key(chunk->coords));
+    voxel_chunk_release(chunk);
+}
+
+// make the chunk the world's own before it gets changed
+static voxel_chunk* chunk_for_write(voxel_world* world, voxel_chunk* chunk)
+{
+    if (chunk->ref_count > 1)
+    {
+        voxel_chunk* copy = (voxel_chunk*)std::calloc(1, sizeof(voxel_chunk));
+        if (!copy)
+            fatal("Out of memory while copying voxel chunk");
+        voxel_chunk_copy(copy, chunk);
+        copy->ref_count = 1;
+
+        voxel_chunk_release(chunk);
+        world->chunks[voxel_chunk_key(copy->coords)] = copy;
+        chunk = copy;
+    }
+
+    chunk->saved_index = voxel_chunk_not_saved;
+    return chunk;
+}
+
+static int3 encoded_chunk_coords(const voxel_world* world, u32 index)
+{
+    const voxel_file_chunk_entry& entry = world->source->view.chunks[index];
+    return int3{entry.coords[0], entry.coords[1], entry.coords[2]};
+}
+
+void voxel_chunk_retain(voxel_chunk* chunk)
+{
+    chunk->ref_count++;
+}
+
+void voxel_chunk_release(voxel_chunk* chunk)
+{
+    if (--chunk->ref_count == 0)
+        chunk_free(chunk);
+}
+
+u32 voxel_chunk_palette_add(voxel_chunk* chunk, const voxel_leaf& leaf)
+{
+    if (!(leaf.flags & voxel_flag_solid))
+        return 0;
+    if (voxel_leaf_equal(chunk->palette[chunk->palette_last], leaf))
+        return chunk->palette_last;
+
+    const u32 hash = voxel_leaf_hash(leaf);
+    u32 mask = chunk->palette_slot_count - 1;
+    for (u32 i = hash & mask; u16 slot = chunk->palette_slots[i]; i = (i + 1) & mask)
+        if (voxel_leaf_equal(chunk->palette[slot - 1], leaf))
+            return chunk->palette_last = slot - 1;
+
+    if (chunk->palette_count == palette_limit(chunk->index_bits_log2))
+        chunk_repack(chunk, 1);
+    if (chunk->palette_count == chunk->palette_capacity)
+        palette_resize(chunk, 2 * chunk->palette_capacity);
+
+    const u32 index = chunk->palette_count++;
+    chunk->palette[index] = leaf;
+    palette_slot_insert(chunk, index);
+    return chunk->palette_last = index;
+}
+
+void voxel_chunk_palette_reserve(voxel_chunk* chunk, u32 count)
+{
+    if (chunk->palette_count + count > palette_limit(chunk->index_bits_log2))
+        chunk_repack(chunk, count);
+    if (chunk->palette_count + count > chunk->palette_capacity)
+        palette_resize(chunk, chunk->palette_count + count);
+}
+
+// store index for count voxels from storage index first on, a word at a time
+static void chunk_set_span(voxel_chunk* chunk, i32 first, i32 count, u32 index)
+{
+    const u32 bits_log2 = chunk->index_bits_log2;
+    const u32 fields_log2 = 5 - bits_log2;
+    if (count < (1 << fields_log2))
+    {
+        for (i32 i = first; i < first + count; i++)
+            voxel_chunk_set_index(chunk, i, index);
+        return;
+    }
+
+    const u32 pattern = index * field_lowest_bits(bits_log2);
+    u32 solid_before = 0;
+    const i32 end = first + count;
+    for (i32 i = first; i < end;)
+    {
+        const u32 field = u32(i) & ((1u << fields_log2) - 1);
+        const u32 n = std::min(u32(end - i), (1u << fields_log2) - field);
+        const u32 mask = (n << bits_log2 == 32 ? ~0u : (1u << (n << bits_log2)) - 1)
+                         << (field << bits_log2);
+
+        u32& word = chunk->indices[i >> fields_log2];
+        solid_before += vx_popcnt(solid_fields(word, bits_log2) & mask);
+        word = (word & ~mask) | (pattern & mask);
+        i += n;
+    }
+    chunk->solid_count += (index ? u32(count) : 0) - solid_before;
+}
+
+#if defined(VX_VOXEL_MORTON)
+// the part of the inclusive box [lo, hi] within the aligned cube at min
+static void fill_cube(
+    voxel_chunk* chunk,
+    const int3& lo,
+    const int3& hi,
+    const int3& min,
+    i32 size,
+    u32 index)
+{
+    const int3 max = min + (size - 1);
+    if (glm::all(glm::lessThanEqual(lo, min)) && glm::all(glm::greaterThanEqual(hi, max)))
+    {
+        chunk_set_span(chunk, voxel_chunk_index(min), size * size * size, index);
+        return;
+    }
+
+    // only the halves the box overlaps
+    const i32 half = size / 2;
+    const int3 first = glm::max(lo - min, int3{0}) / half;
+    const int3 last = glm::min(hi - min, int3{size - 1}) / half;
+    for (int z = first.z; z <= last.z; z++)
+        for (int y = first.y; y <= last.y; y++)
+            for (int x = first.x; x <= last.x; x++)
+                fill_cube(chunk, lo, hi, min + half * int3{x, y, z}, half, index);
+}
+#endif
+
+void voxel_chunk_set_run(voxel_chunk* chunk, i32 first, i32 count, u32 index)
+{
+#if defined(VX_VOXEL_MORTON)
+    for (i32 i = first; i < first + count; i++)
+    {
+        const i32 row = i >> voxel_chunk_size_log2;
+        const int3 local{
+            i & voxel_chunk_mask, row & voxel_chunk_mask, row >> voxel_chunk_size_log2};
+        voxel_chunk_set_index(chunk, voxel_chunk_index(local), index);
+    }
+#else
+    chunk_set_span(chunk, first, count, index);
+#endif
+}
+
+void voxel_chunk_fill_box(voxel_chunk* chunk, const int3& lo, const int3& hi, u32 index)
+{
+#if defined(VX_VOXEL_MORTON)
+    // Aligned cubes are contiguous in Morton order, so the box is split
+    // into the largest ones it covers.
+    fill_cube(chunk, lo, hi, int3{0}, voxel_chunk_size, index);
+#else
+    for (int z = lo.z; z <= hi.z; z++)
+        for (int y = lo.y; y <= hi.y; y++)
+            chunk_set_span(chunk, voxel_chunk_index(int3{lo.x, y, z}), hi.x - lo.x + 1, index);
+#endif
+}
+
+u32 voxel_chunk_solid_row(const voxel_chunk* chunk, i32 row)
+{
+#if defined(VX_VOXEL_MORTON)
+    const i32 first =
+        voxel_chunk_index(int3{0, row & voxel_chunk_mask, row >> voxel_chunk_size_log2});
+    u32 solid = 0;
+    for (u32 x = 0; x < voxel_chunk_size; x++)
+        solid |= u32(voxel_chunk_is_solid(chunk, first | i32(voxel_morton_spread(x)))) << x;
+    return solid;
+#else
+    const u32 bits_log2 = chunk->index_bits_log2;
+    const u32* words = chunk->indices + (row << bits_log2);
+    if (bits_log2 == 0)
+        return words[0];
+
+    const u32 fields = 32 >> bits_log2;
+    u32 solid = 0;
+    for (u32 w = 0; w < (1u << bits_log2); w++)
+    {
+        const u32 word = solid_fields(words[w], bits_log2);
+        for (u32 f = 0; f < fields; f++)
+            solid |= ((word >> (f << bits_log2)) & 1) << (w * fields + f);
+    }
+    return solid;
+#endif
+}
+
+usize voxel_chunk_byte_size(const voxel_chunk* chunk)
+{
+    return sizeof(voxel_chunk) + chunk->palette_capacity * sizeof(voxel_leaf) +
+           chunk->palette_slot_count * sizeof(u16) +
+           index_word_count(chunk->index_bits_log2) * sizeof(u32);
+}
+
+voxel_world* voxel_world_create(i32 resolution)
+{
+    assert(resolution > 0);
+    voxel_world* world = new voxel_world;
+    world->resolution = std::min(resolution, voxel_world_max_resolution);
+    world->source = nullptr;
+    world->corrupt_chunk_count = 0;
+    return world;
+}
+
+void voxel_world_destroy(voxel_world* world)
+{
+    voxel_world_clear(world);
+    delete world;
+}
+
+void voxel_world_clear(voxel_world* world)
+{
+    for (auto& kv : world->chunks)
+        voxel_chunk_release(kv.second);
+    world->chunks.clear();
+
+    world->encoded_chunks.clear();
+    if (world->source)
+        voxel_file_source_release(world->source);
+    world->source = nullptr;
+    world->corrupt_chunk_count = 0;
+}
+
+void voxel_world_resize(voxel_world* world, i32 resolution)
+{
+    assert(resolution > 0);
+    resolution = std::min(resolution, voxel_world_max_resolution);
+    world->resolution = resolution;
+
+    // Chunks that straddle the new boundary keep their inside part, chunks
+    // that are completely outside of it are dropped. Encoded chunks that
+    // straddle it are decoded first, to be clipped with the others.
+    array<u64> encoded_outside;
+    array<int3> encoded_straddling;
+
+    for (auto& kv : world->encoded_chunks)
+    {
+        int3 mn = encoded_chunk_coords(world, kv.second) * voxel_chunk_size;
+        int3 mx = mn + voxel_chunk_size;
+
+        if (glm::any(glm::greaterThanEqual(mn, int3{resolution})))
+            encoded_outside.add(kv.first);
+        else if (glm::any(glm::greaterThan(mx, int3{resolution})))
+            encoded_straddling.add(mn / voxel_chunk_size);
+    }
+
+    for (int i = 0; i < encoded_outside.size(); i++)
+        world->encoded_chunks.erase(encoded_outside[i]);
+    for (int i = 0; i < encoded_straddling.size(); i++)
+        voxel_world_find_chunk(world, encoded_straddling[i]);
+
+    array<voxel_chunk*> straddling, outside;
+
+    for (auto& kv : world->chunks)
+    {
+        voxel_chunk* chunk = kv.second;
+        int3 mn = chunk->coords * voxel_chunk_size;
+        int3 mx = mn + voxel_chunk_size;
+
+        if (glm::any(glm::greaterThanEqual(mn, int3{resolution})))
+            outside.add(chunk);
+        else if (glm::any(glm::greaterThan(mx, int3{resolution})))
+            straddling.add(chunk);
+    }
+
+    for (int i = 0; i < outside.size(); i++)
+        chunk_release(world, outside[i]);
+
+    for (int i = 0; i < straddling.size(); i++)
+    {
+        voxel_chunk* chunk = chunk_for_write(world, straddling[i]);
+        int3 base = chunk->coords * voxel_chunk_size;
+
+        // clear the slabs past the new bounds along each axis
+        const int3 inside = glm::min(int3{resolution} - base, int3{voxel_chunk_size});
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (inside[axis] == voxel_chunk_size)
+                continue;
+            int3 lo{0};
+            lo[axis] = inside[axis];
+            voxel_chunk_fill_box(chunk, lo, int3{voxel_chunk_mask}, 0);
+        }
+
+        if (chunk->solid_count == 0)
+            chunk_release(world, chunk);
+    }
+}
+
+void voxel_world_copy(voxel_world* dst, const voxel_world* src)
+{
+    if (dst == src)
+        return;
+
+    dst->resolution = src->resolution;
+
+    array<voxel_chunk*> stale;
+    for (auto& kv : dst->chunks)
+        if (!src->chunks.count(kv.first))
+            stale.add(kv.second);
+    for (int i = 0; i < stale.size(); i++)
+        chunk_release(dst, stale[i]);
+
+    for (auto& kv : src->chunks)
+    {
+        voxel_chunk*& chunk = dst->chunks[kv.first];
+        if (chunk && chunk->ref_count > 1)
+        {
+            voxel_chunk_release(chunk);
+            chunk = nullptr;
+        }
+        if (!chunk)
+            chunk = (voxel_chunk*)std::calloc(1, sizeof(voxel_chunk));
+        if (!chunk)
+            fatal("Out of memory while copying voxel chunk");
+        voxel_chunk_copy(chunk, kv.second);
+        chunk->ref_count = 1;
+    }
+
+    // Encoded chunks are shared with src, not decoded. Saved indices of
+    // the copied chunks refer to the source of src as well.
+    if (src->source)
+        voxel_file_source_retain(src->source);
+    if (dst->source)
+        voxel_file_source_release(dst->source);
+    dst->source = src->source;
+    dst->encoded_chunks = src->encoded_chunks;
+    dst->corrupt_chunk_count = src->corrupt_chunk_count;
+}
+
+void voxel_world_swap(voxel_world* a, voxel_world* b)
+{
+    std::swap(a->resolution, b->resolution);
+    std::swap(a->source, b->source);
+    a->chunks.swap(b->chunks);
+    a->encoded_chunks.swap(b->encoded_chunks);
+    std::swap(a->corrupt_chunk_count, b->corrupt_chunk_count);
+}
+
+voxel_chunk* voxel_world_find_chunk(const voxel_world* world, const int3& chunk_coords)
+{
+    u64 key = voxel_chunk_key(chunk_coords);
+    auto it = world->chunks.find(key);
+    if (it != world->chunks.end())
+        return it->second;
+    if (world->encoded_chunks.empty())
+        return nullptr;
+
+    auto encoded = world->encoded_chunks.find(key);
+    if (encoded == world->encoded_chunks.end())
+        return nullptr;
+
+    // decode on first access
+    voxel_world* w = const_cast<voxel_world*>(world);
+    voxel_chunk* chunk = chunk_alloc(chunk_coords);
+    if (voxel_file_read_chunk(&world->source->view, encoded->second, chunk))
+    {
+        chunk->saved_index = encoded->second;
+        w->chunks[key] = chunk;
+    }
+    else
+    {
+        // Chunks are only checked when decoded, a corrupt one reads as
+        // empty.
+        w->corrupt_chunk_count++;
+        chunk_free(chunk);
+        chunk = nullptr;
+    }
+
+    w->encoded_chunks.erase(encoded);
+    return chunk;
+}
+
+voxel_chunk* voxel_world_touch_chunk(voxel_world* world, const int3& chunk_coords)
+{
+    if (voxel_chunk* chunk = voxel_world_find_chunk(world, chunk_coords))
+        return chunk_for_write(world, chunk);
+
+    voxel_chunk*& chunk = world->chunks[voxel_chunk_key(chunk_coords)];
+    if (!chunk)
+        chunk = chunk_alloc(chunk_coords);
+    return chunk;
+}
+
+voxel_leaf voxel_world_get(const voxel_world* world, const int3& p)
+{
+    if (!voxel_world_contains(world, p))
+        return voxel_leaf{};
+    if (const voxel_chunk* chunk = voxel_world_find_chunk(world, voxel_chunk_coords(p)))
+        return voxel_chunk_get(chunk, voxel_chunk_index(voxel_chunk_local(p)));
+    return voxel_leaf{};
+}
+
+bool voxel_world_is_solid(const voxel_world* world, const int3& p)
+{
+    if (!voxel_world_contains(world, p))
+        return false;
+    if (const voxel_chunk* chunk = voxel_world_find_chunk(world, voxel_chunk_coords(p)))
+        return voxel_chunk_is_solid(chunk, voxel_chunk_index(voxel_chunk_local(p)));
+    return false;
+}
+
+void voxel_world_set(voxel_world* world, const int3& p, const voxel_leaf& leaf)
+{
+    if (!voxel_world_contains(world, p))
+        return;
+
+    bool solid = (leaf.flags & voxel_flag_solid) != 0;
+    int3 cc = voxel_chunk_coords(p);
+    voxel_chunk* chunk =
+        solid ? voxel_world_touch_chunk(world, cc) : voxel_world_find_chunk(world, cc);
+
+    if (!chunk)
+        return;
+    chunk = chunk_for_write(world, chunk);
+
+    voxel_chunk_set(chunk, voxel_chunk_index(voxel_chunk_local(p)), leaf);
+
+    if (chunk->solid_count == 0)
+        chunk_release(world, chunk);
+}
+
+void voxel_world_fill(voxel_world* world, const bounds3i& b, const voxel_leaf& leaf)
+{
+    bounds3i clipped;
+    clipped.min = glm::max(b.min, int3{0});
+    clipped.max = glm::min(b.max, int3{world->resolution - 1});
+
+    if (glm::any(glm::greaterThan(clipped.min, clipped.max)))
+        return;
+
+    bool solid = (leaf.flags & voxel_flag_solid) != 0;
+    int3 cmin = voxel_chunk_coords(clipped.min);
+    int3 cmax = voxel_chunk_coords(clipped.max);
+
+    for (int cz = cmin.z; cz <= cmax.z; cz++)
+        for (int cy = cmin.y; cy <= cmax.y; cy++)
+            for (int cx = cmin.x; cx <= cmax.x; cx++)
+            {
+                int3 cc{cx, cy, cz};
+                voxel_chunk* chunk =
+                    solid ? voxel_world_touch_chunk(world, cc) : voxel_world_find_chunk(world, cc);
+
+                if (!chunk)
+                    continue;
+                chunk = chunk_for_write(world, chunk);
+
+                int3 base = cc * voxel_chunk_size;
+                int3 lo = glm::max(clipped.min - base, int3{0});
+                int3 hi = glm::min(clipped.max - base, int3{voxel_chunk_mask});
+
+                if (lo == int3{0} && hi == int3{voxel_chunk_mask})
+                {
+                    chunk_reset(chunk, leaf);
+                }
+                else
+                {
+                    voxel_chunk_fill_box(chunk, lo, hi, voxel_chunk_palette_add(chunk, leaf));
+                }
+
+                if (chunk->solid_count == 0)
+                    chunk_release(world, chunk);
+            }
+}
+
+void voxel_world_chunk_coords(const voxel_world* world, array<int3>* out_coords)
+{
+    out_coords->clear();
+    for (auto& kv : world->chunks)
+        out_coords->add(kv.second->coords);
+    for (auto& kv : world->encoded_chunks)
+        out_coords->add(encoded_chunk_coords(world, kv.second));
+}
+
+u64 voxel_world_solid_count(const voxel_world* world)
+{
+    u64 count = 0;
+    for (auto& kv : world->chunks)
+        count += kv.second->solid_count;
+    for (auto& kv : world->encoded_chunks)
+        count += world->source->view.chunks[kv.second].solid_count;
+    return count;
+}
+
+usize voxel_world_byte_size(const voxel_world* world)
+{
+    usize size = sizeof(voxel_world);
+    for (auto& kv : world->chunks)
+        size += voxel_chunk_byte_size(kv.second);
+    return size;
+}
+}
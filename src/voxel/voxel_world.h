@@ -0,0 +1,384 @@
+#pragma once
+
+#include "common/array.h"
+#include "common/geometry.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#if defined(VX_VOXEL_MORTON) && defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace vx
+{
+enum voxel_flag
+{
+    voxel_flag_solid = 1 << 0,
+};
+
+struct voxel_leaf
+{
+    float3 color;
+    u32 flags;
+};
+
+// Leaves are compared and hashed a field at a time. Leaves just built
+// by the caller are in stores of single fields, which wider loads would
+// have to wait for.
+inline u32 voxel_leaf_word(const voxel_leaf& leaf, int i)
+{
+    u32 w;
+    if (i < 3)
+        std::memcpy(&w, &leaf.color[i], sizeof w);
+    else
+        w = leaf.flags;
+    return w;
+}
+
+inline u32 voxel_leaf_hash(const voxel_leaf& leaf)
+{
+    u32 h = voxel_leaf_word(leaf, 0) * 0x9e3779b1u;
+    h = (h ^ voxel_leaf_word(leaf, 1)) * 0x85ebca6bu;
+    h = (h ^ voxel_leaf_word(leaf, 2)) * 0xc2b2ae35u;
+    h = (h ^ voxel_leaf_word(leaf, 3)) * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+// bitwise, unlike comparing the colors as floats
+inline bool voxel_leaf_equal(const voxel_leaf& a, const voxel_leaf& b)
+{
+    u32 diff = 0;
+    for (int i = 0; i < 4; i++)
+        diff |= voxel_leaf_word(a, i) ^ voxel_leaf_word(b, i);
+    return diff == 0;
+}
+
+//
+// chunks
+//
+
+constexpr i32 voxel_chunk_size_log2 = 5;
+constexpr i32 voxel_chunk_size = 1 << voxel_chunk_size_log2;
+constexpr i32 voxel_chunk_mask = voxel_chunk_size - 1;
+constexpr i32 voxel_chunk_volume = voxel_chunk_size * voxel_chunk_size * voxel_chunk_size;
+
+constexpr u32 voxel_chunk_not_saved = ~0u;
+
+// Voxels of a chunk are stored in row order, x then y then z, unless
+// VX_VOXEL_MORTON is defined. Morton order interleaves the bits of x, y and z
+// instead, so every aligned cube of 2^3k voxels is stored in one piece and
+// neighbors along y and z are close by as well. Code walking a chunk row by
+// row goes through the row functions below, which work with either order.
+#if defined(VX_VOXEL_MORTON)
+static_assert(voxel_chunk_size_log2 == 5, "Morton masks assume 32^3 chunks");
+
+// the 5 low bits of v moved to every third bit
+inline u32 voxel_morton_spread(u32 v)
+{
+#if defined(__BMI2__)
+    return _pdep_u32(v, 0x1249u);
+#else
+    v = (v | (v << 8)) & 0x100fu;
+    v = (v | (v << 4)) & 0x10c3u;
+    return (v | (v << 2)) & 0x1249u;
+#endif
+}
+
+// every third bit of v, the inverse of voxel_morton_spread
+inline u32 voxel_morton_compact(u32 v)
+{
+#if defined(__BMI2__)
+    return _pext_u32(v, 0x1249u);
+#else
+    v &= 0x1249u;
+    v = (v | (v >> 2)) & 0x10c3u;
+    v = (v | (v >> 4)) & 0x100fu;
+    return (v | (v >> 8)) & 0x1fu;
+#endif
+}
+
+inline i32 voxel_chunk_index(const int3& local)
+{
+    return i32(
+        voxel_morton_spread(u32(local.x)) | (voxel_morton_spread(u32(local.y)) << 1) |
+        (voxel_morton_spread(u32(local.z)) << 2));
+}
+
+inline int3 voxel_chunk_index_local(i32 i)
+{
+    return int3{voxel_morton_compact(u32(i)),
+                voxel_morton_compact(u32(i) >> 1),
+                voxel_morton_compact(u32(i) >> 2)};
+}
+
+constexpr const char* voxel_chunk_layout_name = "morton";
+#else
+inline i32 voxel_chunk_index(const int3& local)
+{
+    return local.x + (local.y << voxel_chunk_size_log2) + (local.z << (2 * voxel_chunk_size_log2));
+}
+
+inline int3 voxel_chunk_index_local(i32 i)
+{
+    return int3{i, i >> voxel_chunk_size_log2, i >> (2 * voxel_chunk_size_log2)} &
+           voxel_chunk_mask;
+}
+
+constexpr const char* voxel_chunk_layout_name = "row";
+#endif
+
+// voxels are stored as 1, 2, 4, 8 or 16 bit palette indices
+constexpr u32 voxel_chunk_max_index_bits_log2 = 4;
+static_assert(voxel_chunk_volume < 65535, "Palette indices must fit 16 bits");
+
+struct voxel_chunk
+{
+    int3 coords;
+    u32 solid_count;
+
+    // The world and the save snapshots sharing the chunk. A world copies a
+    // shared chunk before changing it, so snapshots never see it change.
+    u32 ref_count;
+
+    // chunk table index of the chunk in the source of its world, as long as
+    // the chunk is unchanged since it was decoded or saved
+    u32 saved_index;
+
+    // The distinct leaves of the chunk. Entry 0 is the empty leaf and all
+    // others are solid, so a voxel is solid when its index is not 0.
+    voxel_leaf* palette;
+    u32 palette_count;
+    u32 palette_capacity;
+
+    // the entry last added or found, voxels mostly repeat the one before
+    u32 palette_last;
+
+    // open addressing over palette, index + 1 or 0 for an empty slot
+    u16* palette_slots;
+    u32 palette_slot_count;
+
+    // Palette index of every voxel in voxel_chunk_index order, packed into
+    // fields of 1 << index_bits_log2 bits. Fields get wider as the palette
+    // grows and narrower when unused entries are dropped.
+    u32 index_bits_log2;
+    u32* indices;
+};
+
+void voxel_chunk_retain(voxel_chunk* chunk);
+void voxel_chunk_release(voxel_chunk* chunk);
+
+// Make dst a copy of src outside of any world, reusing the buffers of dst. dst
+// is either such a copy or zeroed memory, and its buffers are freed with
+// voxel_chunk_free_copy.
+void voxel_chunk_copy(voxel_chunk* dst, const voxel_chunk* src);
+void voxel_chunk_free_copy(voxel_chunk* chunk);
+
+// same as voxel_chunk_copy, from an empty chunk at chunk_coords
+void voxel_chunk_copy_empty(voxel_chunk* dst, const int3& chunk_coords);
+
+inline u32 voxel_chunk_palette_index(const voxel_chunk* chunk, i32 i)
+{
+    const u32 bits_log2 = chunk->index_bits_log2;
+    const u32 fields_log2 = 5 - bits_log2;
+    const u32 shift = (u32(i) & ((1u << fields_log2) - 1)) << bits_log2;
+    return (chunk->indices[i >> fields_log2] >> shift) & ((1u << (1u << bits_log2)) - 1);
+}
+
+inline bool voxel_chunk_is_solid(const voxel_chunk* chunk, i32 i)
+{
+    return voxel_chunk_palette_index(chunk, i) != 0;
+}
+
+inline const voxel_leaf& voxel_chunk_get(const voxel_chunk* chunk, i32 i)
+{
+    return chunk->palette[voxel_chunk_palette_index(chunk, i)];
+}
+
+// Store a palette index, keeping solid_count up to date.
+inline void voxel_chunk_set_index(voxel_chunk* chunk, i32 i, u32 index)
+{
+    const u32 bits_log2 = chunk->index_bits_log2;
+    const u32 fields_log2 = 5 - bits_log2;
+    const u32 shift = (u32(i) & ((1u << fields_log2) - 1)) << bits_log2;
+    const u32 mask = ((1u << (1u << bits_log2)) - 1) << shift;
+
+    u32& word = chunk->indices[i >> fields_log2];
+    chunk->solid_count += u32(index != 0) - u32((word & mask) != 0);
+    word = (word & ~mask) | (index << shift);
+}
+
+// Palette index of leaf, adding it to the palette if it is new. Empty
+// leaves are always 0. Adding may renumber the palette, so an index is
+// only good until the next add unless room was made with
+// voxel_chunk_palette_reserve first.
+u32 voxel_chunk_palette_add(voxel_chunk* chunk, const voxel_leaf& leaf);
+
+// make sure count more leaves can be added without renumbering the palette
+void voxel_chunk_palette_reserve(voxel_chunk* chunk, u32 count);
+
+inline void voxel_chunk_set(voxel_chunk* chunk, i32 i, const voxel_leaf& leaf)
+{
+    voxel_chunk_set_index(chunk, i, voxel_chunk_palette_add(chunk, leaf));
+}
+
+// Store index for count voxels from voxel first on, both in row order where
+// voxel x + (y + z * voxel_chunk_size) * voxel_chunk_size is number i.
+void voxel_chunk_set_run(voxel_chunk* chunk, i32 first, i32 count, u32 index);
+
+// store index for the voxels of the inclusive box [lo, hi] of local coordinates
+void voxel_chunk_fill_box(voxel_chunk* chunk, const int3& lo, const int3& hi, u32 index);
+
+// Solid voxels of row y + z * voxel_chunk_size, bit x for voxel x.
+u32 voxel_chunk_solid_row(const voxel_chunk* chunk, i32 row);
+
+// palette indices of the voxels of row y + z * voxel_chunk_size
+inline void voxel_chunk_row_indices(const voxel_chunk* chunk, i32 row, u32* out)
+{
+#if defined(VX_VOXEL_MORTON)
+    const i32 first =
+        voxel_chunk_index(int3{0, row & voxel_chunk_mask, row >> voxel_chunk_size_log2});
+    for (u32 x = 0; x < voxel_chunk_size; x++)
+        out[x] = voxel_chunk_palette_index(chunk, first | i32(voxel_morton_spread(x)));
+#else
+    const u32 bits_log2 = chunk->index_bits_log2;
+    const u32 fields_log2 = 5 - bits_log2;
+    const u32 mask = (1u << (1u << bits_log2)) - 1;
+    const u32* words = chunk->indices + (row << bits_log2);
+    for (u32 x = 0; x < voxel_chunk_size; x++)
+        out[x] = (words[x >> fields_log2] >> ((x & ((1u << fields_log2) - 1)) << bits_log2)) & mask;
+#endif
+}
+
+// The runs of set bits of free with a bit of seeds in them, seeds being within
+// free. Spreads fills along a row 32 voxels at a time.
+inline u32 voxel_row_fill_runs(u32 seeds, u32 free)
+{
+    u32 up = seeds;
+    u32 f = free;
+    up |= (up << 1) & f;
+    f &= f << 1;
+    up |= (up << 2) & f;
+    f &= f << 2;
+    up |= (up << 4) & f;
+    f &= f << 4;
+    up |= (up << 8) & f;
+    f &= f << 8;
+    up |= (up << 16) & f;
+
+    u32 down = seeds;
+    f = free;
+    down |= (down >> 1) & f;
+    f &= f >> 1;
+    down |= (down >> 2) & f;
+    f &= f >> 2;
+    down |= (down >> 4) & f;
+    f &= f >> 4;
+    down |= (down >> 8) & f;
+    f &= f >> 8;
+    down |= (down >> 16) & f;
+
+    return up | down;
+}
+
+usize voxel_chunk_byte_size(const voxel_chunk* chunk);
+
+inline int3 voxel_chunk_coords(const int3& p) { return p >> voxel_chunk_size_log2; }
+
+inline int3 voxel_chunk_local(const int3& p) { return p & voxel_chunk_mask; }
+
+
+inline u64 voxel_chunk_key(const int3& chunk_coords)
+{
+    return (u64(u32(chunk_coords.x) & 0x1fffff) << 0) |
+           (u64(u32(chunk_coords.y) & 0x1fffff) << 21) |
+           (u64(u32(chunk_coords.z) & 0x1fffff) << 42);
+}
+
+//
+// world
+//
+
+struct voxel_file_source;
+
+// Mesh vertices store the corners 0..resolution of the voxels in 12 bits, see
+// voxel_vertex, so worlds are not made any larger.
+constexpr i32 voxel_world_max_resolution = (1 << 12) - 1;
+
+// A cube of resolution^3 voxels. Storage is split into fixed-size chunks which
+// are only allocated while they contain at least one solid voxel, so memory
+// scales with the occupied space rather than with the bounding cube.
+//
+// A world loaded from a scene file keeps its chunks encoded in the mapped
+// file at first. Looking a chunk up decodes it into chunks, so only the chunks
+// that are actually used get read from disk and decoded.
+struct voxel_world
+{
+    i32 resolution;
+    std::unordered_map<u64, voxel_chunk*> chunks;
+
+    // The scene file the world was last loaded from or saved to, null if
+    // none. Holds the chunks not decoded yet and lets saving copy the
+    // encoding of chunks that did not change.
+    voxel_file_source* source;
+
+    // chunk table indices into source by key, for chunks not decoded yet
+    std::unordered_map<u64, u32> encoded_chunks;
+
+    // chunks of source that failed to decode since the world was last
+    // cleared, they read as empty
+    u32 corrupt_chunk_count;
+};
+
+// resolution is clamped to voxel_world_max_resolution
+voxel_world* voxel_world_create(i32 resolution);
+void voxel_world_destroy(voxel_world* world);
+
+// drop all voxels
+void voxel_world_clear(voxel_world* world);
+
+// Change the resolution, clamped to voxel_world_max_resolution. Voxels outside
+// of the new bounds are dropped.
+void voxel_world_resize(voxel_world* world, i32 resolution);
+
+// make dst an exact copy of src, reusing the chunks dst already owns
+void voxel_world_copy(voxel_world* dst, const voxel_world* src);
+
+// exchange the contents of a and b
+void voxel_world_swap(voxel_world* a, voxel_world* b);
+
+// Decodes the chunk if it is still encoded, a chunk that fails to decode is
+// dropped and counted in corrupt_chunk_count. The world is logically const,
+// but looking up chunks from several threads at once is not safe.
+voxel_chunk* voxel_world_find_chunk(const voxel_world* world, const int3& chunk_coords);
+
+// Find the chunk for changing it, allocating an empty one if it does not
+// exist yet. A chunk shared with a snapshot is replaced by a copy first.
+voxel_chunk* voxel_world_touch_chunk(voxel_world* world, const int3& chunk_coords);
+
+inline bool voxel_world_contains(const voxel_world* world, const int3& p)
+{
+    return p.x >= 0 && p.y >= 0 && p.z >= 0 && p.x < world->resolution &&
+           p.y < world->resolution && p.z < world->resolution;
+}
+
+// returns an empty leaf for coordinates outside of the world or in unallocated chunks
+voxel_leaf voxel_world_get(const voxel_world* world, const int3& p);
+
+bool voxel_world_is_solid(const voxel_world* world, const int3& p);
+
+// coordinates outside of the world are ignored
+void voxel_world_set(voxel_world* world, const int3& p, const voxel_leaf& leaf);
+
+// set every voxel in the inclusive box [b.min, b.max], clipped to the world
+void voxel_world_fill(voxel_world* world, const bounds3i& b, const voxel_leaf& leaf);
+
+// coords of all chunks, decoded or not
+void voxel_world_chunk_coords(const voxel_world* world, array<int3>* out_coords);
+
+// Chunks not decoded yet count with the solid count of their chunk table
+// entry, which is checked against the voxels once they are decoded.
+u64 voxel_world_solid_count(const voxel_world* world);
+
+usize voxel_world_byte_size(const voxel_world* world);
+}